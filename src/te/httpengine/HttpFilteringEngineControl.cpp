@@ -93,7 +93,9 @@ namespace te
 			util::cb::MessageFunction onWarn,
 			util::cb::MessageFunction onError,
 			util::cb::RequestBlockFunction onRequestBlocked,
-			util::cb::ElementBlockFunction onElementsBlocked
+			util::cb::ElementBlockFunction onElementsBlocked,
+			std::string certificateCachePath,
+			std::vector<unsigned char> certificateCacheKey
 			)
 			:
 			util::cb::EventReporter(onInfo, onWarn, onError),			
@@ -110,7 +112,26 @@ namespace te
 			{
 				// XXX TODO - Make a factory for cert store so we don't have this horrible mess everywhere.
 				#if BOOST_OS_WINDOWS
-					m_store.reset(new mitm::secure::WindowsInMemoryCertificateStore(u8"CA", u8"Http Filtering Engine", u8"Http Filtering Engine"));
+					if (!certificateCachePath.empty())
+					{
+						// The cache can swap out the CA, so it's handed to the store at
+						// construction, before anything is minted with it or trusts it.
+						try
+						{
+							m_store.reset(new mitm::secure::WindowsInMemoryCertificateStore(u8"CA", u8"Http Filtering Engine", u8"Http Filtering Engine", certificateCachePath, certificateCacheKey));
+						}
+						catch (std::exception& e)
+						{
+							std::string warning(u8"In HttpFilteringEngineControl::HttpFilteringEngineControl(...) - Carrying on without the certificate cache: ");
+							warning.append(e.what());
+							ReportWarning(warning);
+						}
+					}
+
+					if (m_store == nullptr)
+					{
+						m_store.reset(new mitm::secure::WindowsInMemoryCertificateStore(u8"CA", u8"Http Filtering Engine", u8"Http Filtering Engine"));
+					}
 				#elif BOOST_OS_ANDROID
 					You poor guy.You didn't write a cert store for Android. Are you new?
 				#else
@@ -155,6 +176,11 @@ namespace te
 					m_service->reset();
 				}				
 
+				if (m_hostResolver == nullptr)
+				{
+					m_hostResolver.reset(new network::HostResolver());
+				}
+
 				m_httpAcceptor.reset(
 					new mitm::secure::TcpAcceptor(
 						m_service.get(),
@@ -162,6 +188,7 @@ namespace te
 						m_httpListenerPort,
 						m_caBundleAbsolutePath,
 						nullptr,
+						m_hostResolver.get(),
 						m_onInfo,
 						m_onWarning,
 						m_onError
@@ -179,6 +206,7 @@ namespace te
 						m_httpsListenerPort,
 						m_caBundleAbsolutePath,
 						m_store.get(),
+						m_hostResolver.get(),
 						m_onInfo,
 						m_onWarning,
 						m_onError
@@ -381,6 +409,120 @@ namespace te
 			return{};
 		}
 
+		network::HostResolver::Statistics HttpFilteringEngineControl::GetHostResolverStatistics() const
+		{
+			if (m_hostResolver)
+			{
+				return m_hostResolver->GetStatistics();
+			}
+
+			return{};
+		}
+
+		mitm::secure::UpstreamSessionCache::Statistics HttpFilteringEngineControl::GetUpstreamSessionStatistics() const
+		{
+			if (m_httpsAcceptor)
+			{
+				return m_httpsAcceptor->GetUpstreamSessionStatistics();
+			}
+
+			return{};
+		}
+
+		mitm::secure::TlsAcceptor::DownstreamSessionStatistics HttpFilteringEngineControl::GetDownstreamSessionStatistics() const
+		{
+			if (m_httpsAcceptor)
+			{
+				return m_httpsAcceptor->GetDownstreamSessionStatistics();
+			}
+
+			return{};
+		}
+
+		void HttpFilteringEngineControl::SetDownstreamSessionCacheSize(const uint32_t size)
+		{
+			if (m_store)
+			{
+				m_store->SetServerSessionCacheSize(static_cast<size_t>(size));
+			}
+		}
+
+		const uint32_t HttpFilteringEngineControl::GetDownstreamSessionCacheSize() const
+		{
+			if (m_store)
+			{
+				return static_cast<uint32_t>(m_store->GetServerSessionCacheSize());
+			}
+
+			return 0;
+		}
+
+		mitm::secure::BaseInMemoryCertificateStore::ContextCacheStatistics HttpFilteringEngineControl::GetServerContextCacheStatistics() const
+		{
+			if (m_store)
+			{
+				return m_store->GetContextCacheStatistics();
+			}
+
+			return{};
+		}
+
+		mitm::secure::BaseInMemoryCertificateStore::MintStatistics HttpFilteringEngineControl::GetMintStatistics() const
+		{
+			if (m_store)
+			{
+				return m_store->GetMintStatistics();
+			}
+
+			return{};
+		}
+
+		void HttpFilteringEngineControl::SetSharedLeafKeyEnabled(const bool enabled)
+		{
+			if (m_store)
+			{
+				m_store->SetSharedLeafKeyEnabled(enabled);
+			}
+		}
+
+		const bool HttpFilteringEngineControl::GetSharedLeafKeyEnabled() const
+		{
+			if (m_store)
+			{
+				return m_store->GetSharedLeafKeyEnabled();
+			}
+
+			return false;
+		}
+
+		void HttpFilteringEngineControl::SetPrewarmHostCount(const uint32_t count)
+		{
+			if (m_store)
+			{
+				m_store->SetPrewarmHostCount(static_cast<size_t>(count));
+			}
+		}
+
+		const uint32_t HttpFilteringEngineControl::GetPrewarmHostCount() const
+		{
+			if (m_store)
+			{
+				return static_cast<uint32_t>(m_store->GetPrewarmHostCount());
+			}
+
+			return 0;
+		}
+
+		mitm::secure::BaseInMemoryCertificateStore::PrewarmStatistics HttpFilteringEngineControl::GetPrewarmStatistics() const
+		{
+			if (m_store)
+			{
+				return m_store->GetPrewarmStatistics();
+			}
+
+			return{};
+		}
+
 		void HttpFilteringEngineControl::UnloadRulesForCategory(const uint8_t category)
 		{
 			if (m_httpFilteringEngine != nullptr && category != 0)
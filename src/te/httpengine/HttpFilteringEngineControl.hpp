@@ -36,6 +36,7 @@
 #include <functional>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 #include "util/cb/EventReporter.hpp"
 #include "mitm/secure/TlsCapableHttpAcceptor.hpp"
@@ -134,6 +135,17 @@ namespace te
 			/// generated by the underlying Engine. Default is nullptr. This callback cannot be
 			/// supplied post-construction.
 			/// </param>
+			/// <param name="certificateCachePath">
+			/// The path of a file to keep the CA and the certificates spoofed with it in, so that
+			/// they survive a restart, sparing clients a fresh certificate for every host and the
+			/// Engine from minting them all over again. Default is empty, which keeps nothing.
+			/// </param>
+			/// <param name="certificateCacheKey">
+			/// The key the certificate cache file is encrypted with, which must be 32 bytes. Keep
+			/// it somewhere safer than next to the file, since anyone with both can issue
+			/// certificates the OS trusts. If the cache can't be opened with it, the Engine
+			/// carries on without one, and says so through onWarn.
+			/// </param>
 			HttpFilteringEngineControl(
 				util::cb::FirewallCheckFunction firewallCb,
 				std::string caBundleAbsolutePath = std::string(u8"none"),
@@ -145,7 +157,9 @@ namespace te
 				util::cb::MessageFunction onWarn = nullptr,
 				util::cb::MessageFunction onError = nullptr,
 				util::cb::RequestBlockFunction onRequestBlocked = nullptr,
-				util::cb::ElementBlockFunction onElementsBlocked = nullptr
+				util::cb::ElementBlockFunction onElementsBlocked = nullptr,
+				std::string certificateCachePath = std::string(),
+				std::vector<unsigned char> certificateCacheKey = std::vector<unsigned char>()
 				);
 
 			/// <summary>
@@ -394,6 +408,118 @@ namespace te
 			/// </returns>
 			std::vector<char> GetRootCertificatePEM() const;
 
+			/// <summary>
+			/// Gets a snapshot of the upstream host name cache counters.
+			/// </summary>
+			/// <returns>
+			/// The cache counters. All zero if the proxy has never been started.
+			/// </returns>
+			network::HostResolver::Statistics GetHostResolverStatistics() const;
+
+			/// <summary>
+			/// Gets a snapshot of the upstream TLS session cache counters. The session
+			/// resumption rate is the number of resumed handshakes over the number of
+			/// handshakes.
+			/// </summary>
+			/// <returns>
+			/// The cache counters. All zero if the proxy isn't running.
+			/// </returns>
+			mitm::secure::UpstreamSessionCache::Statistics GetUpstreamSessionStatistics() const;
+
+			/// <summary>
+			/// Gets a snapshot of the downstream TLS session resumption counters, that is,
+			/// how many clients skipped the full handshake with us by resuming a session.
+			/// </summary>
+			/// <returns>
+			/// The resumption counters. All zero if the proxy isn't running.
+			/// </returns>
+			mitm::secure::TlsAcceptor::DownstreamSessionStatistics GetDownstreamSessionStatistics() const;
+
+			/// <summary>
+			/// Sets the maximum number of downstream TLS sessions held in the server side
+			/// session cache. Takes effect the next time the Engine is started.
+			/// </summary>
+			/// <param name="size">
+			/// The maximum number of sessions to hold. Zero means no limit.
+			/// </param>
+			void SetDownstreamSessionCacheSize(const uint32_t size);
+
+			/// <summary>
+			/// Gets the maximum number of downstream TLS sessions held in the server side
+			/// session cache.
+			/// </summary>
+			/// <returns>
+			/// The maximum number of sessions held.
+			/// </returns>
+			const uint32_t GetDownstreamSessionCacheSize() const;
+
+			/// <summary>
+			/// Gets a snapshot of the spoofed certificate context cache counters, including
+			/// the number of contexts held and a rough measure of the memory they hold.
+			/// </summary>
+			/// <returns>
+			/// The cache counters.
+			/// </returns>
+			mitm::secure::BaseInMemoryCertificateStore::ContextCacheStatistics GetServerContextCacheStatistics() const;
+
+			/// <summary>
+			/// Gets a snapshot of the spoofed certificate minting counters, including the
+			/// distribution of the time minting adds to the first handshake with a new host.
+			/// </summary>
+			/// <returns>
+			/// The minting counters.
+			/// </returns>
+			mitm::secure::BaseInMemoryCertificateStore::MintStatistics GetMintStatistics() const;
+
+			/// <summary>
+			/// Sets whether or not every spoofed certificate is issued over one long lived
+			/// leaf key, rather than a key of its own, which makes minting certificates for
+			/// new hosts considerably cheaper. Only applies to hosts first seen from here on.
+			/// </summary>
+			/// <param name="enabled">
+			/// Whether or not to issue every spoofed certificate over the shared leaf key.
+			/// </param>
+			void SetSharedLeafKeyEnabled(const bool enabled);
+
+			/// <summary>
+			/// Gets whether or not every spoofed certificate is issued over one long lived
+			/// leaf key.
+			/// </summary>
+			/// <returns>
+			/// True if spoofed certificates share a leaf key, false otherwise.
+			/// </returns>
+			const bool GetSharedLeafKeyEnabled() const;
+
+			/// <summary>
+			/// Sets the number of the hosts clients ask for most often to keep spoofed
+			/// certificates ready for, so that clients connecting to them never wait on one
+			/// being minted. Certificates are made ready in the background, on startup when a
+			/// certificate cache file was supplied, and every so often after. Zero turns this
+			/// off.
+			/// </summary>
+			/// <param name="count">
+			/// The number of hosts to keep certificates ready for.
+			/// </param>
+			void SetPrewarmHostCount(const uint32_t count);
+
+			/// <summary>
+			/// Gets the number of the hosts clients ask for most often to keep spoofed
+			/// certificates ready for.
+			/// </summary>
+			/// <returns>
+			/// The number of hosts to keep certificates ready for.
+			/// </returns>
+			const uint32_t GetPrewarmHostCount() const;
+
+			/// <summary>
+			/// Gets a snapshot of the prewarming counters, including how many certificates
+			/// made ready ahead of time went on to be used.
+			/// </summary>
+			/// <returns>
+			/// The prewarming counters.
+			/// </returns>
+			mitm::secure::BaseInMemoryCertificateStore::PrewarmStatistics GetPrewarmStatistics() const;
+
 			/// <summary>
 			/// Unloads and and all rules created for the given category.
 			/// </summary>
@@ -472,6 +598,12 @@ namespace te
 			/// </summary>
 			std::unique_ptr<boost::asio::io_service> m_service = nullptr;
 
+			/// <summary>
+			/// The process-wide host resolver and cache shared by every bridge. Declared
+			/// after the io_service so that its lookup threads are stopped first.
+			/// </summary>
+			std::unique_ptr<network::HostResolver> m_hostResolver = nullptr;
+
 			/// <summary>
 			/// The certificate store that will be used for secure clients.
 			/// </summary>
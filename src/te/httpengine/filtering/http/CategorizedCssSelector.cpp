@@ -30,7 +30,11 @@
 */
 
 #include "CategorizedCssSelector.hpp"
+#include <array>
+#include <mutex>
+#include <stdexcept>
 #include <Parser.hpp>
+
 namespace te
 {
 	namespace httpengine
@@ -40,38 +44,112 @@ namespace te
 			namespace http
 			{
 
-				CategorizedCssSelector::CategorizedCssSelector(boost::string_ref domains, std::string selectorString, const uint8_t category)
-					:m_domains(domains), m_category(category)
+				namespace
 				{
-					gq::Parser parser;
+					using ScopedLock = std::lock_guard<std::mutex>;
+
+					/// <summary>
+					/// Compilation is serialized per selector through a fixed set of striped mutexes,
+					/// rather than a mutex per selector. There are tens of thousands of selectors and
+					/// compiling is rare, so contention on a shared stripe is a non-issue, while a
+					/// mutex for every selector would eat a good chunk of the memory that lazy
+					/// compilation is meant to save.
+					/// </summary>
+					std::array<std::mutex, 64> s_compileLocks;
 
-					// This can throw std::runtime_error!
-					m_compiledSelector = parser.CreateSelector(selectorString, true);
+					inline std::mutex& GetCompileLock(const void* selector)
+					{
+						return s_compileLocks[(reinterpret_cast<uintptr_t>(selector) >> 4) % s_compileLocks.size()];
+					}
 				}
 
-				CategorizedCssSelector::~CategorizedCssSelector()
+				CategorizedCssSelector::CategorizedCssSelector(boost::string_ref domains, boost::string_ref selectorString, const uint8_t category)
+					:m_category(category), m_selectorString(selectorString), m_domains(domains)
 				{
+					
+				}
 
+				CategorizedCssSelector::~CategorizedCssSelector()
+				{
+					delete m_compiled.load();
 				}
 
 				const boost::string_ref CategorizedCssSelector::GetOriginalSelectorString() const
 				{
-					if (m_compiledSelector != nullptr)
+					return m_selectorString;
+				}
+
+				const uint8_t CategorizedCssSelector::GetCategory() const
+				{
+					return m_category;
+				}
+
+				const CompiledCssSelector* CategorizedCssSelector::GetCompiled(const uint32_t now)
+				{
+					m_lastUsed.store(now, std::memory_order_relaxed);
+
+					auto compiled = m_compiled.load(std::memory_order_acquire);
+
+					if (compiled != nullptr || m_invalid)
 					{
-						return m_compiledSelector->GetOriginalSelectorString();
+						return compiled;
 					}
 
-					return boost::string_ref();
+					ScopedLock lock(GetCompileLock(this));
+
+					// Someone may have beaten us to it while we were waiting.
+					compiled = m_compiled.load(std::memory_order_acquire);
+
+					if (compiled != nullptr || m_invalid)
+					{
+						return compiled;
+					}
+
+					std::unique_ptr<CompiledCssSelector> result(new CompiledCssSelector());
+
+					try
+					{
+						gq::Parser parser;
+
+						// This can throw std::runtime_error!
+						result->selector = parser.CreateSelector(m_selectorString.to_string(), true);
+					}
+					catch (...)
+					{
+						m_invalid = true;
+						throw;
+					}
+
+					// This never throws. If it isn't simple, we get nullptr.
+					result->simpleSelector = SimpleHtmlSelector::Create(m_selectorString);
+
+					compiled = result.release();
+					m_compiled.store(compiled, std::memory_order_release);
+
+					return compiled;
 				}
 
-				const uint8_t CategorizedCssSelector::GetCategory() const
+				const CompiledCssSelector* CategorizedCssSelector::GetCompiledIfPresent() const
 				{
-					return m_category;
+					return m_compiled.load(std::memory_order_acquire);
 				}
 
-				const gq::SharedSelector& CategorizedCssSelector::GetSelector() const
+				const bool CategorizedCssSelector::Evict(const uint32_t unusedSince)
 				{
-					return m_compiledSelector;
+					if (m_lastUsed.load(std::memory_order_relaxed) >= unusedSince)
+					{
+						return false;
+					}
+
+					auto compiled = m_compiled.exchange(nullptr);
+
+					if (compiled == nullptr)
+					{
+						return false;
+					}
+
+					delete compiled;
+					return true;
 				}
 
 				const boost::string_ref CategorizedCssSelector::GetDomains() const
@@ -31,10 +31,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <boost/utility/string_ref.hpp>
 #include <Selector.hpp>
-#include <Parser.hpp>
-#include <memory>
+#include "SimpleHtmlSelector.hpp"
 
 namespace te
 {
@@ -45,26 +47,76 @@ namespace te
 			namespace http
 			{
 
+				/// <summary>
+				/// Holds the compiled forms of a CategorizedCssSelector.
+				/// </summary>
+				struct CompiledCssSelector
+				{
+					/// <summary>
+					/// The compiled GQ selector. Always valid.
+					/// </summary>
+					gq::SharedSelector selector = nullptr;
+
+					/// <summary>
+					/// The selector compiled for use with the StreamingHtmlRewriter, if the
+					/// selector is simple enough to be evaluated while tokenizing. Most ABP
+					/// selectors are plain class, id and attribute selectors, so this will be
+					/// available far more often than not. Otherwise nullptr, meaning that the
+					/// selector can only be handled by running the GQ selector against a complete
+					/// document.
+					/// </summary>
+					std::shared_ptr<SimpleHtmlSelector> simpleSelector = nullptr;
+				};
+
 				/// <summary>
 				/// The CategorizedCssSelector class serves as a lightweight wrapper around the
 				/// Selector object from the third-party library GQ. In order to sort and store
 				/// selectors based on the category that they belong to, such a wrapper is necessary.
 				/// 
+				/// Compilation of the selector is deferred until the selector is first needed.
+				/// Lists such as EasyList contain tens of thousands of domain specific selectors,
+				/// and the overwhelming majority of them are for sites that any one user will
+				/// never visit. Compiling them all up front is a large part of startup time and
+				/// memory use for no benefit. So, the raw selector string is simply kept, wrapped
+				/// by a string_ref into storage owned by the engine, until ::GetCompiled(...) is
+				/// called. Compiled forms that go unused for long enough may be thrown away again
+				/// with ::Evict(...), and will simply be rebuilt if ever needed again.
+				/// 
 				/// The GQ Selector class represents a "compiled" CSS selector. This object is built
 				/// by the GQ Parser object, which can throw naturally because it attempts to parse
-				/// external user input. Since the CategorizedCssSelector accepts a raw selector
-				/// string as input, construction of this object should be handled in an appropriate
-				/// try/catch. GQ doesn't specify any custom exception classes, and as such simply
-				/// throws all exceptions in std::runtime_error structures. The ::what() member
-				/// contains detailed information for the exception, including precisely where the
-				/// exception originated from.
+				/// external user input. GQ doesn't specify any custom exception classes, and as
+				/// such simply throws all exceptions in std::runtime_error structures. The ::what()
+				/// member contains detailed information for the exception, including precisely
+				/// where the exception originated from. Because compilation is deferred, this
+				/// means that ::GetCompiled(...) can throw, rather than the constructor.
 				/// </summary>
 				class CategorizedCssSelector
 				{
 					
 				public:
 
-					CategorizedCssSelector(boost::string_ref domains, std::string selectorString, const uint8_t category);
+					/// <summary>
+					/// Constructs a new, uncompiled selector.
+					/// </summary>
+					/// <param name="domains">
+					/// The domains that the selector applies to. The string wrapped must outlive
+					/// this object.
+					/// </param>
+					/// <param name="selectorString">
+					/// The raw selector string. The string wrapped must outlive this object.
+					/// </param>
+					/// <param name="category">
+					/// The category that the selector belongs to.
+					/// </param>
+					CategorizedCssSelector(boost::string_ref domains, boost::string_ref selectorString, const uint8_t category);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					CategorizedCssSelector(const CategorizedCssSelector&) = delete;
+					CategorizedCssSelector(CategorizedCssSelector&&) = delete;
+					CategorizedCssSelector& operator=(const CategorizedCssSelector&) = delete;
+
 					~CategorizedCssSelector();
 
 					/// <summary>
@@ -87,12 +139,51 @@ namespace te
 					const uint8_t GetCategory() const;
 
 					/// <summary>
-					/// Gets the underlying compiled shared GQ Selector object.
+					/// Gets the compiled forms of this selector, compiling them first if this is the
+					/// first use of the selector, or the first use since it was evicted. This is
+					/// safe to call from any number of threads at once. Exactly one caller will
+					/// perform compilation, and every other caller will wait for and share the
+					/// result.
+					/// 
+					/// If compilation fails, the std::runtime_error thrown by GQ is propagated, but
+					/// only to the one caller that attempted compilation. The selector is then
+					/// permanently marked as invalid, and every subsequent call returns nullptr.
+					/// 
+					/// The returned pointer remains valid until ::Evict(...) is called, which must
+					/// never happen while any other thread may be using this object.
 					/// </summary>
+					/// <param name="now">
+					/// The current time, in seconds, as supplied by the engine. Used to record when
+					/// the selector was last used, for the purpose of eviction.
+					/// </param>
 					/// <returns>
-					/// The underlying compiled shared GQ Selector.
+					/// The compiled forms of the selector, or nullptr if the selector is invalid.
 					/// </returns>
-					const gq::SharedSelector& GetSelector() const;
+					const CompiledCssSelector* GetCompiled(const uint32_t now);
+
+					/// <summary>
+					/// Gets the compiled forms of this selector if it is currently compiled, without
+					/// compiling it or marking it as used.
+					/// </summary>
+					/// <returns>
+					/// The compiled forms of the selector if currently compiled, nullptr otherwise.
+					/// </returns>
+					const CompiledCssSelector* GetCompiledIfPresent() const;
+
+					/// <summary>
+					/// Throws away the compiled forms of this selector if it has not been used since
+					/// the supplied time. The caller must guarantee that no other thread is using
+					/// this object, or any pointer previously returned by ::GetCompiled(...), for the
+					/// duration of this call.
+					/// </summary>
+					/// <param name="unusedSince">
+					/// The time, in seconds, as supplied to ::GetCompiled(...). If the selector has not
+					/// been used at or after this time, the compiled forms are released.
+					/// </param>
+					/// <returns>
+					/// True if compiled forms were released, false otherwise.
+					/// </returns>
+					const bool Evict(const uint32_t unusedSince);
 
 					/// <summary>
 					/// If the selector is a donain specific selector, retrieves the domains for the
@@ -116,13 +207,26 @@ namespace te
 					uint8_t m_category = 0;
 
 					/// <summary>
-					/// If the selector string supplied during object construction is considered to
-					/// be complex, then a selector engine object will be built. Complex selectors
-					/// must run through a selector engine to be handled correctly.
-					/// 
-					/// If the selector is trivial, this member will remain nullptr.
+					/// Set once compilation of the selector has failed, so that we never try again.
+					/// </summary>
+					std::atomic_bool m_invalid{ false };
+
+					/// <summary>
+					/// The last time, in seconds, that the compiled forms were requested.
+					/// </summary>
+					std::atomic<uint32_t> m_lastUsed{ 0 };
+
+					/// <summary>
+					/// The compiled forms of the selector, or nullptr if the selector has not yet
+					/// been compiled. Owned by this object. Published atomically so that readers
+					/// never need to take a lock once the selector is compiled.
+					/// </summary>
+					std::atomic<CompiledCssSelector*> m_compiled{ nullptr };
+
+					/// <summary>
+					/// The raw selector string, wrapping storage owned by the engine.
 					/// </summary>
-					gq::SharedSelector m_compiledSelector = nullptr;
+					boost::string_ref m_selectorString;
 
 					/// <summary>
 					/// If this is a domain specific selector, then this string contains one or more
@@ -0,0 +1,192 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HostSelectorCache.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				size_t HostSelectorSet::GetMemoryUsage() const
+				{
+					// Close enough. Hash set nodes hold the value plus a next pointer and a cached
+					// hash, and the buckets array holds another pointer per bucket.
+					return sizeof(HostSelectorSet) +
+						(includes.capacity() * sizeof(const CompiledCssSelector*)) +
+						(exceptions.capacity() * sizeof(const CompiledCssSelector*)) +
+						((includeStrings.size() + exceptionStrings.size()) * (sizeof(boost::string_ref) + (sizeof(void*) * 2))) +
+						((includeStrings.bucket_count() + exceptionStrings.bucket_count()) * sizeof(void*));
+				}
+
+				HostSelectorCache::HostSelectorCache(const size_t maxBytes) : m_maxBytes(maxBytes)
+				{
+
+				}
+
+				HostSelectorCache::~HostSelectorCache()
+				{
+
+				}
+
+				SharedHostSelectorSet HostSelectorCache::Get(boost::string_ref host, const uint32_t categoryGeneration)
+				{
+					ScopedLock lock(m_lock);
+
+					auto result = m_index.find(host);
+
+					if (result == m_index.end())
+					{
+						++m_misses;
+						return nullptr;
+					}
+
+					if (result->second->set->categoryGeneration != categoryGeneration)
+					{
+						// Stale. Categories were enabled or disabled since this was built.
+						Remove(result->second);
+						++m_misses;
+						return nullptr;
+					}
+
+					// Move to the front, most recently used.
+					m_entries.splice(m_entries.begin(), m_entries, result->second);
+
+					++m_hits;
+					return result->second->set;
+				}
+
+				void HostSelectorCache::Put(boost::string_ref host, SharedHostSelectorSet set)
+				{
+					if (set == nullptr)
+					{
+						return;
+					}
+
+					const size_t bytes = set->GetMemoryUsage() + sizeof(Entry) + host.size();
+
+					ScopedLock lock(m_lock);
+
+					auto existing = m_index.find(host);
+
+					if (existing != m_index.end())
+					{
+						Remove(existing->second);
+					}
+
+					if (bytes > m_maxBytes)
+					{
+						return;
+					}
+
+					m_entries.push_front(Entry{ host.to_string(), std::move(set), bytes });
+					m_index.insert({ boost::string_ref(m_entries.front().host), m_entries.begin() });
+					m_bytes += bytes;
+
+					Trim();
+				}
+
+				void HostSelectorCache::Clear()
+				{
+					ScopedLock lock(m_lock);
+
+					m_index.clear();
+					m_entries.clear();
+					m_bytes = 0;
+				}
+
+				void HostSelectorCache::Prune(const uint32_t unusedSince, std::unordered_set<const CompiledCssSelector*>& retained)
+				{
+					ScopedLock lock(m_lock);
+
+					for (auto it = m_entries.begin(); it != m_entries.end();)
+					{
+						if (it->set->lastUsed < unusedSince)
+						{
+							Remove(it++);
+							continue;
+						}
+
+						retained.insert(it->set->includes.begin(), it->set->includes.end());
+						retained.insert(it->set->exceptions.begin(), it->set->exceptions.end());
+						++it;
+					}
+				}
+
+				void HostSelectorCache::SetMaxBytes(const size_t maxBytes)
+				{
+					ScopedLock lock(m_lock);
+
+					m_maxBytes = maxBytes;
+
+					Trim();
+				}
+
+				const uint64_t HostSelectorCache::GetHits() const
+				{
+					return m_hits;
+				}
+
+				const uint64_t HostSelectorCache::GetMisses() const
+				{
+					return m_misses;
+				}
+
+				const size_t HostSelectorCache::GetMemoryUsage() const
+				{
+					ScopedLock lock(m_lock);
+
+					return m_bytes;
+				}
+
+				void HostSelectorCache::Trim()
+				{
+					while (m_bytes > m_maxBytes && m_entries.size() > 0)
+					{
+						Remove(std::prev(m_entries.end()));
+					}
+				}
+
+				void HostSelectorCache::Remove(EntryList::iterator entry)
+				{
+					m_bytes -= entry->bytes;
+					m_index.erase(boost::string_ref(entry->host));
+					m_entries.erase(entry);
+				}
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
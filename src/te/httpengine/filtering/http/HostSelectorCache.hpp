@@ -0,0 +1,336 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+#include "../../../util/string/StringRefUtil.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Forward decl for compiled selectors.
+				/// </summary>
+				struct CompiledCssSelector;
+
+				/// <summary>
+				/// The precomputed set of compiled selectors that apply to a single key, either a
+				/// host or the global rule key, given the categories enabled at the time it was
+				/// built. Selectors belonging to disabled categories, selectors that failed to
+				/// compile and selectors whose text duplicates another selector in the set are all
+				/// omitted.
+				/// 
+				/// Both vectors are partitioned so that every selector which has a streaming form
+				/// comes first. This lets the engine decide how to split selectors between the
+				/// StreamingHtmlRewriter and GQ without touching each selector again.
+				/// </summary>
+				struct HostSelectorSet
+				{
+					/// <summary>
+					/// Every applicable inclusion selector. The first simpleIncludeCount entries
+					/// have a streaming form.
+					/// </summary>
+					std::vector<const CompiledCssSelector*> includes;
+
+					/// <summary>
+					/// Every applicable exception selector. The first simpleExceptionCount entries
+					/// have a streaming form.
+					/// </summary>
+					std::vector<const CompiledCssSelector*> exceptions;
+
+					/// <summary>
+					/// The number of leading entries in includes with a streaming form.
+					/// </summary>
+					size_t simpleIncludeCount = 0;
+
+					/// <summary>
+					/// The number of leading entries in exceptions with a streaming form.
+					/// </summary>
+					size_t simpleExceptionCount = 0;
+
+					/// <summary>
+					/// The original text of every inclusion selector in this set. Used to weed out
+					/// duplicates, and to keep host sets from repeating selectors already present
+					/// in the global set.
+					/// </summary>
+					std::unordered_set<boost::string_ref, util::string::StringRefHash> includeStrings;
+
+					/// <summary>
+					/// The original text of every exception selector in this set.
+					/// </summary>
+					std::unordered_set<boost::string_ref, util::string::StringRefHash> exceptionStrings;
+
+					/// <summary>
+					/// The category generation that this set was built against.
+					/// </summary>
+					uint32_t categoryGeneration = 0;
+
+					/// <summary>
+					/// The last time, in seconds on the engine's selector clock, that this set was
+					/// used. The selectors in a set that is still in use must not be evicted.
+					/// </summary>
+					mutable std::atomic<uint32_t> lastUsed{ 0 };
+
+					/// <summary>
+					/// Checks whether or not every exception in this set can be evaluated by the
+					/// StreamingHtmlRewriter.
+					/// </summary>
+					/// <returns>
+					/// True if every exception has a streaming form, false otherwise.
+					/// </returns>
+					inline bool AreExceptionsStreamable() const
+					{
+						return simpleExceptionCount == exceptions.size();
+					}
+
+					/// <summary>
+					/// Estimates the number of bytes of memory used by this set.
+					/// </summary>
+					/// <returns>
+					/// The approximate number of bytes used by this set.
+					/// </returns>
+					size_t GetMemoryUsage() const;
+				};
+
+				using SharedHostSelectorSet = std::shared_ptr<const HostSelectorSet>;
+
+				/// <summary>
+				/// The HostSelectorCache is a thread safe, memory bounded, least recently used
+				/// cache of HostSelectorSet objects, keyed by host. Gathering every selector that
+				/// applies to a host means hash lookups, category checks and compilation checks for
+				/// every single global selector, of which there are tens of thousands. The result
+				/// is the same for every response from the same host until either the loaded
+				/// rules or the enabled categories change, so it only needs to be done once.
+				/// 
+				/// Cached sets hold raw pointers to compiled selectors, so the owner of this
+				/// cache must ::Clear() it whenever loaded rules change or compiled selectors are
+				/// evicted. Changes to enabled categories are handled by the cache itself, by way
+				/// of the category generation recorded in each set.
+				/// </summary>
+				class HostSelectorCache
+				{
+
+				public:
+
+					/// <summary>
+					/// The default maximum amount of memory that cached sets may occupy.
+					/// </summary>
+					static constexpr size_t DefaultMaxBytes = 16 * 1024 * 1024;
+
+					/// <summary>
+					/// Constructs a new, empty cache.
+					/// </summary>
+					/// <param name="maxBytes">
+					/// The maximum amount of memory that cached sets may occupy.
+					/// </param>
+					HostSelectorCache(const size_t maxBytes = DefaultMaxBytes);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					HostSelectorCache(const HostSelectorCache&) = delete;
+					HostSelectorCache(HostSelectorCache&&) = delete;
+					HostSelectorCache& operator=(const HostSelectorCache&) = delete;
+
+					/// <summary>
+					/// Default destructor.
+					/// </summary>
+					~HostSelectorCache();
+
+					/// <summary>
+					/// Looks up the cached set for the supplied host. A set built against a
+					/// different category generation is considered stale, is dropped from the
+					/// cache, and counts as a miss.
+					/// </summary>
+					/// <param name="host">
+					/// The host to get the set for. Case insensitive.
+					/// </param>
+					/// <param name="categoryGeneration">
+					/// The current category generation.
+					/// </param>
+					/// <returns>
+					/// The cached set if present and current, nullptr otherwise.
+					/// </returns>
+					SharedHostSelectorSet Get(boost::string_ref host, const uint32_t categoryGeneration);
+
+					/// <summary>
+					/// Stores the supplied set for the supplied host, replacing any existing set,
+					/// then evicts least recently used sets until the cache is within its memory
+					/// bound. A set that alone exceeds the bound is not stored at all.
+					/// </summary>
+					/// <param name="host">
+					/// The host to store the set for. Case insensitive.
+					/// </param>
+					/// <param name="set">
+					/// The set to store.
+					/// </param>
+					void Put(boost::string_ref host, SharedHostSelectorSet set);
+
+					/// <summary>
+					/// Drops every cached set.
+					/// </summary>
+					void Clear();
+
+					/// <summary>
+					/// Drops every cached set that has not been used since the supplied time, and
+					/// collects every compiled selector referenced by the sets that remain. Those
+					/// selectors are still in use and must not be evicted.
+					/// </summary>
+					/// <param name="unusedSince">
+					/// Sets not used at or after this time are dropped.
+					/// </param>
+					/// <param name="retained">
+					/// Populated with every compiled selector referenced by a remaining set.
+					/// </param>
+					void Prune(const uint32_t unusedSince, std::unordered_set<const CompiledCssSelector*>& retained);
+
+					/// <summary>
+					/// Sets the maximum amount of memory that cached sets may occupy, evicting
+					/// least recently used sets immediately if required.
+					/// </summary>
+					/// <param name="maxBytes">
+					/// The maximum amount of memory that cached sets may occupy.
+					/// </param>
+					void SetMaxBytes(const size_t maxBytes);
+
+					/// <summary>
+					/// Gets the total number of lookups that were answered from the cache.
+					/// </summary>
+					/// <returns>
+					/// The number of cache hits.
+					/// </returns>
+					const uint64_t GetHits() const;
+
+					/// <summary>
+					/// Gets the total number of lookups that were not answered from the cache.
+					/// </summary>
+					/// <returns>
+					/// The number of cache misses.
+					/// </returns>
+					const uint64_t GetMisses() const;
+
+					/// <summary>
+					/// Gets the approximate amount of memory currently occupied by cached sets.
+					/// </summary>
+					/// <returns>
+					/// The approximate number of bytes occupied by cached sets.
+					/// </returns>
+					const size_t GetMemoryUsage() const;
+
+				private:
+
+					using ScopedLock = std::lock_guard<std::mutex>;
+
+					/// <summary>
+					/// A single cached set, along with its key and the memory it was charged for.
+					/// </summary>
+					struct Entry
+					{
+						std::string host;
+						SharedHostSelectorSet set;
+						size_t bytes;
+					};
+
+					using EntryList = std::list<Entry>;
+
+					/// <summary>
+					/// Evicts least recently used entries until within the memory bound. The lock
+					/// must be held by the caller.
+					/// </summary>
+					void Trim();
+
+					/// <summary>
+					/// Removes the supplied entry. The lock must be held by the caller.
+					/// </summary>
+					/// <param name="entry">
+					/// The entry to remove.
+					/// </param>
+					void Remove(EntryList::iterator entry);
+
+					/// <summary>
+					/// Guards all containers. Lookups are made by many threads at once while the
+					/// engine holds only a reader lock, and every lookup reorders the list.
+					/// </summary>
+					mutable std::mutex m_lock;
+
+					/// <summary>
+					/// All entries, most recently used first.
+					/// </summary>
+					EntryList m_entries;
+
+					/// <summary>
+					/// Entries indexed by host. Keys wrap the host string stored in the entry.
+					/// </summary>
+					std::unordered_map<boost::string_ref, EntryList::iterator, util::string::StringRefICaseHash, util::string::StringRefIEquals> m_index;
+
+					/// <summary>
+					/// The maximum amount of memory that cached sets may occupy.
+					/// </summary>
+					size_t m_maxBytes;
+
+					/// <summary>
+					/// The amount of memory that cached sets currently occupy.
+					/// </summary>
+					size_t m_bytes = 0;
+
+					/// <summary>
+					/// The number of lookups answered from the cache.
+					/// </summary>
+					std::atomic<uint64_t> m_hits{ 0 };
+
+					/// <summary>
+					/// The number of lookups not answered from the cache.
+					/// </summary>
+					std::atomic<uint64_t> m_misses{ 0 };
+
+				};
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,225 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HtmlTokenSet.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					inline bool IsHtmlWhitespace(const char c)
+					{
+						return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+					}
+
+					/// <summary>
+					/// Checks if the characters ending at the supplied position spell out the
+					/// supplied lower case attribute name, ignoring case.
+					/// </summary>
+					inline bool EndsWithName(boost::string_ref payload, const size_t end, boost::string_ref name)
+					{
+						if (end < name.size())
+						{
+							return false;
+						}
+
+						const char* start = payload.data() + (end - name.size());
+
+						for (size_t i = 0; i < name.size(); ++i)
+						{
+							if ((start[i] | 0x20) != name[i])
+							{
+								return false;
+							}
+						}
+
+						return true;
+					}
+				}
+
+				HtmlTokenSet::HtmlTokenSet()
+				{
+
+				}
+
+				HtmlTokenSet::HtmlTokenSet(boost::string_ref payload)
+				{
+					Scan(payload);
+				}
+
+				HtmlTokenSet::~HtmlTokenSet()
+				{
+
+				}
+
+				const bool HtmlTokenSet::HasId(boost::string_ref id) const
+				{
+					return std::binary_search(m_ids.begin(), m_ids.end(), id);
+				}
+
+				const bool HtmlTokenSet::HasClass(boost::string_ref className) const
+				{
+					return std::binary_search(m_classes.begin(), m_classes.end(), className);
+				}
+
+				void HtmlTokenSet::Scan(boost::string_ref payload)
+				{
+					m_ids.clear();
+					m_classes.clear();
+
+					const char* data = payload.data();
+					const size_t size = payload.size();
+
+					size_t pos = 0;
+
+					// Rather than walking the payload byte by byte, we let memchr hop from one equals
+					// sign to the next. Every attribute value we care about must follow one, and the
+					// C runtime implementation of memchr is vectorized on every platform we target,
+					// so the overwhelming majority of the payload is never looked at by us at all.
+					while (pos < size)
+					{
+						const char* equals = static_cast<const char*>(std::memchr(data + pos, '=', size - pos));
+
+						if (equals == nullptr)
+						{
+							break;
+						}
+
+						const size_t equalsPos = static_cast<size_t>(equals - data);
+						pos = equalsPos + 1;
+
+						// Whitespace is permitted between the attribute name and the equals sign.
+						size_t nameEnd = equalsPos;
+
+						while (nameEnd > 0 && IsHtmlWhitespace(data[nameEnd - 1]))
+						{
+							--nameEnd;
+						}
+
+						bool isClass = false;
+
+						if (EndsWithName(payload, nameEnd, u8"class"))
+						{
+							isClass = true;
+						}
+						else if (!EndsWithName(payload, nameEnd, u8"id"))
+						{
+							continue;
+						}
+
+						// Whitespace is also permitted between the equals sign and the value.
+						while (pos < size && IsHtmlWhitespace(data[pos]))
+						{
+							++pos;
+						}
+
+						if (pos >= size)
+						{
+							break;
+						}
+
+						size_t valueStart = pos;
+						size_t valueEnd = pos;
+
+						if (data[pos] == '"' || data[pos] == '\'')
+						{
+							++valueStart;
+
+							const char* closingQuote = static_cast<const char*>(std::memchr(data + valueStart, data[pos], size - valueStart));
+
+							valueEnd = closingQuote != nullptr ? static_cast<size_t>(closingQuote - data) : size;
+						}
+						else
+						{
+							while (valueEnd < size && !IsHtmlWhitespace(data[valueEnd]) && data[valueEnd] != '>')
+							{
+								++valueEnd;
+							}
+						}
+
+						auto value = payload.substr(valueStart, valueEnd - valueStart);
+
+						if (!isClass)
+						{
+							m_ids.push_back(value);
+						}
+						else
+						{
+							size_t tokenPos = 0;
+
+							while (tokenPos < value.size())
+							{
+								while (tokenPos < value.size() && IsHtmlWhitespace(value[tokenPos]))
+								{
+									++tokenPos;
+								}
+
+								auto tokenStart = tokenPos;
+
+								while (tokenPos < value.size() && !IsHtmlWhitespace(value[tokenPos]))
+								{
+									++tokenPos;
+								}
+
+								if (tokenPos > tokenStart)
+								{
+									m_classes.push_back(value.substr(tokenStart, tokenPos - tokenStart));
+								}
+							}
+						}
+
+						// Resume right where the value began rather than after it. If we've latched
+						// onto something that only looks like an attribute, such as text within a
+						// script, the quote we matched against may really have been the opening quote
+						// of the next real attribute, and skipping over it could cost us a token.
+						pos = valueStart;
+					}
+
+					std::sort(m_ids.begin(), m_ids.end());
+					m_ids.erase(std::unique(m_ids.begin(), m_ids.end()), m_ids.end());
+
+					std::sort(m_classes.begin(), m_classes.end());
+					m_classes.erase(std::unique(m_classes.begin(), m_classes.end()), m_classes.end());
+				}
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,152 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// The HtmlTokenSet holds every distinct id and class token that appears in an
+				/// HTML payload. It's built by a single cheap scan over the raw bytes that does
+				/// nothing but hunt for id= and class= attributes, without tokenizing the markup
+				/// in any real sense.
+				/// 
+				/// The vast majority of element hiding selectors require that the element they
+				/// match carries some specific id or class. If none of those ids or classes are
+				/// present anywhere in the payload, then the selector can't possibly match
+				/// anything, and there's no reason to run it. When none of the selectors that
+				/// apply to a payload can match, we can skip the expensive work of rewriting or
+				/// parsing the payload entirely.
+				/// 
+				/// The scan is deliberately sloppy in one direction only. It will happily pick up
+				/// tokens from things that aren't really attributes, such as text inside of
+				/// scripts, because a false positive only costs us a skipped optimization. It
+				/// must never miss a token that the StreamingHtmlRewriter would see, because
+				/// that would cost us a missed element.
+				/// 
+				/// Tokens are stored as references into the scanned payload, so the payload
+				/// must outlive this object, or at least the next call to ::Scan(...). Tokens are
+				/// kept in flat sorted vectors rather than hash sets, so that a single instance
+				/// can be reused for payload after payload without allocating once its vectors
+				/// have grown large enough.
+				/// </summary>
+				class HtmlTokenSet
+				{
+
+				public:
+
+					/// <summary>
+					/// Constructs a new, empty token set.
+					/// </summary>
+					HtmlTokenSet();
+
+					/// <summary>
+					/// Constructs a new token set from the supplied payload.
+					/// </summary>
+					/// <param name="payload">
+					/// The raw HTML payload to scan. Must outlive this object.
+					/// </param>
+					HtmlTokenSet(boost::string_ref payload);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					HtmlTokenSet(const HtmlTokenSet&) = delete;
+					HtmlTokenSet(HtmlTokenSet&&) = delete;
+					HtmlTokenSet& operator=(const HtmlTokenSet&) = delete;
+
+					/// <summary>
+					/// Default destructor.
+					/// </summary>
+					~HtmlTokenSet();
+
+					/// <summary>
+					/// Checks whether or not any element in the payload may have the supplied id.
+					/// </summary>
+					/// <param name="id">
+					/// The id to check for. Case sensitive.
+					/// </param>
+					/// <returns>
+					/// True if the id was found in the payload, false otherwise.
+					/// </returns>
+					const bool HasId(boost::string_ref id) const;
+
+					/// <summary>
+					/// Checks whether or not any element in the payload may have the supplied
+					/// class.
+					/// </summary>
+					/// <param name="className">
+					/// The class to check for. Case sensitive.
+					/// </param>
+					/// <returns>
+					/// True if the class was found in the payload, false otherwise.
+					/// </returns>
+					const bool HasClass(boost::string_ref className) const;
+
+					/// <summary>
+					/// Discards all tokens held, then scans the supplied payload, populating the
+					/// set with the ids and classes found within it.
+					/// </summary>
+					/// <param name="payload">
+					/// The raw HTML payload to scan. Must outlive this object, or at least the next
+					/// call to this method.
+					/// </param>
+					void Scan(boost::string_ref payload);
+
+				private:
+
+					/// <summary>
+					/// Every distinct id value found in the payload, sorted.
+					/// </summary>
+					std::vector<boost::string_ref> m_ids;
+
+					/// <summary>
+					/// Every distinct whitespace separated class token found in the payload,
+					/// sorted.
+					/// </summary>
+					std::vector<boost::string_ref> m_classes;
+
+				};
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -31,14 +31,19 @@
 
 #include "HttpFilteringEngine.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <boost/algorithm/string.hpp>
 #include <boost/thread.hpp>
 #include "../../mitm/http/HttpRequest.hpp"
 #include "../../mitm/http/HttpResponse.hpp"
 #include "../options/ProgramWideOptions.hpp"
-#include "../../../util/http/KnownHttpHeaders.hpp"
+#include "../../../util/http/KnownHttpHeaderIds.hpp"
 #include "CategorizedCssSelector.hpp"
+#include "StreamingHtmlRewriter.hpp"
+#include "HtmlTokenSet.hpp"
+#include "HostSelectorCache.hpp"
 
 #include "AbpFilterParser.hpp"
 
@@ -54,6 +59,111 @@ namespace te
 		{
 			namespace http
 			{				
+
+				namespace
+				{
+					/// <summary>
+					/// Gets the current time in whole seconds from a monotonic clock. This is what
+					/// selector use is timed against for the purpose of eviction. 32 bits of seconds
+					/// is good for over a century of uptime.
+					/// </summary>
+					inline uint32_t GetSelectorClock()
+					{
+						return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+					}
+
+					/// <summary>
+					/// Working storage used by ::ProcessHtmlResponse(...). Every HTML response used to
+					/// build all of this from scratch and free it all again on the way out, and with
+					/// dozens of threads doing so at once, contention in the allocator was plainly
+					/// visible. Instead, each thread keeps one of these around, and everything in it
+					/// is cleared rather than freed between responses, so it all keeps whatever
+					/// capacity it has grown to. After a handful of pages, filtering stops
+					/// allocating for anything other than the final output.
+					/// 
+					/// Note that GQ still allocates its document nodes from the heap. That happens
+					/// entirely within the library, beyond our reach. What we can do is keep GQ from
+					/// being invoked at all wherever possible, which is what the streaming rewriter
+					/// and the token prefilter are for.
+					/// </summary>
+					struct HtmlScratchSpace
+					{
+						/// <summary>
+						/// Anything retained beyond this many bytes is freed after use, so that one
+						/// enormous page doesn't pin a huge buffer to a thread forever.
+						/// </summary>
+						static constexpr size_t MaxRetainedBytes = 4 * 1024 * 1024;
+
+						std::vector<const SimpleHtmlSelector*> streamedIncludes;
+						std::vector<const SimpleHtmlSelector*> streamedExceptions;
+						std::vector<const CompiledCssSelector*> documentIncludes;
+						std::vector<const CompiledCssSelector*> documentExceptions;
+						HtmlTokenSet tokens;
+						StreamingHtmlRewriter rewriter;
+
+						/// <summary>
+						/// GQ only parses from a std::string, so whatever we hand it has to be copied in
+						/// here first. It must outlive the document.
+						/// </summary>
+						std::string documentInput;
+
+						/// <summary>
+						/// Clears everything for the next response, keeping capacity.
+						/// </summary>
+						void Release()
+						{
+							streamedIncludes.clear();
+							streamedExceptions.clear();
+							documentIncludes.clear();
+							documentExceptions.clear();
+
+							if (documentInput.capacity() > MaxRetainedBytes)
+							{
+								std::string().swap(documentInput);
+							}
+							else
+							{
+								documentInput.clear();
+							}
+						}
+					};
+
+					/// <summary>
+					/// Scope guard which hands out the calling thread's scratch space, releasing it
+					/// again at the end of the scope no matter how the scope is exited.
+					/// </summary>
+					class HtmlScratchSpaceLease
+					{
+
+					public:
+
+						HtmlScratchSpaceLease() : m_scratch(GetThreadScratchSpace())
+						{
+
+						}
+
+						~HtmlScratchSpaceLease()
+						{
+							m_scratch.Release();
+						}
+
+						HtmlScratchSpace* operator->()
+						{
+							return &m_scratch;
+						}
+
+					private:
+
+						static HtmlScratchSpace& GetThreadScratchSpace()
+						{
+							thread_local HtmlScratchSpace scratch;
+							return scratch;
+						}
+
+						HtmlScratchSpace& m_scratch;
+
+					};
+				}
 				
 				HttpFilteringEngine::HttpFilteringEngine(
 					const options::ProgramWideOptions* programOptions,
@@ -147,6 +257,9 @@ namespace te
 					// Must come after unloading all rules, since UnloadAllFilterRulesForCategory acquires write lock as well.
 					Writer w(m_filterLock);
 
+					// Cached selector sets are about to be out of date.
+					m_hostSelectorCache.Clear();
+
 					std::istringstream f(list);
 					std::string line;
 					while (std::getline(f, line))
@@ -236,6 +349,9 @@ namespace te
 				{
 					Writer w(m_filterLock);
 
+					// Cached selector sets hold pointers to selectors we're about to destroy.
+					m_hostSelectorCache.Clear();
+
 					for (auto& rulePair : m_typelessIncludeRules)
 					{
 						rulePair.second.erase(std::remove_if(rulePair.second.begin(), rulePair.second.end(),
@@ -289,6 +405,10 @@ namespace te
 							return s->GetCategory() == category;
 						}), selectorPair.second.end());
 					}
+
+					// Every selector for the category is gone now, so nothing refers to the raw
+					// selector strings anymore.
+					m_selectorArenas.erase(category);
 				}
 
 				void HttpFilteringEngine::UnloadAllTextTriggersForCategory(const uint8_t category)
@@ -328,7 +448,7 @@ namespace te
 					{
 						auto blockCategory = request->GetShouldBlock();
 
-						auto contentLenHeader = response->GetHeader(util::http::headers::ContentLength);
+						auto contentLenHeader = response->GetHeader(util::http::HeaderId::ContentLength);
 
 						uint32_t blockedContentSize = 0;
 
@@ -336,7 +456,7 @@ namespace te
 						{
 							try
 							{
-								blockedContentSize = static_cast<uint32_t>(std::stoi(contentLenHeader.first->second));
+								blockedContentSize = static_cast<uint32_t>(std::stoi(contentLenHeader.first->second.to_string()));
 							}
 							catch (...)
 							{
@@ -350,10 +470,10 @@ namespace te
 						}
 
 						auto fullRequest = request->RequestURI();
-						const auto hostHeader = request->GetHeader(util::http::headers::Host);
+						const auto hostHeader = request->GetHeader(util::http::HeaderId::Host);
 						if (hostHeader.first != hostHeader.second)
 						{
-							fullRequest = hostHeader.first->second + fullRequest;
+							fullRequest = hostHeader.first->second.to_string() + fullRequest;
 						}
 
 						ReportRequestBlocked(blockCategory, blockedContentSize, fullRequest);
@@ -371,7 +491,7 @@ namespace te
 					// blacklisted host. Of course before doing so, check to see if the host is
 					// whitelisted, meaning no processing by this engine should be done against
 					// content to or from the specified host.
-					auto hostHeaders = request->GetHeader(util::http::headers::Host);
+					auto hostHeaders = request->GetHeader(util::http::HeaderId::Host);
 
 					if (hostHeaders.first != hostHeaders.second)
 					{
@@ -391,7 +511,7 @@ namespace te
 					// First thing is to check and see if the request is third party or not. This can be easily
 					// accomplished by comparing the referer string host against the destination host for the
 					// request.
-					auto refererHeaders = request->GetHeader(util::http::headers::Referer);
+					auto refererHeaders = request->GetHeader(util::http::HeaderId::Referer);
 
 					boost::string_ref extractedRefererStrRef;
 
@@ -423,7 +543,7 @@ namespace te
 
 					// Next, check if the request is an "XML Http Request" by checking the non-standard header
 					// X-Requested-With. This is important because it's used rather heavily in ABP filters.
-					auto requestedWithHeaders = request->GetHeader(util::http::headers::XRequestedWith);
+					auto requestedWithHeaders = request->GetHeader(util::http::HeaderId::XRequestedWith);
 
 					boost::string_ref xmlHttpRequestStrRef(u8"XMLHttpRequest");
 
@@ -673,13 +793,13 @@ namespace te
 								// that we can classify. Check if we have an external classification callback.
 								if (m_onClassifyContent)
 								{
-									auto contentTypeHeader = response->GetHeader(util::http::headers::ContentType);
+									auto contentTypeHeader = response->GetHeader(util::http::HeaderId::ContentType);
 
 									// Default to an empty aka unknown string.
 									std::string contentTypeString;
 									if (contentTypeHeader.first != contentTypeHeader.second)
 									{
-										contentTypeString = contentTypeHeader.first->second;
+										contentTypeString = contentTypeHeader.first->second.to_string();
 									}
 
 									const auto& payload = response->GetPayload();
@@ -697,12 +817,11 @@ namespace te
 								{
 									// Payload is complete, it's HTML, and it was kept for further inspection. Let the CSS selectors
 									// rip through the HTML payload before returning.
-									auto processedHtmlString = this->ProcessHtmlResponse(request, response);
+									auto processedHtml = this->ProcessHtmlResponse(request, response);
 
-									if (processedHtmlString.size() > 0)
+									if (processedHtml.size() > 0)
 									{
-										std::vector<char> processedHtmlVector(processedHtmlString.begin(), processedHtmlString.end());
-										response->SetPayload(std::move(processedHtmlVector));
+										response->SetPayload(std::move(processedHtml));
 									}
 								}
 							}
@@ -713,7 +832,7 @@ namespace te
 					return 0;
 				}				
 
-				std::string HttpFilteringEngine::ProcessHtmlResponse(const mhttp::HttpRequest* request, const mhttp::HttpResponse* response)
+				mhttp::PayloadBuffer HttpFilteringEngine::ProcessHtmlResponse(const mhttp::HttpRequest* request, const mhttp::HttpResponse* response)
 				{
 					#ifndef NDEBUG
 						assert(request != nullptr && response != nullptr && u8"In HttpFilteringEngine::ProcessHtmlResponse(const mhttp::HttpRequest*, const mhttp::HttpResponse*) const - The HttpRequest or HttpResponse parameter was supplied with a nullptr. Both are absolutely required to be valid to accurately filter html payloads.");
@@ -730,7 +849,7 @@ namespace te
 					{
 						// I should destroy the universe for you giving me an incomplete or partial
 						// transaction. But, I'll spare you.
-						return std::string();
+						return mhttp::PayloadBuffer();
 					}
 
 					bool isPayloadText = response->IsPayloadText();
@@ -739,174 +858,276 @@ namespace te
 					if (!isPayloadText || !isPayloadHtml)
 					{
 						// We can't attempt to parse this as HTML when the content type doesn't even come close.
-						return std::string();
+						return mhttp::PayloadBuffer();
 					}
 
-					// So, if the payload is described as text, it may well be valid HTML. It may
-					// also be some mess of mixed up data with embedded HTML. We can't be certain.
-					// So, we'll just take a full stride run at parsing and filtering, and if we
-					// succeed, we'll check the offsets of the document start and end. If the
-					// offsets don't start at zero and end at the payload end, then we'll try to put
-					// humpty-dumpty back together again. #yolo.
+					// Try to get the host information from the request.
+					boost::string_ref hostStringRef;
+
+					auto hostHeaders = request->GetHeader(util::http::HeaderId::Host);
+
+					if (hostHeaders.first != hostHeaders.second)
+					{
+						hostStringRef = boost::string_ref(hostHeaders.first->second);
+					}
+
+					// Reader lock. Must be held for as long as we hold pointers to selectors.
+					Reader r(m_filterLock);
+
+					// Every selector that applies to this response comes from one of two sets, the
+					// global set and the set for this specific host. Building either one means
+					// visiting every selector stored under the key, so both are cached until the
+					// loaded rules or the enabled categories change.
+					const uint32_t now = GetSelectorClock();
+					const uint32_t categoryGeneration = m_programOptions->GetHttpCategoryGeneration();
+
+					const auto globalSet = GetHostSelectorSet(m_globalRuleKey, categoryGeneration, now, nullptr);
+
+					SharedHostSelectorSet hostSet = nullptr;
 
-					auto doc = gq::Document::Create();
+					if (hostStringRef.size() > 0)
+					{
+						hostSet = GetHostSelectorSet(hostStringRef, categoryGeneration, now, globalSet.get());
+					}
+
+					const HostSelectorSet* selectorSets[] = { globalSet.get(), hostSet.get() };
 
 					const auto& payloadVector = response->GetPayload();
 
 					boost::string_ref payloadStrRef(payloadVector.data(), payloadVector.size());
-					auto payloadString = payloadStrRef.to_string();
 
-					try
+					++m_htmlDocumentsInspected;
+
+					if (globalSet->includes.size() == 0 && (hostSet == nullptr || hostSet->includes.size() == 0))
 					{
-						// XXX TODO - Why doesn't GQ take a string_ref param so we don't have to copy? Good grief,
-						// who wrote that crap?
-						doc->Parse(payloadString);
-					}
-					catch (std::runtime_error& e)
-					{						
-						// This would only happen, AFAIK, if we failed to parse any valid HTML.
-						std::string errMessage(u8"In HttpFilteringEngine::ProcessHtmlResponse(const mhttp::HttpRequest*, const mhttp::HttpResponse*) const - Error:\t");
-						errMessage.append(e.what());
-						ReportError(errMessage);
-						return std::string();
+						// Nothing to remove, so there's no need to rewrite or parse anything.
+						++m_htmlDocumentsSkipped;
+						return mhttp::PayloadBuffer();
 					}
 
-					// Where we're going to collect all matched nodes.
-					gq::NodeMutationCollection collection;		
+					// Selectors simple enough to be evaluated while tokenizing are handed to the
+					// StreamingHtmlRewriter, which doesn't need to build a DOM at all. Everything
+					// else has to go through GQ. The rewriter can only honor exceptions that it can
+					// evaluate itself, so if even one exception can't be streamed, every include
+					// has to go through GQ as well.
+					const bool allExceptionsStreamable = globalSet->AreExceptionsStreamable() && (hostSet == nullptr || hostSet->AreExceptionsStreamable());
 
-					// Reader lock.
-					Reader r(m_filterLock);
+					HtmlScratchSpaceLease scratch;
+
+					auto& streamedIncludes = scratch->streamedIncludes;
+					auto& streamedExceptions = scratch->streamedExceptions;
+					auto& documentIncludes = scratch->documentIncludes;
+					auto& documentExceptions = scratch->documentExceptions;
 
-					// We'll start out getting global selectors and running them against the
-					// document, collecting all results into the NodeMutationCollection structure.
-					const auto& globalIncludeSelectors = m_inclusionSelectors.find(m_globalRuleKey);
+					// Most selectors can only ever match an element carrying some specific id or
+					// class. The global generic selectors apply to every single page, but the ids
+					// and classes they need rarely show up, so we do a cheap scan over the raw bytes
+					// for id and class values and throw out every selector whose requirements
+					// aren't present. Selectors that GQ must handle are only thrown out if they also
+					// have a simple form that we can reason about.
+					auto& tokens = scratch->tokens;
+					tokens.Scan(payloadStrRef);
 
-					if (globalIncludeSelectors != m_inclusionSelectors.end())
+					for (const auto selectorSet : selectorSets)
 					{
-						for (const auto& selector : globalIncludeSelectors->second)
+						if (selectorSet == nullptr)
+						{
+							continue;
+						}
+
+						for (size_t i = 0; i < selectorSet->includes.size(); ++i)
 						{
-							if (m_programOptions->GetIsHttpCategoryFiltered(selector->GetCategory()))
+							const auto compiled = selectorSet->includes[i];
+
+							// Sets are partitioned so that everything with a simple form comes first.
+							if (i < selectorSet->simpleIncludeCount)
 							{
-								doc->Each(selector->GetSelector(),
-									[&collection](const gq::Node* node)->void
+								if (!compiled->simpleSelector->MayMatch(tokens))
 								{
-									collection.Add(node);
-								});
-							}							
-						}
-					}
+									continue;
+								}
 
-					// Try to get the host information from the request.
-					boost::string_ref hostStringRef;
+								if (allExceptionsStreamable)
+								{
+									streamedIncludes.push_back(compiled->simpleSelector.get());
+									continue;
+								}
+							}
 
-					auto hostHeaders = request->GetHeader(util::http::headers::Host);
+							documentIncludes.push_back(compiled);
+						}
+					}
 
-					if (hostHeaders.first != hostHeaders.second)
+					if (streamedIncludes.size() == 0 && documentIncludes.size() == 0)
 					{
-						hostStringRef = boost::string_ref(hostHeaders.first->second);
+						// Nothing can possibly match, so there's no need to rewrite or parse anything.
+						++m_htmlDocumentsSkipped;
+						return mhttp::PayloadBuffer();
 					}
 
-					// If we got host information, we'll move to host specific selectors and collect
-					// all results in the same collection.
-					if (hostStringRef.size() > 0)
+					for (const auto selectorSet : selectorSets)
 					{
-						const auto& hostIncludeSelectors = m_inclusionSelectors.find(hostStringRef);
+						if (selectorSet == nullptr)
+						{
+							continue;
+						}
 
-						if (hostIncludeSelectors != m_inclusionSelectors.end())
+						if (documentIncludes.size() > 0)
 						{
-							for (const auto& selector : hostIncludeSelectors->second)
+							documentExceptions.insert(documentExceptions.end(), selectorSet->exceptions.begin(), selectorSet->exceptions.end());
+						}
+
+						if (streamedIncludes.size() > 0)
+						{
+							for (const auto compiled : selectorSet->exceptions)
 							{
-								if (m_programOptions->GetIsHttpCategoryFiltered(selector->GetCategory()))
-								{
-									doc->Each(selector->GetSelector(),
-										[&collection](const gq::Node* node)->void
-									{
-										collection.Add(node);
-									});
-								}								
+								streamedExceptions.push_back(compiled->simpleSelector.get());
 							}
 						}
+					}
 
-						// Now we have collected every possible element for removal, it's time to
-						// prune down the collection with whitelist selectors. Start with host specific
-						// while we're in this scope.
+					uint32_t totalRemoved = 0;
 
-						const auto& hostExcludeSelectors = m_exceptionSelectors.find(hostStringRef);
+					// This only ever gets populated if something was actually removed. Otherwise,
+					// there's no reason to hand back a copy of what the response already has.
+					mhttp::PayloadBuffer result;
 
-						if (hostExcludeSelectors != m_exceptionSelectors.end())
+					if (streamedIncludes.size() > 0)
+					{
+						result.reserve(payloadVector.size());
+
+						auto& rewriter = scratch->rewriter;
+
+						rewriter.Reset(
+							streamedIncludes, 
+							streamedExceptions, 
+							[&result](const char* data, const size_t length)->void
 						{
-							for (const auto& selector : hostExcludeSelectors->second)
-							{
-								if (m_programOptions->GetIsHttpCategoryFiltered(selector->GetCategory()))
-								{
-									doc->Each(selector->GetSelector(),
-										[&collection](const gq::Node* node)->void
-									{
-										collection.Remove(node);
-									});
-								}
-							}
+							result.insert(result.end(), data, data + length);
+						});
+
+						rewriter.Write(payloadVector.data(), payloadVector.size());
+						rewriter.Finish();
+
+						totalRemoved = rewriter.GetElementsRemoved();
+
+						if (totalRemoved > 0)
+						{
+							payloadStrRef = boost::string_ref(result.data(), result.size());
+						}
+						else
+						{
+							result.clear();
 						}
 					}
 
-					// Now we'll run global whitelist selectors and prune our results further.
-					const auto& globalExceptionSelectors = m_exceptionSelectors.find(m_globalRuleKey);
-
-					if (globalExceptionSelectors != m_exceptionSelectors.end())
+					if (documentIncludes.size() > 0)
 					{
-						for (const auto& selector : globalExceptionSelectors->second)
+						// So, if the payload is described as text, it may well be valid HTML. It may
+						// also be some mess of mixed up data with embedded HTML. We can't be certain.
+						// So, we'll just take a full stride run at parsing and filtering, and if we
+						// succeed, we'll check the offsets of the document start and end. If the
+						// offsets don't start at zero and end at the payload end, then we'll try to put
+						// humpty-dumpty back together again. #yolo.
+
+						// XXX TODO - Why doesn't GQ take a string_ref param so we don't have to copy? Good grief,
+						// who wrote that crap? Must outlive the document, which it does, since the
+						// scratch space is only released once we return.
+						auto& payloadString = scratch->documentInput;
+						payloadString.assign(payloadStrRef.data(), payloadStrRef.size());
+
+						auto doc = gq::Document::Create();
+
+						bool documentParsed = true;
+
+						try
+						{
+							doc->Parse(payloadString);
+						}
+						catch (std::runtime_error& e)
 						{
-							if (m_programOptions->GetIsHttpCategoryFiltered(selector->GetCategory()))
+							// This would only happen, AFAIK, if we failed to parse any valid HTML.
+							// Whatever the rewriter already removed still stands, so we carry on with
+							// its output rather than throwing that away too.
+							documentParsed = false;
+
+							std::string errMessage(u8"In HttpFilteringEngine::ProcessHtmlResponse(const mhttp::HttpRequest*, const mhttp::HttpResponse*) const - Error:\t");
+							errMessage.append(e.what());
+							ReportError(errMessage);
+						}
+
+						if (documentParsed)
+						{
+							// Where we're going to collect all matched nodes.
+							gq::NodeMutationCollection collection;
+
+							for (const auto selector : documentIncludes)
 							{
+								doc->Each(selector->selector,
+									[&collection](const gq::Node* node)->void
+								{
+									collection.Add(node);
+								});
+							}
 
-								doc->Each(selector->GetSelector(),
+							// Now we have collected every possible element for removal, it's time to
+							// prune down the collection with whitelist selectors.
+							for (const auto selector : documentExceptions)
+							{
+								doc->Each(selector->selector,
 									[&collection](const gq::Node* node)->void
 								{
 									collection.Remove(node);
 								});
 							}
-						}
-					}
 
-					
+							if (collection.Size() > 0)
+							{
+								totalRemoved += static_cast<uint32_t>(collection.Size());
 
-					// Report numberOfHtmlElementsRemoved
-					if (collection.Size() > 0)
-					{
-						std::string fullRequestString = hostStringRef.to_string();
-						fullRequestString += request->RequestURI();
-						ReportElementsBlocked(static_cast<uint32_t>(collection.Size()), fullRequestString);
-					}					
+								// Now we can serialize the result, removing our final collection of nodes.
+								auto serialized = gq::Serializer::Serialize(doc.get(), &collection);
 
-					// Now we can serialize the result, removing our final collection of nodes.
-					auto serialized = gq::Serializer::Serialize(doc.get(), &collection);
+								auto docStartPos = doc->GetStartOuterPosition();
+								auto docEndPos = doc->GetEndOuterPosition();
 
-					std::string finalResult;
+								mhttp::PayloadBuffer documentResult;
+								documentResult.reserve(payloadStrRef.size());
 
-					auto docStartPos = doc->GetStartOuterPosition();
-					auto docEndPos = doc->GetEndOuterPosition();
+								// As mentioned earlier in the comments, we might have got some valid HTML that
+								// was embedded in some other unknown data. So, we'll check the
+								// doc->GetStartOuterPosition() and doc->GetEndOuterPosition(), then copy the
+								// difference in offsets onto the serialized string and return it. This way,
+								// we're not blowing away any data we shouldn't be.
+								if (docStartPos > 0)
+								{
+									documentResult.insert(documentResult.end(), payloadStrRef.begin(), payloadStrRef.begin() + docStartPos);
+								}
 
-					// As mentioned earlier in the comments, we might have got some valid HTML that
-					// was embedded in some other unknown data. So, we'll check the
-					// doc->GetStartOuterPosition() and doc->GetEndOuterPosition(), then copy the
-					// difference in offsets onto the serialized string and return it. This way,
-					// we're not blowing away any data we shouldn't be.
-					if (docStartPos > 0)
-					{
-						finalResult.append(payloadStrRef.substr(0, docStartPos).to_string());
-					}
+								documentResult.insert(documentResult.end(), serialized.begin(), serialized.end());
 
-					finalResult.append(serialized);
+								if (docEndPos < (payloadStrRef.size() - 1))
+								{
+									documentResult.insert(documentResult.end(), payloadStrRef.begin() + docEndPos + 1, payloadStrRef.end());
+								}
+
+								result = std::move(documentResult);
+							}
+						}
+					}
 
-					if (docEndPos < (payloadStrRef.size() - 1))
+					// Report numberOfHtmlElementsRemoved
+					if (totalRemoved > 0)
 					{
-						finalResult.append(payloadStrRef.substr(docEndPos + 1).to_string());
+						std::string fullRequestString = hostStringRef.to_string();
+						fullRequestString += request->RequestURI();
+						ReportElementsBlocked(totalRemoved, fullRequestString);
 					}
 
-					return finalResult;
+					return result;
 				}
 
-				uint8_t HttpFilteringEngine::ShouldBlockBecauseOfTextTrigger(const std::vector<char>& payload) const
+				uint8_t HttpFilteringEngine::ShouldBlockBecauseOfTextTrigger(const mhttp::PayloadBuffer& payload) const
 				{
 					boost::string_ref content = boost::string_ref(payload.data(), payload.size());
 
@@ -1014,7 +1235,7 @@ namespace te
 								// because it's a domain-specific exception selector. Exception selectors that are domain
 								// specific employ a unique format, in that the "actual" selector string is preceeded by
 								// #@## instead of simply #@. So a class selector would look like #@#.
-								AddSelectorMultiDomain(m_globalRuleKey, rule.substr(selectorStartPosition + 3), category, true);
+								AddSelectorMultiDomain(domains, rule.substr(selectorStartPosition + 3), category, true);
 								return true;
 							}
 							else if(rule[selectorStartPosition + 1] == '#')
@@ -1023,7 +1244,7 @@ namespace te
 								// selectors, the inclusion selectors (elements that should be hidden) follow the same syntax
 								// as global selectors. That is, they are preceeded by only 2 padding characters, "##". So
 								// a domain specific class selector would look like ##.class, so we trim at pos 2.
-								AddSelectorMultiDomain(m_globalRuleKey, rule.substr(selectorStartPosition + 2), category);
+								AddSelectorMultiDomain(domains, rule.substr(selectorStartPosition + 2), category);
 								return true;
 							}
 						}
@@ -1104,19 +1325,15 @@ namespace te
 					)
 				{
 					
-					SharedCategorizedCssSelector sSelector = nullptr;
+					// The domains string is wrapped from the original rule, which will not survive
+					// this call, so it must be preserved as well.
+					domains = GetPreservedICaseStringRef(domains);
 
-					try
-					{
-						sSelector = std::make_shared<CategorizedCssSelector>(domains, selector, category);
-					}
-					catch (std::runtime_error& e)
-					{
-						std::string errMsg(u8"In HttpFilteringEngine::AddSelectorMultiDomain(boost::string_ref, const std::string&, const uint8_t) Error:\t");
-						errMsg.append(e.what());
-						ReportError(errMsg);
-						return;
-					}					
+					// Selectors aren't compiled until they're first used. Until then, all we keep is
+					// the raw selector string, packed into the arena for the category.
+					auto selectorStored = m_selectorArenas[category].Store(selector);
+
+					SharedCategorizedCssSelector sSelector = std::make_shared<CategorizedCssSelector>(domains, selectorStored, category);
 
 					#ifndef NDEBUG
 						assert(sSelector != nullptr && u8"In HttpFilteringEngine::AddSelectorMultiDomain(boost::string_ref, const std::string&, const uint8_t) - Failed to allocate shared selector.");
@@ -1171,6 +1388,100 @@ namespace te
 					}
 				}				
 
+				const CompiledCssSelector* HttpFilteringEngine::GetCompiledSelector(const SharedCategorizedCssSelector& selector, const uint32_t now) const
+				{
+					try
+					{
+						return selector->GetCompiled(now);
+					}
+					catch (std::runtime_error& e)
+					{
+						// This only ever happens once per selector. After this, the selector is
+						// marked invalid and simply returns nullptr.
+						std::string errMsg(u8"In HttpFilteringEngine::GetCompiledSelector(const SharedCategorizedCssSelector&, const uint32_t) - Failed to compile selector ");
+						errMsg.append(selector->GetOriginalSelectorString().to_string());
+						errMsg.append(u8" Error:\t");
+						errMsg.append(e.what());
+						ReportError(errMsg);
+					}
+
+					return nullptr;
+				}
+
+				SharedHostSelectorSet HttpFilteringEngine::GetHostSelectorSet(boost::string_ref key, const uint32_t categoryGeneration, const uint32_t now, const HostSelectorSet* globalSet)
+				{
+					auto cached = m_hostSelectorCache.Get(key, categoryGeneration);
+
+					if (cached != nullptr)
+					{
+						cached->lastUsed = now;
+						return cached;
+					}
+
+					auto selectorSet = std::make_shared<HostSelectorSet>();
+					selectorSet->categoryGeneration = categoryGeneration;
+					selectorSet->lastUsed = now;
+
+					auto collect = [this, key, now](
+						const std::unordered_map<boost::string_ref, std::vector<SharedCategorizedCssSelector>, util::string::StringRefICaseHash, util::string::StringRefIEquals>& source,
+						const std::unordered_set<boost::string_ref, util::string::StringRefHash>* globalStrings,
+						std::unordered_set<boost::string_ref, util::string::StringRefHash>& seenStrings,
+						std::vector<const CompiledCssSelector*>& out
+						)->size_t
+					{
+						const auto& selectors = source.find(key);
+
+						if (selectors != source.end())
+						{
+							for (const auto& selector : selectors->second)
+							{
+								if (!m_programOptions->GetIsHttpCategoryFiltered(selector->GetCategory()))
+								{
+									continue;
+								}
+
+								// The same selector text shows up in multiple lists all the time. There's
+								// no sense in running it more than once.
+								const auto selectorString = selector->GetOriginalSelectorString();
+
+								if (globalStrings != nullptr && globalStrings->find(selectorString) != globalStrings->end())
+								{
+									continue;
+								}
+
+								if (!seenStrings.insert(selectorString).second)
+								{
+									continue;
+								}
+
+								const auto compiled = GetCompiledSelector(selector, now);
+
+								if (compiled != nullptr)
+								{
+									out.push_back(compiled);
+								}
+							}
+						}
+
+						out.shrink_to_fit();
+
+						auto simpleEnd = std::stable_partition(out.begin(), out.end(),
+							[](const CompiledCssSelector* compiled)->bool
+						{
+							return compiled->simpleSelector != nullptr;
+						});
+
+						return static_cast<size_t>(simpleEnd - out.begin());
+					};
+
+					selectorSet->simpleIncludeCount = collect(m_inclusionSelectors, globalSet != nullptr ? &globalSet->includeStrings : nullptr, selectorSet->includeStrings, selectorSet->includes);
+					selectorSet->simpleExceptionCount = collect(m_exceptionSelectors, globalSet != nullptr ? &globalSet->exceptionStrings : nullptr, selectorSet->exceptionStrings, selectorSet->exceptions);
+
+					m_hostSelectorCache.Put(key, selectorSet);
+
+					return selectorSet;
+				}
+
 				void HttpFilteringEngine::AddIncludeSelector(boost::string_ref domain, const SharedCategorizedCssSelector& selector)
 				{
 					// This absolutely must be done, otherwise we can't guarantee that the string which
@@ -1375,6 +1686,86 @@ namespace te
 					}
 				}
 
+				uint32_t HttpFilteringEngine::EvictUnusedSelectors(const uint32_t unusedForSeconds)
+				{
+					const uint32_t now = GetSelectorClock();
+					const uint32_t unusedSince = now > unusedForSeconds ? now - unusedForSeconds : 0;
+
+					// Writer lock, because ::Evict(...) requires that nobody else is holding on to
+					// the compiled forms, and readers hold raw pointers to them.
+					Writer w(m_filterLock);
+
+					// Selectors reached through cached sets aren't marked as used each time, the
+					// set is instead. So first, drop the sets that have gone unused, and then keep
+					// every selector still referenced by the sets that remain.
+					std::unordered_set<const CompiledCssSelector*> retained;
+					m_hostSelectorCache.Prune(unusedSince, retained);
+
+					uint32_t evicted = 0;
+
+					auto evictFrom = [&retained, &evicted, unusedSince](const std::vector<SharedCategorizedCssSelector>& selectors)
+					{
+						for (const auto& selector : selectors)
+						{
+							const auto compiled = selector->GetCompiledIfPresent();
+
+							if (compiled == nullptr || retained.find(compiled) != retained.end())
+							{
+								continue;
+							}
+
+							// The same selector may be stored under many domains, but it can only be
+							// evicted once, so this count is still accurate.
+							if (selector->Evict(unusedSince))
+							{
+								++evicted;
+							}
+						}
+					};
+
+					for (const auto& selectorPair : m_inclusionSelectors)
+					{
+						evictFrom(selectorPair.second);
+					}
+
+					for (const auto& selectorPair : m_exceptionSelectors)
+					{
+						evictFrom(selectorPair.second);
+					}
+
+					return evicted;
+				}
+
+				void HttpFilteringEngine::SetHostSelectorCacheMaxBytes(const size_t maxBytes)
+				{
+					m_hostSelectorCache.SetMaxBytes(maxBytes);
+				}
+
+				const uint64_t HttpFilteringEngine::GetHostSelectorCacheHits() const
+				{
+					return m_hostSelectorCache.GetHits();
+				}
+
+				const uint64_t HttpFilteringEngine::GetHostSelectorCacheMisses() const
+				{
+					return m_hostSelectorCache.GetMisses();
+				}
+
+				const size_t HttpFilteringEngine::GetHostSelectorCacheMemoryUsage() const
+				{
+					return m_hostSelectorCache.GetMemoryUsage();
+				}
+
+				const uint64_t HttpFilteringEngine::GetHtmlDocumentsInspected() const
+				{
+					return m_htmlDocumentsInspected;
+				}
+
+				const uint64_t HttpFilteringEngine::GetHtmlDocumentsSkipped() const
+				{
+					return m_htmlDocumentsSkipped;
+				}
+
 				void HttpFilteringEngine::ReportElementsBlocked(const uint32_t numElementsRemoved, boost::string_ref fullRequest) const
 				{
 					if (m_onElementsBlocked)
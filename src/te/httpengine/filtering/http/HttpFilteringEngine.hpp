@@ -31,6 +31,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <memory>
 #include <string>
@@ -41,8 +42,11 @@
 #include <boost/thread/lock_types.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include "../../../util/string/StringRefUtil.hpp"
+#include "../../../util/string/StringArena.hpp"
 #include "../../util/cb/EventReporter.hpp"
+#include "../../mitm/http/PayloadMemory.hpp"
 #include "AbpFilterOptions.hpp"
+#include "HostSelectorCache.hpp"
 
 /// <summary>
 /// Forward decl for gq structures.
@@ -93,6 +97,7 @@ namespace te
 				class AbpFilter;
 				class AbpFilterParser;
 				class CategorizedCssSelector;
+				struct CompiledCssSelector;
 
 				namespace 
 				{
@@ -357,19 +362,28 @@ namespace te
 					uint8_t ShouldBlock(const mhttp::HttpRequest* request, mhttp::HttpResponse* response = nullptr, const bool isSecure = false);					
 
 					/// <summary>
-					/// Attempts to load and parse the response portion of the supplied transaction,
-					/// then runs all relevant CSS selectors against the document, collecting nodes
-					/// that match the supplied selectors. Once this is done, the document is
-					/// serialized back to an HTML string and, during this serialization process,
-					/// all matched nodes are removed. This functionality is entirely provided by
-					/// the third-party library GQ.
+					/// Runs all relevant CSS selectors against the response portion of the supplied
+					/// transaction, removing every matched element.
+					/// 
+					/// Selectors that are simple enough (tag, id, class and attribute selectors,
+					/// joined by descendant or child combinators) are run through the
+					/// StreamingHtmlRewriter, which removes matched subtrees in a single forward
+					/// pass without ever building a document. Any remaining selectors require a
+					/// full document, so if any of those apply, the payload is loaded and parsed by
+					/// the third-party library GQ, the selectors are run, and the document is
+					/// serialized back to HTML with matched nodes omitted. If GQ fails to parse
+					/// the payload, whatever the rewriter removed is still returned.
+					/// 
+					/// Both passes run over the complete payload, since text triggers and
+					/// classification have to see all of it before anything is sent on anyway.
+					/// The rewriter only takes the place of the DOM pass for simple selectors.
 					/// 
 					/// Note that if the payload on the response side in fact not valid or supported
-					/// HTML data, this function will return an empty string. This function does not
-					/// modify any input at all, but rather attempts to return a result that the
-					/// user can use in a fashion that the engine is agnostic of. However, common
-					/// practice and intended purpose are to simply replace the response payload
-					/// with the data returned from this method.
+					/// HTML data, or if nothing was removed, this function will return an empty
+					/// vector. This function does not modify any input at all, but rather attempts
+					/// to return a result that the user can use in a fashion that the engine is
+					/// agnostic of. However, common practice and intended purpose are to simply
+					/// replace the response payload with the data returned from this method.
 					/// </summary>
 					/// <param name="request">
 					/// The request side of the transaction. Must not be nullptr.
@@ -378,11 +392,88 @@ namespace te
 					/// The response side of the transaction. Must not be nullptr.
 					/// </param>
 					/// <returns>
-					/// If valid, supported HTML was found in the response payload and it was
-					/// successfully parsed, a string containing the filtered HTML. Otherwise, an
-					/// empty string.
+					/// If valid, supported HTML was found in the response payload and one or more
+					/// elements were removed from it, the filtered HTML. Otherwise, an empty
+					/// vector.
+					/// </returns>
+					mhttp::PayloadBuffer ProcessHtmlResponse(const mhttp::HttpRequest* request, const mhttp::HttpResponse* response);
+
+					/// <summary>
+					/// Gets the total number of HTML payloads that have been handed to
+					/// ::ProcessHtmlResponse(...) and had selectors considered against them.
+					/// </summary>
+					/// <returns>
+					/// The number of HTML payloads inspected.
+					/// </returns>
+					const uint64_t GetHtmlDocumentsInspected() const;
+
+					/// <summary>
+					/// CSS selectors are compiled lazily, the first time that they apply to a
+					/// response. Over a long running session, many compiled selectors will have
+					/// been used once or twice and then never again. This releases the compiled
+					/// forms of every selector that has gone unused for the supplied length of
+					/// time, returning them to their raw string form. If they're ever needed
+					/// again, they'll simply be compiled again.
+					/// 
+					/// This acquires an exclusive lock on the filtering containers, so it should be
+					/// called sparingly, such as on a timer measured in minutes.
+					/// </summary>
+					/// <param name="unusedForSeconds">
+					/// The number of seconds that a selector must have gone unused for in order to
+					/// be evicted.
+					/// </param>
+					/// <returns>
+					/// The number of selectors evicted.
+					/// </returns>
+					uint32_t EvictUnusedSelectors(const uint32_t unusedForSeconds);
+
+					/// <summary>
+					/// Sets the maximum amount of memory that may be occupied by cached per host
+					/// selector sets. See HostSelectorCache.
+					/// </summary>
+					/// <param name="maxBytes">
+					/// The maximum amount of memory that cached selector sets may occupy.
+					/// </param>
+					void SetHostSelectorCacheMaxBytes(const size_t maxBytes);
+
+					/// <summary>
+					/// Gets the number of times that the selectors applicable to a host were found
+					/// in the per host selector cache. The global selector set is looked up once
+					/// per HTML response as well, and is counted here too.
+					/// </summary>
+					/// <returns>
+					/// The number of per host selector cache hits.
 					/// </returns>
-					std::string ProcessHtmlResponse(const mhttp::HttpRequest* request, const mhttp::HttpResponse* response);
+					const uint64_t GetHostSelectorCacheHits() const;
+
+					/// <summary>
+					/// Gets the number of times that the selectors applicable to a host had to be
+					/// gathered because they were not cached, or were cached but stale.
+					/// </summary>
+					/// <returns>
+					/// The number of per host selector cache misses.
+					/// </returns>
+					const uint64_t GetHostSelectorCacheMisses() const;
+
+					/// <summary>
+					/// Gets the approximate amount of memory occupied by cached per host selector
+					/// sets.
+					/// </summary>
+					/// <returns>
+					/// The approximate number of bytes occupied by cached selector sets.
+					/// </returns>
+					const size_t GetHostSelectorCacheMemoryUsage() const;
+
+					/// <summary>
+					/// Gets the total number of inspected HTML payloads that were never rewritten
+					/// or parsed at all, because none of the applicable selectors could possibly
+					/// match anything in them. Divide by ::GetHtmlDocumentsInspected() to get the
+					/// fraction of pages on which the prefilter saved us the trouble.
+					/// </summary>
+					/// <returns>
+					/// The number of HTML payloads skipped.
+					/// </returns>
+					const uint64_t GetHtmlDocumentsSkipped() const;
 
 				private:
 
@@ -571,6 +662,20 @@ namespace te
 					/// </summary>
 					std::unordered_map<boost::string_ref, std::vector<SharedCategorizedCssSelector>, util::string::StringRefICaseHash, util::string::StringRefIEquals> m_exceptionSelectors;
 
+					/// <summary>
+					/// Selectors are not compiled until they are first used, so until then, all we
+					/// keep is the raw selector string. Rather than keeping tens of thousands of
+					/// individually allocated strings, they're packed into one arena per category,
+					/// which is released in its entirety when the category is unloaded.
+					/// </summary>
+					std::unordered_map<uint8_t, util::string::StringArena> m_selectorArenas;
+
+					/// <summary>
+					/// Caches the precomputed selector sets for recently seen hosts, as well as the
+					/// global selector set.
+					/// </summary>
+					HostSelectorCache m_hostSelectorCache;
+
 					/// <summary>
 					/// Holds all loaded text triggers. Text triggers are highly specific keywords
 					/// meant to cat text of very specific categories, such as pornography. They
@@ -579,6 +684,17 @@ namespace te
 					/// </summary>
 					std::unordered_map<boost::string_ref, uint8_t, util::string::StringRefICaseHash, util::string::StringRefIEquals> m_textTriggers;
 
+					/// <summary>
+					/// The number of HTML payloads that have had selectors considered against them.
+					/// </summary>
+					std::atomic<uint64_t> m_htmlDocumentsInspected{ 0 };
+
+					/// <summary>
+					/// The number of inspected HTML payloads which were skipped entirely, because no
+					/// applicable selector could match anything within them.
+					/// </summary>
+					std::atomic<uint64_t> m_htmlDocumentsSkipped{ 0 };
+
 					/// <summary>
 					/// Checks if the given payload has text triggers, and if one is found where the
 					/// category is enabled, then the category for the matched trigger is returned.
@@ -590,7 +706,7 @@ namespace te
 					/// A non-zero value if the content should be blocked. Zero if the content should
 					/// not be blocked.
 					/// </returns>
-					uint8_t ShouldBlockBecauseOfTextTrigger(const std::vector<char>& payload) const;
+					uint8_t ShouldBlockBecauseOfTextTrigger(const mhttp::PayloadBuffer& payload) const;
 
 					/// <summary>
 					/// Method that accepts a single Adblock Plus formatted filter or selector
@@ -654,6 +770,46 @@ namespace te
 					/// </param>
 					void AddIncludeSelector(boost::string_ref domain, const SharedCategorizedCssSelector& selector);
 
+					/// <summary>
+					/// Gets the compiled forms of the supplied selector, compiling it if required.
+					/// If compilation fails, the error is reported through the EventReporter
+					/// interface.
+					/// </summary>
+					/// <param name="selector">
+					/// The selector to get the compiled forms of.
+					/// </param>
+					/// <param name="now">
+					/// The current selector clock time in seconds.
+					/// </param>
+					/// <returns>
+					/// The compiled forms of the selector, or nullptr if the selector is invalid.
+					/// </returns>
+					const CompiledCssSelector* GetCompiledSelector(const SharedCategorizedCssSelector& selector, const uint32_t now) const;
+
+					/// <summary>
+					/// Gets the set of selectors applicable to the supplied key, either from the
+					/// host selector cache or, failing that, by gathering every selector stored
+					/// under the key whose category is enabled, compiling them as needed. Must be
+					/// called with at least a reader lock held.
+					/// </summary>
+					/// <param name="key">
+					/// The host, or the global rule key.
+					/// </param>
+					/// <param name="categoryGeneration">
+					/// The category generation read before calling this method.
+					/// </param>
+					/// <param name="now">
+					/// The current selector clock time in seconds.
+					/// </param>
+					/// <param name="globalSet">
+					/// When gathering a host set, the global set, so that selectors already present
+					/// there can be left out. Otherwise nullptr.
+					/// </param>
+					/// <returns>
+					/// The set of selectors applicable to the supplied key.
+					/// </returns>
+					SharedHostSelectorSet GetHostSelectorSet(boost::string_ref key, const uint32_t categoryGeneration, const uint32_t now, const HostSelectorSet* globalSet);
+
 					/// <summary>
 					/// Indexes an exception selector using the supplied domains as the key(s). This
 					/// method is called by *MultiDomain(...) methods which delegates the job of
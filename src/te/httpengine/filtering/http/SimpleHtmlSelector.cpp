@@ -0,0 +1,634 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SimpleHtmlSelector.hpp"
+#include "HtmlTokenSet.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					inline bool IsSelectorWhitespace(const char c)
+					{
+						return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+					}
+
+					inline bool IsIdentChar(const char c)
+					{
+						// Anything outside of ASCII is permitted in a CSS identifier.
+						return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || static_cast<unsigned char>(c) >= 0x80;
+					}
+
+					inline boost::string_ref TrimSelectorWhitespace(boost::string_ref str)
+					{
+						while (str.size() > 0 && IsSelectorWhitespace(str.front()))
+						{
+							str.remove_prefix(1);
+						}
+
+						while (str.size() > 0 && IsSelectorWhitespace(str.back()))
+						{
+							str.remove_suffix(1);
+						}
+
+						return str;
+					}
+
+					inline bool ReadIdent(boost::string_ref str, size_t& pos, std::string& out)
+					{
+						auto start = pos;
+
+						while (pos < str.size() && IsIdentChar(str[pos]))
+						{
+							++pos;
+						}
+
+						if (pos == start)
+						{
+							return false;
+						}
+
+						out.assign(str.data() + start, pos - start);
+						return true;
+					}
+
+					inline void ToLower(std::string& str)
+					{
+						std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+					}
+
+					inline const std::string* FindAttribute(const HtmlElement& element, const std::string& name)
+					{
+						for (const auto& attribute : element.attributes)
+						{
+							if (attribute.first == name)
+							{
+								return &attribute.second;
+							}
+						}
+
+						return nullptr;
+					}
+
+					inline bool HasWhitespaceToken(boost::string_ref list, boost::string_ref token)
+					{
+						if (token.size() == 0)
+						{
+							return false;
+						}
+
+						size_t pos = 0;
+						while (pos < list.size())
+						{
+							while (pos < list.size() && IsSelectorWhitespace(list[pos]))
+							{
+								++pos;
+							}
+
+							auto start = pos;
+
+							while (pos < list.size() && !IsSelectorWhitespace(list[pos]))
+							{
+								++pos;
+							}
+
+							if (pos - start == token.size() && list.substr(start, pos - start) == token)
+							{
+								return true;
+							}
+						}
+
+						return false;
+					}
+				}
+
+				SimpleHtmlSelector::SimpleHtmlSelector()
+				{
+
+				}
+
+				SimpleHtmlSelector::~SimpleHtmlSelector()
+				{
+
+				}
+
+				std::shared_ptr<SimpleHtmlSelector> SimpleHtmlSelector::Create(boost::string_ref selectorString)
+				{
+					std::shared_ptr<SimpleHtmlSelector> selector(new SimpleHtmlSelector());
+
+					// Split the selector into its comma separated alternatives, being careful not to
+					// split on commas found within attribute selector values.
+					size_t start = 0;
+					size_t bracketDepth = 0;
+					char quote = 0;
+
+					for (size_t i = 0; i <= selectorString.size(); ++i)
+					{
+						if (i < selectorString.size())
+						{
+							const char c = selectorString[i];
+
+							if (quote != 0)
+							{
+								if (c == quote)
+								{
+									quote = 0;
+								}
+
+								continue;
+							}
+
+							if (c == '"' || c == '\'')
+							{
+								quote = c;
+								continue;
+							}
+
+							if (c == '[')
+							{
+								++bracketDepth;
+								continue;
+							}
+
+							if (c == ']' && bracketDepth > 0)
+							{
+								--bracketDepth;
+								continue;
+							}
+
+							if (c != ',' || bracketDepth > 0)
+							{
+								continue;
+							}
+						}
+
+						auto part = TrimSelectorWhitespace(selectorString.substr(start, i - start));
+
+						ComplexSelector complex;
+
+						if (part.size() == 0 || !ParseComplex(part, complex))
+						{
+							// Either an empty alternative or something we don't support. Either
+							// way, this whole selector has to be handed off to GQ.
+							return nullptr;
+						}
+
+						if (complex.size() > 1)
+						{
+							selector->m_requiresAncestors = true;
+						}
+
+						if (complex.back().id.empty() && complex.back().classes.size() == 0)
+						{
+							selector->m_requiresTokens = false;
+						}
+
+						selector->m_alternatives.push_back(std::move(complex));
+
+						start = i + 1;
+					}
+
+					if (quote != 0 || bracketDepth != 0 || selector->m_alternatives.size() == 0)
+					{
+						return nullptr;
+					}
+
+					return selector;
+				}
+
+				bool SimpleHtmlSelector::IsMatch(const HtmlElement& element, const HtmlElement* ancestors, const size_t ancestorCount) const
+				{
+					for (const auto& complex : m_alternatives)
+					{
+						// Always evaluate right to left. The right-most compound must match the
+						// element itself, and this is the cheapest and most selective check.
+						if (!IsCompoundMatch(complex.back(), element))
+						{
+							continue;
+						}
+
+						if (complex.size() == 1 || IsAncestryMatch(complex, complex.size() - 1, ancestors, ancestorCount))
+						{
+							return true;
+						}
+					}
+
+					return false;
+				}
+
+				const bool SimpleHtmlSelector::RequiresAncestors() const
+				{
+					return m_requiresAncestors;
+				}
+
+				bool SimpleHtmlSelector::MayMatch(const HtmlTokenSet& tokens) const
+				{
+					if (!m_requiresTokens)
+					{
+						return true;
+					}
+
+					for (const auto& complex : m_alternatives)
+					{
+						const auto& compound = complex.back();
+
+						if (!compound.id.empty() && !tokens.HasId(compound.id))
+						{
+							continue;
+						}
+
+						bool hasAllClasses = true;
+
+						for (const auto& className : compound.classes)
+						{
+							if (!tokens.HasClass(className))
+							{
+								hasAllClasses = false;
+								break;
+							}
+						}
+
+						if (hasAllClasses)
+						{
+							return true;
+						}
+					}
+
+					return false;
+				}
+
+				bool SimpleHtmlSelector::ParseComplex(boost::string_ref selectorString, ComplexSelector& out)
+				{
+					size_t pos = 0;
+					Combinator pendingCombinator = Combinator::None;
+
+					while (pos < selectorString.size())
+					{
+						bool sawWhitespace = false;
+
+						while (pos < selectorString.size() && IsSelectorWhitespace(selectorString[pos]))
+						{
+							sawWhitespace = true;
+							++pos;
+						}
+
+						if (pos >= selectorString.size())
+						{
+							break;
+						}
+
+						if (sawWhitespace && out.size() > 0 && pendingCombinator == Combinator::None)
+						{
+							pendingCombinator = Combinator::Descendant;
+						}
+
+						if (selectorString[pos] == '>')
+						{
+							if (out.size() == 0 || pendingCombinator == Combinator::Child)
+							{
+								return false;
+							}
+
+							pendingCombinator = Combinator::Child;
+							++pos;
+							continue;
+						}
+
+						if (out.size() > 0 && pendingCombinator == Combinator::None)
+						{
+							// Two compounds jammed together with something we don't understand
+							// between them.
+							return false;
+						}
+
+						Compound compound;
+						compound.combinator = pendingCombinator;
+						bool hadAny = false;
+
+						if (selectorString[pos] == '*')
+						{
+							hadAny = true;
+							++pos;
+						}
+						else if (IsIdentChar(selectorString[pos]))
+						{
+							ReadIdent(selectorString, pos, compound.tag);
+							ToLower(compound.tag);
+							hadAny = true;
+						}
+
+						while (pos < selectorString.size())
+						{
+							const char c = selectorString[pos];
+
+							if (c == '#')
+							{
+								++pos;
+
+								if (!compound.id.empty() || !ReadIdent(selectorString, pos, compound.id))
+								{
+									return false;
+								}
+							}
+							else if (c == '.')
+							{
+								++pos;
+
+								std::string className;
+								if (!ReadIdent(selectorString, pos, className))
+								{
+									return false;
+								}
+
+								compound.classes.push_back(std::move(className));
+							}
+							else if (c == '[')
+							{
+								++pos;
+
+								AttributeCondition condition;
+
+								while (pos < selectorString.size() && IsSelectorWhitespace(selectorString[pos])) { ++pos; }
+
+								if (!ReadIdent(selectorString, pos, condition.name))
+								{
+									return false;
+								}
+
+								ToLower(condition.name);
+
+								while (pos < selectorString.size() && IsSelectorWhitespace(selectorString[pos])) { ++pos; }
+
+								if (pos >= selectorString.size())
+								{
+									return false;
+								}
+
+								if (selectorString[pos] != ']')
+								{
+									switch (selectorString[pos])
+									{
+										case '=':
+											condition.op = AttributeOperator::Equals;
+											break;
+										case '^':
+											condition.op = AttributeOperator::Prefix;
+											break;
+										case '$':
+											condition.op = AttributeOperator::Suffix;
+											break;
+										case '*':
+											condition.op = AttributeOperator::Contains;
+											break;
+										case '~':
+											condition.op = AttributeOperator::ListContains;
+											break;
+										case '|':
+											condition.op = AttributeOperator::DashMatch;
+											break;
+										default:
+											return false;
+									}
+
+									if (condition.op != AttributeOperator::Equals)
+									{
+										++pos;
+
+										if (pos >= selectorString.size() || selectorString[pos] != '=')
+										{
+											return false;
+										}
+									}
+
+									++pos;
+
+									while (pos < selectorString.size() && IsSelectorWhitespace(selectorString[pos])) { ++pos; }
+
+									if (pos >= selectorString.size())
+									{
+										return false;
+									}
+
+									const char quote = selectorString[pos];
+
+									if (quote == '"' || quote == '\'')
+									{
+										++pos;
+
+										auto valueEnd = selectorString.substr(pos).find(quote);
+
+										if (valueEnd == boost::string_ref::npos)
+										{
+											return false;
+										}
+
+										valueEnd += pos;
+
+										auto value = selectorString.substr(pos, valueEnd - pos);
+
+										if (value.find('\\') != boost::string_ref::npos)
+										{
+											// Escapes aren't worth the trouble. Let GQ have it.
+											return false;
+										}
+
+										condition.value = value.to_string();
+										pos = valueEnd + 1;
+									}
+									else if (!ReadIdent(selectorString, pos, condition.value))
+									{
+										return false;
+									}
+
+									while (pos < selectorString.size() && IsSelectorWhitespace(selectorString[pos])) { ++pos; }
+
+									// This also rejects case sensitivity flags, ie [href="x" i].
+									if (pos >= selectorString.size() || selectorString[pos] != ']')
+									{
+										return false;
+									}
+								}
+
+								++pos;
+
+								compound.attributes.push_back(std::move(condition));
+							}
+							else if (IsSelectorWhitespace(c) || c == '>')
+							{
+								break;
+							}
+							else
+							{
+								// Pseudo classes, sibling combinators, escapes and so on.
+								return false;
+							}
+
+							hadAny = true;
+						}
+
+						if (!hadAny)
+						{
+							return false;
+						}
+
+						out.push_back(std::move(compound));
+						pendingCombinator = Combinator::None;
+					}
+
+					return out.size() > 0 && pendingCombinator != Combinator::Child;
+				}
+
+				bool SimpleHtmlSelector::IsCompoundMatch(const Compound& compound, const HtmlElement& element)
+				{
+					if (!compound.tag.empty() && compound.tag != element.name)
+					{
+						return false;
+					}
+
+					if (!compound.id.empty())
+					{
+						const auto id = FindAttribute(element, u8"id");
+
+						if (id == nullptr || *id != compound.id)
+						{
+							return false;
+						}
+					}
+
+					if (compound.classes.size() > 0)
+					{
+						const auto classList = FindAttribute(element, u8"class");
+
+						if (classList == nullptr)
+						{
+							return false;
+						}
+
+						for (const auto& className : compound.classes)
+						{
+							if (!HasWhitespaceToken(*classList, className))
+							{
+								return false;
+							}
+						}
+					}
+
+					for (const auto& condition : compound.attributes)
+					{
+						const auto attribute = FindAttribute(element, condition.name);
+
+						if (attribute == nullptr)
+						{
+							return false;
+						}
+
+						const boost::string_ref value(*attribute);
+						const boost::string_ref expected(condition.value);
+
+						switch (condition.op)
+						{
+							case AttributeOperator::Exists:
+								break;
+
+							case AttributeOperator::Equals:
+								if (value != expected) { return false; }
+								break;
+
+							case AttributeOperator::Prefix:
+								if (expected.size() == 0 || !value.starts_with(expected)) { return false; }
+								break;
+
+							case AttributeOperator::Suffix:
+								if (expected.size() == 0 || !value.ends_with(expected)) { return false; }
+								break;
+
+							case AttributeOperator::Contains:
+								if (expected.size() == 0 || value.find(expected) == boost::string_ref::npos) { return false; }
+								break;
+
+							case AttributeOperator::ListContains:
+								if (!HasWhitespaceToken(value, expected)) { return false; }
+								break;
+
+							case AttributeOperator::DashMatch:
+								if (value != expected && !(value.size() > expected.size() && value.starts_with(expected) && value[expected.size()] == '-')) { return false; }
+								break;
+						}
+					}
+
+					return true;
+				}
+
+				bool SimpleHtmlSelector::IsAncestryMatch(const ComplexSelector& complex, const size_t compoundIndex, const HtmlElement* ancestors, const size_t ancestorCount)
+				{
+					if (compoundIndex == 0)
+					{
+						return true;
+					}
+
+					const auto& left = complex[compoundIndex - 1];
+
+					if (complex[compoundIndex].combinator == Combinator::Child)
+					{
+						if (ancestorCount == 0)
+						{
+							return false;
+						}
+
+						return IsCompoundMatch(left, ancestors[ancestorCount - 1]) && IsAncestryMatch(complex, compoundIndex - 1, ancestors, ancestorCount - 1);
+					}
+
+					// Descendant. Try every ancestor, nearest first, backtracking if the remainder
+					// of the chain fails to match from that point.
+					for (size_t i = ancestorCount; i-- > 0;)
+					{
+						if (IsCompoundMatch(left, ancestors[i]) && IsAncestryMatch(complex, compoundIndex - 1, ancestors, i))
+						{
+							return true;
+						}
+					}
+
+					return false;
+				}
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
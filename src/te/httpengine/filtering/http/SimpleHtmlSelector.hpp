@@ -0,0 +1,297 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Forward decl for the payload token set.
+				/// </summary>
+				class HtmlTokenSet;
+
+				/// <summary>
+				/// A minimal representation of an HTML element start tag, as seen by the
+				/// StreamingHtmlRewriter while tokenizing. The tag name and all attribute names
+				/// are stored in lower case. Attribute values are stored exactly as they were
+				/// found in the markup, minus any surrounding quotes.
+				/// </summary>
+				struct HtmlElement
+				{
+					/// <summary>
+					/// The lower case tag name of the element.
+					/// </summary>
+					std::string name;
+
+					/// <summary>
+					/// All of the attributes of the element, as name/value pairs, in the order
+					/// that they were declared.
+					/// </summary>
+					std::vector<std::pair<std::string, std::string>> attributes;
+				};
+
+				/// <summary>
+				/// The SimpleHtmlSelector is a tiny CSS selector engine that handles only the
+				/// subset of CSS selectors that can be evaluated against an element at the exact
+				/// moment its start tag is tokenized. That is, tag, id, class and attribute
+				/// selectors, compounded together, joined by descendant or child combinators,
+				/// and grouped with commas.
+				///
+				/// Anything else, such as pseudo classes or sibling combinators, requires either
+				/// knowledge of the document that comes after the element or a full tree, so
+				/// selectors using such features are rejected and must be handled by GQ instead.
+				/// The vast majority of ABP element hiding rules are simple class, id and
+				/// attribute selectors, so the vast majority of them can be handled here without
+				/// ever building a DOM.
+				/// </summary>
+				class SimpleHtmlSelector
+				{
+
+				public:
+
+					/// <summary>
+					/// Attempts to compile the supplied selector string into a SimpleHtmlSelector.
+					/// Unlike the GQ parser, this will not throw when given a selector that it does
+					/// not understand. The selector may be perfectly valid, simply not something
+					/// that we're capable of handling, so nullptr is returned instead.
+					/// </summary>
+					/// <param name="selectorString">
+					/// The raw CSS selector string.
+					/// </param>
+					/// <returns>
+					/// A compiled selector if the selector string is entirely within the supported
+					/// subset, nullptr otherwise.
+					/// </returns>
+					static std::shared_ptr<SimpleHtmlSelector> Create(boost::string_ref selectorString);
+
+					/// <summary>
+					/// Default destructor.
+					/// </summary>
+					~SimpleHtmlSelector();
+
+					/// <summary>
+					/// Determines if the supplied element, given the supplied ancestors, is matched
+					/// by this selector.
+					/// </summary>
+					/// <param name="element">
+					/// The element to match.
+					/// </param>
+					/// <param name="ancestors">
+					/// Pointer to the first element of the currently open element stack, where
+					/// the element at ancestorCount - 1 is the direct parent of the supplied
+					/// element. May be nullptr if ancestorCount is zero.
+					/// </param>
+					/// <param name="ancestorCount">
+					/// The number of open ancestor elements.
+					/// </param>
+					/// <returns>
+					/// True if the element is matched by this selector, false otherwise.
+					/// </returns>
+					bool IsMatch(const HtmlElement& element, const HtmlElement* ancestors, const size_t ancestorCount) const;
+
+					/// <summary>
+					/// Indicates whether or not this selector uses combinators, meaning that
+					/// attributes of ancestor elements must be retained in order to evaluate it.
+					/// </summary>
+					/// <returns>
+					/// True if any part of this selector requires ancestor information, false
+					/// otherwise.
+					/// </returns>
+					const bool RequiresAncestors() const;
+
+					/// <summary>
+					/// Determines if this selector could possibly match any element within a
+					/// payload, given the ids and classes found in that payload. Every compound
+					/// that must match the element itself requires its id and classes to be present
+					/// somewhere in the payload, so if they aren't, the selector cannot match.
+					/// </summary>
+					/// <param name="tokens">
+					/// The ids and classes found in the payload.
+					/// </param>
+					/// <returns>
+					/// False if this selector definitely cannot match anything within the payload,
+					/// true otherwise. Selectors without any id or class requirement, such as plain
+					/// tag or attribute selectors, always return true.
+					/// </returns>
+					bool MayMatch(const HtmlTokenSet& tokens) const;
+
+				private:
+
+					/// <summary>
+					/// Supported attribute selector operators.
+					/// </summary>
+					enum class AttributeOperator : uint8_t
+					{
+						Exists,
+						Equals,
+						Prefix,
+						Suffix,
+						Contains,
+						ListContains,
+						DashMatch
+					};
+
+					/// <summary>
+					/// Supported combinators. The combinator is stored on the compound it
+					/// precedes, describing the relation of that compound to the compound on its
+					/// left.
+					/// </summary>
+					enum class Combinator : uint8_t
+					{
+						None,
+						Descendant,
+						Child
+					};
+
+					/// <summary>
+					/// A single attribute condition, such as [href^="http://ads."].
+					/// </summary>
+					struct AttributeCondition
+					{
+						std::string name;
+						std::string value;
+						AttributeOperator op = AttributeOperator::Exists;
+					};
+
+					/// <summary>
+					/// A compound selector, such as div#main.ad[data-ad], which must match a
+					/// single element in its entirety.
+					/// </summary>
+					struct Compound
+					{
+						std::string tag;
+						std::string id;
+						std::vector<std::string> classes;
+						std::vector<AttributeCondition> attributes;
+						Combinator combinator = Combinator::None;
+					};
+
+					/// <summary>
+					/// A complex selector is a chain of compounds, left to right.
+					/// </summary>
+					using ComplexSelector = std::vector<Compound>;
+
+					/// <summary>
+					/// Private constructor. Use ::Create(...).
+					/// </summary>
+					SimpleHtmlSelector();
+
+					/// <summary>
+					/// Parses a single comma-free complex selector into the supplied structure.
+					/// </summary>
+					/// <param name="selectorString">
+					/// The complex selector string, trimmed of surrounding whitespace.
+					/// </param>
+					/// <param name="out">
+					/// The structure to populate.
+					/// </param>
+					/// <returns>
+					/// True if the selector was parsed entirely, false if the selector uses
+					/// something outside of the supported subset.
+					/// </returns>
+					static bool ParseComplex(boost::string_ref selectorString, ComplexSelector& out);
+
+					/// <summary>
+					/// Determines if the supplied compound matches the supplied element.
+					/// </summary>
+					/// <param name="compound">
+					/// The compound selector.
+					/// </param>
+					/// <param name="element">
+					/// The element.
+					/// </param>
+					/// <returns>
+					/// True if the compound matches the element, false otherwise.
+					/// </returns>
+					static bool IsCompoundMatch(const Compound& compound, const HtmlElement& element);
+
+					/// <summary>
+					/// Recursively matches the compounds of a complex selector, from right to
+					/// left, against the open ancestors of an already matched element. This
+					/// backtracks where required, so mixed descendant and child combinators are
+					/// evaluated correctly.
+					/// </summary>
+					/// <param name="complex">
+					/// The complex selector being evaluated.
+					/// </param>
+					/// <param name="compoundIndex">
+					/// The index of the last compound that was successfully matched.
+					/// </param>
+					/// <param name="ancestors">
+					/// Pointer to the first element of the open element stack.
+					/// </param>
+					/// <param name="ancestorCount">
+					/// The number of ancestors which are candidates for the next compound to the
+					/// left of compoundIndex.
+					/// </param>
+					/// <returns>
+					/// True if the remainder of the complex selector was matched, false
+					/// otherwise.
+					/// </returns>
+					static bool IsAncestryMatch(const ComplexSelector& complex, const size_t compoundIndex, const HtmlElement* ancestors, const size_t ancestorCount);
+
+					/// <summary>
+					/// Every comma separated selector in the original selector string.
+					/// </summary>
+					std::vector<ComplexSelector> m_alternatives;
+
+					/// <summary>
+					/// Indicates if any alternative uses a combinator.
+					/// </summary>
+					bool m_requiresAncestors = false;
+
+					/// <summary>
+					/// Indicates if every alternative requires the matched element to carry at
+					/// least one id or class. If not, the selector can never be ruled out by
+					/// looking at the ids and classes present in a payload.
+					/// </summary>
+					bool m_requiresTokens = true;
+
+				};
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
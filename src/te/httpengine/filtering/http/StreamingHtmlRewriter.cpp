@@ -0,0 +1,819 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StreamingHtmlRewriter.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					inline bool IsHtmlWhitespace(const char c)
+					{
+						return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+					}
+
+					inline bool IsVoidElement(const std::string& name)
+					{
+						static const char* const voidElements[] = 
+						{
+							u8"area", u8"base", u8"br", u8"col", u8"embed", u8"hr", u8"img", u8"input",
+							u8"keygen", u8"link", u8"meta", u8"param", u8"source", u8"track", u8"wbr"
+						};
+
+						for (const auto voidElement : voidElements)
+						{
+							if (name == voidElement)
+							{
+								return true;
+							}
+						}
+
+						return false;
+					}
+
+					inline bool IsRawTextElement(const std::string& name)
+					{
+						static const char* const rawTextElements[] =
+						{
+							u8"script", u8"style", u8"textarea", u8"title", u8"xmp", u8"iframe", u8"noembed", u8"noframes", u8"noscript"
+						};
+
+						for (const auto rawTextElement : rawTextElements)
+						{
+							if (name == rawTextElement)
+							{
+								return true;
+							}
+						}
+
+						return false;
+					}
+
+					inline bool IsParagraphCloser(const std::string& name)
+					{
+						static const char* const closers[] =
+						{
+							u8"address", u8"article", u8"aside", u8"blockquote", u8"details", u8"dialog", u8"div", u8"dl",
+							u8"fieldset", u8"figcaption", u8"figure", u8"footer", u8"form", u8"h1", u8"h2", u8"h3", u8"h4",
+							u8"h5", u8"h6", u8"header", u8"hgroup", u8"hr", u8"main", u8"menu", u8"nav", u8"ol", u8"p",
+							u8"pre", u8"section", u8"table", u8"ul"
+						};
+
+						for (const auto closer : closers)
+						{
+							if (name == closer)
+							{
+								return true;
+							}
+						}
+
+						return false;
+					}
+
+					inline bool IsTableSection(const std::string& name)
+					{
+						return name == u8"tbody" || name == u8"thead" || name == u8"tfoot";
+					}
+
+					/// <summary>
+					/// Finds the closing angle bracket of a start tag beginning at the supplied
+					/// offset, skipping over any that are found inside of quoted attribute values.
+					/// </summary>
+					inline size_t FindStartTagEnd(const char* data, size_t pos, const size_t length)
+					{
+						char quote = 0;
+
+						for (; pos < length; ++pos)
+						{
+							const char c = data[pos];
+
+							if (quote != 0)
+							{
+								if (c == quote)
+								{
+									quote = 0;
+								}
+							}
+							else if (c == '"' || c == '\'')
+							{
+								// Only treat this as a quote if it opens an attribute value.
+								if (pos > 0 && (data[pos - 1] == '=' || IsHtmlWhitespace(data[pos - 1])))
+								{
+									quote = c;
+								}
+							}
+							else if (c == '>')
+							{
+								return pos;
+							}
+						}
+
+						return std::string::npos;
+					}
+				}
+
+				StreamingHtmlRewriter::StreamingHtmlRewriter()
+				{
+
+				}
+
+				StreamingHtmlRewriter::StreamingHtmlRewriter(
+					const std::vector<const SimpleHtmlSelector*>& removalSelectors,
+					const std::vector<const SimpleHtmlSelector*>& exceptionSelectors,
+					OutputFunction onOutput
+					)
+				{
+					Reset(removalSelectors, exceptionSelectors, std::move(onOutput));
+				}
+
+				StreamingHtmlRewriter::~StreamingHtmlRewriter()
+				{
+
+				}
+
+				void StreamingHtmlRewriter::Reset(
+					const std::vector<const SimpleHtmlSelector*>& removalSelectors,
+					const std::vector<const SimpleHtmlSelector*>& exceptionSelectors,
+					OutputFunction onOutput
+					)
+				{
+					#ifndef NDEBUG
+						assert(onOutput && u8"In StreamingHtmlRewriter::Reset(const std::vector<const SimpleHtmlSelector*>&, const std::vector<const SimpleHtmlSelector*>&, OutputFunction) - Output function must be valid.");
+					#else
+						if (!onOutput) { throw std::runtime_error(u8"In StreamingHtmlRewriter::Reset(const std::vector<const SimpleHtmlSelector*>&, const std::vector<const SimpleHtmlSelector*>&, OutputFunction) - Output function must be valid."); };
+					#endif
+
+					// Note that everything here is cleared or assigned rather than replaced, so
+					// that whatever capacity was built up by previous documents is kept.
+					m_removalSelectors.assign(removalSelectors.begin(), removalSelectors.end());
+					m_exceptionSelectors.assign(exceptionSelectors.begin(), exceptionSelectors.end());
+					m_onOutput = std::move(onOutput);
+
+					m_pending.clear();
+					m_state = State::Data;
+					m_rawTextTag.clear();
+					m_openCount = 0;
+					m_currentElement.name.clear();
+					m_endTagName.clear();
+					m_removalDepth = NotRemoving;
+					m_elementsRemoved = 0;
+
+					m_retainAncestorAttributes = false;
+
+					for (const auto selector : m_removalSelectors)
+					{
+						m_retainAncestorAttributes = m_retainAncestorAttributes || selector->RequiresAncestors();
+					}
+
+					for (const auto selector : m_exceptionSelectors)
+					{
+						m_retainAncestorAttributes = m_retainAncestorAttributes || selector->RequiresAncestors();
+					}
+				}
+
+				void StreamingHtmlRewriter::Write(const char* data, const size_t length)
+				{
+					if (length == 0)
+					{
+						return;
+					}
+
+					if (m_pending.empty())
+					{
+						// Nothing held over from last time, so we can tokenize the caller's data
+						// right where it sits.
+						auto consumed = Process(data, length, false);
+
+						if (consumed < length)
+						{
+							m_pending.assign(data + consumed, length - consumed);
+						}
+
+						return;
+					}
+
+					m_pending.append(data, length);
+
+					auto consumed = Process(m_pending.data(), m_pending.size(), false);
+
+					m_pending.erase(0, consumed);
+				}
+
+				void StreamingHtmlRewriter::Finish()
+				{
+					if (!m_pending.empty())
+					{
+						Process(m_pending.data(), m_pending.size(), true);
+						m_pending.clear();
+					}
+				}
+
+				const uint32_t StreamingHtmlRewriter::GetElementsRemoved() const
+				{
+					return m_elementsRemoved;
+				}
+
+				size_t StreamingHtmlRewriter::Process(const char* data, const size_t length, const bool final)
+				{
+					size_t pos = 0;
+
+					while (pos < length)
+					{
+						switch (m_state)
+						{
+							case State::Data:
+							{
+								auto lt = static_cast<const char*>(std::memchr(data + pos, '<', length - pos));
+
+								if (lt == nullptr)
+								{
+									Emit(data + pos, length - pos);
+									return length;
+								}
+
+								size_t ltPos = static_cast<size_t>(lt - data);
+
+								if (ltPos > pos)
+								{
+									Emit(data + pos, ltPos - pos);
+								}
+
+								pos = ltPos;
+
+								if (pos + 1 >= length)
+								{
+									break;
+								}
+
+								const char next = data[pos + 1];
+
+								if (next == '!' || next == '?')
+								{
+									if (next == '!' && (length - pos) < 4 && !final)
+									{
+										// Might be the start of a comment, can't tell yet.
+										return pos;
+									}
+
+									if ((length - pos) >= 4 && std::memcmp(data + pos, u8"<!--", 4) == 0)
+									{
+										Emit(data + pos, 4);
+										pos += 4;
+										m_state = State::Comment;
+										continue;
+									}
+
+									// Doctype, CDATA, processing instruction or bogus comment.
+									// Just pass it along.
+									auto gt = static_cast<const char*>(std::memchr(data + pos, '>', length - pos));
+
+									if (gt == nullptr)
+									{
+										break;
+									}
+
+									auto gtPos = static_cast<size_t>(gt - data);
+									Emit(data + pos, gtPos + 1 - pos);
+									pos = gtPos + 1;
+									continue;
+								}
+
+								if (next == '/')
+								{
+									auto gt = static_cast<const char*>(std::memchr(data + pos, '>', length - pos));
+
+									if (gt == nullptr)
+									{
+										break;
+									}
+
+									auto gtPos = static_cast<size_t>(gt - data);
+
+									boost::string_ref tag(data + pos, gtPos + 1 - pos);
+
+									size_t nameEnd = 2;
+									while (nameEnd < tag.size() && !IsHtmlWhitespace(tag[nameEnd]) && tag[nameEnd] != '/' && tag[nameEnd] != '>')
+									{
+										++nameEnd;
+									}
+
+									if (nameEnd == 2 || !std::isalpha(static_cast<unsigned char>(tag[2])))
+									{
+										// Bogus comment.
+										Emit(tag.data(), tag.size());
+									}
+									else
+									{
+										m_endTagName.assign(tag.data() + 2, nameEnd - 2);
+										std::transform(m_endTagName.begin(), m_endTagName.end(), m_endTagName.begin(), ::tolower);
+										OnEndTag(tag, m_endTagName);
+									}
+
+									pos = gtPos + 1;
+									continue;
+								}
+
+								if (std::isalpha(static_cast<unsigned char>(next)))
+								{
+									auto gtPos = FindStartTagEnd(data, pos + 1, length);
+
+									if (gtPos == std::string::npos)
+									{
+										break;
+									}
+
+									boost::string_ref tag(data + pos, gtPos + 1 - pos);
+
+									OnStartTag(tag, ParseStartTag(tag));
+
+									pos = gtPos + 1;
+									continue;
+								}
+
+								// Just a stray less-than sign.
+								Emit(data + pos, 1);
+								++pos;
+								continue;
+							}
+							break;
+
+							case State::Comment:
+							{
+								boost::string_ref remaining(data + pos, length - pos);
+
+								auto end = remaining.find(u8"-->");
+
+								if (end != boost::string_ref::npos)
+								{
+									Emit(data + pos, end + 3);
+									pos += end + 3;
+									m_state = State::Data;
+									continue;
+								}
+
+								if (final)
+								{
+									Emit(data + pos, length - pos);
+									return length;
+								}
+
+								// Hold onto the last two bytes, since they may be the beginning of the
+								// comment terminator.
+								if (length - pos > 2)
+								{
+									Emit(data + pos, length - pos - 2);
+									pos = length - 2;
+								}
+
+								return pos;
+							}
+							break;
+
+							case State::RawText:
+							{
+								boost::string_ref remaining(data + pos, length - pos);
+
+								const size_t tagLength = m_rawTextTag.size();
+
+								size_t searchFrom = 0;
+								bool foundEnd = false;
+
+								while (searchFrom < remaining.size())
+								{
+									auto candidate = remaining.substr(searchFrom).find(u8"</");
+
+									if (candidate == boost::string_ref::npos)
+									{
+										break;
+									}
+
+									candidate += searchFrom;
+
+									if (candidate + 2 + tagLength >= remaining.size())
+									{
+										if (final)
+										{
+											break;
+										}
+
+										// Not enough data to know if this is our end tag or not.
+										Emit(data + pos, candidate);
+										return pos + candidate;
+									}
+
+									bool nameMatches = true;
+
+									for (size_t i = 0; i < tagLength; ++i)
+									{
+										if (std::tolower(static_cast<unsigned char>(remaining[candidate + 2 + i])) != m_rawTextTag[i])
+										{
+											nameMatches = false;
+											break;
+										}
+									}
+
+									const char after = remaining[candidate + 2 + tagLength];
+
+									if (nameMatches && (IsHtmlWhitespace(after) || after == '/' || after == '>'))
+									{
+										Emit(data + pos, candidate);
+										pos += candidate;
+										m_state = State::Data;
+										foundEnd = true;
+										break;
+									}
+
+									searchFrom = candidate + 2;
+								}
+
+								if (foundEnd)
+								{
+									continue;
+								}
+
+								if (!final && remaining.back() == '<')
+								{
+									Emit(data + pos, remaining.size() - 1);
+									return length - 1;
+								}
+
+								Emit(data + pos, remaining.size());
+								return length;
+							}
+							break;
+						}
+
+						// We only get here when a token in the data state was incomplete.
+						if (final)
+						{
+							Emit(data + pos, length - pos);
+							return length;
+						}
+
+						return pos;
+					}
+
+					return pos;
+				}
+
+				bool StreamingHtmlRewriter::ParseStartTag(boost::string_ref tag)
+				{
+					// Strip the angle brackets.
+					tag = tag.substr(1, tag.size() - 2);
+
+					size_t pos = 0;
+
+					while (pos < tag.size() && !IsHtmlWhitespace(tag[pos]) && tag[pos] != '/')
+					{
+						++pos;
+					}
+
+					m_currentElement.name.assign(tag.data(), pos);
+					std::transform(m_currentElement.name.begin(), m_currentElement.name.end(), m_currentElement.name.begin(), ::tolower);
+
+					// Attribute slots left over from the previous tag are overwritten in place, so
+					// that their strings don't have to be allocated all over again.
+					auto& attributes = m_currentElement.attributes;
+					size_t attributeCount = 0;
+
+					bool selfClosing = false;
+
+					while (pos < tag.size())
+					{
+						const char c = tag[pos];
+
+						if (IsHtmlWhitespace(c))
+						{
+							++pos;
+							continue;
+						}
+
+						if (c == '/')
+						{
+							selfClosing = (pos + 1 == tag.size());
+							++pos;
+							continue;
+						}
+
+						auto nameStart = pos;
+
+						while (pos < tag.size() && !IsHtmlWhitespace(tag[pos]) && tag[pos] != '=' && tag[pos] != '/')
+						{
+							++pos;
+						}
+
+						// An attribute name may begin with an equals sign, believe it or not.
+						if (pos == nameStart)
+						{
+							++pos;
+						}
+
+						if (attributeCount == attributes.size())
+						{
+							attributes.emplace_back();
+						}
+
+						auto& attributeName = attributes[attributeCount].first;
+						auto& attributeValue = attributes[attributeCount].second;
+
+						attributeName.assign(tag.data() + nameStart, pos - nameStart);
+						std::transform(attributeName.begin(), attributeName.end(), attributeName.begin(), ::tolower);
+
+						attributeValue.clear();
+
+						while (pos < tag.size() && IsHtmlWhitespace(tag[pos]))
+						{
+							++pos;
+						}
+
+						if (pos < tag.size() && tag[pos] == '=')
+						{
+							++pos;
+
+							while (pos < tag.size() && IsHtmlWhitespace(tag[pos]))
+							{
+								++pos;
+							}
+
+							if (pos < tag.size() && (tag[pos] == '"' || tag[pos] == '\''))
+							{
+								const char quote = tag[pos];
+								++pos;
+
+								auto valueEnd = tag.substr(pos).find(quote);
+
+								if (valueEnd == boost::string_ref::npos)
+								{
+									valueEnd = tag.size();
+								}
+								else
+								{
+									valueEnd += pos;
+								}
+
+								attributeValue.assign(tag.data() + pos, valueEnd - pos);
+								pos = valueEnd + 1;
+							}
+							else
+							{
+								auto valueStart = pos;
+
+								while (pos < tag.size() && !IsHtmlWhitespace(tag[pos]))
+								{
+									++pos;
+								}
+
+								attributeValue.assign(tag.data() + valueStart, pos - valueStart);
+							}
+						}
+
+						// Per spec, only the first occurrence of an attribute counts. A duplicate
+						// simply doesn't claim the slot, and gets overwritten by whatever comes next.
+						bool duplicate = false;
+						for (size_t i = 0; i < attributeCount; ++i)
+						{
+							if (attributes[i].first == attributeName)
+							{
+								duplicate = true;
+								break;
+							}
+						}
+
+						if (!duplicate)
+						{
+							++attributeCount;
+						}
+					}
+
+					attributes.resize(attributeCount);
+
+					return selfClosing;
+				}
+
+				void StreamingHtmlRewriter::OnStartTag(boost::string_ref tag, const bool selfClosing)
+				{
+					CloseImplicitly(m_currentElement.name);
+
+					const bool isVoid = selfClosing || IsVoidElement(m_currentElement.name);
+
+					if (!IsRemoving() && ShouldRemove())
+					{
+						++m_elementsRemoved;
+
+						if (!isVoid)
+						{
+							m_removalDepth = m_openCount;
+							Push();
+						}
+					}
+					else
+					{
+						Emit(tag.data(), tag.size());
+
+						if (!isVoid)
+						{
+							Push();
+						}
+					}
+
+					if (!isVoid && IsRawTextElement(m_currentElement.name))
+					{
+						m_state = State::RawText;
+						m_rawTextTag = m_currentElement.name;
+					}
+				}
+
+				void StreamingHtmlRewriter::OnEndTag(boost::string_ref tag, const std::string& name)
+				{
+					size_t match = m_openCount;
+
+					for (size_t i = m_openCount; i-- > 0;)
+					{
+						if (m_openElements[i].name == name)
+						{
+							match = i;
+							break;
+						}
+					}
+
+					if (match == m_openCount)
+					{
+						// Stray end tag. Nothing to pop, pass it along unless we're removing.
+						Emit(tag.data(), tag.size());
+						return;
+					}
+
+					// If this end tag closes the removed element or anything inside of it, it
+					// belongs to the removed subtree. If it closes an ancestor of the removed
+					// element, the removal ends implicitly and the end tag itself must be kept.
+					const bool suppress = IsRemoving() && match >= m_removalDepth;
+
+					PopTo(match);
+
+					if (!suppress)
+					{
+						Emit(tag.data(), tag.size());
+					}
+				}
+
+				void StreamingHtmlRewriter::CloseImplicitly(const std::string& name)
+				{
+					while (m_openCount > 0)
+					{
+						const auto& top = m_openElements[m_openCount - 1].name;
+
+						bool closes = false;
+
+						if (top == u8"p")
+						{
+							closes = IsParagraphCloser(name) || name == u8"li" || name == u8"dd" || name == u8"dt";
+						}
+						else if (top == u8"li")
+						{
+							closes = (name == u8"li");
+						}
+						else if (top == u8"dt" || top == u8"dd")
+						{
+							closes = (name == u8"dt" || name == u8"dd");
+						}
+						else if (top == u8"option")
+						{
+							closes = (name == u8"option" || name == u8"optgroup");
+						}
+						else if (top == u8"optgroup")
+						{
+							closes = (name == u8"optgroup");
+						}
+						else if (top == u8"td" || top == u8"th")
+						{
+							closes = (name == u8"td" || name == u8"th" || name == u8"tr" || IsTableSection(name));
+						}
+						else if (top == u8"tr")
+						{
+							closes = (name == u8"tr" || IsTableSection(name));
+						}
+						else if (IsTableSection(top))
+						{
+							closes = IsTableSection(name);
+						}
+
+						if (!closes)
+						{
+							break;
+						}
+
+						PopTo(m_openCount - 1);
+					}
+				}
+
+				void StreamingHtmlRewriter::PopTo(const size_t count)
+				{
+					if (count >= m_openCount)
+					{
+						return;
+					}
+
+					if (IsRemoving() && count <= m_removalDepth)
+					{
+						m_removalDepth = NotRemoving;
+					}
+
+					m_openCount = count;
+				}
+
+				void StreamingHtmlRewriter::Push()
+				{
+					if (m_openCount == m_openElements.size())
+					{
+						m_openElements.emplace_back();
+					}
+
+					auto& slot = m_openElements[m_openCount++];
+
+					slot.name.assign(m_currentElement.name);
+
+					if (m_retainAncestorAttributes)
+					{
+						slot.attributes = m_currentElement.attributes;
+					}
+					else
+					{
+						slot.attributes.clear();
+					}
+				}
+
+				bool StreamingHtmlRewriter::ShouldRemove() const
+				{
+					const HtmlElement* ancestors = m_openElements.data();
+
+					for (const auto removal : m_removalSelectors)
+					{
+						if (removal->IsMatch(m_currentElement, ancestors, m_openCount))
+						{
+							for (const auto exception : m_exceptionSelectors)
+							{
+								if (exception->IsMatch(m_currentElement, ancestors, m_openCount))
+								{
+									return false;
+								}
+							}
+
+							return true;
+						}
+					}
+
+					return false;
+				}
+
+				void StreamingHtmlRewriter::Emit(const char* data, const size_t length)
+				{
+					if (length > 0 && !IsRemoving())
+					{
+						m_onOutput(data, length);
+					}
+				}
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
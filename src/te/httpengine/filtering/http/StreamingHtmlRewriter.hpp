@@ -0,0 +1,368 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+#include "SimpleHtmlSelector.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace filtering
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// The StreamingHtmlRewriter is a forward-only HTML tokenizer that removes
+				/// elements, and their entire subtrees, which are matched by a set of
+				/// SimpleHtmlSelector objects. Unlike GQ, no document tree is ever constructed.
+				/// Input can be supplied in arbitrarily sized pieces, and output is handed to the
+				/// supplied callback as soon as it is known to be safe to emit, so the amount of
+				/// memory used is bound to the size of the largest single tag rather than the
+				/// size of the document.
+				///
+				/// This is not a conforming HTML5 tree builder, and it doesn't try to be one. It
+				/// keeps a stack of open elements and applies the handful of implied end tag
+				/// rules that matter most for real world markup (unclosed paragraphs, list
+				/// items, table cells etc), so that removing an element can never swallow more
+				/// than the subtree of the element's parent. Raw text elements such as script
+				/// and style are respected, as are comments.
+				///
+				/// The selector pointers supplied at construction must remain valid for the
+				/// lifetime of the rewriter.
+				/// </summary>
+				class StreamingHtmlRewriter
+				{
+
+				public:
+
+					/// <summary>
+					/// Function that receives rewritten output.
+					/// </summary>
+					using OutputFunction = std::function<void(const char* data, const size_t length)>;
+
+					/// <summary>
+					/// Constructs a new, idle rewriter. ::Reset(...) must be called before the
+					/// rewriter is written to.
+					/// </summary>
+					StreamingHtmlRewriter();
+
+					/// <summary>
+					/// Constructs a new rewriter.
+					/// </summary>
+					/// <param name="removalSelectors">
+					/// Selectors matching elements which should be removed.
+					/// </param>
+					/// <param name="exceptionSelectors">
+					/// Selectors matching elements which must never be removed, even when matched
+					/// by a removal selector.
+					/// </param>
+					/// <param name="onOutput">
+					/// Callback which will receive all output. Must be valid.
+					/// </param>
+					StreamingHtmlRewriter(
+						const std::vector<const SimpleHtmlSelector*>& removalSelectors,
+						const std::vector<const SimpleHtmlSelector*>& exceptionSelectors,
+						OutputFunction onOutput
+						);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					StreamingHtmlRewriter(const StreamingHtmlRewriter&) = delete;
+					StreamingHtmlRewriter(StreamingHtmlRewriter&&) = delete;
+					StreamingHtmlRewriter& operator=(const StreamingHtmlRewriter&) = delete;
+
+					/// <summary>
+					/// Default destructor.
+					/// </summary>
+					~StreamingHtmlRewriter();
+
+					/// <summary>
+					/// Prepares the rewriter for a brand new document, discarding all state left
+					/// over from the previous one. Internal buffers, including the strings held by
+					/// the stack of open elements, keep the capacity they've grown to. A rewriter
+					/// that is kept around and reset for each document therefore quickly stops
+					/// allocating altogether.
+					/// </summary>
+					/// <param name="removalSelectors">
+					/// Selectors matching elements which should be removed.
+					/// </param>
+					/// <param name="exceptionSelectors">
+					/// Selectors matching elements which must never be removed, even when matched
+					/// by a removal selector.
+					/// </param>
+					/// <param name="onOutput">
+					/// Callback which will receive all output. Must be valid.
+					/// </param>
+					void Reset(
+						const std::vector<const SimpleHtmlSelector*>& removalSelectors,
+						const std::vector<const SimpleHtmlSelector*>& exceptionSelectors,
+						OutputFunction onOutput
+						);
+
+					/// <summary>
+					/// Feeds more of the document to the rewriter. Any output that can be safely
+					/// produced from the data supplied so far is immediately sent to the output
+					/// callback. A token that is split across two writes is held internally until
+					/// the remainder arrives. When the internal holding buffer is empty, the
+					/// supplied data is tokenized in place without being copied.
+					/// </summary>
+					/// <param name="data">
+					/// Pointer to the next piece of the document.
+					/// </param>
+					/// <param name="length">
+					/// The length of the data.
+					/// </param>
+					void Write(const char* data, const size_t length);
+
+					/// <summary>
+					/// Signals the end of the document, flushing anything held internally as-is.
+					/// </summary>
+					void Finish();
+
+					/// <summary>
+					/// Gets the total number of elements removed so far. Elements nested within an
+					/// already removed element are not counted.
+					/// </summary>
+					/// <returns>
+					/// The number of elements removed.
+					/// </returns>
+					const uint32_t GetElementsRemoved() const;
+
+				private:
+
+					/// <summary>
+					/// The tokenizer states that may span multiple writes.
+					/// </summary>
+					enum class State : uint8_t
+					{
+						Data,
+						RawText,
+						Comment
+					};
+
+					/// <summary>
+					/// Tokenizes as much of the supplied data as possible.
+					/// </summary>
+					/// <param name="data">
+					/// The data to tokenize.
+					/// </param>
+					/// <param name="length">
+					/// The length of the data.
+					/// </param>
+					/// <param name="final">
+					/// Whether or not this is the last of the document. When true, incomplete
+					/// tokens are emitted as-is rather than held.
+					/// </param>
+					/// <returns>
+					/// The number of bytes consumed. Anything not consumed must be supplied
+					/// again, with more data appended, on the next call.
+					/// </returns>
+					size_t Process(const char* data, const size_t length, const bool final);
+
+					/// <summary>
+					/// Parses a complete start tag into m_currentElement.
+					/// </summary>
+					/// <param name="tag">
+					/// The entire tag, including the angle brackets.
+					/// </param>
+					/// <returns>
+					/// True if the tag is self closing, false otherwise.
+					/// </returns>
+					bool ParseStartTag(boost::string_ref tag);
+
+					/// <summary>
+					/// Handles a complete start tag that has been parsed into m_currentElement.
+					/// </summary>
+					/// <param name="tag">
+					/// The entire tag, including the angle brackets.
+					/// </param>
+					/// <param name="selfClosing">
+					/// Whether or not the tag was self closing.
+					/// </param>
+					void OnStartTag(boost::string_ref tag, const bool selfClosing);
+
+					/// <summary>
+					/// Handles a complete end tag.
+					/// </summary>
+					/// <param name="tag">
+					/// The entire tag, including the angle brackets.
+					/// </param>
+					/// <param name="name">
+					/// The lower case name of the tag.
+					/// </param>
+					void OnEndTag(boost::string_ref tag, const std::string& name);
+
+					/// <summary>
+					/// Applies implied end tag rules for the supplied start tag name, popping any
+					/// open elements that the start tag implicitly closes.
+					/// </summary>
+					/// <param name="name">
+					/// The lower case name of the start tag about to be opened.
+					/// </param>
+					void CloseImplicitly(const std::string& name);
+
+					/// <summary>
+					/// Pops open elements until only the supplied count remain, ending any
+					/// removal in progress if the removed element is popped.
+					/// </summary>
+					/// <param name="count">
+					/// The number of open elements which should remain.
+					/// </param>
+					void PopTo(const size_t count);
+
+					/// <summary>
+					/// Pushes m_currentElement onto the stack of open elements.
+					/// </summary>
+					void Push();
+
+					/// <summary>
+					/// Determines if m_currentElement should be removed.
+					/// </summary>
+					/// <returns>
+					/// True if the element is matched by a removal selector and not by any
+					/// exception selector.
+					/// </returns>
+					bool ShouldRemove() const;
+
+					/// <summary>
+					/// Sends the supplied data to the output callback, unless an element is
+					/// currently being removed.
+					/// </summary>
+					/// <param name="data">
+					/// The data to emit.
+					/// </param>
+					/// <param name="length">
+					/// The length of the data.
+					/// </param>
+					void Emit(const char* data, const size_t length);
+
+					/// <summary>
+					/// Indicates if an element is currently being removed.
+					/// </summary>
+					/// <returns>
+					/// True if output is currently being suppressed, false otherwise.
+					/// </returns>
+					inline bool IsRemoving() const
+					{
+						return m_removalDepth != NotRemoving;
+					}
+
+					/// <summary>
+					/// Value of m_removalDepth when no element is being removed.
+					/// </summary>
+					static constexpr size_t NotRemoving = static_cast<size_t>(-1);
+
+					/// <summary>
+					/// Selectors matching elements which should be removed.
+					/// </summary>
+					std::vector<const SimpleHtmlSelector*> m_removalSelectors;
+
+					/// <summary>
+					/// Selectors matching elements which must not be removed.
+					/// </summary>
+					std::vector<const SimpleHtmlSelector*> m_exceptionSelectors;
+
+					/// <summary>
+					/// Where all output goes.
+					/// </summary>
+					OutputFunction m_onOutput;
+
+					/// <summary>
+					/// Holds an incomplete token which was split across writes.
+					/// </summary>
+					std::string m_pending;
+
+					/// <summary>
+					/// The current tokenizer state.
+					/// </summary>
+					State m_state = State::Data;
+
+					/// <summary>
+					/// When in the RawText state, the name of the element whose end tag we're
+					/// looking for.
+					/// </summary>
+					std::string m_rawTextTag;
+
+					/// <summary>
+					/// The stack of open elements. This vector is never shrunk. Instead,
+					/// m_openCount indicates how many entries are live, so that the strings held
+					/// by popped entries keep their capacity and can be reused without
+					/// allocating.
+					/// </summary>
+					std::vector<HtmlElement> m_openElements;
+
+					/// <summary>
+					/// The number of live entries in m_openElements.
+					/// </summary>
+					size_t m_openCount = 0;
+
+					/// <summary>
+					/// The most recently parsed start tag.
+					/// </summary>
+					HtmlElement m_currentElement;
+
+					/// <summary>
+					/// The lower case name of the most recently tokenized end tag.
+					/// </summary>
+					std::string m_endTagName;
+
+					/// <summary>
+					/// When an element is being removed, the index in the open element stack of
+					/// the removed element. NotRemoving otherwise.
+					/// </summary>
+					size_t m_removalDepth = NotRemoving;
+
+					/// <summary>
+					/// Whether or not any selector needs the attributes of ancestor elements. If
+					/// not, only tag names are retained in the stack of open elements.
+					/// </summary>
+					bool m_retainAncestorAttributes = false;
+
+					/// <summary>
+					/// The number of elements removed.
+					/// </summary>
+					uint32_t m_elementsRemoved = 0;
+
+				};
+
+			} /* namespace http */
+		} /* namespace filtering */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
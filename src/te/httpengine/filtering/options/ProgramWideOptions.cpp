@@ -74,7 +74,15 @@ namespace te
 						return;
 					}
 
-					m_httpContentFilteringCategories[category] = value;
+					if (m_httpContentFilteringCategories[category].exchange(value) != value)
+					{
+						++m_httpCategoryGeneration;
+					}
+				}
+
+				const uint32_t ProgramWideOptions::GetHttpCategoryGeneration() const
+				{
+					return m_httpCategoryGeneration;
 				}
 
 				bool ProgramWideOptions::GetIsHttpFilteringOptionEnabled(const http::HttpFilteringOption option) const
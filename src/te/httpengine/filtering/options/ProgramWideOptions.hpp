@@ -130,6 +130,18 @@ namespace te
 					/// </param>
 					void SetIsHttpCategoryFiltered(const uint8_t category, const bool value);
 
+					/// <summary>
+					/// Gets the current generation of the HTTP filtering category settings. The
+					/// generation changes every time that any category is enabled or disabled, so
+					/// anything computed from the state of the categories can record the
+					/// generation it was computed at, then cheaply tell later on whether or not it
+					/// is stale.
+					/// </summary>
+					/// <returns>
+					/// The current generation of the HTTP filtering category settings.
+					/// </returns>
+					const uint32_t GetHttpCategoryGeneration() const;
+
 					/// <summary>
 					/// Check if the specified HTTP filtering option is enabled or not. Aside from
 					/// filtering content by category, the HTTP filtering engine provides some
@@ -182,6 +194,12 @@ namespace te
 					/// </summary>
 					std::array<std::atomic_bool, std::numeric_limits<uint8_t>::max()> m_httpContentFilteringCategories;
 
+					/// <summary>
+					/// Incremented every time that the value of any http filtering category
+					/// actually changes.
+					/// </summary>
+					std::atomic<uint32_t> m_httpCategoryGeneration{ 0 };
+
 					/// <summary>
 					/// Hold the state of enabled or disabled http filtering options. The idea
 					/// here is you simply access the option of the fixed size array using the
@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "PayloadMemory.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Abstract base for streaming Content-Encoding decoders. A decoder is fed the
+				/// encoded body of a transaction piece by piece, exactly as it arrives off the
+				/// wire (minus any chunked transfer framing), and appends whatever it can decode
+				/// from each piece to an output buffer immediately. No decoder ever needs to see
+				/// the entire encoded body at once.
+				///
+				/// Decoders are meant to be kept and reused by a single transaction object for
+				/// its entire lifetime, being reset between payloads, so that whatever state and
+				/// working memory the underlying library allocates is only allocated once.
+				/// </summary>
+				class BaseContentDecoder
+				{
+
+				public:
+
+					/// <summary>
+					/// Constructs a new decoder.
+					/// </summary>
+					/// <param name="maxOutputSize">
+					/// The maximum total number of bytes the decoder may produce for a single
+					/// payload. Decoding fails once this is exceeded, which guards against
+					/// payloads that decompress to absurd sizes.
+					/// </param>
+					BaseContentDecoder(const size_t maxOutputSize);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					BaseContentDecoder(const BaseContentDecoder&) = delete;
+					BaseContentDecoder(BaseContentDecoder&&) = delete;
+					BaseContentDecoder& operator=(const BaseContentDecoder&) = delete;
+
+					/// <summary>
+					/// Default destructor.
+					/// </summary>
+					virtual ~BaseContentDecoder();
+
+					/// <summary>
+					/// Decodes the supplied piece of the encoded payload, appending all output that
+					/// can be produced from it to the supplied buffer. Any existing contents of the
+					/// buffer are left untouched.
+					/// </summary>
+					/// <param name="data">
+					/// The next piece of the encoded payload.
+					/// </param>
+					/// <param name="length">
+					/// The length of the data.
+					/// </param>
+					/// <param name="output">
+					/// The buffer to append decoded data to.
+					/// </param>
+					/// <returns>
+					/// True if the data was decoded successfully, false if the data is corrupt or
+					/// the output limit was exceeded. Once false has been returned, the decoder must
+					/// be reset before it is used again.
+					/// </returns>
+					virtual const bool Decode(const char* data, const size_t length, PayloadBuffer& output) = 0;
+
+					/// <summary>
+					/// Indicates whether or not the end of the encoded stream has been reached.
+					/// </summary>
+					/// <returns>
+					/// True if the complete encoded stream has been decoded, false otherwise.
+					/// </returns>
+					virtual const bool IsComplete() const = 0;
+
+					/// <summary>
+					/// Discards all state from the current payload, preparing the decoder for a
+					/// new one.
+					/// </summary>
+					virtual void Reset() = 0;
+
+				protected:
+
+					/// <summary>
+					/// The number of bytes of free space that decoders should make available at the
+					/// end of the output buffer for each step of decoding.
+					/// </summary>
+					static constexpr size_t OutputStepSize = 16384;
+
+					/// <summary>
+					/// The maximum number of bytes that may be produced for a single payload.
+					/// </summary>
+					const size_t m_maxOutputSize;
+
+				};
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
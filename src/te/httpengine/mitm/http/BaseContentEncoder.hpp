@@ -0,0 +1,116 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "PayloadMemory.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Abstract base for Content-Encoding encoders. Encoders are only ever used once a
+				/// payload is complete and has been inspected, so each call encodes a complete
+				/// payload.
+				///
+				/// Encoders hold a good deal of working memory, so they are meant to be kept and
+				/// reused, rather than constructed for each payload. An encoder is not thread
+				/// safe.
+				/// </summary>
+				class BaseContentEncoder
+				{
+
+				public:
+
+					/// <summary>
+					/// The lowest compression level.
+					/// </summary>
+					static constexpr int MinLevel = 1;
+
+					/// <summary>
+					/// The highest compression level.
+					/// </summary>
+					static constexpr int MaxLevel = 9;
+
+					/// <summary>
+					/// Default constructor.
+					/// </summary>
+					BaseContentEncoder();
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					BaseContentEncoder(const BaseContentEncoder&) = delete;
+					BaseContentEncoder(BaseContentEncoder&&) = delete;
+					BaseContentEncoder& operator=(const BaseContentEncoder&) = delete;
+
+					/// <summary>
+					/// Default destructor.
+					/// </summary>
+					virtual ~BaseContentEncoder();
+
+					/// <summary>
+					/// Encodes the supplied payload, appending the complete encoded stream to the
+					/// supplied buffer. Any existing contents of the buffer are left untouched.
+					/// </summary>
+					/// <param name="data">
+					/// The complete payload.
+					/// </param>
+					/// <param name="length">
+					/// The length of the payload.
+					/// </param>
+					/// <param name="level">
+					/// The compression level, from ::MinLevel to ::MaxLevel, trading speed for
+					/// size in the manner of zlib's compression levels. Encoders whose underlying
+					/// library uses a different scale map this onto their own.
+					/// </param>
+					/// <param name="output">
+					/// The buffer to append the encoded payload to.
+					/// </param>
+					/// <returns>
+					/// True if the payload was encoded successfully, false otherwise.
+					/// </returns>
+					virtual const bool Encode(const char* data, const size_t length, const int level, PayloadBuffer& output) = 0;
+
+				};
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -35,12 +35,15 @@
 #include <utility>
 #include <algorithm>
 #include <chrono>
+#include <atomic>
 #include <boost/algorithm/string.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
-#include <boost/iostreams/filter/zlib.hpp>
-#include <boost/iostreams/copy.hpp>
 #include "BaseHttpTransaction.hpp"
+#include "ZlibContentDecoder.hpp"
+#include "ZlibContentEncoder.hpp"
+#include "BrotliContentDecoder.hpp"
+#include "BrotliContentEncoder.hpp"
+#include "ZstdContentDecoder.hpp"
+#include "ZstdContentEncoder.hpp"
 #include "../../../util/http/KnownHttpHeaders.hpp"
 #include <stdexcept>
 
@@ -66,9 +69,132 @@ namespace te
 
 				const boost::string_ref BaseHttpTransaction::ContentTypeJavascript = u8"javascript";
 
+				namespace
+				{
+					/// <summary>
+					/// See BaseHttpTransaction::SetBufferHighWaterMark(...).
+					/// </summary>
+					std::atomic<size_t> BufferHighWaterMark{ BaseHttpTransaction::DefaultBufferHighWaterMark };
+
+					/// <summary>
+					/// See BaseHttpTransaction::SetCompressionLevel(...).
+					/// </summary>
+					std::atomic<int> CompressionLevel{ BaseHttpTransaction::DefaultCompressionLevel };
+
+					/// <summary>
+					/// Gets the calling thread's encoder for the supplied encoding. Encoders need
+					/// hundreds of kilobytes of working memory, and are only busy for the moment it
+					/// takes to encode a complete payload, so one per thread beats one per
+					/// transaction by a wide margin.
+					/// </summary>
+					/// <param name="encoding">
+					/// The encoding. Must be one of Gzip, Deflate, Brotli or Zstd.
+					/// </param>
+					/// <returns>
+					/// The encoder.
+					/// </returns>
+					BaseContentEncoder& GetThreadEncoder(const ContentEncoding encoding)
+					{
+						thread_local ZlibContentEncoder gzipEncoder(ZlibContentEncoder::Format::Gzip);
+						thread_local ZlibContentEncoder deflateEncoder(ZlibContentEncoder::Format::Deflate);
+						thread_local BrotliContentEncoder brotliEncoder;
+						thread_local ZstdContentEncoder zstdEncoder;
+
+						switch (encoding)
+						{
+							case ContentEncoding::Deflate:
+								return deflateEncoder;
+
+							case ContentEncoding::Brotli:
+								return brotliEncoder;
+
+							case ContentEncoding::Zstd:
+								return zstdEncoder;
+
+							default:
+								return gzipEncoder;
+						}
+					}
+
+					/// <summary>
+					/// Every thread keeps a small stack of payload buffers, which transactions take
+					/// from when constructed and give back to when destroyed. Combined with
+					/// transactions being reset rather than reconstructed between keep-alive
+					/// requests, this means that the 128 KB payload buffer is almost never
+					/// allocated once a thread has warmed up. Buffers that grew beyond the high
+					/// water mark are simply freed instead.
+					/// </summary>
+					class PayloadBufferPool
+					{
+
+					public:
+
+						/// <summary>
+						/// Maximum number of idle buffers kept by each thread.
+						/// </summary>
+						static constexpr size_t MaxPooledBuffers = 8;
+
+						static PayloadBufferPool& GetThreadPool()
+						{
+							thread_local PayloadBufferPool pool;
+							return pool;
+						}
+
+						/// <summary>
+						/// Takes a buffer from the pool.
+						/// </summary>
+						/// <returns>
+						/// An empty buffer, with capacity if one was available.
+						/// </returns>
+						PayloadBuffer Acquire()
+						{
+							if (m_buffers.empty())
+							{
+								return PayloadBuffer();
+							}
+
+							auto buffer = std::move(m_buffers.back());
+							m_buffers.pop_back();
+
+							return buffer;
+						}
+
+						/// <summary>
+						/// Gives a buffer to the pool, or frees it if the pool is full or the buffer
+						/// is too large to keep.
+						/// </summary>
+						/// <param name="buffer">
+						/// The buffer to give up.
+						/// </param>
+						void Release(PayloadBuffer&& buffer)
+						{
+							PayloadBuffer released = std::move(buffer);
+
+							if (released.capacity() == 0 || released.capacity() > BufferHighWaterMark || m_buffers.size() >= MaxPooledBuffers)
+							{
+								return;
+							}
+
+							released.clear();
+							m_buffers.push_back(std::move(released));
+						}
+
+					private:
+
+						PayloadBufferPool()
+						{
+							m_buffers.reserve(MaxPooledBuffers);
+						}
+
+						std::vector<PayloadBuffer> m_buffers;
+
+					};
+				}
+
 				BaseHttpTransaction::BaseHttpTransaction() 
 					: 
-					m_headerBuffer(MaxPayloadResize)
+					m_headerBuffer(MaxPayloadResize),
+					m_transactionData(PayloadBufferPool::GetThreadPool().Acquire())
 				{					
 					m_httpParserSettings.on_body = &OnBody;
 					m_httpParserSettings.on_chunk_complete = &OnChunkComplete;
@@ -86,84 +212,116 @@ namespace te
 					{
 						free(m_httpParser);
 					}
+
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_transactionData));
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_decodedData));
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_encodedData));
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_relayRing));
 				}
 
-				const HttpProtocolVersion BaseHttpTransaction::GetHttpVersion() const
+				void BaseHttpTransaction::SetBufferHighWaterMark(const size_t bytes)
 				{
-					return m_httpVersion;
+					BufferHighWaterMark = bytes;
 				}
 
-				void BaseHttpTransaction::SetHttpVersion(const HttpProtocolVersion httpVersion)
+				const size_t BaseHttpTransaction::GetBufferHighWaterMark()
 				{
-					m_httpVersion = httpVersion;
+					return BufferHighWaterMark;
 				}
 
-				void BaseHttpTransaction::AddHeader(const std::string& name, std::string value, const bool replaceIfExists)
+				void BaseHttpTransaction::SetCompressionLevel(const int level)
 				{
-					std::string headerNameCopy = name;
+					CompressionLevel = level;
+				}
+
+				const int BaseHttpTransaction::GetCompressionLevel()
+				{
+					return CompressionLevel;
+				}
 
-					auto matchRange = m_headers.equal_range(headerNameCopy);
+				void BaseHttpTransaction::Reset()
+				{
+					const size_t highWaterMark = BufferHighWaterMark;
 
-					if (replaceIfExists)
+					// http_parser_init keeps parser->data intact, so the parser remains bound to
+					// this object.
+					if (m_httpParser != nullptr)
 					{
-						// Since replaceIfExists is true, we want to remove all headers that have the same
-						// name before inserting the new header value.
-						while (matchRange.first != matchRange.second)
-						{
-							m_headers.erase(matchRange.first++);
-						}
+						http_parser_init(m_httpParser, static_cast<http_parser_type>(m_httpParser->type));
+					}
 
-						m_headers.insert(std::make_pair(headerNameCopy, value));
+					m_headers.Reset(highWaterMark);
 
-						return;
+					if (m_headerBuffer.size() > 0)
+					{
+						m_headerBuffer.consume(m_headerBuffer.size());
 					}
-					else
+
+					if (m_transactionData.capacity() > highWaterMark)
 					{
-						auto it = matchRange.first;
-						while (it != matchRange.second)
-						{
-							// If the exact same header and value exist, we clearly don't want to add
-							// another.
-							if (boost::iequals(it->second, value))
-							{
-								//Exists already, both name and value
-								return;
-							}
+						// Don't let one huge payload pin a huge buffer to a keep-alive connection
+						// for the rest of its life. Swap it for a right sized one from the pool.
+						PayloadBufferPool::GetThreadPool().Release(std::move(m_transactionData));
+						m_transactionData = PayloadBufferPool::GetThreadPool().Acquire();
+					}
 
-							++it;
-						}
+					m_transactionData.clear();
+					m_unwrittenPayloadSize = 0;
 
-						m_headers.insert(std::make_pair(headerNameCopy, value));
-					}
+					m_serializedHeaders.clear();
+
+					m_dechunking = false;
+					m_dechunkedSize = 0;
+					m_leadingBodySlices.clear();
+
+					ResetContentDecoding();
+					ResetRelay();
+
+					m_headersComplete = false;
+					m_headersSent = false;
+					m_payloadComplete = false;
+					m_shouldBlock = 0;
+					m_consumeAllBeforeSending = false;
+				}
+
+				const HttpProtocolVersion BaseHttpTransaction::GetHttpVersion() const
+				{
+					return m_httpVersion;
 				}
 
-				void BaseHttpTransaction::RemoveHeader(const std::string& name, const std::string& value)
+				void BaseHttpTransaction::SetHttpVersion(const HttpProtocolVersion httpVersion)
 				{
-					auto matchRange = m_headers.equal_range(name);
+					m_httpVersion = httpVersion;
+				}
 
-					while (matchRange.first != matchRange.second)
-					{
-						// Must match exactly both key and value to qualify for removal
-						if (boost::iequals(matchRange.first->second.c_str(), value.c_str()))
-						{
-							m_headers.erase(matchRange.first++);
-						}
-					}
+				void BaseHttpTransaction::AddHeader(const boost::string_ref name, const boost::string_ref value, const bool replaceIfExists)
+				{
+					m_headers.Add(name, value, replaceIfExists);
 				}
 
-				void BaseHttpTransaction::RemoveHeader(const std::string& name)
+				void BaseHttpTransaction::RemoveHeader(const boost::string_ref name, const boost::string_ref value)
 				{
-					auto matchRange = m_headers.equal_range(name);
+					m_headers.Remove(name, value);
+				}
 
-					while (matchRange.first != matchRange.second)
-					{
-						m_headers.erase(matchRange.first++);
-					}
+				void BaseHttpTransaction::RemoveHeader(const boost::string_ref name)
+				{
+					m_headers.Remove(name);
 				}
 
-				const HttpHeaderRangeMatch BaseHttpTransaction::GetHeader(const std::string& header) const
+				void BaseHttpTransaction::RemoveHeader(const util::http::HeaderId id)
+				{
+					m_headers.Remove(id);
+				}
+
+				const HttpHeaderRangeMatch BaseHttpTransaction::GetHeader(const boost::string_ref header) const
 				{					
-					return m_headers.equal_range(header);
+					return m_headers.Find(header);
+				}
+
+				const HttpHeaderRangeMatch BaseHttpTransaction::GetHeader(const util::http::HeaderId id) const
+				{
+					return m_headers.Find(id);
 				}
 
 				const bool BaseHttpTransaction::HeadersComplete() const
@@ -183,13 +341,25 @@ namespace te
 
 					if (!m_headersComplete)
 					{
-						std::string hdrString{ (std::istreambuf_iterator<char>(&m_headerBuffer)), std::istreambuf_iterator<char>() };
+						auto bytesToParse = m_headerBuffer.size();
+
+						// The header data is copied exactly once, into the source buffer of the header
+						// collection. Every header name and value parsed out of it is then just a view
+						// into that buffer, rather than a pair of freshly allocated strings.
+						char* hdrData = m_headers.PrepareSource(bytesToParse);
 
-						auto bytesToParse = hdrString.size();
+						boost::asio::buffer_copy(boost::asio::buffer(hdrData, bytesToParse), m_headerBuffer.data());
+						m_headerBuffer.consume(bytesToParse);
 
 						// The parser must ALWAYS be called first. The OnMessageBegin callback will reset the state
-						// of this object, clearing everything excluding the payload data.
-						auto nparsed = http_parser_execute(m_httpParser, &m_httpParserSettings, hdrString.c_str(), bytesToParse);
+						// of this object, clearing everything excluding the payload data. Any body
+						// data following the headers lands at the front of the payload buffer, so
+						// note where it starts. See ::CompactLeadingChunkedPayload().
+						m_leadingBodyBase = hdrData + bytesReceived;
+
+						auto nparsed = http_parser_execute(m_httpParser, &m_httpParserSettings, hdrData, bytesToParse);
+
+						m_leadingBodyBase = nullptr;
 
 						if (nparsed != bytesToParse)
 						{
@@ -217,16 +387,29 @@ namespace te
 							// Payload should be empty, so let's ensure it is.
 							m_transactionData.clear();
 
-							m_transactionData.assign(hdrString.begin() + bytesReceived, hdrString.end());
+							m_transactionData.assign(hdrData + bytesReceived, hdrData + bytesToParse);
+
+							// No header views this data, so there's no reason to keep a second copy of it.
+							m_headers.TrimSource(m_headers.GetSourceSize() - (bytesToParse - bytesReceived));
 						}
 
 						success = true;
 					}
 					else 
 					{
+						// Any chunked body data that came in with the headers was already compacted
+						// by ::GetPayloadReadBuffer(), before this read was placed behind it.
 						auto nparsed = http_parser_execute(m_httpParser, &m_httpParserSettings, m_transactionData.data() + m_unwrittenPayloadSize, bytesReceived);
 
-						unwrittenBytesCopy += bytesReceived;
+						if (m_dechunking)
+						{
+							// Only the body data survives, packed down at the front of the buffer.
+							unwrittenBytesCopy = m_dechunkedSize;
+						}
+						else
+						{
+							unwrittenBytesCopy += bytesReceived;
+						}
 
 						if (nparsed != bytesReceived)
 						{
@@ -255,56 +438,55 @@ namespace te
 					{
 						bool finalizationFailed = false;
 
-						const auto transferEncoding = GetHeader(util::http::headers::TransferEncoding);
-						
-						if (transferEncoding.first != transferEncoding.second)
+						if (!m_dechunking && (m_httpParser->flags & F_CHUNKED) != 0)
 						{
-							RemoveHeader(util::http::headers::TransferEncoding);
-							
-							if (!ConvertPayloadFromChunkedToFixedLength())
-							{
-								// No need to generate messages here, the method itself will do so.
-								finalizationFailed = true;
-							}
+							// The entire chunked payload came in along with the headers.
+							CompactLeadingChunkedPayload();
 						}
 
-						const auto contentEncoding = GetHeader(util::http::headers::ContentEncoding);
-
-						if (finalizationFailed == false && contentEncoding.first != contentEncoding.second)
+						if (m_contentDecoder != nullptr)
 						{
-							if (boost::iequals(contentEncoding.first->second, u8"gzip"))
+							// The payload was decoded as it was parsed, so it is already free of any
+							// chunked framing. All that is left is to swap it into place.
+							if (!FinalizeDecodedPayload())
 							{
-								if (!DecompressGzip())
-								{
-									// We will report an error, but will not abort further operations, since even if this fails,
-									// the transaction can theoretically be simply passed on to the client. 
-									finalizationFailed = true;
-									ReportError("In BaseHttpTransaction::Parse(const size_t&) - Failed to decompress Gzip encoded payload!");
-								}
-								else
+								// We will report an error, but will not abort further operations, since even if this fails,
+								// the transaction can theoretically be simply passed on to the client. 
+								finalizationFailed = true;
+
+								const auto contentEncoding = GetHeader(util::http::HeaderId::ContentEncoding);
+
+								std::string errMsg(u8"In BaseHttpTransaction::Parse(const size_t&) - Failed to decode payload with Content-Encoding: ");
+
+								if (contentEncoding.first != contentEncoding.second)
 								{
-									RemoveHeader(util::http::headers::ContentEncoding);
+									errMsg.append(contentEncoding.first->second.data(), contentEncoding.first->second.size());
 								}
+
+								ReportError(errMsg);
 							}
-							else if(boost::iequals(contentEncoding.first->second, u8"deflate"))
+						}
+						else
+						{
+							// Chunk framing, if there was any, was stripped while parsing. See
+							// ::CompactLeadingChunkedPayload().
+							RemoveHeader(util::http::HeaderId::TransferEncoding);
+
+							if (m_dechunking && m_transactionData.size() > m_unwrittenPayloadSize)
 							{
-								if (!DecompressDeflate())
-								{
-									// We will report an error, but will not abort further operations, since even if this fails,
-									// the transaction can theoretically be simply passed on to the client. 
-									finalizationFailed = true;
-									ReportError("In BaseHttpTransaction::Parse(const size_t&) - Failed to decompress Deflate encoded payload!");
-								}
-								else
-								{
-									RemoveHeader(util::http::headers::ContentEncoding);
-								}
+								// Cut the buffer down to the body that was packed into the front of it.
+								m_transactionData.resize(m_unwrittenPayloadSize);
 							}
-							else
+
+							const auto contentEncoding = GetHeader(util::http::HeaderId::ContentEncoding);
+
+							if (finalizationFailed == false && contentEncoding.first != contentEncoding.second)
 							{
+								// Any encoding we know how to decode has a decoder, so this one is
+								// beyond us.
 								finalizationFailed = true;
-								ReportError("In BaseHttpTransaction::Parse(const size_t&) - Unknown Content-Encoding, cannot decompress: " + contentEncoding.first->second);
-							}							
+								ReportError("In BaseHttpTransaction::Parse(const size_t&) - Unknown Content-Encoding, cannot decompress: " + contentEncoding.first->second.to_string());
+							}
 						}
 
 						success = !finalizationFailed;
@@ -391,6 +573,14 @@ namespace te
 						return boost::asio::mutable_buffers_1(m_transactionData.data(), m_transactionData.size());
 					}
 
+					if (!m_dechunking && (m_httpParser->flags & F_CHUNKED) != 0)
+					{
+						// Chunked body data that came in with the headers still has its framing. Strip
+						// it now, so that this read lands directly behind the body data, which is where
+						// the parser will be pointed at it.
+						CompactLeadingChunkedPayload();
+					}
+
 					if (m_consumeAllBeforeSending && m_unwrittenPayloadSize > 0)
 					{
 						if (m_transactionData.size() < MaxPayloadResize)
@@ -418,19 +608,17 @@ namespace te
 					return boost::asio::mutable_buffers_1(m_transactionData.data() + m_unwrittenPayloadSize, PayloadBufferReadSize);
 				}
 
-				boost::asio::const_buffers_1 BaseHttpTransaction::GetWriteBuffer()
+				BaseHttpTransaction::WriteBufferSequence BaseHttpTransaction::GetWriteBuffer()
 				{
+					boost::asio::const_buffer headersBuffer;
+
 					if (!m_headersSent)
 					{
-						auto headersVector = HeadersToVector();				
-
-						headersVector.reserve(headersVector.capacity() + m_transactionData.size());
-
-						headersVector.insert(headersVector.end(), std::make_move_iterator(m_transactionData.begin()), std::make_move_iterator(m_transactionData.begin() + m_unwrittenPayloadSize));
-
-						m_transactionData = std::move(headersVector);
+						// The headers go out in a buffer of their own, ahead of the payload, in the
+						// same gathered write. The payload stays exactly where it is.
+						m_serializedHeaders = HeadersToVector();
 
-						m_unwrittenPayloadSize = m_transactionData.size();
+						headersBuffer = boost::asio::const_buffer(m_serializedHeaders.data(), m_serializedHeaders.size());
 
 						m_headersSent = true;
 					}
@@ -442,24 +630,121 @@ namespace te
 					// keeping track of things like partial reads etc is all gone.
 					m_unwrittenPayloadSize = 0;
 
-					return boost::asio::const_buffers_1(m_transactionData.data(), bytesToWrite);
+					return WriteBufferSequence{ { headersBuffer, boost::asio::const_buffer(m_transactionData.data(), bytesToWrite) } };
 				}
 
-				const std::vector<char>& BaseHttpTransaction::GetPayload() const
+				boost::asio::mutable_buffers_1 BaseHttpTransaction::GetRelayReadBuffer()
+				{
+					if (!m_relaying)
+					{
+						m_relayRing = PayloadBufferPool::GetThreadPool().Acquire();
+						m_relayRing.resize(RelaySlotCount * RelaySlotSize);
+						m_relaying = true;
+					}
+
+					const size_t slot = (m_relayHead + m_relayFilled) % RelaySlotCount;
+
+					return boost::asio::mutable_buffers_1(m_relayRing.data() + (slot * RelaySlotSize), RelaySlotSize);
+				}
+
+				const bool BaseHttpTransaction::CommitRelayRead(const size_t bytesReceived)
+				{
+					if (!m_relaying || m_relayFilled >= RelaySlotCount)
+					{
+						ReportError(u8"In BaseHttpTransaction::CommitRelayRead(const size_t) - No relay read is outstanding.");
+						return false;
+					}
+
+					const size_t slot = (m_relayHead + m_relayFilled) % RelaySlotCount;
+
+					const char* data = m_relayRing.data() + (slot * RelaySlotSize);
+
+					// The parser is paused when the message completes, so it returns having parsed
+					// exactly up to the end of the payload.
+					const size_t nparsed = http_parser_execute(m_httpParser, &m_httpParserSettings, data, bytesReceived);
+
+					if (nparsed != bytesReceived)
+					{
+						if (HTTP_PARSER_ERRNO(m_httpParser) == HPE_PAUSED)
+						{
+							ReportWarning(u8"In BaseHttpTransaction::CommitRelayRead(const size_t) - Dropping data read past the end of the payload.");
+						}
+						else if (m_httpParser->http_errno != 0)
+						{
+							std::string errMsg(u8"In BaseHttpTransaction::CommitRelayRead(const size_t) - Failed to parse payload. Got http_parser error: ");
+							errMsg.append(http_errno_description(HTTP_PARSER_ERRNO(m_httpParser)));
+							ReportError(errMsg);
+							return false;
+						}
+					}
+
+					if (nparsed > 0)
+					{
+						m_relaySlotLengths[slot] = nparsed;
+						++m_relayFilled;
+					}
+
+					return true;
+				}
+
+				void BaseHttpTransaction::CommitRelayEof()
+				{
+					if (!m_payloadComplete)
+					{
+						http_parser_execute(m_httpParser, &m_httpParserSettings, nullptr, 0);
+					}
+				}
+
+				const bool BaseHttpTransaction::CanRelayRead() const
+				{
+					return m_relayFilled < RelaySlotCount;
+				}
+
+				const bool BaseHttpTransaction::HasRelayWrite() const
+				{
+					return m_relayFilled > 0;
+				}
+
+				boost::asio::const_buffers_1 BaseHttpTransaction::GetRelayWriteBuffer()
+				{
+					return boost::asio::const_buffers_1(m_relayRing.data() + (m_relayHead * RelaySlotSize), m_relaySlotLengths[m_relayHead]);
+				}
+
+				void BaseHttpTransaction::CommitRelayWrite()
+				{
+					if (m_relayFilled == 0)
+					{
+						return;
+					}
+
+					m_relaySlotLengths[m_relayHead] = 0;
+					m_relayHead = (m_relayHead + 1) % RelaySlotCount;
+					--m_relayFilled;
+				}
+
+				const PayloadBuffer& BaseHttpTransaction::GetPayload() const
 				{
 					return m_transactionData;
 				}
 
-				void BaseHttpTransaction::SetPayload(std::vector<char>&& payload)
+				const PayloadBuffer& BaseHttpTransaction::GetDecodedPayload() const
+				{
+					return m_decodedData;
+				}
+
+				void BaseHttpTransaction::SetPayload(PayloadBuffer&& payload)
 				{
 					// XXX TODO - Cleanup this code duplication.
 
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_transactionData));
+
 					m_transactionData = std::move(payload);					
 					m_payloadComplete = true;
+					m_payloadModified = true;
 										
-					RemoveHeader(util::http::headers::ContentLength);
-					RemoveHeader(util::http::headers::TransferEncoding);
-					RemoveHeader(util::http::headers::ContentEncoding);					
+					RemoveHeader(util::http::HeaderId::ContentLength);
+					RemoveHeader(util::http::HeaderId::TransferEncoding);
+					RemoveHeader(util::http::HeaderId::ContentEncoding);					
 
 					size_t payloadSize = 0;
 
@@ -494,13 +779,14 @@ namespace te
 				{
 					// XXX TODO - Cleanup this code duplication.
 
-					m_transactionData = payload;
+					m_transactionData.assign(payload.begin(), payload.end());
 					
 					m_payloadComplete = true;
+					m_payloadModified = true;
 
-					RemoveHeader(util::http::headers::ContentLength);
-					RemoveHeader(util::http::headers::TransferEncoding);
-					RemoveHeader(util::http::headers::ContentEncoding);
+					RemoveHeader(util::http::HeaderId::ContentLength);
+					RemoveHeader(util::http::HeaderId::TransferEncoding);
+					RemoveHeader(util::http::HeaderId::ContentEncoding);
 
 					size_t payloadSize = 0;
 
@@ -611,7 +897,7 @@ namespace te
 
 				const bool BaseHttpTransaction::IsPayloadCompressed() const
 				{
-					const auto contentEncoding = GetHeader(util::http::headers::ContentEncoding);
+					const auto contentEncoding = GetHeader(util::http::HeaderId::ContentEncoding);
 
 					if (contentEncoding.first != contentEncoding.second)
 					{
@@ -666,7 +952,7 @@ namespace te
 
 				const bool BaseHttpTransaction::DoesContentTypeMatch(const boost::string_ref type) const
 				{
-					auto contentTypeHeader = GetHeader(util::http::headers::ContentType);
+					auto contentTypeHeader = GetHeader(util::http::HeaderId::ContentType);
 
 					if (contentTypeHeader.first != contentTypeHeader.second)
 					{
@@ -686,7 +972,7 @@ namespace te
 
 				const bool BaseHttpTransaction::DoesContentTypeContain(const boost::string_ref type) const
 				{
-					auto contentTypeHeader = GetHeader(util::http::headers::ContentType);
+					auto contentTypeHeader = GetHeader(util::http::HeaderId::ContentType);
 
 					if (contentTypeHeader.first != contentTypeHeader.second)
 					{
@@ -706,311 +992,322 @@ namespace te
 
 				const bool BaseHttpTransaction::CompressGzip()
 				{
-					if (m_transactionData.size() == 0)
+					if (m_unwrittenPayloadSize == 0)
 					{
-						ReportError(u8"In BaseBridge::CompressDeflate() - There is no payload to compress.");
+						ReportError(u8"In BaseHttpTransaction::CompressGzip() - There is no payload to compress.");
 						return false;
 					}
 
-					std::vector<char> compressed;
-
-					try
-					{
-						boost::iostreams::filtering_ostream os;
+					const int level = CompressionLevel;
 
-						os.push(boost::iostreams::gzip_compressor());
-						os.push(boost::iostreams::back_inserter(compressed));
+					return EncodePayload(ContentEncoding::Gzip, level > 0 ? level : DefaultCompressionLevel);
+				}
 
-						boost::iostreams::write(os, m_transactionData.data(), m_unwrittenPayloadSize);
-					}
-					catch (std::exception &e)
+				const bool BaseHttpTransaction::CompressDeflate()
+				{
+					if (m_unwrittenPayloadSize == 0)
 					{
-						std::string errMessage("In BaseBridge::CompressGzip() - Exception while compressing: ");
-						errMessage.append(e.what());
-						ReportError(errMessage);
+						ReportError(u8"In BaseHttpTransaction::CompressDeflate() - There is no payload to compress.");
 						return false;
 					}
 
-					if (m_transactionData.size() > compressed.size())
-					{
-						m_transactionData = std::move(compressed);
-						std::string gzip(u8"gzip");
-						AddHeader(util::http::headers::ContentEncoding, gzip);
-						return true;
-					}
-					else {
-						return false;
-					}
+					const int level = CompressionLevel;
+
+					return EncodePayload(ContentEncoding::Deflate, level > 0 ? level : DefaultCompressionLevel);
 				}
 
-				const bool BaseHttpTransaction::CompressDeflate()
+				void BaseHttpTransaction::ApplyContentEncodingPolicy(const ContentEncodingSet acceptedEncodings)
 				{
-					if (m_transactionData.size() == 0)
+					if (!m_payloadComplete || m_shouldBlock != 0 || m_headersSent)
 					{
-						ReportError(u8"In BaseBridge::CompressDeflate() - There is no payload to compress.");
-						return false;
+						return;
 					}
 
-					std::vector<char> compressed;
+					if (m_payloadContentEncoding == ContentEncoding::Identity || m_payloadContentEncoding == ContentEncoding::Unknown || m_contentDecoder != nullptr)
+					{
+						// Never decoded, or never finished decoding, so the payload is still exactly
+						// as it arrived.
+						return;
+					}
 
-					try
+					if (!m_payloadModified && (acceptedEncodings & ToContentEncodingSet(m_payloadContentEncoding)) != 0)
 					{
-						boost::iostreams::filtering_ostream os;
+						RestoreEncodedPayload();
+						return;
+					}
 
-						os.push(boost::iostreams::zlib_compressor());
-						os.push(boost::iostreams::back_inserter(compressed));
+					// The original is of no further use.
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_encodedData));
+					m_encodedData.clear();
 
-						boost::iostreams::write(os, m_transactionData.data(), m_unwrittenPayloadSize);
-					}
-					catch (std::exception &e)
+					const int level = CompressionLevel;
+
+					if (level <= 0)
 					{
-						std::string errMessage("In BaseBridge::CompressDeflate() - Exception while compressing: ");
-						errMessage.append(e.what());
-						ReportError(errMessage);
-						return false;
+						return;
 					}
 
-					if (m_transactionData.size() > compressed.size())
+					// The encoding the server chose is preferred. Failing that, zstd for its speed,
+					// then brotli for its density, then the zlib formats.
+					for (const auto encoding : { m_payloadContentEncoding, ContentEncoding::Zstd, ContentEncoding::Brotli, ContentEncoding::Gzip, ContentEncoding::Deflate })
 					{
-						m_transactionData = std::move(compressed);
-						std::string deflate(u8"deflate");
-						AddHeader(util::http::headers::ContentEncoding, deflate);
-						return true;
-					}
-					else {
-						return false;
+						if ((acceptedEncodings & ToContentEncodingSet(encoding)) != 0)
+						{
+							EncodePayload(encoding, level);
+							return;
+						}
 					}
 				}
 
-				const bool BaseHttpTransaction::DecompressGzip()
+				void BaseHttpTransaction::RestoreEncodedPayload()
 				{
-					if (m_transactionData.size() == 0)
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_transactionData));
+
+					m_transactionData = std::move(m_encodedData);
+					m_encodedData.clear();
+
+					m_unwrittenPayloadSize = m_transactionData.size();
+
+					AddHeader(util::http::headers::ContentEncoding, GetContentEncodingName(m_payloadContentEncoding));
+
+					if (m_encodedDataChunked)
 					{
-						ReportError(u8"In BaseBridge::DecompressGzip() - There is no payload to decompress.");
-						return false;
+						// The framing, right down to the terminating chunk, came along with it.
+						RemoveHeader(util::http::HeaderId::ContentLength);
+						AddHeader(util::http::headers::TransferEncoding, u8"chunked");
 					}
-
-					// Must trim off unusued allocated space.
-					if (m_transactionData.size() > m_unwrittenPayloadSize)
+					else
 					{
-						m_transactionData.resize(m_unwrittenPayloadSize);
+						AddHeader(util::http::headers::ContentLength, std::to_string(m_transactionData.size()));
 					}
+				}
 
-					// If the terminating CRLF's on the payload are left, they'll screw with
-					// decompression. They need to be trimmed first.
+				const bool BaseHttpTransaction::EncodePayload(const ContentEncoding encoding, const int level)
+				{
+					size_t payloadSize = m_unwrittenPayloadSize;
+
+					// Leave out the terminating CRLF's that ::Parse(...) and ::SetPayload(...)
+					// append, since they're not part of the payload.
 					if (
-						m_transactionData.at(m_transactionData.size() - 4) == '\r' &&
-						m_transactionData.at(m_transactionData.size() - 3) == '\n' &&
-						m_transactionData.at(m_transactionData.size() - 2) == '\r' &&
-						m_transactionData.at(m_transactionData.size() - 1) == '\n'
+						payloadSize >= 4 &&
+						m_transactionData[payloadSize - 4] == '\r' &&
+						m_transactionData[payloadSize - 3] == '\n' &&
+						m_transactionData[payloadSize - 2] == '\r' &&
+						m_transactionData[payloadSize - 1] == '\n'
 						)
 					{
-						m_transactionData.resize(m_transactionData.size() - 4);
+						payloadSize -= 4;
 					}
 
-					std::vector<char> decompressed;
-
-					try
+					if (payloadSize == 0)
 					{
-						boost::iostreams::filtering_streambuf<boost::iostreams::input> in;
-
-						in.push(boost::iostreams::gzip_decompressor());
-						in.push(boost::iostreams::array_source(m_transactionData.data(), m_transactionData.size()));
-
-						boost::iostreams::copy(in, std::back_insert_iterator<std::vector<char>>(decompressed));
-
-					}
-					catch (std::exception& e)
-					{
-						std::string errMessage(u8"In BaseBridge::DecompressGzip() - Exception while decompressing: ");
-						errMessage.append(e.what());
-						ReportError(errMessage);
 						return false;
 					}
 
-					m_transactionData = std::move(decompressed);
-					m_unwrittenPayloadSize = m_transactionData.size();
+					auto encoded = PayloadBufferPool::GetThreadPool().Acquire();
 
-					if (m_transactionData.size() > 0)
-					{						
-						return true;
-					}
-					else 
+					if (!GetThreadEncoder(encoding).Encode(m_transactionData.data(), payloadSize, level, encoded))
 					{
+						PayloadBufferPool::GetThreadPool().Release(std::move(encoded));
+						ReportWarning(u8"In BaseHttpTransaction::EncodePayload(const ContentEncoding, const int) - Failed to encode payload.");
 						return false;
 					}
-				}
 
-				const bool BaseHttpTransaction::DecompressDeflate()
-				{
-					if (m_transactionData.size() == 0)
+					if (encoded.size() >= payloadSize)
 					{
-						ReportError(u8"In BaseBridge::DecompressDeflate() - There is no payload to decompress.");
+						// Already about as dense as it gets. Don't make it worse.
+						PayloadBufferPool::GetThreadPool().Release(std::move(encoded));
 						return false;
 					}
 
-					// Must trim off unusued allocated space.
-					if (m_transactionData.size() > m_unwrittenPayloadSize)
-					{
-						m_transactionData.resize(m_unwrittenPayloadSize);
-					}
+					PayloadBufferPool::GetThreadPool().Release(std::move(m_transactionData));
 
-					// If the terminating CRLF's on the payload are left, they'll screw with
-					// decompression. They need to be trimmed first.
-					if (
-						m_transactionData.at(m_transactionData.size() - 4) == '\r' &&
-						m_transactionData.at(m_transactionData.size() - 3) == '\n' &&
-						m_transactionData.at(m_transactionData.size() - 2) == '\r' &&
-						m_transactionData.at(m_transactionData.size() - 1) == '\n'
-						)
-					{
-						m_transactionData.resize(m_transactionData.size() - 4);
-					}
+					m_transactionData = std::move(encoded);
+					m_unwrittenPayloadSize = m_transactionData.size();
 
-					std::vector<char> decompressed;
+					RemoveHeader(util::http::HeaderId::TransferEncoding);
+					AddHeader(util::http::headers::ContentEncoding, GetContentEncodingName(encoding));
+					AddHeader(util::http::headers::ContentLength, std::to_string(m_transactionData.size()));
 
-					try
-					{
-						boost::iostreams::filtering_streambuf<boost::iostreams::input> in;
+					return true;
+				}
 
-						in.push(boost::iostreams::zlib_decompressor());
-						in.push(boost::iostreams::array_source(m_transactionData.data(), m_transactionData.size()));
+				void BaseHttpTransaction::PrepareContentDecoder()
+				{
+					ResetContentDecoding();
 
-						boost::iostreams::copy(in, std::back_insert_iterator<std::vector<char>>(decompressed));
+					const auto contentEncoding = GetHeader(util::http::HeaderId::ContentEncoding);
 
-					}
-					catch (std::exception& e)
+					if (contentEncoding.first == contentEncoding.second)
 					{
-						std::string errMessage(u8"In BaseBridge::DecompressDeflate() - Exception while decompressing: ");
-						errMessage.append(e.what());
-						ReportError(errMessage);
-						return false;
+						return;
 					}
 
-					m_transactionData = std::move(decompressed);
-					m_unwrittenPayloadSize = m_transactionData.size();
+					auto nextEncoding = contentEncoding.first;
+					++nextEncoding;
 
-					if (m_transactionData.size() > 0)
-					{						
-						return true;
-					}
-					else {
-						return false;
+					if (nextEncoding != contentEncoding.second)
+					{
+						// Multiple encodings were applied, one after the other. Nobody does this.
+						return;
 					}
-				}
 
-				const bool BaseHttpTransaction::ConvertPayloadFromChunkedToFixedLength()
-				{
-					const boost::string_ref crlf = u8"\r\n";
+					const auto encoding = ParseContentEncoding(contentEncoding.first->second);
 
-					// First we need to cut down the payload buffer to the exact size of how many bytes
-					// we've received.
-					if (m_transactionData.size() > m_unwrittenPayloadSize)
+					switch (encoding)
 					{
-						m_transactionData.resize(m_unwrittenPayloadSize);
-					}					
+						case ContentEncoding::Gzip:
+						case ContentEncoding::Deflate:
+						{
+							if (m_zlibDecoder == nullptr)
+							{
+								m_zlibDecoder.reset(new ZlibContentDecoder(MaxPayloadResize));
+							}
+
+							m_zlibDecoder->SetFormat(encoding == ContentEncoding::Gzip ? ZlibContentDecoder::Format::Gzip : ZlibContentDecoder::Format::Deflate);
+							m_contentDecoder = m_zlibDecoder.get();
+						}
+						break;
 
-					boost::string_ref payloadStrRef(m_transactionData.data(), m_transactionData.size());
+						case ContentEncoding::Brotli:
+						{
+							if (m_brotliDecoder == nullptr)
+							{
+								m_brotliDecoder.reset(new BrotliContentDecoder(MaxPayloadResize));
+							}
+							else
+							{
+								m_brotliDecoder->Reset();
+							}
+
+							m_contentDecoder = m_brotliDecoder.get();
+						}
+						break;
 
-					// All chunked content will be moved into this container, and m_transactionData
-					// will be reassigned to it on a successful conversion.
-					std::vector<char> result;
-					result.reserve(m_transactionData.size());
+						case ContentEncoding::Zstd:
+						{
+							if (m_zstdDecoder == nullptr)
+							{
+								m_zstdDecoder.reset(new ZstdContentDecoder(MaxPayloadResize));
+							}
+							else
+							{
+								m_zstdDecoder->Reset();
+							}
 
-					// Get the first position of the end of the first chunk header
-					auto pos = payloadStrRef.find(crlf);
+							m_contentDecoder = m_zstdDecoder.get();
+						}
+						break;
 
-					std::stringstream ss;
+						default:
+							return;
+					}
 
-					size_t chunkLength = 0;
+					m_payloadContentEncoding = encoding;
+				}
 
-					bool noError = false;
+				void BaseHttpTransaction::ResetContentDecoding()
+				{
+					m_contentDecoder = nullptr;
+					m_encodedPayloadSize = 0;
+					m_contentDecodingFailed = false;
+					m_payloadContentEncoding = ContentEncoding::Identity;
+					m_encodedDataChunked = false;
+					m_payloadModified = false;
 
-					size_t globalPos = 0;
+					if (m_decodedData.capacity() > 0)
+					{
+						PayloadBufferPool::GetThreadPool().Release(std::move(m_decodedData));
+						m_decodedData.clear();
+					}
 
-					while (pos != boost::string_ref::npos)
+					if (m_encodedData.capacity() > 0)
 					{
-						chunkLength = 0;
+						PayloadBufferPool::GetThreadPool().Release(std::move(m_encodedData));
+						m_encodedData.clear();
+					}
+				}
 
-						// Completely reset the stream
-						ss.str(std::string());
-						ss.clear();
+				const bool BaseHttpTransaction::FinalizeDecodedPayload()
+				{
+					if (m_contentDecoder == nullptr || m_contentDecodingFailed)
+					{
+						return false;
+					}
 
-						boost::string_ref chunkLenStr = payloadStrRef.substr(0, pos);
+					// An empty payload is trivially decoded, but anything else must have reached
+					// the end of the encoded stream. Otherwise it was truncated.
+					if (m_encodedPayloadSize > 0 && !m_contentDecoder->IsComplete())
+					{
+						return false;
+					}
 
-						auto chunkLengthTrailerPos = chunkLenStr.find(';');
+					const auto transferEncoding = GetHeader(util::http::HeaderId::TransferEncoding);
+					m_encodedDataChunked = transferEncoding.first != transferEncoding.second && !m_dechunking;
 
-						if (chunkLengthTrailerPos != boost::string_ref::npos)
-						{
-							chunkLenStr = chunkLenStr.substr(0, chunkLengthTrailerPos);
-						}
+					RemoveHeader(util::http::HeaderId::TransferEncoding);
+					RemoveHeader(util::http::HeaderId::ContentEncoding);
 
-						ss << std::hex << chunkLenStr;
+					// The original payload, framing and all, is held on to rather than discarded.
+					// If nothing modifies the decoded payload and the client accepts the original
+					// encoding, it can go out exactly as it came in, without being encoded all
+					// over again. See ::ApplyContentEncodingPolicy(...).
+					m_transactionData.resize(m_unwrittenPayloadSize);
+					m_encodedData = std::move(m_transactionData);
 
-						if (ss.fail())
-						{
-							ReportError(u8"In BaseHttpTransaction::ConvertPayloadFromChunkedToFixedLength() - Chunk length conversion to integer value failed.");
-							break;
-						}
+					m_transactionData = std::move(m_decodedData);
+					m_decodedData.clear();
 
-						ss >> chunkLength;
+					m_unwrittenPayloadSize = m_transactionData.size();
 
-						if (chunkLength == 0)
-						{
-							// All data has been read if we've reached the terminating chunk header
-							// which defines a length of zero.
-							noError = true;
-							break;
-						}
+					m_contentDecoder = nullptr;
+					
+					return true;
+				}
 
-						// Advance beyond the chunk length terminating crlf.
-						pos += crlf.size();
+				void BaseHttpTransaction::ResetRelay()
+				{
+					if (m_relayRing.capacity() > 0)
+					{
+						PayloadBufferPool::GetThreadPool().Release(std::move(m_relayRing));
+						m_relayRing.clear();
+					}
 
-						if ((pos + chunkLength) > payloadStrRef.size())
-						{
-							ReportError(u8"In BaseHttpTransaction::ConvertPayloadFromChunkedToFixedLength() - New chunk length specified is greater than the total payload container size.");
-							break;
-						}
+					for (size_t i = 0; i < RelaySlotCount; ++i)
+					{
+						m_relaySlotLengths[i] = 0;
+					}
 
-						globalPos += pos;
+					m_relayHead = 0;
+					m_relayFilled = 0;
+					m_relaying = false;
+				}
 
-						// We know have a chunk, its start position and its end position. Move it.
-						// XXX TODO - Change this to a straight up copy, moving char is slower.
-						result.insert(result.end(), (m_transactionData.begin() + globalPos), (m_transactionData.begin() + (globalPos + chunkLength)));
+				void BaseHttpTransaction::CompactLeadingChunkedPayload()
+				{
+					size_t compactedSize = 0;
 
-						// Advance pos beyond clrf at the start of the chunk, then beyond the chunk length, then again beyond the
-						// terminating clrf before we search again.
-						pos += (chunkLength + crlf.size());
-						globalPos += (chunkLength + crlf.size());
-						
-						if (pos > payloadStrRef.length())
+					for (const auto& slice : m_leadingBodySlices)
+					{
+						if (slice.first + slice.second > m_unwrittenPayloadSize)
 						{
-							ReportError(u8"In BaseHttpTransaction::ConvertPayloadFromChunkedToFixedLength() - Next chunk length specified is greater than the total payload container size.");
+							// Can't happen, since the slices were recorded from this very data.
 							break;
-						}						
-
-						payloadStrRef = payloadStrRef.substr(pos);
-
-						pos = payloadStrRef.find(crlf);
+						}
 
-						if (pos == boost::string_ref::npos)
+						if (slice.first != compactedSize)
 						{
-							ReportError(u8"In BaseHttpTransaction::ConvertPayloadFromChunkedToFixedLength() - Final chunk not yet encountered, but failed to locate the next chunk header.");
-							break;
+							std::memmove(m_transactionData.data() + compactedSize, m_transactionData.data() + slice.first, slice.second);
 						}
-					}
 
-					if (noError)
-					{
-						m_transactionData = std::move(result);
-						m_unwrittenPayloadSize = m_transactionData.size();
-					}
-					else
-					{
-						ReportError(u8"In BaseHttpTransaction::ConvertPayloadFromChunkedToFixedLength() - Failed to convert chunked content to fixed-length transfer.");
+						compactedSize += slice.second;
 					}
 
-					return noError;
+					m_leadingBodySlices.clear();
+
+					m_dechunkedSize = compactedSize;
+					m_unwrittenPayloadSize = compactedSize;
+					m_dechunking = true;
 				}
 
 				int BaseHttpTransaction::OnMessageBegin(http_parser* parser)
@@ -1027,11 +1324,14 @@ namespace te
 						trans->m_payloadComplete = false;
 						trans->m_consumeAllBeforeSending = false;
 						trans->m_shouldBlock = 0;
-						trans->m_headers.clear();
+						trans->m_headers.Clear();
+						trans->ResetContentDecoding();
 						trans->m_unwrittenPayloadSize = 0;
+						trans->m_dechunking = false;
+						trans->m_dechunkedSize = 0;
+						trans->m_leadingBodySlices.clear();
 						trans->m_headersSent = false;
 						trans->m_headersComplete = false;
-						trans->m_lastHeader = std::string("");
 						
 					}
 					else
@@ -1059,6 +1359,8 @@ namespace te
 						trans->m_headersComplete = true;
 						trans->m_headersSent = false;
 
+						trans->PrepareContentDecoder();
+
 					}
 					else
 					{
@@ -1083,6 +1385,13 @@ namespace te
 						}
 
 						trans->m_payloadComplete = true;
+
+						if (trans->m_relaying)
+						{
+							// Whatever follows is not part of this message, and must not be
+							// relayed along with it.
+							http_parser_pause(parser, 1);
+						}
 					
 					}
 					else
@@ -1165,13 +1474,17 @@ namespace te
 							throw std::runtime_error(u8"In BaseHttpTransaction::OnHeaderField() - http_parser->data is nullptr when it should contain a pointer the http_parser's owning BaseHttpTransaction object.");
 						}
 
-						trans->m_lastHeader = std::string(at, length);
-
 						if (length == 0)
 						{
 							trans->ReportError(u8"In BaseHttpTransaction::OnHeaderField() - Length provided for the parsed header field/name is zero.");
 							return -1;
 						}
+
+						if (!trans->m_headers.OnParsedName(at, length))
+						{
+							trans->ReportError(u8"In BaseHttpTransaction::OnHeaderField() - Parsed header field/name does not continue the previous partial field/name.");
+							return -1;
+						}
 					}
 					else
 					{
@@ -1195,16 +1508,9 @@ namespace te
 							throw std::runtime_error(u8"In BaseHttpTransaction::OnHeaderValue() - http_parser->data is nullptr when it should contain a pointer the http_parser's owning BaseHttpTransaction object.");
 						}
 
-						if (trans->m_lastHeader.length() > 0)
-						{							
-							std::string headerValue(at, length);
-							trans->AddHeader(trans->m_lastHeader, headerValue, false);
-
-							trans->m_lastHeader.clear();
-						}
-						else
+						if (!trans->m_headers.OnParsedValue(at, length))
 						{
-							trans->ReportError(std::string(u8"In BaseHttpTransaction::OnHeaderValue() - OnHeaderValue called while BaseHttpTransaction::m_lastHeader was empty."));
+							trans->ReportError(std::string(u8"In BaseHttpTransaction::OnHeaderValue() - OnHeaderValue called without a preceeding header field/name."));
 							return -1;
 						}
 					}
@@ -1223,17 +1529,12 @@ namespace te
 				{
 					if (parser != nullptr)
 					{
-						/*
-
-						This method has been disabled due to a design change decision. Formerly, this object
-						was not going to own the buffers used for reading the raw data it is intended to parse.
-						However, having considered design issues that are much uglier than this object owning
-						read buffers, I've decided to make this object own the read buffers. As such, this
-						method is no longer required for copying out body data, as the body data will already
-						exist inside this object however it comes in over the wire. From there, the body
-						may or may not be converted from chunked to a fixed-length body, etc, depending
-						on configuration options, at which time the same raw read buffers will be mutated
-						accordingly. See notes on the ::Parse(const size_t&) method for more information.
+						// Body data is never copied out here, since it already lives in the read
+						// buffers this object owns. See notes on the ::Parse(const size_t&) method. The
+						// things done with it here are decoding, when the payload is encoded, and
+						// stripping chunked framing in place, when the payload is being collected. Since
+						// the body is handed to us with any chunked framing already stripped, the
+						// decoder can be fed directly.
 
 						BaseHttpTransaction* trans = static_cast<BaseHttpTransaction*>(parser->data);
 
@@ -1242,8 +1543,51 @@ namespace te
 							throw std::runtime_error(u8"In BaseHttpTransaction::OnBody() - http_parser->data is nullptr when it should contain a pointer the http_parser's owning BaseHttpTransaction object.");
 						}
 
-						trans->m_transactionData.insert(trans->m_transactionData.end(), at, at + length);
-						*/
+						// The decision to consume the whole payload is made once the headers have been
+						// parsed, by which point some of the body may have come through along with the
+						// headers. So, decode everything until the headers are written, and only keep
+						// going past that if the payload is being consumed.
+						if (trans->m_contentDecoder != nullptr && !trans->m_contentDecodingFailed && (trans->m_consumeAllBeforeSending || !trans->m_headersSent))
+						{
+							if (trans->m_decodedData.capacity() == 0)
+							{
+								trans->m_decodedData = PayloadBufferPool::GetThreadPool().Acquire();
+							}
+
+							trans->m_encodedPayloadSize += length;
+
+							if (!trans->m_contentDecoder->Decode(at, length, trans->m_decodedData))
+							{
+								trans->m_contentDecodingFailed = true;
+								trans->ReportWarning(u8"In BaseHttpTransaction::OnBody() - Failed to decode payload. The data is either corrupt, or decodes to more than the maximum payload size.");
+							}
+						}
+
+						if ((parser->flags & F_CHUNKED) == 0)
+						{
+							return 0;
+						}
+
+						if (trans->m_dechunking)
+						{
+							// Strip the chunk framing in place. The destination never runs ahead of
+							// the data being parsed, so this only ever moves data down. Any decoding
+							// above is already done with this slice.
+							char* destination = trans->m_transactionData.data() + trans->m_dechunkedSize;
+
+							if (destination != at)
+							{
+								std::memmove(destination, at, length);
+							}
+
+							trans->m_dechunkedSize += length;
+						}
+						else if (trans->m_leadingBodyBase != nullptr && at >= trans->m_leadingBodyBase)
+						{
+							// Body data that came in with the headers. It can't be touched yet, so
+							// just remember where it is.
+							trans->m_leadingBodySlices.emplace_back(static_cast<size_t>(at - trans->m_leadingBodyBase), length);
+						}
 					}
 					else
 					{
@@ -31,13 +31,19 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <cstring>
+#include <memory>
 #include <string>
-#include <map>
+#include <vector>
 #include <boost/asio/buffers_iterator.hpp>
 #include <boost/asio/streambuf.hpp>
 #include <boost/utility/string_ref.hpp>
 #include "http_parser.h"
+#include "ContentEncoding.hpp"
+#include "HttpHeaderCollection.hpp"
+#include "PayloadMemory.hpp"
 #include "../../util/cb/EventReporter.hpp"
 
 #ifdef _MSC_VER 
@@ -65,36 +71,10 @@ namespace te
 					HTTP2
 				};
 
-				/// <summary>
-				/// Binary predicate for case insensitive lookups in std::multimap.
-				/// </summary>
-				struct CaseInsensitiveComparer : public std::binary_function<std::string,
-					std::string, bool>
-				{
-					bool operator()(const std::string &strOne, const std::string &strTwo) const
-					{
-						return strcasecmp(strOne.c_str(), strTwo.c_str()) < 0;
-					}
-				};
-
-				/// <summary>
-				/// Basic string/string multimap for storing the headers with case insensitive key
-				/// comparison.
-				/// </summary>
-				typedef std::multimap<std::string, std::string, CaseInsensitiveComparer> HttpHeaderMap;
-
-				/// <summary>
-				/// Shorthand map constant iterator type.
-				/// </summary>
-				typedef HttpHeaderMap::const_iterator HttpHeaderConstIterator;
-
-				/// <summary>
-				/// We need to be able to support multiple header entries by the same name, since
-				/// this is legal according to the spec. So, all methods that query against the map,
-				/// looking for a specific entry, will return a range based match, rather than a
-				/// single string value.
-				/// </summary>					
-				typedef std::pair<HttpHeaderConstIterator, HttpHeaderConstIterator> HttpHeaderRangeMatch;
+				class BaseContentDecoder;
+				class ZlibContentDecoder;
+				class BrotliContentDecoder;
+				class ZstdContentDecoder;
 
 				/// <summary>
 				/// Abstract base class for HTTP Requests and Responses. This class is meant to
@@ -114,10 +94,74 @@ namespace te
 				{
 				public:
 
+					/// <summary>
+					/// Default capacity, in bytes, beyond which transaction buffers are released
+					/// rather than kept for reuse. See ::SetBufferHighWaterMark(...).
+					/// </summary>
+					static constexpr size_t DefaultBufferHighWaterMark = 524288;
+
+					/// <summary>
+					/// Default level used when payloads are encoded. See ::SetCompressionLevel(...).
+					/// </summary>
+					static constexpr int DefaultCompressionLevel = 6;
+
 					BaseHttpTransaction();
 					
 					virtual ~BaseHttpTransaction();
 
+					/// <summary>
+					/// Sets the capacity, in bytes, beyond which transaction buffers are released
+					/// rather than kept for reuse. This applies to buffers kept by a transaction
+					/// across a ::Reset() as well as to payload buffers held in the per-thread
+					/// payload buffer pool. Raising this trades memory held by idle connections
+					/// and threads for fewer allocations when payloads are large.
+					/// </summary>
+					/// <param name="bytes">
+					/// The largest buffer capacity to retain.
+					/// </param>
+					static void SetBufferHighWaterMark(const size_t bytes);
+
+					/// <summary>
+					/// Gets the capacity, in bytes, beyond which transaction buffers are released
+					/// rather than kept for reuse.
+					/// </summary>
+					/// <returns>
+					/// The largest buffer capacity that is retained.
+					/// </returns>
+					static const size_t GetBufferHighWaterMark();
+
+					/// <summary>
+					/// Sets the level used whenever a payload is encoded, whether by
+					/// ::ApplyContentEncodingPolicy(...) or by an explicit call to ::CompressGzip()
+					/// or ::CompressDeflate(). Levels run from 1, fastest, to 9, smallest, as with
+					/// zlib. Setting zero disables re-encoding by ::ApplyContentEncodingPolicy(...),
+					/// so that modified payloads are always sent unencoded.
+					/// </summary>
+					/// <param name="level">
+					/// The compression level.
+					/// </param>
+					static void SetCompressionLevel(const int level);
+
+					/// <summary>
+					/// Gets the level used whenever a payload is encoded.
+					/// </summary>
+					/// <returns>
+					/// The compression level. Zero if re-encoding is disabled.
+					/// </returns>
+					static const int GetCompressionLevel();
+
+					/// <summary>
+					/// Returns the transaction to the state of a freshly constructed one, so that
+					/// it can be reused for the next transaction on a keep-alive connection,
+					/// rather than being destroyed and reconstructed. The http_parser, the header
+					/// read buffer, the header storage and the payload buffer are all kept, along
+					/// with whatever capacity they've grown to, unless that capacity exceeds
+					/// ::GetBufferHighWaterMark(). Event callbacks are kept as well.
+					/// 
+					/// Subclasses that hold state of their own must override this and call up.
+					/// </summary>
+					virtual void Reset();
+
 					/// <summary>
 					/// Fetches the value of the defined HTTP Protocol Version for the transaction.
 					/// </summary>
@@ -156,7 +200,7 @@ namespace te
 					/// If any instances of the specified header exist, remove them and replace with
 					/// this value. True by default.
 					/// </param>
-					void AddHeader(const std::string& name, std::string value, const bool replaceIfExists = true);
+					void AddHeader(const boost::string_ref name, const boost::string_ref value, const bool replaceIfExists = true);
 
 					/// <summary>
 					/// Will remove a header that matches exactly the provided name and value, case
@@ -175,7 +219,7 @@ namespace te
 					/// <param name="value">
 					/// The value for the specified header, which must be exactly matched. 
 					/// </param>
-					void RemoveHeader(const std::string& name, const std::string& value);
+					void RemoveHeader(const boost::string_ref name, const boost::string_ref value);
 
 					/// <summary>
 					/// Will remove all headers that matches exactly the provided name key, case
@@ -191,14 +235,28 @@ namespace te
 					/// <param name="name">
 					/// The name of the header to remove. 
 					/// </param>
-					void RemoveHeader(const std::string& name);
+					void RemoveHeader(const boost::string_ref name);
+
+					/// <summary>
+					/// Will remove all headers with the supplied known header id. This is the
+					/// preferred way of removing any header declared in KnownHttpHeaders.hpp, as
+					/// no string comparison takes place. The same warnings as
+					/// ::RemoveHeader(const boost::string_ref) apply.
+					/// </summary>
+					/// <param name="id">
+					/// The id of the header to remove. Must not be HeaderId::Unknown.
+					/// </param>
+					void RemoveHeader(const util::http::HeaderId id);
 
 					/// <summary>
 					/// Check for the existence of a header by the specified header name. Lookups
 					/// are case insensitive.
 					/// 
-					/// Since the storage mechanism for the headers is a multimap, a range is
-					/// returned, which may contain zero or more entries.
+					/// Since multiple headers by the same name are legal, a range is returned,
+					/// which may contain zero or more entries. The names and values in the range
+					/// are views into storage owned by this transaction. They remain valid until
+					/// the headers are next modified, so take a copy if you need them beyond
+					/// that.
 					/// </summary>
 					/// <param name="header">
 					/// The name of the HTTP header to lookup. Example: "Content-Type" 
@@ -206,7 +264,22 @@ namespace te
 					/// <returns>
 					/// A constant range based iterator which may contain zero or more entries. 
 					/// </returns>
-					const HttpHeaderRangeMatch GetHeader(const std::string& header) const;
+					const HttpHeaderRangeMatch GetHeader(const boost::string_ref header) const;
+
+					/// <summary>
+					/// Check for the existence of a header by the supplied known header id. This is
+					/// the preferred way of looking up any header declared in KnownHttpHeaders.hpp,
+					/// as the id of every parsed header is resolved while parsing, so this lookup
+					/// never compares a string. See ::GetHeader(const boost::string_ref) for
+					/// details on the returned range.
+					/// </summary>
+					/// <param name="id">
+					/// The id of the HTTP header to lookup. Example: util::http::HeaderId::ContentType
+					/// </param>
+					/// <returns>
+					/// A constant range based iterator which may contain zero or more entries.
+					/// </returns>
+					const HttpHeaderRangeMatch GetHeader(const util::http::HeaderId id) const;
 
 					/// <summary>
 					/// Check to see if all headers for the transaction have successfully been
@@ -276,17 +349,21 @@ namespace te
 					/// As such, this object will always retain the buffers in the original state
 					/// that they arrived at over the socket. These buffers will only ever be
 					/// modified when the modifications are guaranteed to produce a valid state for
-					/// the object. The OnBody callbacks of the internal http_parser will be
-					/// ignored, as will the OnChunk methods, because no copy is necessary. Chunked
-					/// encoding will only ever be converted to fixed-length (content-length header
-					/// defined) transactions when ::ConsumeAllBeforeSending() is configured to
-					/// true.
-					/// 
-					/// Conversion from chunked to fixed-length content and decompression will be
-					/// done entirely manually by this objects own conversion implementation, thus
-					/// making the sole purpose of the http_parser object to accurately extract
-					/// header information and signal when the end of the transaction has been
-					/// reached.
+					/// the object. Body data is never copied out of the buffers, because no copy
+					/// is necessary. Chunked encoding will only ever be converted to fixed-length
+					/// (content-length header defined) transactions when ::ConsumeAllBeforeSending()
+					/// is configured to true.
+					/// 
+					/// That conversion happens in place as the payload is parsed. Each piece of
+					/// chunk data handed to the OnBody callback is moved down over the chunk
+					/// framing that preceded it, so that when the final chunk is parsed the payload
+					/// already sits contiguous at the front of the payload buffer, and no second
+					/// pass over the payload is needed. The one exception to copy-free handling is
+					/// a payload with a Content-Encoding this object knows how to decode. The
+					/// OnBody callback feeds such payloads, with any chunked framing already
+					/// stripped by http_parser, to a streaming decoder as they arrive, so that the
+					/// decoded payload is complete the moment the final byte is parsed. See
+					/// ::GetDecodedPayload().
 					/// </summary>
 					/// <param name="bytes_transferred">
 					/// The number of bytes_transferred indicated in the asio::async_read* handler
@@ -343,21 +420,105 @@ namespace te
 					boost::asio::mutable_buffers_1 GetPayloadReadBuffer();
 
 					/// <summary>
-					/// Retrieve a boost::asio::const_buffers_1 object which wraps the internal
-					/// transaction payload. Call this method when you intend to write the entire
-					/// contents of the transaction outbound from the proxy.
+					/// A buffer sequence made up of the serialized headers, followed by the
+					/// payload. Suitable for handing directly to asio::async_write(...), which
+					/// gathers both in a single write.
+					/// </summary>
+					typedef std::array<boost::asio::const_buffer, 2> WriteBufferSequence;
+
+					/// <summary>
+					/// Retrieve a buffer sequence which wraps the serialized headers, if they have
+					/// not yet been sent, and the internal transaction payload. Call this method
+					/// when you intend to write the entire contents of the transaction outbound
+					/// from the proxy.
+					/// 
+					/// The headers and the payload are kept in separate buffers and written with a
+					/// single gathered write, so the payload is never copied in behind the
+					/// headers. Once the headers have been sent, the headers buffer in the
+					/// returned sequence is empty.
 					/// 
 					/// Note that this method lacks a right-hand const declaration. The internal
 					/// state of the object will be irreversibly altered once this method is called,
-					/// as if the headers have not yet been set, the headers must be merged into the
-					/// final, separated payload storage before being supplied as a single buffer
-					/// for writing.
+					/// as the headers are flagged as sent and the payload as written. Both buffers
+					/// remain valid until the next call to a method that modifies this object.
+					/// </summary>
+					/// <returns>
+					/// A buffer sequence wrapping the serialized headers and the internal
+					/// transaction payload data.
+					/// </returns>
+					WriteBufferSequence GetWriteBuffer();
+
+					/// <summary>
+					/// Gets the next free slot of the relay ring, for reading more of a payload
+					/// that is being relayed rather than consumed. ::CommitRelayRead(...) must be
+					/// called in the completion handler of the read.
+					/// 
+					/// Relaying is for payloads that are not being inspected, once the headers have
+					/// been written. Rather than funneling every read through the payload buffer,
+					/// which ::GetPayloadReadBuffer() may grow along the way, the payload is read
+					/// into a small, fixed ring of slots, each of which is written out as soon as
+					/// it is filled. Since reading one slot and writing another can overlap, the
+					/// connection keeps moving in both directions, and the memory it holds stays
+					/// the same no matter the size of the payload.
+					/// 
+					/// At most one read and one write may be outstanding at once, and only when
+					/// ::CanRelayRead() and ::HasRelayWrite() respectively are true.
+					/// </summary>
+					/// <returns>
+					/// A boost::asio::mutable_buffers_1 wrapping the next free slot.
+					/// </returns>
+					boost::asio::mutable_buffers_1 GetRelayReadBuffer();
+
+					/// <summary>
+					/// Parses the data read into the slot given by the last call to
+					/// ::GetRelayReadBuffer(), queueing it for writing. The parser tracks the
+					/// Content-Length or chunk framing of the payload exactly, so anything read
+					/// past the end of the message is dropped rather than relayed.
+					/// </summary>
+					/// <param name="bytesReceived">
+					/// The number of bytes read into the slot.
+					/// </param>
+					/// <returns>
+					/// True if the data was parsed successfully, false otherwise.
+					/// </returns>
+					const bool CommitRelayRead(const size_t bytesReceived);
+
+					/// <summary>
+					/// Informs the parser that the remote peer closed the connection, which is how
+					/// the end of a payload without a Content-Length or chunked framing is marked.
+					/// </summary>
+					void CommitRelayEof();
+
+					/// <summary>
+					/// Indicates whether or not the relay ring has a free slot to read into.
+					/// </summary>
+					/// <returns>
+					/// True if a free slot is available, false otherwise.
+					/// </returns>
+					const bool CanRelayRead() const;
+
+					/// <summary>
+					/// Indicates whether or not the relay ring holds a slot waiting to be written.
+					/// </summary>
+					/// <returns>
+					/// True if a slot is waiting to be written, false otherwise.
+					/// </returns>
+					const bool HasRelayWrite() const;
+
+					/// <summary>
+					/// Gets the oldest filled slot of the relay ring, for writing.
+					/// ::CommitRelayWrite() must be called in the completion handler of the write.
 					/// </summary>
 					/// <returns>
-					/// A boost::asio::const_buffers_1 object wrapping the internal transaction
-					/// payload data.
+					/// A boost::asio::const_buffers_1 wrapping the oldest filled slot.
 					/// </returns>
-					boost::asio::const_buffers_1 GetWriteBuffer();
+					boost::asio::const_buffers_1 GetRelayWriteBuffer();
+
+					/// <summary>
+					/// Frees the slot given by the last call to ::GetRelayWriteBuffer(), once it has
+					/// been written.
+					/// </summary>
+					void CommitRelayWrite();
 
 					/// <summary>
 					/// Fetch the raw payload data. In the event that ::ConsumeAllBeforeSending() is
@@ -375,7 +536,23 @@ namespace te
 					/// <returns>
 					/// The transaction payload, aka the body. May or may not be compressed. 
 					/// </returns>
-					const std::vector<char>& GetPayload() const;
+					const PayloadBuffer& GetPayload() const;
+
+					/// <summary>
+					/// Fetch the decoded payload data received so far. When the payload has a
+					/// supported Content-Encoding, it is decoded incrementally as it is read for as
+					/// long as ::ConsumeAllBeforeSending() is true, so that consumers can start work
+					/// on the decoded content before the transaction is complete. Once the payload
+					/// is complete, the decoded data is moved into the payload proper, and this
+					/// buffer is empty again.
+					/// 
+					/// This data is exposed purely for analysis.
+					/// </summary>
+					/// <returns>
+					/// The decoded payload received so far. Empty if the payload is not encoded,
+					/// or the encoding is not supported.
+					/// </returns>
+					const PayloadBuffer& GetDecodedPayload() const;
 
 					/// <summary>
 					/// Moves the supplied payload to the internal transaction payload buffer. Sets
@@ -390,7 +567,7 @@ namespace te
 					/// <param name="payload">
 					/// The payload to be moved to the internal payload buffer.
 					/// </param>
-					void SetPayload(std::vector<char>&& payload);
+					void SetPayload(PayloadBuffer&& payload);
 
 					/// <summary>
 					/// Copies the supplied payload to the internal transaction payload buffer. Sets
@@ -647,6 +824,29 @@ namespace te
 					/// </returns>
 					const bool CompressDeflate();
 
+					/// <summary>
+					/// Decides how a complete payload, which was decoded for inspection, is encoded
+					/// when it is sent on. Without this, such payloads always leave the proxy
+					/// decoded, which can multiply their size on the wire.
+					/// 
+					/// If the payload was not modified since it was decoded, and the recipient
+					/// accepts the encoding it originally arrived with, the original encoded
+					/// payload, which is retained for exactly this purpose, is restored as-is. No
+					/// encoding work is done at all. Otherwise, the payload is encoded with the
+					/// best encoding the recipient accepts, at the level given by
+					/// ::GetCompressionLevel(). If the recipient accepts no encoding we can
+					/// produce, or the encoded payload would not be any smaller, the payload is
+					/// left decoded.
+					/// 
+					/// Payloads that were never decoded, and blocked transactions, are left alone.
+					/// Must be called before the first call to ::GetWriteBuffer().
+					/// </summary>
+					/// <param name="acceptedEncodings">
+					/// The set of encodings the recipient accepts, typically parsed from the
+					/// Accept-Encoding header of the request with ParseAcceptEncoding(...).
+					/// </param>
+					void ApplyContentEncodingPolicy(const ContentEncodingSet acceptedEncodings);
+
 				protected:
 					
 					/// <summary>
@@ -696,6 +896,18 @@ namespace te
 					/// </summary>
 					static constexpr uint32_t MaxPayloadResize = 10485760;
 
+					/// <summary>
+					/// The size of each slot in the relay ring.
+					/// </summary>
+					static constexpr uint32_t RelaySlotSize = 32768;
+
+					/// <summary>
+					/// The number of slots in the relay ring. Together with RelaySlotSize, this
+					/// keeps the ring the same size as a single payload read buffer, so that the
+					/// ring is drawn from the same pool of buffers.
+					/// </summary>
+					static constexpr uint32_t RelaySlotCount = 4;
+
 					/// <summary>
 					/// The http_parser object that gets stuck with doing all of the hard work.
 					/// </summary>
@@ -712,20 +924,11 @@ namespace te
 					HttpProtocolVersion m_httpVersion;
 
 					/// <summary>
-					/// Case insensitive multimap for storing the http header fields and values
-					/// read during the transaction.
+					/// Stores the http header fields and values read during the transaction. The
+					/// raw header block is copied into the collection once, and every parsed name
+					/// and value is simply a view into it. See HttpHeaderCollection for details.
 					/// </summary>
-					HttpHeaderMap m_headers;
-
-					/// <summary>
-					/// Due to the nature of the protocol and specifically how the http_parser
-					/// processes data, a reference to the last header read by the parser has
-					/// to be kept during the header parsing process. When the OnHeaderValue(...)
-					/// method is called, this should be set to the last header name read, at
-					/// which time the complete header can be inserted and this variable reset
-					/// to be empty.
-					/// </summary>
-					std::string m_lastHeader;
+					HttpHeaderCollection m_headers;
 
 					/// <summary>
 					/// This object is used exclusively for reading in headers using
@@ -739,8 +942,18 @@ namespace te
 					/// it's possible to instruct the transaction to collect the entire payload in
 					/// this container before sending it outbound, in order to perform operations
 					/// such as deep content analysis on the payload data.
+					///
+					/// Payload collected this way can grow large, so once it passes the spill
+					/// threshold, or the shared memory budget runs out, it moves into a memory
+					/// mapped temporary file. See PayloadMemory.
+					/// </summary>
+					PayloadBuffer m_transactionData;
+
+					/// <summary>
+					/// Holds the serialized headers for the duration of the write that sends them.
+					/// See ::GetWriteBuffer().
 					/// </summary>
-					std::vector<char> m_transactionData;
+					std::vector<char> m_serializedHeaders;
 
 					/// <summary>
 					/// This object uses a vector of char for storing our payload data. This object
@@ -799,45 +1012,188 @@ namespace te
 					bool m_consumeAllBeforeSending = false;
 
 					/// <summary>
-					/// Decompress the payload contents, expecting gzip format.
+					/// Holds the decoded payload while an encoded payload is being read. See
+					/// ::GetDecodedPayload(). Like m_transactionData, this buffer is drawn from and
+					/// returned to the per-thread payload buffer pool.
+					/// </summary>
+					PayloadBuffer m_decodedData;
+
+					/// <summary>
+					/// Holds the original, still encoded payload after the decoded payload has
+					/// been moved into place, so that it can be restored if the decoded payload
+					/// goes unmodified. See ::ApplyContentEncodingPolicy(...).
+					/// </summary>
+					PayloadBuffer m_encodedData;
+
+					/// <summary>
+					/// The Content-Encoding the current payload arrived with, if it is being or has
+					/// been decoded. Identity otherwise.
+					/// </summary>
+					ContentEncoding m_payloadContentEncoding = ContentEncoding::Identity;
+
+					/// <summary>
+					/// Flag used to indicate that the payload held in m_encodedData still carries
+					/// its chunked transfer framing.
+					/// </summary>
+					bool m_encodedDataChunked = false;
+
+					/// <summary>
+					/// Flag used to indicate that the payload has been replaced through
+					/// ::SetPayload(...) since it was decoded.
+					/// </summary>
+					bool m_payloadModified = false;
+
+					/// <summary>
+					/// Decoder for gzip and deflate payloads. Created the first time such a payload
+					/// is seen, and kept for the lifetime of this object.
+					/// </summary>
+					std::unique_ptr<ZlibContentDecoder> m_zlibDecoder;
+
+					/// <summary>
+					/// Decoder for br payloads. Created the first time such a payload is seen, and
+					/// kept for the lifetime of this object.
+					/// </summary>
+					std::unique_ptr<BrotliContentDecoder> m_brotliDecoder;
+
+					/// <summary>
+					/// Decoder for zstd payloads. Created the first time such a payload is seen,
+					/// and kept for the lifetime of this object.
+					/// </summary>
+					std::unique_ptr<ZstdContentDecoder> m_zstdDecoder;
+
+					/// <summary>
+					/// The decoder for the current payload. Null if the payload is not encoded, or
+					/// the encoding is not supported.
+					/// </summary>
+					BaseContentDecoder* m_contentDecoder = nullptr;
+
+					/// <summary>
+					/// The number of encoded payload bytes given to m_contentDecoder.
+					/// </summary>
+					size_t m_encodedPayloadSize = 0;
+
+					/// <summary>
+					/// Flag used to indicate that m_contentDecoder failed to decode the payload.
+					/// </summary>
+					bool m_contentDecodingFailed = false;
+
+					/// <summary>
+					/// Selects m_contentDecoder according to the Content-Encoding header of the
+					/// transaction, and prepares it for a new payload.
+					/// </summary>
+					void PrepareContentDecoder();
+
+					/// <summary>
+					/// Discards all content decoding state for the current payload.
+					/// </summary>
+					void ResetContentDecoding();
+
+					/// <summary>
+					/// Moves the decoded payload into m_transactionData, once the entire payload
+					/// has been decoded. Headers describing the encoding and framing of the
+					/// original payload are removed.
 					/// </summary>
 					/// <returns>
-					/// True if the decompression succeeded, false otherwise.
+					/// True if the decoded payload was complete and has been moved into place,
+					/// false otherwise.
 					/// </returns>
-					const bool DecompressGzip();
+					const bool FinalizeDecodedPayload();
+
+					/// <summary>
+					/// Ring of slots that payloads being relayed are read into. See
+					/// ::GetRelayReadBuffer(). Only holds storage while relaying.
+					/// </summary>
+					PayloadBuffer m_relayRing;
+
+					/// <summary>
+					/// The number of bytes to be written from each slot of m_relayRing.
+					/// </summary>
+					size_t m_relaySlotLengths[RelaySlotCount] = {};
+
+					/// <summary>
+					/// The index of the oldest filled slot of m_relayRing.
+					/// </summary>
+					size_t m_relayHead = 0;
+
+					/// <summary>
+					/// The number of filled slots of m_relayRing.
+					/// </summary>
+					size_t m_relayFilled = 0;
+
+					/// <summary>
+					/// Flag used to indicate that the payload is being relayed.
+					/// </summary>
+					bool m_relaying = false;
 
 					/// <summary>
-					/// Decompress the payload contents, expecting deflate format.
+					/// Stops relaying, returning m_relayRing to the payload buffer pool.
 					/// </summary>
+					void ResetRelay();
+
+					/// <summary>
+					/// Swaps the original encoded payload held in m_encodedData back into place,
+					/// along with the headers describing its encoding and framing.
+					/// </summary>
+					void RestoreEncodedPayload();
+
+					/// <summary>
+					/// Encodes the payload with the supplied encoding, replacing the payload and
+					/// adjusting headers to suit, provided that the encoded payload is smaller.
+					/// </summary>
+					/// <param name="encoding">
+					/// The encoding to apply. Must be one of Gzip, Deflate, Brotli or Zstd.
+					/// </param>
+					/// <param name="level">
+					/// The compression level.
+					/// </param>
 					/// <returns>
-					/// True if the decompression succeeded, false otherwise.
+					/// True if the payload was encoded and replaced, false otherwise.
 					/// </returns>
-					const bool DecompressDeflate();
+					const bool EncodePayload(const ContentEncoding encoding, const int level);
 
 					/// <summary>
-					/// In the even that the user has specified that they wish collect the entire
-					/// payload of a transaction for inspection, certain guarantees are provided:
-					/// that chunked content will be converted to a normal,
-					/// fixed-length/precalculated transfer, and the payload will be decompressed.
-					/// 
-					/// Since this object owns the buffers directly used on the sockets, and in
-					/// order to maintain a valid state during and up-till a completely read
-					/// request/response, even though the http_parser is parsing the data on every
-					/// read, chunked data is not being extracted during any read operation leading
-					/// up to a completed transaction. This is to avoid fragmenting the object state
-					/// so that it remains valid. See notes on ::Parse(..) for more on that.
+					/// In the event that the user has specified that they wish to collect the
+					/// entire payload of a transaction for inspection, chunked content is
+					/// guaranteed to be converted to a normal, fixed-length transfer. Rather than
+					/// doing so in a second pass once the payload is complete, the chunk framing
+					/// is stripped while parsing: every slice of body data http_parser hands to
+					/// ::OnBody(...) is moved down in m_transactionData to sit directly behind the
+					/// previous one. Since the body is never further along than the data it came
+					/// from, this is always safe to do in place.
 					/// 
-					/// As such, when and only when the the following two conditions are met, the
-					/// transaction payload can/should be converted to a normal precalcuated
-					/// transfer and decompressed: ::ConsumeAllBeforeSending() is true, and
-					/// ::IsPayloadComplete() is also true. If these conditions are met, this object
-					/// will automatically provide the described functionality via this method once
-					/// the final ::Parse(...) has been called.
+					/// Body data that came in with the headers is parsed before anyone has had the
+					/// chance to ask for the payload to be collected, and must be left as-is in
+					/// case it is not. The position of each slice of it is recorded instead, and
+					/// this method moves those slices into place before the first read of a
+					/// collected payload is handed out, or once the headers are parsed, if the
+					/// entire payload came in with them.
 					/// </summary>
-					/// <returns>
-					/// True if the conversion succeeded, false otherwise. 
-					/// </returns>
-					const bool ConvertPayloadFromChunkedToFixedLength();					
+					void CompactLeadingChunkedPayload();
+
+					/// <summary>
+					/// Indicates whether or not chunk framing is being stripped from the payload
+					/// as it is parsed. See ::CompactLeadingChunkedPayload().
+					/// </summary>
+					bool m_dechunking = false;
+
+					/// <summary>
+					/// The number of bytes of de-chunked body data at the front of
+					/// m_transactionData.
+					/// </summary>
+					size_t m_dechunkedSize = 0;
+
+					/// <summary>
+					/// The start of the body data that came in with the headers, while it is being
+					/// parsed. Null otherwise.
+					/// </summary>
+					const char* m_leadingBodyBase = nullptr;
+
+					/// <summary>
+					/// The offset and length, relative to the start of the body data that came in
+					/// with the headers, of each slice of body data within it. See
+					/// ::CompactLeadingChunkedPayload().
+					/// </summary>
+					std::vector<std::pair<size_t, size_t>> m_leadingBodySlices;
 
 					/// <summary>
 					/// Called when the http_parser has begun reading a new transaction.
@@ -0,0 +1,142 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BrotliContentDecoder.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				BrotliContentDecoder::BrotliContentDecoder(const size_t maxOutputSize)
+					:
+					BaseContentDecoder(maxOutputSize)
+				{
+					m_state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+				}
+
+				BrotliContentDecoder::~BrotliContentDecoder()
+				{
+					if (m_state != nullptr)
+					{
+						BrotliDecoderDestroyInstance(m_state);
+					}
+				}
+
+				const bool BrotliContentDecoder::Decode(const char* data, const size_t length, PayloadBuffer& output)
+				{
+					if (m_state == nullptr)
+					{
+						return false;
+					}
+
+					if (length == 0 || m_complete)
+					{
+						// Anything past the end of the stream is junk, and is ignored.
+						return true;
+					}
+
+					size_t availableIn = length;
+					const uint8_t* nextIn = reinterpret_cast<const uint8_t*>(data);
+
+					for (;;)
+					{
+						const size_t used = output.size();
+
+						if (used >= m_maxOutputSize)
+						{
+							return false;
+						}
+
+						size_t available = m_maxOutputSize - used;
+
+						if (available > OutputStepSize)
+						{
+							available = OutputStepSize;
+						}
+
+						output.resize(used + available);
+
+						size_t availableOut = available;
+						uint8_t* nextOut = reinterpret_cast<uint8_t*>(output.data() + used);
+
+						const auto ret = BrotliDecoderDecompressStream(m_state, &availableIn, &nextIn, &availableOut, &nextOut, nullptr);
+
+						output.resize(used + (available - availableOut));
+
+						switch (ret)
+						{
+							case BROTLI_DECODER_RESULT_SUCCESS:
+								m_complete = true;
+								return true;
+
+							case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+								return true;
+
+							case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+								continue;
+
+							default:
+								return false;
+						}
+					}
+				}
+
+				const bool BrotliContentDecoder::IsComplete() const
+				{
+					return m_complete;
+				}
+
+				void BrotliContentDecoder::Reset()
+				{
+					m_complete = false;
+
+					if (m_state != nullptr && !BrotliDecoderIsUsed(m_state))
+					{
+						return;
+					}
+
+					if (m_state != nullptr)
+					{
+						BrotliDecoderDestroyInstance(m_state);
+					}
+
+					m_state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
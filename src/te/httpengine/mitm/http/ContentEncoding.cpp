@@ -0,0 +1,239 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ContentEncoding.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					/// <summary>
+					/// Trims leading and trailing whitespace from the supplied value.
+					/// </summary>
+					boost::string_ref Trim(boost::string_ref value)
+					{
+						while (value.size() > 0 && (value.front() == ' ' || value.front() == '\t'))
+						{
+							value.remove_prefix(1);
+						}
+
+						while (value.size() > 0 && (value.back() == ' ' || value.back() == '\t'))
+						{
+							value.remove_suffix(1);
+						}
+
+						return value;
+					}
+
+					/// <summary>
+					/// Determines if the supplied Accept-Encoding parameters, everything following
+					/// the first semicolon of an entry, give the entry a quality value of zero.
+					/// </summary>
+					const bool IsZeroQuality(boost::string_ref parameters)
+					{
+						while (parameters.size() > 0)
+						{
+							const auto semicolon = parameters.find(';');
+
+							auto parameter = Trim(parameters.substr(0, semicolon));
+
+							parameters = semicolon == boost::string_ref::npos ? boost::string_ref() : parameters.substr(semicolon + 1);
+
+							if (parameter.size() < 2 || (parameter[0] != 'q' && parameter[0] != 'Q') || parameter[1] != '=')
+							{
+								continue;
+							}
+
+							parameter = Trim(parameter.substr(2));
+
+							if (parameter.size() == 0 || parameter[0] != '0')
+							{
+								return false;
+							}
+
+							for (const char c : parameter)
+							{
+								if (c != '0' && c != '.')
+								{
+									return false;
+								}
+							}
+
+							return true;
+						}
+
+						return false;
+					}
+				}
+
+				const ContentEncoding ParseContentEncoding(boost::string_ref value)
+				{
+					value = Trim(value);
+
+					if (value.size() == 0 || boost::iequals(value, u8"identity"))
+					{
+						return ContentEncoding::Identity;
+					}
+
+					if (boost::iequals(value, u8"gzip") || boost::iequals(value, u8"x-gzip"))
+					{
+						return ContentEncoding::Gzip;
+					}
+
+					if (boost::iequals(value, u8"deflate"))
+					{
+						return ContentEncoding::Deflate;
+					}
+
+					if (boost::iequals(value, u8"br"))
+					{
+						return ContentEncoding::Brotli;
+					}
+
+					if (boost::iequals(value, u8"zstd"))
+					{
+						return ContentEncoding::Zstd;
+					}
+
+					return ContentEncoding::Unknown;
+				}
+
+				const ContentEncodingSet ParseAcceptEncoding(boost::string_ref value)
+				{
+					const ContentEncodingSet known =
+						ToContentEncodingSet(ContentEncoding::Gzip) |
+						ToContentEncodingSet(ContentEncoding::Deflate) |
+						ToContentEncodingSet(ContentEncoding::Brotli) |
+						ToContentEncodingSet(ContentEncoding::Zstd);
+
+					ContentEncodingSet accepted = ToContentEncodingSet(ContentEncoding::Identity);
+					ContentEncodingSet mentioned = 0;
+					bool wildcard = false;
+
+					while (value.size() > 0)
+					{
+						const auto comma = value.find(',');
+
+						const auto entry = value.substr(0, comma);
+
+						value = comma == boost::string_ref::npos ? boost::string_ref() : value.substr(comma + 1);
+
+						const auto semicolon = entry.find(';');
+
+						const auto name = Trim(entry.substr(0, semicolon));
+
+						const bool rejected = semicolon != boost::string_ref::npos && IsZeroQuality(entry.substr(semicolon + 1));
+
+						if (name == u8"*")
+						{
+							wildcard = !rejected;
+							continue;
+						}
+
+						const auto encoding = ParseContentEncoding(name);
+
+						if (encoding == ContentEncoding::Identity || encoding == ContentEncoding::Unknown)
+						{
+							continue;
+						}
+
+						mentioned |= ToContentEncodingSet(encoding);
+
+						if (!rejected)
+						{
+							accepted |= ToContentEncodingSet(encoding);
+						}
+					}
+
+					if (wildcard)
+					{
+						accepted |= (known & ~mentioned);
+					}
+
+					return accepted;
+				}
+
+				const boost::string_ref GetContentEncodingName(const ContentEncoding encoding)
+				{
+					switch (encoding)
+					{
+						case ContentEncoding::Gzip:
+							return boost::string_ref(u8"gzip");
+
+						case ContentEncoding::Deflate:
+							return boost::string_ref(u8"deflate");
+
+						case ContentEncoding::Brotli:
+							return boost::string_ref(u8"br");
+
+						case ContentEncoding::Zstd:
+							return boost::string_ref(u8"zstd");
+
+						default:
+							return boost::string_ref();
+					}
+				}
+
+				std::string FormatAcceptEncoding(const ContentEncodingSet encodings)
+				{
+					std::string value;
+
+					for (const auto encoding : { ContentEncoding::Gzip, ContentEncoding::Deflate, ContentEncoding::Brotli, ContentEncoding::Zstd })
+					{
+						if ((encodings & ToContentEncodingSet(encoding)) == 0)
+						{
+							continue;
+						}
+
+						if (value.size() > 0)
+						{
+							value.append(u8", ");
+						}
+
+						const auto name = GetContentEncodingName(encoding);
+						value.append(name.data(), name.size());
+					}
+
+					return value;
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
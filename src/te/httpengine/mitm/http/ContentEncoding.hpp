@@ -0,0 +1,135 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <boost/utility/string_ref.hpp>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// The Content-Encoding values that this library knows how to decode and
+				/// encode, plus Identity for payloads with no encoding, and Unknown for
+				/// everything else.
+				/// </summary>
+				enum class ContentEncoding : uint8_t
+				{
+					Identity,
+					Gzip,
+					Deflate,
+					Brotli,
+					Zstd,
+					Unknown
+				};
+
+				/// <summary>
+				/// A set of content encodings, one bit per ContentEncoding value. See
+				/// ::ToContentEncodingSet(...).
+				/// </summary>
+				typedef uint8_t ContentEncodingSet;
+
+				/// <summary>
+				/// Gets the single member set for the supplied encoding.
+				/// </summary>
+				/// <param name="encoding">
+				/// The encoding.
+				/// </param>
+				/// <returns>
+				/// The set containing only the supplied encoding.
+				/// </returns>
+				constexpr ContentEncodingSet ToContentEncodingSet(const ContentEncoding encoding)
+				{
+					return static_cast<ContentEncodingSet>(1u << static_cast<uint8_t>(encoding));
+				}
+
+				/// <summary>
+				/// Parses the value of a Content-Encoding header. Only a single encoding is
+				/// understood. Values listing several encodings, applied one after the other,
+				/// are reported as Unknown.
+				/// </summary>
+				/// <param name="value">
+				/// The header value.
+				/// </param>
+				/// <returns>
+				/// The encoding named by the value.
+				/// </returns>
+				const ContentEncoding ParseContentEncoding(boost::string_ref value);
+
+				/// <summary>
+				/// Parses the value of an Accept-Encoding header into the set of known
+				/// encodings it permits. Encodings given a quality value of zero are excluded,
+				/// and a wildcard permits every known encoding not explicitly mentioned.
+				/// Identity is always included.
+				/// </summary>
+				/// <param name="value">
+				/// The header value.
+				/// </param>
+				/// <returns>
+				/// The set of encodings the value permits.
+				/// </returns>
+				const ContentEncodingSet ParseAcceptEncoding(boost::string_ref value);
+
+				/// <summary>
+				/// Gets the token used for the supplied encoding in Content-Encoding headers.
+				/// </summary>
+				/// <param name="encoding">
+				/// The encoding.
+				/// </param>
+				/// <returns>
+				/// The token for the encoding. Empty for Identity and Unknown.
+				/// </returns>
+				const boost::string_ref GetContentEncodingName(const ContentEncoding encoding);
+
+				/// <summary>
+				/// Builds an Accept-Encoding header value listing every encoding in the
+				/// supplied set, other than Identity, which is implied.
+				/// </summary>
+				/// <param name="encodings">
+				/// The set of encodings to list.
+				/// </param>
+				/// <returns>
+				/// The header value, such as "gzip, deflate, br".
+				/// </returns>
+				std::string FormatAcceptEncoding(const ContentEncodingSet encodings);
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
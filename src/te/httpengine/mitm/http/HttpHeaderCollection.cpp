@@ -0,0 +1,485 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HttpHeaderCollection.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					inline bool EqualsIgnoreCase(const boost::string_ref one, const boost::string_ref two)
+					{
+						if (one.size() != two.size())
+						{
+							return false;
+						}
+
+						for (size_t i = 0; i < one.size(); ++i)
+						{
+							if (util::http::FoldHeaderNameCase(one[i]) != util::http::FoldHeaderNameCase(two[i]))
+							{
+								return false;
+							}
+						}
+
+						return true;
+					}
+				}
+
+				const boost::string_ref HttpHeaderCollection::CrLf = u8"\r\n";
+
+				const boost::string_ref HttpHeaderCollection::Separator = u8": ";
+
+				HttpHeaderConstIterator::HttpHeaderConstIterator()
+				{
+
+				}
+
+				HttpHeaderConstIterator::HttpHeaderConstIterator(const HttpHeaderCollection* collection, const size_t index)
+					:
+					m_collection(collection),
+					m_index(index),
+					m_matchIndex(index)
+				{
+					Load();
+				}
+
+				HttpHeaderConstIterator::reference HttpHeaderConstIterator::operator*() const
+				{
+					return m_current;
+				}
+
+				HttpHeaderConstIterator::pointer HttpHeaderConstIterator::operator->() const
+				{
+					return &m_current;
+				}
+
+				HttpHeaderConstIterator& HttpHeaderConstIterator::operator++()
+				{
+					const auto& entries = m_collection->m_entries;
+
+					const auto& match = entries[m_matchIndex];
+
+					++m_index;
+
+					while (m_index < entries.size() && !m_collection->IsMatch(m_index, match.header.first, match.nameHash, match.id))
+					{
+						++m_index;
+					}
+
+					Load();
+
+					return *this;
+				}
+
+				HttpHeaderConstIterator HttpHeaderConstIterator::operator++(int)
+				{
+					HttpHeaderConstIterator copy = *this;
+					++(*this);
+					return copy;
+				}
+
+				bool HttpHeaderConstIterator::operator==(const HttpHeaderConstIterator& other) const
+				{
+					return m_collection == other.m_collection && m_index == other.m_index;
+				}
+
+				bool HttpHeaderConstIterator::operator!=(const HttpHeaderConstIterator& other) const
+				{
+					return !(*this == other);
+				}
+
+				void HttpHeaderConstIterator::Load()
+				{
+					if (m_collection != nullptr && m_index < m_collection->m_entries.size())
+					{
+						m_current = m_collection->m_entries[m_index].header;
+					}
+					else
+					{
+						m_current = HttpHeader();
+					}
+				}
+
+				HttpHeaderCollection::HttpHeaderCollection()
+					:
+					m_overlay(OverlayBlockSize)
+				{
+					m_firstById.fill(0);
+				}
+
+				HttpHeaderCollection::~HttpHeaderCollection()
+				{
+
+				}
+
+				const uint32_t HttpHeaderCollection::HashName(const boost::string_ref name)
+				{
+					return util::http::ContinueHeaderNameHash(util::http::detail::HeaderNameHashOffsetBasis, name.data(), name.size());
+				}
+
+				void HttpHeaderCollection::Clear()
+				{
+					m_entries.clear();
+					m_overlay.Clear();
+					m_firstById.fill(0);
+					m_parseState = ParseState::None;
+				}
+
+				void HttpHeaderCollection::Reset(const size_t retainedCapacity)
+				{
+					m_entries.clear();
+					m_source.clear();
+					m_overlay.Reset();
+					m_firstById.fill(0);
+					m_parseState = ParseState::None;
+
+					if (m_source.capacity() > retainedCapacity)
+					{
+						std::vector<char>().swap(m_source);
+					}
+
+					if ((m_entries.capacity() * sizeof(Entry)) > retainedCapacity)
+					{
+						std::vector<Entry>().swap(m_entries);
+					}
+				}
+
+				char* HttpHeaderCollection::PrepareSource(const size_t length)
+				{
+					const char* previousData = m_source.data();
+					const size_t previousSize = m_source.size();
+
+					m_source.resize(previousSize + length);
+
+					if (previousData != nullptr && previousData != m_source.data())
+					{
+						// The buffer moved, so every view into it must follow.
+						for (auto& entry : m_entries)
+						{
+							if (!entry.inSource)
+							{
+								continue;
+							}
+
+							auto& name = entry.header.first;
+							auto& value = entry.header.second;
+
+							name = boost::string_ref(m_source.data() + (name.data() - previousData), name.size());
+
+							if (value.data() != nullptr)
+							{
+								value = boost::string_ref(m_source.data() + (value.data() - previousData), value.size());
+							}
+						}
+					}
+
+					return m_source.data() + previousSize;
+				}
+
+				void HttpHeaderCollection::TrimSource(const size_t length)
+				{
+					if (length < m_source.size())
+					{
+						// Shrinking never moves the buffer, so no views are affected.
+						m_source.resize(length);
+					}
+				}
+
+				const size_t HttpHeaderCollection::GetSourceSize() const
+				{
+					return m_source.size();
+				}
+
+				const bool HttpHeaderCollection::OnParsedName(const char* at, const size_t length)
+				{
+					if (m_parseState == ParseState::Name)
+					{
+						// The parser split the name across two calls. Since the source buffer is
+						// only ever appended to, the second piece must directly follow the first.
+						auto& entry = m_entries.back();
+
+						if (entry.header.first.data() + entry.header.first.size() != at)
+						{
+							return false;
+						}
+
+						entry.header.first = boost::string_ref(entry.header.first.data(), entry.header.first.size() + length);
+						entry.nameHash = util::http::ContinueHeaderNameHash(entry.nameHash, at, length);
+
+						ResolveId(m_entries.size() - 1);
+
+						return true;
+					}
+
+					Entry entry;
+					entry.header.first = boost::string_ref(at, length);
+					entry.nameHash = HashName(entry.header.first);
+					entry.inSource = true;
+
+					m_entries.push_back(entry);
+
+					ResolveId(m_entries.size() - 1);
+
+					m_parseState = ParseState::Name;
+
+					return true;
+				}
+
+				const bool HttpHeaderCollection::OnParsedValue(const char* at, const size_t length)
+				{
+					switch (m_parseState)
+					{
+						case ParseState::Name:
+						{
+							m_entries.back().header.second = boost::string_ref(at, length);
+							m_parseState = ParseState::Value;
+							return true;
+						}
+						break;
+
+						case ParseState::Value:
+						{
+							auto& value = m_entries.back().header.second;
+
+							if (value.data() + value.size() != at)
+							{
+								return false;
+							}
+
+							value = boost::string_ref(value.data(), value.size() + length);
+							return true;
+						}
+						break;
+
+						default:
+							return false;
+					}
+				}
+
+				void HttpHeaderCollection::Add(const boost::string_ref name, const boost::string_ref value, const bool replaceIfExists)
+				{
+					const auto nameHash = HashName(name);
+					const auto id = util::http::GetHeaderId(name, nameHash);
+
+					for (size_t i = (id != util::http::HeaderId::Unknown ? GetSearchStart(id) : 0); i < m_entries.size(); ++i)
+					{
+						if (!IsMatch(i, name, nameHash, id))
+						{
+							continue;
+						}
+
+						if (replaceIfExists)
+						{
+							// Since replaceIfExists is true, we want to remove all headers that have
+							// the same name before inserting the new header value.
+							m_entries[i].removed = true;
+						}
+						else if (EqualsIgnoreCase(m_entries[i].header.second, value))
+						{
+							// If the exact same header and value exist, we clearly don't want to add
+							// another.
+							return;
+						}
+					}
+
+					Entry entry;
+					entry.header.first = m_overlay.Store(name);
+					entry.header.second = m_overlay.Store(value);
+					entry.nameHash = nameHash;
+
+					m_entries.push_back(entry);
+
+					ResolveId(m_entries.size() - 1);
+
+					// Whatever the parser was in the middle of, it isn't at the back anymore.
+					m_parseState = ParseState::None;
+				}
+
+				void HttpHeaderCollection::Remove(const boost::string_ref name)
+				{
+					const auto nameHash = HashName(name);
+					const auto id = util::http::GetHeaderId(name, nameHash);
+
+					if (id != util::http::HeaderId::Unknown)
+					{
+						Remove(id);
+						return;
+					}
+
+					for (size_t i = 0; i < m_entries.size(); ++i)
+					{
+						if (IsMatch(i, name, nameHash, id))
+						{
+							m_entries[i].removed = true;
+						}
+					}
+				}
+
+				void HttpHeaderCollection::Remove(const util::http::HeaderId id)
+				{
+					for (size_t i = GetSearchStart(id); i < m_entries.size(); ++i)
+					{
+						if (!m_entries[i].removed && m_entries[i].id == id)
+						{
+							m_entries[i].removed = true;
+						}
+					}
+				}
+
+				void HttpHeaderCollection::Remove(const boost::string_ref name, const boost::string_ref value)
+				{
+					const auto nameHash = HashName(name);
+					const auto id = util::http::GetHeaderId(name, nameHash);
+
+					for (size_t i = (id != util::http::HeaderId::Unknown ? GetSearchStart(id) : 0); i < m_entries.size(); ++i)
+					{
+						// Must match exactly both key and value to qualify for removal
+						if (IsMatch(i, name, nameHash, id) && EqualsIgnoreCase(m_entries[i].header.second, value))
+						{
+							m_entries[i].removed = true;
+						}
+					}
+				}
+
+				const HttpHeaderRangeMatch HttpHeaderCollection::Find(const boost::string_ref name) const
+				{
+					const auto nameHash = HashName(name);
+					const auto id = util::http::GetHeaderId(name, nameHash);
+
+					if (id != util::http::HeaderId::Unknown)
+					{
+						return Find(id);
+					}
+
+					HttpHeaderConstIterator end(this, m_entries.size());
+
+					for (size_t i = 0; i < m_entries.size(); ++i)
+					{
+						if (IsMatch(i, name, nameHash, id))
+						{
+							return HttpHeaderRangeMatch(HttpHeaderConstIterator(this, i), end);
+						}
+					}
+
+					return HttpHeaderRangeMatch(end, end);
+				}
+
+				const HttpHeaderRangeMatch HttpHeaderCollection::Find(const util::http::HeaderId id) const
+				{
+					HttpHeaderConstIterator end(this, m_entries.size());
+
+					for (size_t i = GetSearchStart(id); i < m_entries.size(); ++i)
+					{
+						if (!m_entries[i].removed && m_entries[i].id == id)
+						{
+							return HttpHeaderRangeMatch(HttpHeaderConstIterator(this, i), end);
+						}
+					}
+
+					return HttpHeaderRangeMatch(end, end);
+				}
+
+				const size_t HttpHeaderCollection::GetSerializedSize() const
+				{
+					size_t size = 0;
+
+					for (const auto& entry : m_entries)
+					{
+						if (!entry.removed)
+						{
+							size += CrLf.size() + entry.header.first.size() + Separator.size() + entry.header.second.size();
+						}
+					}
+
+					return size;
+				}
+
+				void HttpHeaderCollection::ResolveId(const size_t index)
+				{
+					auto& entry = m_entries[index];
+
+					entry.id = util::http::GetHeaderId(entry.header.first, entry.nameHash);
+
+					if (entry.id == util::http::HeaderId::Unknown)
+					{
+						return;
+					}
+
+					auto& first = m_firstById[static_cast<size_t>(entry.id)];
+
+					if (first == 0)
+					{
+						first = static_cast<uint16_t>(index + 1 < UnindexedEntry ? index + 1 : UnindexedEntry);
+					}
+				}
+
+				const size_t HttpHeaderCollection::GetSearchStart(const util::http::HeaderId id) const
+				{
+					const auto first = m_firstById[static_cast<size_t>(id)];
+
+					if (first == 0)
+					{
+						return m_entries.size();
+					}
+
+					return first == UnindexedEntry ? 0 : static_cast<size_t>(first - 1);
+				}
+
+				const bool HttpHeaderCollection::IsMatch(const size_t index, const boost::string_ref name, const uint32_t nameHash, const util::http::HeaderId id) const
+				{
+					const auto& entry = m_entries[index];
+
+					if (entry.removed)
+					{
+						return false;
+					}
+
+					if (id != util::http::HeaderId::Unknown)
+					{
+						// Known names resolve to exactly one id, so there's nothing else to compare.
+						return entry.id == id;
+					}
+
+					return entry.nameHash == nameHash && EqualsIgnoreCase(entry.header.first, name);
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,526 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+#include "../../../util/http/KnownHttpHeaderIds.hpp"
+#include "../../../util/string/StringArena.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// A single HTTP header, name first and value second. Both members are views
+				/// into storage owned by the HttpHeaderCollection the header was fetched from,
+				/// so if you need to keep either around beyond the lifetime of the
+				/// transaction, or beyond the next modification of its headers, take a copy.
+				/// </summary>
+				typedef std::pair<boost::string_ref, boost::string_ref> HttpHeader;
+
+				/// <summary>
+				/// Forward decl for the iterator.
+				/// </summary>
+				class HttpHeaderCollection;
+
+				/// <summary>
+				/// Forward iterator which visits every header in a HttpHeaderCollection that
+				/// shares the name of the header it was created at, in the order in which they
+				/// were received or added. Removed headers are skipped.
+				/// </summary>
+				class HttpHeaderConstIterator
+				{
+
+				public:
+
+					typedef std::forward_iterator_tag iterator_category;
+					typedef const HttpHeader value_type;
+					typedef std::ptrdiff_t difference_type;
+					typedef const HttpHeader* pointer;
+					typedef const HttpHeader& reference;
+
+					/// <summary>
+					/// Constructs an iterator which is not associated with any collection.
+					/// </summary>
+					HttpHeaderConstIterator();
+
+					/// <summary>
+					/// Constructs an iterator positioned at the supplied entry.
+					/// </summary>
+					/// <param name="collection">
+					/// The collection being iterated.
+					/// </param>
+					/// <param name="index">
+					/// The index of the entry the iterator points to. Subsequent entries will only
+					/// be visited if they share the name of this entry. When equal to the number
+					/// of entries in the collection, the iterator is an end iterator.
+					/// </param>
+					HttpHeaderConstIterator(const HttpHeaderCollection* collection, const size_t index);
+
+					reference operator*() const;
+
+					pointer operator->() const;
+
+					HttpHeaderConstIterator& operator++();
+
+					HttpHeaderConstIterator operator++(int);
+
+					bool operator==(const HttpHeaderConstIterator& other) const;
+
+					bool operator!=(const HttpHeaderConstIterator& other) const;
+
+				private:
+
+					/// <summary>
+					/// Refreshes m_current from the entry at m_index.
+					/// </summary>
+					void Load();
+
+					/// <summary>
+					/// The collection being iterated.
+					/// </summary>
+					const HttpHeaderCollection* m_collection = nullptr;
+
+					/// <summary>
+					/// The index of the entry the iterator currently points to.
+					/// </summary>
+					size_t m_index = 0;
+
+					/// <summary>
+					/// The index of the entry the iterator was created at. Every other entry
+					/// visited must have the same name as this entry.
+					/// </summary>
+					size_t m_matchIndex = 0;
+
+					/// <summary>
+					/// The header currently pointed to.
+					/// </summary>
+					HttpHeader m_current;
+
+				};
+
+				/// <summary>
+				/// We need to be able to support multiple header entries by the same name, since
+				/// this is legal according to the spec. So, all methods that query against the
+				/// headers, looking for a specific entry, will return a range based match, rather
+				/// than a single string value.
+				/// </summary>
+				typedef std::pair<HttpHeaderConstIterator, HttpHeaderConstIterator> HttpHeaderRangeMatch;
+
+				/// <summary>
+				/// The HttpHeaderCollection stores the headers of a single HTTP transaction
+				/// without copying each name and value into its own string. The raw header block
+				/// read off the wire is kept in a single per-transaction source buffer, and the
+				/// http_parser callbacks simply record where each name and value begins and ends
+				/// within it. Entries are kept in a small flat vector in the order they arrived,
+				/// each carrying a case insensitive hash of its name computed once at parse time,
+				/// so a lookup is a linear walk comparing integers, with a full case insensitive
+				/// compare only on a hash hit. Real world transactions rarely carry more than a
+				/// couple of dozen headers, which makes this considerably cheaper than any kind of
+				/// tree or hash table.
+				///
+				/// Names found in KnownHttpHeaders.hpp are additionally resolved to their
+				/// util::http::HeaderId while parsing, which costs a single name compare thanks to
+				/// the perfect hash in KnownHttpHeaderIds.hpp. The collection remembers where the
+				/// first header with each id lives, so lookups by id skip straight to it and
+				/// never compare a string.
+				///
+				/// Modifications never touch the source buffer. Added headers are copied into a
+				/// small overlay arena and appended as new entries, and removed headers are
+				/// simply flagged as such, so views already handed out remain valid.
+				///
+				/// This class is not thread safe, just like the transaction that owns it.
+				/// </summary>
+				class HttpHeaderCollection
+				{
+
+					friend class HttpHeaderConstIterator;
+
+				public:
+
+					HttpHeaderCollection();
+
+					/// <summary>
+					/// No copy no move no thx. Entries hold views into the source buffer.
+					/// </summary>
+					HttpHeaderCollection(const HttpHeaderCollection&) = delete;
+					HttpHeaderCollection(HttpHeaderCollection&&) = delete;
+					HttpHeaderCollection& operator=(const HttpHeaderCollection&) = delete;
+
+					~HttpHeaderCollection();
+
+					/// <summary>
+					/// Computes the case insensitive hash of a header name, as stored alongside
+					/// every entry.
+					/// </summary>
+					/// <param name="name">
+					/// The header name to hash.
+					/// </param>
+					/// <returns>
+					/// The case insensitive hash of the name.
+					/// </returns>
+					static const uint32_t HashName(const boost::string_ref name);
+
+					/// <summary>
+					/// Removes every header, including any added to the overlay. The source buffer
+					/// is deliberately left alone, because this is called by the http_parser
+					/// callbacks while the parser is still reading from the source buffer.
+					/// </summary>
+					void Clear();
+
+					/// <summary>
+					/// Prepares the collection for a brand new transaction. Removes every header
+					/// and empties the source buffer. The storage of the source buffer, the entry
+					/// vector and the overlay is kept for reuse, unless it grew larger than the
+					/// supplied capacity, in which case it's released.
+					/// </summary>
+					/// <param name="retainedCapacity">
+					/// The maximum number of bytes of source buffer and entry storage to hold on
+					/// to, each.
+					/// </param>
+					void Reset(const size_t retainedCapacity);
+
+					/// <summary>
+					/// Grows the source buffer by the supplied number of bytes, so that more raw
+					/// header data can be copied in and parsed. If growing the buffer forces it to
+					/// move, every entry that views the source buffer is rebased onto the new
+					/// storage.
+					/// </summary>
+					/// <param name="length">
+					/// The number of bytes to make room for.
+					/// </param>
+					/// <returns>
+					/// Pointer to the start of the newly added space, where exactly length bytes
+					/// must be written.
+					/// </returns>
+					char* PrepareSource(const size_t length);
+
+					/// <summary>
+					/// Shrinks the source buffer to the supplied size. Used to drop payload data
+					/// that was read in along with the headers, once it has been copied out. The
+					/// dropped bytes must not be viewed by any entry.
+					/// </summary>
+					/// <param name="length">
+					/// The new size of the source buffer.
+					/// </param>
+					void TrimSource(const size_t length);
+
+					/// <summary>
+					/// Gets the number of bytes held in the source buffer.
+					/// </summary>
+					/// <returns>
+					/// The number of bytes held in the source buffer.
+					/// </returns>
+					const size_t GetSourceSize() const;
+
+					/// <summary>
+					/// Records a header name, or a piece of one, reported by the http_parser. The
+					/// supplied data must lie within the source buffer.
+					/// </summary>
+					/// <param name="at">
+					/// Pointer to the name within the source buffer.
+					/// </param>
+					/// <param name="length">
+					/// The length of the name.
+					/// </param>
+					/// <returns>
+					/// True if the name was recorded, false if the data did not continue the name
+					/// currently being parsed when it had to.
+					/// </returns>
+					const bool OnParsedName(const char* at, const size_t length);
+
+					/// <summary>
+					/// Records a header value, or a piece of one, reported by the http_parser. The
+					/// supplied data must lie within the source buffer.
+					/// </summary>
+					/// <param name="at">
+					/// Pointer to the value within the source buffer.
+					/// </param>
+					/// <param name="length">
+					/// The length of the value.
+					/// </param>
+					/// <returns>
+					/// True if the value was recorded, false if no name preceded it or the data
+					/// did not continue the value currently being parsed when it had to.
+					/// </returns>
+					const bool OnParsedValue(const char* at, const size_t length);
+
+					/// <summary>
+					/// Adds a header to the overlay.
+					/// </summary>
+					/// <param name="name">
+					/// The name of the header to add.
+					/// </param>
+					/// <param name="value">
+					/// The value of the header to add.
+					/// </param>
+					/// <param name="replaceIfExists">
+					/// If true, all existing headers by the same name are removed first. If false,
+					/// the header is only added when no header by the same name already has the
+					/// exact same value.
+					/// </param>
+					void Add(const boost::string_ref name, const boost::string_ref value, const bool replaceIfExists);
+
+					/// <summary>
+					/// Removes all headers by the supplied name, case insensitive.
+					/// </summary>
+					/// <param name="name">
+					/// The name of the headers to remove.
+					/// </param>
+					void Remove(const boost::string_ref name);
+
+					/// <summary>
+					/// Removes all headers that exactly match the supplied name and value, case
+					/// insensitive.
+					/// </summary>
+					/// <param name="name">
+					/// The name of the headers to remove.
+					/// </param>
+					/// <param name="value">
+					/// The value the headers must have to be removed.
+					/// </param>
+					void Remove(const boost::string_ref name, const boost::string_ref value);
+
+					/// <summary>
+					/// Finds all headers by the supplied name, case insensitive.
+					/// </summary>
+					/// <param name="name">
+					/// The name of the headers to find.
+					/// </param>
+					/// <returns>
+					/// A range which may contain zero or more entries.
+					/// </returns>
+					const HttpHeaderRangeMatch Find(const boost::string_ref name) const;
+
+					/// <summary>
+					/// Finds all headers with the supplied id.
+					/// </summary>
+					/// <param name="id">
+					/// The id of the headers to find. Must not be HeaderId::Unknown.
+					/// </param>
+					/// <returns>
+					/// A range which may contain zero or more entries.
+					/// </returns>
+					const HttpHeaderRangeMatch Find(const util::http::HeaderId id) const;
+
+					/// <summary>
+					/// Removes all headers with the supplied id.
+					/// </summary>
+					/// <param name="id">
+					/// The id of the headers to remove. Must not be HeaderId::Unknown.
+					/// </param>
+					void Remove(const util::http::HeaderId id);
+
+					/// <summary>
+					/// Gets the exact number of bytes ::Serialize(...) will write.
+					/// </summary>
+					/// <returns>
+					/// The serialized size of all headers.
+					/// </returns>
+					const size_t GetSerializedSize() const;
+
+					/// <summary>
+					/// Appends every header, each preceeded by a CRLF, to the supplied container.
+					/// Callers should reserve ::GetSerializedSize() bytes beforehand, so that the
+					/// entire header block is written in a single pass without reallocating.
+					/// </summary>
+					/// <param name="out">
+					/// The container to append to. Either std::string or std::vector of char.
+					/// </param>
+					template<typename Container>
+					void Serialize(Container& out) const
+					{
+						for (const auto& entry : m_entries)
+						{
+							if (entry.removed)
+							{
+								continue;
+							}
+
+							out.insert(out.end(), CrLf.begin(), CrLf.end());
+							out.insert(out.end(), entry.header.first.begin(), entry.header.first.end());
+							out.insert(out.end(), Separator.begin(), Separator.end());
+							out.insert(out.end(), entry.header.second.begin(), entry.header.second.end());
+						}
+					}
+
+				private:
+
+					/// <summary>
+					/// What the parser reported last, so that names and values split across
+					/// multiple parser callbacks can be stitched back together.
+					/// </summary>
+					enum class ParseState : uint8_t
+					{
+						None,
+						Name,
+						Value
+					};
+
+					/// <summary>
+					/// A single stored header.
+					/// </summary>
+					struct Entry
+					{
+						/// <summary>
+						/// The header name and value.
+						/// </summary>
+						HttpHeader header;
+
+						/// <summary>
+						/// Case insensitive hash of the header name.
+						/// </summary>
+						uint32_t nameHash = 0;
+
+						/// <summary>
+						/// The id of the header name, if it's a known header.
+						/// </summary>
+						util::http::HeaderId id = util::http::HeaderId::Unknown;
+
+						/// <summary>
+						/// Whether or not the header views the source buffer. If not, it views the
+						/// overlay.
+						/// </summary>
+						bool inSource = false;
+
+						/// <summary>
+						/// Whether or not the header has been removed.
+						/// </summary>
+						bool removed = false;
+					};
+
+					/// <summary>
+					/// Inserted between every header.
+					/// </summary>
+					static const boost::string_ref CrLf;
+
+					/// <summary>
+					/// Inserted between every header name and value.
+					/// </summary>
+					static const boost::string_ref Separator;
+
+					/// <summary>
+					/// Block size of the overlay arena. Modifications are few and small.
+					/// </summary>
+					static constexpr size_t OverlayBlockSize = 1024;
+
+					/// <summary>
+					/// Stored in m_firstById when the first header with an id sits at an index too
+					/// large to record, meaning the search has to start from the beginning.
+					/// </summary>
+					static constexpr uint16_t UnindexedEntry = 0xFFFF;
+
+					/// <summary>
+					/// Resolves the id of the entry at the supplied index from its name and hash,
+					/// and records the entry as the first with that id if no other has been.
+					/// </summary>
+					/// <param name="index">
+					/// The index of the entry.
+					/// </param>
+					void ResolveId(const size_t index);
+
+					/// <summary>
+					/// Gets the index to begin searching from for headers with the supplied id.
+					/// </summary>
+					/// <param name="id">
+					/// The id to search for.
+					/// </param>
+					/// <returns>
+					/// The index of the first entry that could have the supplied id, or the number
+					/// of entries if there is none.
+					/// </returns>
+					const size_t GetSearchStart(const util::http::HeaderId id) const;
+
+					/// <summary>
+					/// Determines if the entry at the supplied index is live and has the supplied
+					/// name.
+					/// </summary>
+					/// <param name="index">
+					/// The index of the entry.
+					/// </param>
+					/// <param name="name">
+					/// The name to compare against.
+					/// </param>
+					/// <param name="nameHash">
+					/// The hash of the name to compare against.
+					/// </param>
+					/// <param name="id">
+					/// The id of the name to compare against. When known, only ids are compared.
+					/// </param>
+					/// <returns>
+					/// True if the entry is live and matches the supplied name.
+					/// </returns>
+					const bool IsMatch(const size_t index, const boost::string_ref name, const uint32_t nameHash, const util::http::HeaderId id) const;
+
+					/// <summary>
+					/// The raw header data read off the wire, which parsed entries view.
+					/// </summary>
+					std::vector<char> m_source;
+
+					/// <summary>
+					/// Storage for the names and values of added headers.
+					/// </summary>
+					util::string::StringArena m_overlay;
+
+					/// <summary>
+					/// All headers, live or removed, in the order they were received or added.
+					/// </summary>
+					std::vector<Entry> m_entries;
+
+					/// <summary>
+					/// For every header id, one plus the index of the first entry that was ever
+					/// given that id, or zero if no entry has been.
+					/// </summary>
+					std::array<uint16_t, util::http::HeaderIdCount> m_firstById;
+
+					/// <summary>
+					/// What the parser reported last.
+					/// </summary>
+					ParseState m_parseState = ParseState::None;
+
+				};
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -73,43 +73,62 @@ namespace te
 					m_requestMethod = method;
 				}
 
-				std::string HttpRequest::HeadersToString() const
+				void HttpRequest::Reset()
 				{
-					std::string ret;
+					BaseHttpTransaction::Reset();
 
-					ret.append(http_method_str(m_requestMethod));
-					ret.append(u8" ");
+					m_requestURI.clear();
+				}
+
+				template<typename Container>
+				void HttpRequest::WriteHeaders(Container& out) const
+				{
+					const boost::string_ref method(http_method_str(m_requestMethod));
+					const boost::string_ref terminator(u8"\r\n\r\n");
 
-					ret.append(m_requestURI);
+					boost::string_ref version;
 
 					if (m_httpVersion == HttpProtocolVersion::HTTP1)
 					{
-						ret.append(u8" HTTP/1.0");
+						version = u8" HTTP/1.0";
 					}
 					else if (m_httpVersion == HttpProtocolVersion::HTTP1_1)
 					{
-						ret.append(u8" HTTP/1.1");
+						version = u8" HTTP/1.1";
 					}
 					else if (m_httpVersion == HttpProtocolVersion::HTTP2)
 					{
-						ret.append(u8" HTTP/2.0");
+						version = u8" HTTP/2.0";
 					}
 
-					for (auto header = m_headers.begin(); header != m_headers.end(); ++header)
-					{
-						ret.append(u8"\r\n").append(header->first).append(u8": ").append(header->second);
-					}
+					out.reserve(out.size() + method.size() + 1 + m_requestURI.size() + version.size() + m_headers.GetSerializedSize() + terminator.size());
 
-					ret.append(u8"\r\n\r\n");
+					out.insert(out.end(), method.begin(), method.end());
+					out.push_back(' ');
+					out.insert(out.end(), m_requestURI.begin(), m_requestURI.end());
+					out.insert(out.end(), version.begin(), version.end());
+
+					m_headers.Serialize(out);
+
+					out.insert(out.end(), terminator.begin(), terminator.end());
+				}
+
+				std::string HttpRequest::HeadersToString() const
+				{
+					std::string ret;
+
+					WriteHeaders(ret);
 
 					return ret;
 				}
 
 				std::vector<char> HttpRequest::HeadersToVector() const
 				{
-					std::string headersAsString = HeadersToString();
+					std::vector<char> ret;
 
-					return std::vector<char>(headersAsString.begin(), headersAsString.end());
+					WriteHeaders(ret);
+
+					return ret;
 				}
 
 				int HttpRequest::OnUrl(http_parser* parser, const char *at, size_t length)
@@ -104,6 +104,12 @@ namespace te
 					/// </param>
 					void Method(const HttpRequestMethod method);
 
+					/// <summary>
+					/// Resets the transaction for reuse, additionally clearing the request URI.
+					/// See BaseHttpTransaction::Reset().
+					/// </summary>
+					virtual void Reset() override;
+
 					/// <summary>
 					/// Convenience function for formatting the transaction headers into a
 					/// std::string container.
@@ -136,6 +142,17 @@ namespace te
 					/// </summary>
 					HttpRequestMethod m_requestMethod;
 
+					/// <summary>
+					/// Writes the complete, formatted transaction headers to the supplied
+					/// container in a single pass. The exact size of the output is computed up
+					/// front and reserved, so the container is allocated exactly once.
+					/// </summary>
+					/// <param name="out">
+					/// The container to write to. Either std::string or std::vector of char.
+					/// </param>
+					template<typename Container>
+					void WriteHeaders(Container& out) const;
+
 					/// <summary>
 					/// Called when the url read has been completed by http_parser. 
 					/// </summary>
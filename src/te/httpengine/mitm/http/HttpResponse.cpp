@@ -92,27 +92,44 @@ namespace te
 					m_statusString = status;
 				}
 
-				std::string HttpResponse::HeadersToString() const
+				void HttpResponse::Reset()
 				{
-					std::string ret;
+					BaseHttpTransaction::Reset();
 
-					ret.append(m_statusString);					
+					m_statusCode = 0;
+					m_statusString.clear();
+				}
 
-					for (auto header = m_headers.begin(); header != m_headers.end(); ++header)
-					{
-						ret.append(u8"\r\n").append(header->first).append(u8": ").append(header->second);
-					}
+				template<typename Container>
+				void HttpResponse::WriteHeaders(Container& out) const
+				{
+					const boost::string_ref terminator(u8"\r\n\r\n");
+
+					out.reserve(out.size() + m_statusString.size() + m_headers.GetSerializedSize() + terminator.size());
+
+					out.insert(out.end(), m_statusString.begin(), m_statusString.end());
 
-					ret.append(u8"\r\n\r\n");
+					m_headers.Serialize(out);
+
+					out.insert(out.end(), terminator.begin(), terminator.end());
+				}
+
+				std::string HttpResponse::HeadersToString() const
+				{
+					std::string ret;
+
+					WriteHeaders(ret);
 
 					return ret;
 				}
 
 				std::vector<char> HttpResponse::HeadersToVector() const
 				{
-					std::string headersAsString = HeadersToString();
+					std::vector<char> ret;
 
-					return std::vector<char>(headersAsString.begin(), headersAsString.end());
+					WriteHeaders(ret);
+
+					return ret;
 				}
 
 				int HttpResponse::OnStatus(http_parser* parser, const char *at, size_t length)
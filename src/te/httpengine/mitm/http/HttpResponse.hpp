@@ -129,6 +129,12 @@ namespace te
 					/// </param>
 					void StatusString(const std::string& status);
 
+					/// <summary>
+					/// Resets the transaction for reuse, additionally clearing the status code and
+					/// status string. See BaseHttpTransaction::Reset().
+					/// </summary>
+					virtual void Reset() override;
+
 					/// <summary>
 					/// Convenience function for formatting the transaction headers into a
 					/// std::string container.
@@ -162,6 +168,17 @@ namespace te
 					/// </summary>
 					std::string m_statusString;
 
+					/// <summary>
+					/// Writes the complete, formatted transaction headers to the supplied
+					/// container in a single pass. The exact size of the output is computed up
+					/// front and reserved, so the container is allocated exactly once.
+					/// </summary>
+					/// <param name="out">
+					/// The container to write to. Either std::string or std::vector of char.
+					/// </param>
+					template<typename Container>
+					void WriteHeaders(Container& out) const;
+
 					/// <summary>
 					/// Called when the status read been completed by the http_parser.
 					/// </summary>
@@ -0,0 +1,354 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PayloadMemory.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <boost/predef/os.h>
+
+#if BOOST_OS_WINDOWS
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif // if BOOST_OS_WINDOWS
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					/// <summary>
+					/// Sits in front of every block handed out, recording where the block came
+					/// from, so that it can be given back the same way.
+					/// </summary>
+					struct BlockHeader
+					{
+						/// <summary>
+						/// Whether or not the block lives in a temporary file mapping.
+						/// </summary>
+						bool spilled;
+
+						/// <summary>
+						/// The handle of the temporary file, on Windows. The file is marked for
+						/// deletion on close, so it must be held until the view is unmapped.
+						/// </summary>
+						void* file;
+					};
+
+					/// <summary>
+					/// Space reserved in front of every block for its header. Generous enough to
+					/// keep the block itself aligned for anything.
+					/// </summary>
+					constexpr size_t HeaderSize = 32;
+
+					static_assert(sizeof(BlockHeader) <= HeaderSize, "BlockHeader does not fit in HeaderSize.");
+
+					/// <summary>
+					/// See PayloadMemory::SetSpillThreshold(...).
+					/// </summary>
+					std::atomic<size_t> SpillThreshold{ PayloadMemory::DefaultSpillThreshold };
+
+					/// <summary>
+					/// See PayloadMemory::SetMemoryBudget(...).
+					/// </summary>
+					std::atomic<size_t> MemoryBudget{ PayloadMemory::DefaultMemoryBudget };
+
+					/// <summary>
+					/// See PayloadMemory::GetMemoryInUse().
+					/// </summary>
+					std::atomic<size_t> MemoryInUse{ 0 };
+
+					/// <summary>
+					/// See PayloadMemory::GetSpilledInUse().
+					/// </summary>
+					std::atomic<size_t> SpilledInUse{ 0 };
+
+					/// <summary>
+					/// Maps a fresh, already deleted temporary file of the supplied size.
+					/// </summary>
+					/// <param name="size">
+					/// The size of the mapping.
+					/// </param>
+					/// <param name="file">
+					/// Receives the file handle that must be kept until the mapping is released,
+					/// or null where none is needed.
+					/// </param>
+					/// <returns>
+					/// The mapping, or null on failure.
+					/// </returns>
+					char* MapTemporaryFile(const size_t size, void*& file)
+					{
+						file = nullptr;
+
+						#if BOOST_OS_WINDOWS
+
+						wchar_t directory[MAX_PATH + 1];
+						wchar_t path[MAX_PATH + 1];
+
+						if (GetTempPathW(MAX_PATH + 1, directory) == 0 || GetTempFileNameW(directory, L"hfe", 0, path) == 0)
+						{
+							return nullptr;
+						}
+
+						HANDLE handle = CreateFileW(
+							path,
+							GENERIC_READ | GENERIC_WRITE,
+							0,
+							nullptr,
+							CREATE_ALWAYS,
+							FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+							nullptr);
+
+						if (handle == INVALID_HANDLE_VALUE)
+						{
+							DeleteFileW(path);
+							return nullptr;
+						}
+
+						const unsigned long long mappingSize = static_cast<unsigned long long>(size);
+
+						HANDLE mapping = CreateFileMappingW(
+							handle,
+							nullptr,
+							PAGE_READWRITE,
+							static_cast<DWORD>(mappingSize >> 32),
+							static_cast<DWORD>(mappingSize & 0xFFFFFFFF),
+							nullptr);
+
+						if (mapping == nullptr)
+						{
+							CloseHandle(handle);
+							return nullptr;
+						}
+
+						void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+						// The view keeps the mapping object alive by itself.
+						CloseHandle(mapping);
+
+						if (view == nullptr)
+						{
+							CloseHandle(handle);
+							return nullptr;
+						}
+
+						file = handle;
+
+						return static_cast<char*>(view);
+
+						#else
+
+						const char* directory = std::getenv("TMPDIR");
+
+						std::string path(directory != nullptr && directory[0] != '\0' ? directory : "/tmp");
+						path.append("/hfe-payload-XXXXXX");
+
+						const int descriptor = mkstemp(&path[0]);
+
+						if (descriptor == -1)
+						{
+							return nullptr;
+						}
+
+						// The file lives on only for as long as the descriptor and mapping do.
+						unlink(path.c_str());
+
+						if (ftruncate(descriptor, static_cast<off_t>(size)) != 0)
+						{
+							close(descriptor);
+							return nullptr;
+						}
+
+						void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+
+						// The mapping keeps the file alive by itself.
+						close(descriptor);
+
+						if (view == MAP_FAILED)
+						{
+							return nullptr;
+						}
+
+						return static_cast<char*>(view);
+
+						#endif // if BOOST_OS_WINDOWS
+					}
+
+					/// <summary>
+					/// Releases a mapping given by ::MapTemporaryFile(...), and with it, the file.
+					/// </summary>
+					/// <param name="view">
+					/// The mapping.
+					/// </param>
+					/// <param name="size">
+					/// The size of the mapping.
+					/// </param>
+					/// <param name="file">
+					/// The file handle given along with the mapping.
+					/// </param>
+					void UnmapTemporaryFile(char* view, const size_t size, void* file)
+					{
+						#if BOOST_OS_WINDOWS
+
+						(void)size;
+
+						UnmapViewOfFile(view);
+
+						if (file != nullptr)
+						{
+							CloseHandle(file);
+						}
+
+						#else
+
+						// The whole mapping goes with the view, there's no handle to close.
+						(void)file;
+
+						munmap(view, size);
+
+						#endif // if BOOST_OS_WINDOWS
+					}
+				}
+
+				void PayloadMemory::SetSpillThreshold(const size_t bytes)
+				{
+					SpillThreshold = bytes;
+				}
+
+				const size_t PayloadMemory::GetSpillThreshold()
+				{
+					return SpillThreshold;
+				}
+
+				void PayloadMemory::SetMemoryBudget(const size_t bytes)
+				{
+					MemoryBudget = bytes;
+				}
+
+				const size_t PayloadMemory::GetMemoryBudget()
+				{
+					return MemoryBudget;
+				}
+
+				const size_t PayloadMemory::GetMemoryInUse()
+				{
+					return MemoryInUse;
+				}
+
+				const size_t PayloadMemory::GetSpilledInUse()
+				{
+					return SpilledInUse;
+				}
+
+				void* PayloadMemory::Allocate(const size_t size)
+				{
+					const size_t spillThreshold = SpillThreshold;
+
+					// The budget is only checked, not reserved, so concurrent allocations can
+					// overshoot it slightly. That's fine, it's a ceiling on growth, not a hard
+					// limit.
+					const bool spill =
+						spillThreshold > 0 &&
+						size >= MinimumSpillSize &&
+						(size >= spillThreshold || MemoryInUse + size > MemoryBudget);
+
+					if (spill)
+					{
+						void* file = nullptr;
+
+						char* view = MapTemporaryFile(HeaderSize + size, file);
+
+						if (view != nullptr)
+						{
+							BlockHeader* header = reinterpret_cast<BlockHeader*>(view);
+							header->spilled = true;
+							header->file = file;
+
+							SpilledInUse += size;
+
+							return view + HeaderSize;
+						}
+
+						// Fall back to the heap. Better to go over budget than to fail outright.
+					}
+
+					char* block = static_cast<char*>(::operator new(HeaderSize + size));
+
+					BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+					header->spilled = false;
+					header->file = nullptr;
+
+					MemoryInUse += size;
+
+					return block + HeaderSize;
+				}
+
+				void PayloadMemory::Free(void* block, const size_t size)
+				{
+					if (block == nullptr)
+					{
+						return;
+					}
+
+					char* base = static_cast<char*>(block) - HeaderSize;
+
+					const BlockHeader* header = reinterpret_cast<const BlockHeader*>(base);
+
+					if (header->spilled)
+					{
+						SpilledInUse -= size;
+
+						UnmapTemporaryFile(base, HeaderSize + size, header->file);
+						return;
+					}
+
+					MemoryInUse -= size;
+
+					::operator delete(base);
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
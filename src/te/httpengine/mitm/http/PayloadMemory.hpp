@@ -0,0 +1,227 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Supplies the memory behind every payload buffer, and keeps the books on it.
+				///
+				/// All payload buffers, across every bridge, draw against a single in-memory
+				/// budget. Small allocations always come from the heap. Large ones, being a
+				/// payload collected for inspection that has grown beyond the spill threshold,
+				/// or any sizeable allocation made while the budget is exhausted, are instead
+				/// backed by a temporary file that is deleted as soon as it is created (or
+				/// marked for deletion on close, on Windows) and mapped into memory. The data
+				/// is still reached through an ordinary pointer, so nothing that inspects a
+				/// payload needs to know where it lives, but the operating system is free to
+				/// page it out to disk rather than keeping it resident.
+				///
+				/// Should a temporary file fail to be created or mapped, the allocation simply
+				/// falls back to the heap.
+				/// </summary>
+				class PayloadMemory
+				{
+
+				public:
+
+					/// <summary>
+					/// Default size, in bytes, of a single allocation beyond which the allocation
+					/// is backed by a temporary file. See ::SetSpillThreshold(...).
+					/// </summary>
+					static constexpr size_t DefaultSpillThreshold = 2097152;
+
+					/// <summary>
+					/// Default number of bytes that payload buffers may take from the heap, across
+					/// all transactions. See ::SetMemoryBudget(...).
+					/// </summary>
+					static constexpr size_t DefaultMemoryBudget = 268435456;
+
+					/// <summary>
+					/// Allocations smaller than this always come from the heap, even when the
+					/// budget is exhausted. A temporary file per read buffer would cost far more
+					/// than it saves.
+					/// </summary>
+					static constexpr size_t MinimumSpillSize = 262144;
+
+					/// <summary>
+					/// No construction, everything here is static.
+					/// </summary>
+					PayloadMemory() = delete;
+
+					/// <summary>
+					/// Sets the size, in bytes, of a single allocation beyond which the allocation
+					/// is backed by a temporary file rather than the heap. Setting zero disables
+					/// spilling to disk entirely, budget or no budget.
+					/// </summary>
+					/// <param name="bytes">
+					/// The spill threshold.
+					/// </param>
+					static void SetSpillThreshold(const size_t bytes);
+
+					/// <summary>
+					/// Gets the size, in bytes, of a single allocation beyond which the allocation
+					/// is backed by a temporary file.
+					/// </summary>
+					/// <returns>
+					/// The spill threshold. Zero if spilling is disabled.
+					/// </returns>
+					static const size_t GetSpillThreshold();
+
+					/// <summary>
+					/// Sets the number of bytes that payload buffers may take from the heap, across
+					/// all transactions. Once this is used up, any allocation of at least
+					/// MinimumSpillSize is backed by a temporary file, regardless of the spill
+					/// threshold.
+					/// </summary>
+					/// <param name="bytes">
+					/// The memory budget.
+					/// </param>
+					static void SetMemoryBudget(const size_t bytes);
+
+					/// <summary>
+					/// Gets the number of bytes that payload buffers may take from the heap, across
+					/// all transactions.
+					/// </summary>
+					/// <returns>
+					/// The memory budget.
+					/// </returns>
+					static const size_t GetMemoryBudget();
+
+					/// <summary>
+					/// Gets the number of bytes that payload buffers currently hold on the heap.
+					/// </summary>
+					/// <returns>
+					/// The number of heap bytes in use.
+					/// </returns>
+					static const size_t GetMemoryInUse();
+
+					/// <summary>
+					/// Gets the number of bytes that payload buffers currently hold in temporary
+					/// files.
+					/// </summary>
+					/// <returns>
+					/// The number of spilled bytes in use.
+					/// </returns>
+					static const size_t GetSpilledInUse();
+
+					/// <summary>
+					/// Allocates a block of payload memory.
+					/// </summary>
+					/// <param name="size">
+					/// The size of the block.
+					/// </param>
+					/// <returns>
+					/// The block. Never null, std::bad_alloc is thrown on failure.
+					/// </returns>
+					static void* Allocate(const size_t size);
+
+					/// <summary>
+					/// Frees a block given by ::Allocate(...).
+					/// </summary>
+					/// <param name="block">
+					/// The block.
+					/// </param>
+					/// <param name="size">
+					/// The size the block was allocated with.
+					/// </param>
+					static void Free(void* block, const size_t size);
+
+				};
+
+				/// <summary>
+				/// Standard allocator that draws from PayloadMemory.
+				/// </summary>
+				template<typename T>
+				class PayloadAllocator
+				{
+
+				public:
+
+					typedef T value_type;
+
+					PayloadAllocator()
+					{
+
+					}
+
+					template<typename U>
+					PayloadAllocator(const PayloadAllocator<U>&)
+					{
+
+					}
+
+					T* allocate(const size_t count)
+					{
+						return static_cast<T*>(PayloadMemory::Allocate(count * sizeof(T)));
+					}
+
+					void deallocate(T* block, const size_t count)
+					{
+						PayloadMemory::Free(block, count * sizeof(T));
+					}
+
+				};
+
+				template<typename T, typename U>
+				inline bool operator==(const PayloadAllocator<T>&, const PayloadAllocator<U>&)
+				{
+					return true;
+				}
+
+				template<typename T, typename U>
+				inline bool operator!=(const PayloadAllocator<T>&, const PayloadAllocator<U>&)
+				{
+					return false;
+				}
+
+				/// <summary>
+				/// The container for all payload data, whether as read off the wire, decoded
+				/// or encoded.
+				/// </summary>
+				typedef std::vector<char, PayloadAllocator<char>> PayloadBuffer;
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,240 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ZlibContentDecoder.hpp"
+#include <cstring>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					/// <summary>
+					/// Window bits for gzip or zlib wrapped data, detected automatically.
+					/// </summary>
+					constexpr int AutoDetectWindowBits = MAX_WBITS + 32;
+
+					/// <summary>
+					/// Window bits for raw deflate data.
+					/// </summary>
+					constexpr int RawDeflateWindowBits = -MAX_WBITS;
+
+					/// <summary>
+					/// The first byte of every gzip member.
+					/// </summary>
+					constexpr unsigned char GzipMagic = 0x1f;
+				}
+
+				ZlibContentDecoder::ZlibContentDecoder(const size_t maxOutputSize)
+					:
+					BaseContentDecoder(maxOutputSize)
+				{
+					std::memset(&m_stream, 0, sizeof(m_stream));
+
+					m_initialized = inflateInit2(&m_stream, AutoDetectWindowBits) == Z_OK;
+				}
+
+				ZlibContentDecoder::~ZlibContentDecoder()
+				{
+					if (m_initialized)
+					{
+						inflateEnd(&m_stream);
+					}
+				}
+
+				void ZlibContentDecoder::SetFormat(const Format format)
+				{
+					m_format = format;
+
+					Reset();
+				}
+
+				const bool ZlibContentDecoder::Decode(const char* data, const size_t length, PayloadBuffer& output)
+				{
+					if (!m_initialized)
+					{
+						return false;
+					}
+
+					if (length == 0)
+					{
+						return true;
+					}
+
+					if (m_complete)
+					{
+						// Anything following the end of a gzip member is either another member, or
+						// junk that some servers pad the body with. Junk is ignored, just as zlib's
+						// own gzip utilities do.
+						if (m_format != Format::Gzip || static_cast<unsigned char>(data[0]) != GzipMagic || !ResetStream(AutoDetectWindowBits))
+						{
+							return true;
+						}
+
+						m_complete = false;
+					}
+
+					const size_t previousInputSize = m_inputSize;
+					const size_t initialOutputSize = output.size();
+
+					if (m_inputSize < ZlibHeaderSize)
+					{
+						const size_t missingHeaderBytes = ZlibHeaderSize - m_inputSize;
+						const size_t headerBytes = length < missingHeaderBytes ? length : missingHeaderBytes;
+						std::memcpy(m_headerInput + m_inputSize, data, headerBytes);
+					}
+
+					m_inputSize += length;
+
+					// zlib's interface predates const correctness, but it never writes to the input.
+					m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+					m_stream.avail_in = static_cast<uInt>(length);
+
+					for (;;)
+					{
+						const size_t used = output.size();
+
+						if (used >= m_maxOutputSize)
+						{
+							return false;
+						}
+
+						size_t available = m_maxOutputSize - used;
+
+						if (available > OutputStepSize)
+						{
+							available = OutputStepSize;
+						}
+
+						output.resize(used + available);
+
+						m_stream.next_out = reinterpret_cast<Bytef*>(output.data() + used);
+						m_stream.avail_out = static_cast<uInt>(available);
+
+						const int ret = inflate(&m_stream, Z_NO_FLUSH);
+
+						output.resize(used + (available - m_stream.avail_out));
+
+						if (ret == Z_STREAM_END)
+						{
+							if (m_format == Format::Gzip && m_stream.avail_in > 0 && *m_stream.next_in == GzipMagic)
+							{
+								// Another gzip member follows.
+								if (!ResetStream(AutoDetectWindowBits))
+								{
+									return false;
+								}
+
+								continue;
+							}
+
+							m_complete = true;
+							return true;
+						}
+
+						if (ret == Z_DATA_ERROR && m_format == Format::Deflate && !m_rawDeflate && previousInputSize <= ZlibHeaderSize && output.size() == initialOutputSize)
+						{
+							// Failed the header check straight away. Start over, treating the
+							// payload as raw deflate. Whatever part of the header came in earlier
+							// calls has to be given again first.
+							if (!ResetStream(RawDeflateWindowBits))
+							{
+								return false;
+							}
+
+							m_rawDeflate = true;
+
+							if (previousInputSize > 0)
+							{
+								// These bytes are already held, so don't capture them again.
+								m_inputSize = ZlibHeaderSize;
+
+								if (!Decode(m_headerInput, previousInputSize, output))
+								{
+									return false;
+								}
+
+								m_inputSize = previousInputSize + length;
+							}
+
+							m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+							m_stream.avail_in = static_cast<uInt>(length);
+							continue;
+						}
+
+						if (ret != Z_OK && ret != Z_BUF_ERROR)
+						{
+							return false;
+						}
+
+						// inflate only stops short of filling the output when it has run out of
+						// input, so free space means everything available has been decoded.
+						if (m_stream.avail_out != 0)
+						{
+							return true;
+						}
+					}
+				}
+
+				const bool ZlibContentDecoder::IsComplete() const
+				{
+					return m_complete;
+				}
+
+				void ZlibContentDecoder::Reset()
+				{
+					m_rawDeflate = false;
+					m_inputSize = 0;
+					m_complete = false;
+
+					ResetStream(AutoDetectWindowBits);
+				}
+
+				const bool ZlibContentDecoder::ResetStream(const int windowBits)
+				{
+					if (!m_initialized)
+					{
+						return false;
+					}
+
+					return inflateReset2(&m_stream, windowBits) == Z_OK;
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,162 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <zlib.h>
+#include "BaseContentDecoder.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Streaming decoder for the gzip and deflate content encodings, built directly on
+				/// a zlib inflate stream. The inflate stream, including its 32 KB window, is
+				/// allocated once when the decoder is constructed and merely reset between
+				/// payloads.
+				///
+				/// Both formats are inflated with zlib's automatic header detection, so that a
+				/// gzip payload labelled deflate, or vice versa, still decodes. Since a great
+				/// many servers have historically sent raw deflate data without the zlib wrapper
+				/// that RFC 7230 calls for, a deflate payload that fails its header check is
+				/// retried as raw deflate. Payloads consisting of several concatenated gzip
+				/// members are decoded in their entirety.
+				/// </summary>
+				class ZlibContentDecoder : public BaseContentDecoder
+				{
+
+				public:
+
+					/// <summary>
+					/// The formats this decoder can handle.
+					/// </summary>
+					enum class Format : uint8_t
+					{
+						Gzip,
+						Deflate
+					};
+
+					/// <summary>
+					/// Constructs a new decoder, initially configured for gzip.
+					/// </summary>
+					/// <param name="maxOutputSize">
+					/// The maximum total number of bytes the decoder may produce for a single
+					/// payload.
+					/// </param>
+					ZlibContentDecoder(const size_t maxOutputSize);
+
+					/// <summary>
+					/// Releases the inflate stream.
+					/// </summary>
+					virtual ~ZlibContentDecoder();
+
+					/// <summary>
+					/// Resets the decoder and configures it for the supplied format.
+					/// </summary>
+					/// <param name="format">
+					/// The format of the next payload.
+					/// </param>
+					void SetFormat(const Format format);
+
+					virtual const bool Decode(const char* data, const size_t length, PayloadBuffer& output) override;
+
+					virtual const bool IsComplete() const override;
+
+					virtual void Reset() override;
+
+				private:
+
+					/// <summary>
+					/// Resets the inflate stream with the supplied window bits.
+					/// </summary>
+					/// <param name="windowBits">
+					/// The window bits to reset the inflate stream with. See zlib's inflateInit2.
+					/// </param>
+					/// <returns>
+					/// True if the stream was reset, false otherwise.
+					/// </returns>
+					const bool ResetStream(const int windowBits);
+
+					/// <summary>
+					/// The zlib inflate stream.
+					/// </summary>
+					z_stream m_stream;
+
+					/// <summary>
+					/// Whether or not m_stream was successfully initialized.
+					/// </summary>
+					bool m_initialized = false;
+
+					/// <summary>
+					/// The format of the current payload.
+					/// </summary>
+					Format m_format = Format::Gzip;
+
+					/// <summary>
+					/// Whether or not the current deflate payload is being decoded as raw deflate,
+					/// without the zlib wrapper.
+					/// </summary>
+					bool m_rawDeflate = false;
+
+					/// <summary>
+					/// The size of the zlib header, which is all of the input that needs to be
+					/// replayed when falling back to raw deflate.
+					/// </summary>
+					static constexpr size_t ZlibHeaderSize = 2;
+
+					/// <summary>
+					/// The first bytes of the current payload, kept in case they were given in an
+					/// earlier call than the one that fails the header check.
+					/// </summary>
+					char m_headerInput[ZlibHeaderSize];
+
+					/// <summary>
+					/// The number of bytes of input given for the current payload.
+					/// </summary>
+					size_t m_inputSize = 0;
+
+					/// <summary>
+					/// Whether or not the end of the encoded stream has been reached.
+					/// </summary>
+					bool m_complete = false;
+
+				};
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
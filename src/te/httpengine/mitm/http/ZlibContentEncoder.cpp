@@ -0,0 +1,147 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ZlibContentEncoder.hpp"
+#include <cstring>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				namespace
+				{
+					/// <summary>
+					/// Window bits for gzip wrapped output.
+					/// </summary>
+					constexpr int GzipWindowBits = MAX_WBITS + 16;
+
+					/// <summary>
+					/// Window bits for zlib wrapped output.
+					/// </summary>
+					constexpr int ZlibWindowBits = MAX_WBITS;
+
+					/// <summary>
+					/// zlib's default, and largest sensible, memory level.
+					/// </summary>
+					constexpr int MemoryLevel = 8;
+				}
+
+				ZlibContentEncoder::ZlibContentEncoder(const Format format)
+					:
+					m_format(format)
+				{
+					std::memset(&m_stream, 0, sizeof(m_stream));
+				}
+
+				ZlibContentEncoder::~ZlibContentEncoder()
+				{
+					if (m_level != 0)
+					{
+						deflateEnd(&m_stream);
+					}
+				}
+
+				const bool ZlibContentEncoder::Encode(const char* data, const size_t length, const int level, PayloadBuffer& output)
+				{
+					if (!Prepare(level))
+					{
+						return false;
+					}
+
+					const size_t used = output.size();
+
+					// The bound is the worst case for the whole payload, so it all gets done in a
+					// single call.
+					const size_t bound = static_cast<size_t>(deflateBound(&m_stream, static_cast<uLong>(length)));
+
+					output.resize(used + bound);
+
+					// zlib's interface predates const correctness, but it never writes to the input.
+					m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+					m_stream.avail_in = static_cast<uInt>(length);
+					m_stream.next_out = reinterpret_cast<Bytef*>(output.data() + used);
+					m_stream.avail_out = static_cast<uInt>(bound);
+
+					const int ret = deflate(&m_stream, Z_FINISH);
+
+					output.resize(used + (bound - m_stream.avail_out));
+
+					deflateReset(&m_stream);
+
+					return ret == Z_STREAM_END;
+				}
+
+				const bool ZlibContentEncoder::Prepare(const int level)
+				{
+					int clampedLevel = level;
+
+					if (clampedLevel < MinLevel)
+					{
+						clampedLevel = MinLevel;
+					}
+					else if (clampedLevel > MaxLevel)
+					{
+						clampedLevel = MaxLevel;
+					}
+
+					if (m_level == clampedLevel)
+					{
+						return true;
+					}
+
+					if (m_level != 0)
+					{
+						deflateEnd(&m_stream);
+						std::memset(&m_stream, 0, sizeof(m_stream));
+						m_level = 0;
+					}
+
+					const int windowBits = m_format == Format::Gzip ? GzipWindowBits : ZlibWindowBits;
+
+					if (deflateInit2(&m_stream, clampedLevel, Z_DEFLATED, windowBits, MemoryLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+					{
+						return false;
+					}
+
+					m_level = clampedLevel;
+
+					return true;
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,114 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <zlib.h>
+#include "BaseContentEncoder.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Encoder for the gzip and deflate content encodings, built directly on a zlib
+				/// deflate stream. Deflate output carries the zlib wrapper, as RFC 7230 calls
+				/// for. The deflate stream is only set up again when the compression level
+				/// changes, and is otherwise simply reset between payloads.
+				/// </summary>
+				class ZlibContentEncoder : public BaseContentEncoder
+				{
+
+				public:
+
+					/// <summary>
+					/// The formats this encoder can produce.
+					/// </summary>
+					enum class Format : uint8_t
+					{
+						Gzip,
+						Deflate
+					};
+
+					/// <summary>
+					/// Constructs a new encoder.
+					/// </summary>
+					/// <param name="format">
+					/// The format to produce.
+					/// </param>
+					ZlibContentEncoder(const Format format);
+
+					/// <summary>
+					/// Releases the deflate stream.
+					/// </summary>
+					virtual ~ZlibContentEncoder();
+
+					virtual const bool Encode(const char* data, const size_t length, const int level, PayloadBuffer& output) override;
+
+				private:
+
+					/// <summary>
+					/// Ensures that the deflate stream is set up for the supplied level.
+					/// </summary>
+					/// <param name="level">
+					/// The compression level.
+					/// </param>
+					/// <returns>
+					/// True if the stream is ready for use, false otherwise.
+					/// </returns>
+					const bool Prepare(const int level);
+
+					/// <summary>
+					/// The zlib deflate stream.
+					/// </summary>
+					z_stream m_stream;
+
+					/// <summary>
+					/// The format produced.
+					/// </summary>
+					const Format m_format;
+
+					/// <summary>
+					/// The level m_stream was set up with, or zero if it has not been set up.
+					/// </summary>
+					int m_level = 0;
+
+				};
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,137 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ZstdContentDecoder.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				ZstdContentDecoder::ZstdContentDecoder(const size_t maxOutputSize)
+					:
+					BaseContentDecoder(maxOutputSize)
+				{
+					m_context = ZSTD_createDCtx();
+
+					if (m_context != nullptr)
+					{
+						ZSTD_DCtx_setParameter(m_context, ZSTD_d_windowLogMax, MaxWindowLog);
+					}
+				}
+
+				ZstdContentDecoder::~ZstdContentDecoder()
+				{
+					if (m_context != nullptr)
+					{
+						ZSTD_freeDCtx(m_context);
+					}
+				}
+
+				const bool ZstdContentDecoder::Decode(const char* data, const size_t length, PayloadBuffer& output)
+				{
+					if (m_context == nullptr)
+					{
+						return false;
+					}
+
+					if (length == 0)
+					{
+						return true;
+					}
+
+					ZSTD_inBuffer input{ data, length, 0 };
+
+					for (;;)
+					{
+						const size_t used = output.size();
+
+						if (used >= m_maxOutputSize)
+						{
+							return false;
+						}
+
+						size_t available = m_maxOutputSize - used;
+
+						if (available > OutputStepSize)
+						{
+							available = OutputStepSize;
+						}
+
+						output.resize(used + available);
+
+						ZSTD_outBuffer out{ output.data() + used, available, 0 };
+
+						const size_t ret = ZSTD_decompressStream(m_context, &out, &input);
+
+						output.resize(used + out.pos);
+
+						if (ZSTD_isError(ret))
+						{
+							return false;
+						}
+
+						// Zero means a frame was just completed and flushed. Any input left over is
+						// the start of another frame, which the context picks up on its own.
+						m_complete = ret == 0;
+
+						// The context stops short of filling the output only when it has nothing
+						// more to give for the input it has.
+						if (input.pos == input.size && out.pos < out.size)
+						{
+							return true;
+						}
+					}
+				}
+
+				const bool ZstdContentDecoder::IsComplete() const
+				{
+					return m_complete;
+				}
+
+				void ZstdContentDecoder::Reset()
+				{
+					m_complete = false;
+
+					if (m_context != nullptr)
+					{
+						ZSTD_DCtx_reset(m_context, ZSTD_reset_session_only);
+					}
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <zstd.h>
+#include "BaseContentDecoder.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Streaming decoder for the zstd content encoding, built on a zstd decompression
+				/// context which is allocated once and reset between payloads. Payloads made up
+				/// of several frames are decoded in their entirety.
+				///
+				/// RFC 9659 caps the window of zstd encoded HTTP content at 8 MB, and the
+				/// decoder refuses anything larger, so that a hostile server can't make each
+				/// connection commit to the 128 MB window zstd otherwise permits.
+				/// </summary>
+				class ZstdContentDecoder : public BaseContentDecoder
+				{
+
+				public:
+
+					/// <summary>
+					/// Constructs a new decoder.
+					/// </summary>
+					/// <param name="maxOutputSize">
+					/// The maximum total number of bytes the decoder may produce for a single
+					/// payload.
+					/// </param>
+					ZstdContentDecoder(const size_t maxOutputSize);
+
+					/// <summary>
+					/// Releases the decompression context.
+					/// </summary>
+					virtual ~ZstdContentDecoder();
+
+					virtual const bool Decode(const char* data, const size_t length, PayloadBuffer& output) override;
+
+					virtual const bool IsComplete() const override;
+
+					virtual void Reset() override;
+
+				private:
+
+					/// <summary>
+					/// The largest window, as a power of two, that is accepted. See RFC 9659.
+					/// </summary>
+					static constexpr int MaxWindowLog = 23;
+
+					/// <summary>
+					/// The zstd decompression context.
+					/// </summary>
+					ZSTD_DCtx* m_context = nullptr;
+
+					/// <summary>
+					/// Whether or not the last frame given has been decoded to its end.
+					/// </summary>
+					bool m_complete = false;
+
+				};
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,104 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ZstdContentEncoder.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				ZstdContentEncoder::ZstdContentEncoder()
+				{
+					m_context = ZSTD_createCCtx();
+				}
+
+				ZstdContentEncoder::~ZstdContentEncoder()
+				{
+					if (m_context != nullptr)
+					{
+						ZSTD_freeCCtx(m_context);
+					}
+				}
+
+				const bool ZstdContentEncoder::Encode(const char* data, const size_t length, const int level, PayloadBuffer& output)
+				{
+					if (m_context == nullptr)
+					{
+						return false;
+					}
+
+					int clampedLevel = level;
+
+					if (clampedLevel < MinLevel)
+					{
+						clampedLevel = MinLevel;
+					}
+					else if (clampedLevel > MaxLevel)
+					{
+						clampedLevel = MaxLevel;
+					}
+
+					if (ZSTD_isError(ZSTD_CCtx_setParameter(m_context, ZSTD_c_compressionLevel, clampedLevel)))
+					{
+						return false;
+					}
+
+					const size_t used = output.size();
+
+					// The bound is the worst case for the whole payload, so it all gets done in a
+					// single call.
+					const size_t bound = ZSTD_compressBound(length);
+
+					output.resize(used + bound);
+
+					const size_t ret = ZSTD_compress2(m_context, output.data() + used, bound, data, length);
+
+					if (ZSTD_isError(ret))
+					{
+						output.resize(used);
+						ZSTD_CCtx_reset(m_context, ZSTD_reset_session_only);
+						return false;
+					}
+
+					output.resize(used + ret);
+
+					return true;
+				}
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <zstd.h>
+#include "BaseContentEncoder.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Encoder for the zstd content encoding, built on a zstd compression context
+				/// which is allocated once and reused for every payload.
+				///
+				/// Levels map directly onto zstd levels 1 through 9, every one of which keeps
+				/// the window within the 8 MB that RFC 9659 permits for HTTP content.
+				/// </summary>
+				class ZstdContentEncoder : public BaseContentEncoder
+				{
+
+				public:
+
+					/// <summary>
+					/// Constructs a new encoder.
+					/// </summary>
+					ZstdContentEncoder();
+
+					/// <summary>
+					/// Releases the compression context.
+					/// </summary>
+					virtual ~ZstdContentEncoder();
+
+					virtual const bool Encode(const char* data, const size_t length, const int level, PayloadBuffer& output) override;
+
+				private:
+
+					/// <summary>
+					/// The zstd compression context.
+					/// </summary>
+					ZSTD_CCtx* m_context = nullptr;
+
+				};
+
+			} /* namespace http */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
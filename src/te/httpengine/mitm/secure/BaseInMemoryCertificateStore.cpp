@@ -35,6 +35,10 @@
 #include <limits>
 #include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <cstring>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
 
 namespace te
 {
@@ -55,305 +59,1307 @@ namespace te
 				BaseInMemoryCertificateStore::BaseInMemoryCertificateStore(
 					const std::string& countryCode,
 					const std::string& organizationName,
-					const std::string& commonName
+					const std::string& commonName,
+					const std::string& cachePath,
+					const std::vector<unsigned char>& cacheKey
 					) :
 					m_caCountryCode(countryCode),
 					m_caOrgName(organizationName),
 					m_caCommonName(commonName)
 				{
-					// Generate self signed CA cert.
-					m_thisCaKeyPair = GenerateEcKey();
-					m_thisCa = GenerateSelfSignedCert(m_thisCaKeyPair, m_caCountryCode, m_caOrgName, m_caCommonName);
+					// Generate self signed CA cert.
+					m_thisCaKeyPair = GenerateEcKey();
+					m_thisCa = GenerateSelfSignedCert(m_thisCaKeyPair, m_caCountryCode, m_caOrgName, m_caCommonName);
+
+					if (!cachePath.empty())
+					{
+						// Has to happen before any thread that mints is started, since it can swap
+						// out the CA.
+						try
+						{
+							OpenPersistentCache(cachePath, cacheKey);
+						}
+						catch (...)
+						{
+							EVP_PKEY_free(m_thisCaKeyPair);
+							X509_free(m_thisCa);
+							throw;
+						}
+					}
+
+					// Start the workers that mint contexts for ::AsyncGetServerContext(...).
+					m_mintWork.reset(new boost::asio::io_service::work(m_mintService));
+
+					for (uint32_t i = 0; i < DefaultNumMintThreads; ++i)
+					{
+						m_mintThreads.emplace_back([this]()
+						{
+							m_mintService.run();
+						});
+					}
+
+					RequestKeyPoolRefill();
+
+					m_prewarmThread = std::thread([this]()
+					{
+						RunPrewarming();
+					});
+				}
+
+				BaseInMemoryCertificateStore::~BaseInMemoryCertificateStore()
+				{
+					// Prewarming mints too, so it goes first.
+					{
+						std::lock_guard<std::mutex> lock(m_prewarmMutex);
+						m_prewarmStopping = true;
+					}
+
+					m_prewarmCondition.notify_all();
+
+					if (m_prewarmThread.joinable())
+					{
+						m_prewarmThread.join();
+					}
+
+					PersistHostHistory();
+
+					// Stop minting before anything minting depends on goes away. Mints still
+					// queued are dropped, and so are the handlers waiting on them.
+					m_mintWork.reset();
+					m_mintService.stop();
+
+					for (auto& thread : m_mintThreads)
+					{
+						if (thread.joinable())
+						{
+							thread.join();
+						}
+					}
+
+					m_mintThreads.clear();
+					m_mintsInFlight.clear();
+
+					for (auto* key : m_keyPool)
+					{
+						EVP_PKEY_free(key);
+					}
+
+					m_keyPool.clear();
+
+					if (m_sharedLeafKey != nullptr)
+					{
+						EC_KEY_free(m_sharedLeafKey);
+						m_sharedLeafKey = nullptr;
+					}
+
+					// XXX TODO - What about the temp EC key? Does it simply die as part of the
+					// context? Why is there no method to fetch it later? If it doesn't die with
+					// the context, then we need to store it separately. :(
+					//
+					// Contexts are freed once the last reference to them goes, so any still held
+					// by bridges will outlive us.
+					m_hostContexts.clear();
+					m_storedContexts.clear();
+					m_storedContextBytes = 0;
+
+					for (auto& key : m_ticketKeys)
+					{
+						OPENSSL_cleanse(&key, sizeof(key));
+					}
+
+					m_ticketKeys.clear();
+				}
+
+				BaseInMemoryCertificateStore::SharedServerContext BaseInMemoryCertificateStore::GetServerContext(const std::string& hostname, X509* originalCertificate)
+				{
+					std::string host = hostname;
+
+					std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+
+					RememberUpstreamCertificate(host, originalCertificate);
+
+					auto existing = FindServerContext(host);
+
+					if (existing != nullptr)
+					{
+						return existing;
+					}
+
+					const auto started = std::chrono::steady_clock::now();
+
+					std::vector<std::string> sanDomains;
+
+					auto* ctx = ObtainServerContext(host, originalCertificate, sanDomains);
+
+					auto stored = StoreServerContext(host, ctx, sanDomains);
+
+					RecordMintLatency(std::chrono::steady_clock::now() - started);
+
+					return stored;
+				}
+
+				void BaseInMemoryCertificateStore::AsyncGetServerContext(boost::asio::io_service& service, const std::string& hostname, X509* originalCertificate, ServerContextHandler handler)
+				{
+					std::string host = hostname;
+
+					std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+
+					RememberUpstreamCertificate(host, originalCertificate);
+
+					auto existing = FindServerContext(host);
+
+					if (existing != nullptr)
+					{
+						service.post(std::bind(handler, existing, std::string()));
+						return;
+					}
+
+					ScopedLock lock(m_mintMutex);
+
+					auto inFlight = m_mintsInFlight.find(host);
+
+					if (inFlight != m_mintsInFlight.end())
+					{
+						// Somebody is already minting a context for this host. Just wait on theirs.
+						inFlight->second.push_back({ &service, handler });
+						return;
+					}
+
+					// The mint that was in flight may have finished between our lookup and taking
+					// the mint lock, so look again before starting another.
+					existing = FindServerContext(host);
+
+					if (existing != nullptr)
+					{
+						service.post(std::bind(handler, existing, std::string()));
+						return;
+					}
+
+					// The certificate belongs to the caller's upstream connection, which is free to
+					// go away before the worker gets around to it, so the worker gets its own copy.
+					X509* certificateCopy = originalCertificate != nullptr ? X509_dup(originalCertificate) : nullptr;
+
+					if (certificateCopy == nullptr)
+					{
+						service.post(std::bind(handler, nullptr, std::string(u8"In BaseInMemoryCertificateStore::AsyncGetServerContext(...) - Failed to copy certificate to spoof.")));
+						return;
+					}
+
+					m_mintsInFlight[host].push_back({ &service, handler });
+
+					std::shared_ptr<X509> certificate(certificateCopy, X509_free);
+
+					m_mintService.post(std::bind(&BaseInMemoryCertificateStore::MintServerContext, this, host, certificate, std::chrono::steady_clock::now()));
+				}
+
+				BaseInMemoryCertificateStore::SharedServerContext BaseInMemoryCertificateStore::FindServerContext(const std::string& host)
+				{
+					Reader lock(m_contextLock);
+
+					const auto& result = m_hostContexts.find(host);
+
+					if (result != m_hostContexts.end())
+					{
+						// We only hold a shared lock, so we can't move the context to the front of
+						// the recency list. Just mark it as used, and let eviction sort it out.
+						result->second->referenced = true;
+
+						if (result->second->prewarmed.exchange(false))
+						{
+							++m_prewarmHits;
+						}
+
+						return result->second->context;
+					}
+
+					return nullptr;
+				}
+
+				const BaseInMemoryCertificateStore::ContextCacheStatistics BaseInMemoryCertificateStore::GetContextCacheStatistics()
+				{
+					ContextCacheStatistics stats;
+
+					stats.evictions = m_contextEvictions;
+
+					Reader lock(m_contextLock);
+
+					stats.contexts = m_storedContexts.size();
+					stats.hosts = m_hostContexts.size();
+					stats.approximateBytes = m_storedContextBytes;
+
+					return stats;
+				}
+
+				boost::asio::ssl::context* BaseInMemoryCertificateStore::SpoofServerContext(const std::string& host, X509* originalCertificate, std::vector<std::string>& sanDomains)
+				{
+					if (m_thisCa == nullptr || m_thisCaKeyPair == nullptr || originalCertificate == nullptr)
+					{
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::SpoofServerContext(const std::string&, X509*, std::vector<std::string>&) - Cannot spoof certificate. Either member CA , member CA keypair or certificate to spoof is nullptr.");
+					}
+
+					char countryBuff[1024];
+					char orgBuff[1024];
+					char cnBuff[1024];
+
+					int countryLen = 0;
+					int orgLen = 0;
+					int cnLen = 0;
+
+					X509_NAME* certToSpoofName = X509_get_subject_name(originalCertificate);
+
+					if (certToSpoofName == nullptr)
+					{
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::SpoofServerContext(const std::string&, X509*, std::vector<std::string>&) - Failed to load remote certificate X509_NAME data.");
+					}
+
+					cnLen = X509_NAME_get_text_by_NID(certToSpoofName, NID_commonName, cnBuff, 1024);
+					orgLen = X509_NAME_get_text_by_NID(certToSpoofName, NID_organizationName, orgBuff, 1024);
+					countryLen = X509_NAME_get_text_by_NID(certToSpoofName, NID_countryName, countryBuff, 1024);
+
+					if (countryLen < 0)
+					{
+						countryLen = 0;
+					}
+
+					if (orgLen < 0)
+					{
+						orgLen = 0;
+					}
+
+					if (cnLen < 0)
+					{
+						cnLen = 0;
+					}
+
+					std::string countryCode(countryBuff, countryLen);
+					std::string organizationName(orgBuff, orgLen);
+					std::string commonName(cnBuff, cnLen);
+
+					EVP_PKEY* spoofedCertKeypair = TakeLeafKey();
+
+					if (spoofedCertKeypair == nullptr)
+					{
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::SpoofServerContext(const std::string&, X509*, std::vector<std::string>&) - Failed to generate EC key for spoofed certificate.");
+					}
+
+					// We pass nullptr as the issuer keypair, because we don't want it to be signed yet. We
+					// still have modifications to make, such as adding SAN's.
+					X509* spoofedCert = IssueCertificate(spoofedCertKeypair, nullptr, false, countryCode, organizationName, commonName);
+
+					if (spoofedCert == nullptr)
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::SpoofServerContext(const std::string&, X509*, std::vector<std::string>&) - Failed to generate X509 structure.");
+					}
+
+					// We need to get all the SAN, or Subject Alternative Names out of the certificate
+					// we are spoofing, and then add them to our own. This is important for things like
+					// wildcard domains. If we ignored SAN's, we'd get hard to diagnose issues while
+					// in the proxy where some requests that appear to be to the same host are rejected
+					// while others are not. 
+					int i;
+					int sanNamesCount = -1;
+					STACK_OF(GENERAL_NAME)* sanNames = nullptr;
+
+					sanNames = (STACK_OF(GENERAL_NAME)*) X509_get_ext_d2i(originalCertificate, NID_subject_alt_name, nullptr, nullptr);
+
+					sanNamesCount = sk_GENERAL_NAME_num(sanNames);
+
+					// We want to keep each SAN stored in a vector without modification, or any appended
+					// special strings like "DNS:". We want this so we can use this vector for the sole
+					// purpose of iterating over all extracted SAN's and then using them as keys
+					// to point to the same final certificate and or context.
+					//
+					// The SAN string we're going to copy directly into our spoofed certificate is generated
+					// along side this vector, but stored entirely in the sanDnsString variable.
+					std::string sanDnsString;
+
+					for (i = 0; i < sanNamesCount; i++)
+					{
+						const GENERAL_NAME* currentName = sk_GENERAL_NAME_value(sanNames, i);
+
+						switch (currentName->type)
+						{
+						case GEN_DNS:
+						{
+							std::string dnsNameString(reinterpret_cast<char*>(ASN1_STRING_data(currentName->d.dNSName)));
+
+							auto len = ASN1_STRING_length(currentName->d.dNSName);
+
+							if (len == dnsNameString.size())
+							{
+								std::transform(dnsNameString.begin(), dnsNameString.end(), dnsNameString.begin(), ::tolower);
+
+								if (sanDomains.size() == 0)
+								{
+									sanDnsString.append("DNS:");
+								}
+								else
+								{
+									sanDnsString.append(",DNS:");
+								}
+
+								sanDnsString.append(dnsNameString);
+
+								sanDomains.push_back(dnsNameString);
+							}
+							else
+							{
+								// Malformed certificate? SAN has embedded null perhaps?
+								break;
+							}
+						}
+						break;
+
+						// case GEN_OTHERNAME:
+						// case GEN_EMAIL:
+						// case GEN_X400:
+						// case GEN_DIRNAME:
+						// case GEN_EDIPARTY:
+						// case GEN_URI:
+						// case GEN_IPADD:
+						// case GEN_RID:
+
+						default:
+							continue;
+						}
+					} // End of SAN name loop
+
+					if (sanNames != nullptr)
+					{
+						sk_GENERAL_NAME_pop_free(sanNames, GENERAL_NAME_free);
+					}
+
+					if (sanDnsString.size() > 0)
+					{
+						if (!Addx509Extension(spoofedCert, NID_subject_alt_name, sanDnsString))
+						{
+							EVP_PKEY_free(spoofedCertKeypair);
+							X509_free(spoofedCert);
+							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::SpoofServerContext(const std::string&, X509*, std::vector<std::string>&) - Failed to set SAN's for spoofed certificate.");
+						}
+					}
+
+					// Now we're done altering the cert, so sign it.
+					if (m_thisCaKeyPair == nullptr || X509_sign(spoofedCert, m_thisCaKeyPair, EVP_sha256()) == 0)
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+						X509_free(spoofedCert);
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::SpoofServerContext(const std::string&, X509*, std::vector<std::string>&) - Failed to sign certificate.");
+					}
+
+					return CreateServerContext(spoofedCert, spoofedCertKeypair);
+				}
+
+				boost::asio::ssl::context* BaseInMemoryCertificateStore::CreateServerContext(X509* spoofedCert, EVP_PKEY* spoofedCertKeypair)
+				{
+					boost::asio::ssl::context* ctx = new boost::asio::ssl::context(boost::asio::ssl::context::tlsv12_server);
+
+					if (ctx == nullptr)
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+						X509_free(spoofedCert);
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::CreateServerContext(X509*, EVP_PKEY*) - Failed to allocate new server context for spoofed certificate.");
+					}
+
+					ctx->set_options(
+						boost::asio::ssl::context::no_compression |
+						boost::asio::ssl::context::default_workarounds |
+						boost::asio::ssl::context::no_sslv2 | 
+						boost::asio::ssl::context::no_sslv3
+						);
+
+
+					if (SSL_CTX_set_cipher_list(ctx->native_handle(), ContextCipherList.c_str()) != 1)
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+						X509_free(spoofedCert);
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::CreateServerContext(X509*, EVP_PKEY*) - Failed to set context cipher list.");
+					}						
+
+					if (SSL_CTX_use_certificate(ctx->native_handle(), spoofedCert) != 1)
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+						X509_free(spoofedCert);
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::CreateServerContext(X509*, EVP_PKEY*) - Failed to set server context certificate.");
+					}
+
+					if (SSL_CTX_use_PrivateKey(ctx->native_handle(), spoofedCertKeypair) != 1)
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+						X509_free(spoofedCert);
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::CreateServerContext(X509*, EVP_PKEY*) - Failed to set server context private key.");
+					}
+
+					SSL_CTX_set_options(ctx->native_handle(), SSL_OP_CIPHER_SERVER_PREFERENCE);
+
+					EC_KEY* tmpNegotiationEcKey;
+
+					if (nullptr == (tmpNegotiationEcKey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1)))
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+						X509_free(spoofedCert);
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::CreateServerContext(X509*, EVP_PKEY*) - Failed to allocate server context temporary negotiation EC key.");
+					}
+
+					// The temporary key only serves to name the curve. The context keeps its own
+					// copy, and since the copy has no key material in it, a fresh ephemeral key is
+					// generated for every handshake anyway, so there's no point generating one here
+					// on the way to the first handshake.
+					SSL_CTX_set_tmp_ecdh(ctx->native_handle(), tmpNegotiationEcKey);
+
+					EC_KEY_free(tmpNegotiationEcKey);
+
+					if (!ConfigureServerSessions(ctx->native_handle()))
+					{
+						EVP_PKEY_free(spoofedCertKeypair);
+						X509_free(spoofedCert);
+						delete ctx;
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::CreateServerContext(X509*, EVP_PKEY*) - Failed to configure server context session resumption.");
+					}
+
+					return ctx;
+				}
+
+				boost::asio::ssl::context* BaseInMemoryCertificateStore::ObtainServerContext(const std::string& host, X509* originalCertificate, std::vector<std::string>& sanDomains)
+				{
+					if (m_persistentCache != nullptr)
+					{
+						PersistentCertificateCache::Entry entry;
+
+						if (m_persistentCache->Find(host, originalCertificate, entry))
+						{
+							sanDomains = std::move(entry.sanDomains);
+
+							++m_restoredContexts;
+
+							return CreateServerContext(entry.certificate, entry.keypair);
+						}
+					}
+
+					auto* ctx = SpoofServerContext(host, originalCertificate, sanDomains);
+
+					if (m_persistentCache != nullptr)
+					{
+						// If this fails, all it costs is minting this one again after a restart.
+						m_persistentCache->Store(
+							host,
+							originalCertificate,
+							SSL_CTX_get0_privatekey(ctx->native_handle()),
+							SSL_CTX_get0_certificate(ctx->native_handle()),
+							sanDomains
+							);
+					}
+
+					return ctx;
+				}
+
+				BaseInMemoryCertificateStore::SharedServerContext BaseInMemoryCertificateStore::StoreServerContext(const std::string& host, boost::asio::ssl::context* ctx, const std::vector<std::string>& sanDomains, const bool prewarmed)
+				{
+					// From here on, the context is freed once the last reference to it goes, be
+					// that ours or that of a bridge still serving a client with it.
+					SharedServerContext context(ctx, &BaseInMemoryCertificateStore::FreeServerContext);
+
+					// Work out the size before taking the lock. Every key is counted, even though
+					// some may turn out to be stored already, which errs on the side of caution.
+					size_t bytes = EstimateServerContextBytes(ctx);
+
+					for (const auto& domain : sanDomains)
+					{
+						bytes += domain.size() + EstimatedHostKeyOverheadBytes;
+					}
+
+					bytes += host.size() + EstimatedHostKeyOverheadBytes;
+
+					Writer lock(m_contextLock);
+
+					const auto existing = m_hostContexts.find(host);
+
+					if (existing != m_hostContexts.end())
+					{
+						// Someone else got a context stored for this host while we were minting ours.
+						// Theirs wins, and ours is freed as we leave.
+						existing->second->referenced = true;
+						return existing->second->context;
+					}
+
+					EvictServerContexts(bytes);
+
+					m_storedContexts.emplace_front();
+
+					auto entry = m_storedContexts.begin();
+
+					entry->context = context;
+					entry->bytes = bytes;
+					entry->prewarmed = prewarmed;
+
+					for (const auto& domain : sanDomains)
+					{
+						if (m_hostContexts.find(domain) == m_hostContexts.end())
+						{
+							m_hostContexts.insert({ domain, entry });
+							entry->hosts.push_back(domain);
+						}
+					}
+
+					if (m_hostContexts.find(host) == m_hostContexts.end())
+					{
+						m_hostContexts.insert({ host, entry });
+						entry->hosts.push_back(host);
+					}
+
+					m_storedContextBytes += bytes;
+
+					return context;
+				}
+
+				const bool BaseInMemoryCertificateStore::HasServerContext(const std::string& host)
+				{
+					Reader lock(m_contextLock);
+
+					return m_hostContexts.find(host) != m_hostContexts.end();
+				}
+
+				void BaseInMemoryCertificateStore::EvictServerContexts(const size_t incomingBytes)
+				{
+					// This is the "second chance" approximation of LRU. Walking from the back of
+					// the list, which is the oldest, any context that has been used since we last
+					// came by gets its mark cleared and is moved to the front, and the first one
+					// that hasn't been used goes. Every context can be passed over at most once,
+					// so this always ends.
+					while (
+						m_storedContexts.size() > 0 && 
+						(m_storedContexts.size() >= MaxStoredContexts || m_storedContextBytes + incomingBytes > MaxStoredContextBytes)
+						)
+					{
+						auto oldest = std::prev(m_storedContexts.end());
+
+						if (oldest->referenced.exchange(false))
+						{
+							m_storedContexts.splice(m_storedContexts.begin(), m_storedContexts, oldest);
+							continue;
+						}
+
+						for (const auto& key : oldest->hosts)
+						{
+							auto hostEntry = m_hostContexts.find(key);
+
+							if (hostEntry != m_hostContexts.end() && hostEntry->second == oldest)
+							{
+								m_hostContexts.erase(hostEntry);
+							}
+						}
+
+						m_storedContextBytes -= oldest->bytes;
+
+						m_storedContexts.erase(oldest);
+
+						++m_contextEvictions;
+					}
+				}
+
+				const size_t BaseInMemoryCertificateStore::EstimateServerContextBytes(boost::asio::ssl::context* ctx)
+				{
+					size_t bytes = EstimatedContextOverheadBytes;
+
+					auto* contextCert = SSL_CTX_get0_certificate(ctx->native_handle());
+
+					if (contextCert != nullptr)
+					{
+						// The DER encoding is a fair stand in for the size of the parsed structure.
+						// The parsed form runs a few times larger, which is what the overhead
+						// estimate is padded for.
+						const int derLength = i2d_X509(contextCert, nullptr);
+
+						if (derLength > 0)
+						{
+							bytes += static_cast<size_t>(derLength);
+						}
+					}
+
+					return bytes;
+				}
+
+				void BaseInMemoryCertificateStore::MintServerContext(const std::string& host, std::shared_ptr<X509> certificate, const std::chrono::steady_clock::time_point requested)
+				{
+					SharedServerContext ctx = nullptr;
+					std::string errorMessage;
+
+					try
+					{
+						std::vector<std::string> sanDomains;
+
+						auto* spoofed = ObtainServerContext(host, certificate.get(), sanDomains);
+						ctx = StoreServerContext(host, spoofed, sanDomains);
+					}
+					catch (std::exception& e)
+					{
+						ctx = nullptr;
+						errorMessage = e.what();
+					}
+
+					if (ctx != nullptr)
+					{
+						// Measured from the request, so time spent queued for a minting thread
+						// counts too, as it does for the client waiting on it.
+						RecordMintLatency(std::chrono::steady_clock::now() - requested);
+					}
+
+					std::vector<ContextWaiter> waiters;
+
+					{
+						ScopedLock lock(m_mintMutex);
+
+						auto inFlight = m_mintsInFlight.find(host);
+
+						if (inFlight != m_mintsInFlight.end())
+						{
+							waiters = std::move(inFlight->second);
+							m_mintsInFlight.erase(inFlight);
+						}
+					}
+
+					for (auto& waiter : waiters)
+					{
+						waiter.service->post(std::bind(waiter.handler, ctx, errorMessage));
+					}
+				}
+
+				void BaseInMemoryCertificateStore::FreeServerContext(boost::asio::ssl::context* ctx)
+				{
+					auto* nativeHandle = ctx->native_handle();
+					auto* contextCert = SSL_CTX_get0_certificate(nativeHandle);
+					auto* privkey = SSL_CTX_get0_privatekey(nativeHandle);
+
+					EVP_PKEY_free(privkey);
+					X509_free(contextCert);
+
+					delete ctx;
+				}
+
+				const bool BaseInMemoryCertificateStore::ConfigureServerSessions(SSL_CTX* context)
+				{
+					if (context == nullptr)
+					{
+						return false;
+					}
+
+					if (SSL_CTX_set_ex_data(context, GetContextStoreIndex(), this) != 1)
+					{
+						return false;
+					}
+
+					// The session ID context is only strictly required when verifying client
+					// certificates, which we don't, but it costs nothing and keeps sessions from
+					// ever being resumed on a context that isn't one of ours.
+					static const unsigned char sessionIdContext[] = u8"HttpFilteringEngine";
+
+					if (SSL_CTX_set_session_id_context(context, sessionIdContext, sizeof(sessionIdContext) - 1) != 1)
+					{
+						return false;
+					}
+
+					SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER);
+					SSL_CTX_sess_set_cache_size(context, static_cast<long>(m_serverSessionCacheSize.load()));
+					SSL_CTX_set_timeout(context, SessionTicketKeyRotationSeconds);
+					SSL_CTX_clear_options(context, SSL_OP_NO_TICKET);
+					SSL_CTX_set_tlsext_ticket_key_cb(context, &BaseInMemoryCertificateStore::OnSessionTicketKey);
+
+					return true;
+				}
+
+				void BaseInMemoryCertificateStore::SetServerSessionCacheSize(const size_t size)
+				{
+					m_serverSessionCacheSize = size;
+				}
+
+				const size_t BaseInMemoryCertificateStore::GetServerSessionCacheSize() const
+				{
+					return m_serverSessionCacheSize;
+				}
+
+				int BaseInMemoryCertificateStore::OnSessionTicketKey(SSL* ssl, unsigned char* keyName, unsigned char* iv, EVP_CIPHER_CTX* cipherContext, HMAC_CTX* hmacContext, int encrypt)
+				{
+					auto* store = static_cast<BaseInMemoryCertificateStore*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), GetContextStoreIndex()));
+
+					if (store == nullptr)
+					{
+						// Refusing to decrypt just means a full handshake, but refusing to encrypt
+						// fails the handshake, which is at least loud about it.
+						return encrypt ? -1 : 0;
+					}
+
+					std::lock_guard<std::mutex> lock(store->m_ticketKeyMutex);
+
+					if (encrypt)
+					{
+						if (!store->RotateTicketKeys() || store->m_ticketKeys.size() == 0)
+						{
+							return -1;
+						}
+
+						const auto& key = store->m_ticketKeys.front();
+
+						if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+						{
+							return -1;
+						}
+
+						std::memcpy(keyName, key.name, sizeof(key.name));
+
+						if (EVP_EncryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, key.aesKey, iv) != 1)
+						{
+							return -1;
+						}
+
+						if (HMAC_Init_ex(hmacContext, key.hmacKey, sizeof(key.hmacKey), EVP_sha256(), nullptr) != 1)
+						{
+							return -1;
+						}
+
+						return 1;
+					}
+
+					// Decrypting. Rotate first, so that tickets under keys that have just aged out
+					// aren't accepted for however long it's been since the last ticket we issued.
+					store->RotateTicketKeys();
+
+					for (size_t i = 0; i < store->m_ticketKeys.size(); ++i)
+					{
+						const auto& key = store->m_ticketKeys[i];
+
+						if (std::memcmp(keyName, key.name, sizeof(key.name)) != 0)
+						{
+							continue;
+						}
+
+						if (HMAC_Init_ex(hmacContext, key.hmacKey, sizeof(key.hmacKey), EVP_sha256(), nullptr) != 1)
+						{
+							return 0;
+						}
+
+						if (EVP_DecryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, key.aesKey, iv) != 1)
+						{
+							return 0;
+						}
+
+						// Two tells OpenSSL to resume, but to issue the client a new ticket under
+						// the newest key, so that the client moves off the old key before it's gone.
+						return i == 0 ? 1 : 2;
+					}
+
+					// Unknown key, most likely one that has been rotated out. Full handshake.
+					return 0;
+				}
+
+				int BaseInMemoryCertificateStore::GetContextStoreIndex()
+				{
+					static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+
+					return index;
 				}
 
-				BaseInMemoryCertificateStore::~BaseInMemoryCertificateStore()
+				const bool BaseInMemoryCertificateStore::RotateTicketKeys()
 				{
-					// XXX TODO - What about the temp EC key? Does it simply die as part of the
-					// context? Why is there no method to fetch it later? If it doesn't die with
-					// the context, then we need to store it separately. :(
-					for (const auto& pair : m_hostContexts)
+					const std::time_t now = std::time(nullptr);
+
+					// Keys are kept for two rotations, so that a ticket issued just before a rotation
+					// is still good for as long as its session is.
+					while (m_ticketKeys.size() > 0 && now - m_ticketKeys.back().created >= (2 * SessionTicketKeyRotationSeconds))
+					{
+						OPENSSL_cleanse(&m_ticketKeys.back(), sizeof(SessionTicketKey));
+						m_ticketKeys.pop_back();
+					}
+
+					if (m_ticketKeys.size() > 0 && now - m_ticketKeys.front().created < SessionTicketKeyRotationSeconds)
 					{
-						auto* nativeHandle = pair.second->native_handle();
-						auto* contextCert = SSL_CTX_get0_certificate(nativeHandle);
-						auto* privkey = SSL_CTX_get0_privatekey(nativeHandle);
+						return true;
+					}
+
+					SessionTicketKey key;
 
-						EVP_PKEY_free(privkey);
-						X509_free(contextCert);
+					if (
+						RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+						RAND_bytes(key.aesKey, sizeof(key.aesKey)) != 1 ||
+						RAND_bytes(key.hmacKey, sizeof(key.hmacKey)) != 1
+						)
+					{
+						OPENSSL_cleanse(&key, sizeof(key));
 
-						delete pair.second;
+						// Carry on with the current key if there still is one. Better that than no
+						// tickets at all.
+						return m_ticketKeys.size() > 0;
 					}
 
-					m_hostContexts.clear();
+					key.created = now;
+
+					m_ticketKeys.push_front(key);
+
+					OPENSSL_cleanse(&key, sizeof(key));
+
+					return true;
 				}
 
-				boost::asio::ssl::context* BaseInMemoryCertificateStore::GetServerContext(const std::string& hostname, X509* originalCertificate)
+				void BaseInMemoryCertificateStore::SetSharedLeafKeyEnabled(const bool enabled)
 				{
-					ScopedLock lock(m_spoofMutex);
+					m_sharedLeafKeyEnabled = enabled;
+				}
 
-					std::string host = hostname;
+				const bool BaseInMemoryCertificateStore::GetSharedLeafKeyEnabled() const
+				{
+					return m_sharedLeafKeyEnabled;
+				}
 
-					std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+				const BaseInMemoryCertificateStore::MintStatistics BaseInMemoryCertificateStore::GetMintStatistics()
+				{
+					MintStatistics stats;
 
-					const auto& result = m_hostContexts.find(host);
+					stats.mints = m_mints;
+					stats.pooledKeys = m_pooledKeysTaken;
+					stats.inlineKeys = m_inlineKeysGenerated;
+					stats.sharedKeys = m_sharedKeysTaken;
+					stats.restored = m_restoredContexts;
 
-					if (result != m_hostContexts.end())
+					for (size_t i = 0; i < MintLatencyBucketCount; ++i)
+					{
+						stats.latencyBuckets[i] = m_mintLatencyBuckets[i];
+					}
+
+					return stats;
+				}
+
+				void BaseInMemoryCertificateStore::OpenPersistentCache(const std::string& path, const std::vector<unsigned char>& key)
+				{
+					std::unique_ptr<PersistentCertificateCache> cache(new PersistentCertificateCache(path, key));
+
+					PersistentCertificateCache::Entry ca;
+
+					if (cache->LoadCertificateAuthority(ca))
 					{
-						return result->second;
-					}										
+						// Nothing has been issued with the CA we generated, and nothing trusts it
+						// yet, so it can just go.
+						EVP_PKEY_free(m_thisCaKeyPair);
+						X509_free(m_thisCa);
 
-					if (m_thisCa != nullptr && m_thisCaKeyPair != nullptr && originalCertificate != nullptr)
+						m_thisCaKeyPair = ca.keypair;
+						m_thisCa = ca.certificate;
+					}
+					else if (!cache->StoreCertificateAuthority(m_thisCaKeyPair, m_thisCa))
 					{
-						char countryBuff[1024];
-						char orgBuff[1024];
-						char cnBuff[1024];
+						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::OpenPersistentCache(const std::string&, const std::vector<unsigned char>&) - Failed to store CA.");
+					}
 
-						int countryLen = 0;
-						int orgLen = 0;
-						int cnLen = 0;
+					std::vector<PersistentCertificateCache::HostHistoryEntry> history;
 
-						X509_NAME* certToSpoofName = X509_get_subject_name(originalCertificate);
+					if (cache->LoadHostHistory(history))
+					{
+						ScopedLock lock(m_upstreamCertificateMutex);
 
-						if (certToSpoofName == nullptr)
+						for (auto& entry : history)
 						{
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to load remote certificate X509_NAME data.");
+							m_hostSketch.Record(entry.host, entry.seen);
+							m_upstreamCertificates[entry.host] = std::shared_ptr<X509>(entry.upstreamCertificate, X509_free);
 						}
 
-						cnLen = X509_NAME_get_text_by_NID(certToSpoofName, NID_commonName, cnBuff, 1024);
-						orgLen = X509_NAME_get_text_by_NID(certToSpoofName, NID_organizationName, orgBuff, 1024);
-						countryLen = X509_NAME_get_text_by_NID(certToSpoofName, NID_countryName, countryBuff, 1024);
+						PruneUpstreamCertificates();
+					}
+
+					m_persistentCache = std::move(cache);
 
-						if (countryLen < 0)
-						{
-							countryLen = 0;
-						}
+					// Whatever was seen most often last time is likely to be seen again soon.
+					{
+						std::lock_guard<std::mutex> lock(m_prewarmMutex);
+						m_prewarmRequested = true;
+					}
 
-						if (orgLen < 0)
-						{
-							orgLen = 0;
-						}
+					m_prewarmCondition.notify_all();
+				}
+
+				void BaseInMemoryCertificateStore::RecordHostSeen(const std::string& hostname)
+				{
+					std::string host = hostname;
+
+					std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+
+					m_hostSketch.Record(host);
+				}
+
+				void BaseInMemoryCertificateStore::SetPrewarmHostCount(const size_t count)
+				{
+					m_prewarmHostCount = count > MaxPrewarmHostCount ? static_cast<size_t>(MaxPrewarmHostCount) : count;
+				}
+
+				const size_t BaseInMemoryCertificateStore::GetPrewarmHostCount() const
+				{
+					return m_prewarmHostCount;
+				}
+
+				const BaseInMemoryCertificateStore::PrewarmStatistics BaseInMemoryCertificateStore::GetPrewarmStatistics()
+				{
+					PrewarmStatistics stats;
+
+					stats.passes = m_prewarmPasses;
+					stats.prewarmed = m_prewarmedContexts;
+					stats.hits = m_prewarmHits;
+					stats.trackedHosts = m_hostSketch.GetCandidateCount();
 
-						if (cnLen < 0)
+					ScopedLock lock(m_upstreamCertificateMutex);
+
+					stats.knownCertificates = m_upstreamCertificates.size();
+
+					return stats;
+				}
+
+				void BaseInMemoryCertificateStore::RememberUpstreamCertificate(const std::string& host, X509* certificate)
+				{
+					if (certificate == nullptr || m_prewarmHostCount == 0 || !m_hostSketch.IsCandidate(host))
+					{
+						return;
+					}
+
+					{
+						ScopedLock lock(m_upstreamCertificateMutex);
+
+						auto known = m_upstreamCertificates.find(host);
+
+						if (known != m_upstreamCertificates.end() && X509_cmp(known->second.get(), certificate) == 0)
 						{
-							cnLen = 0;
+							return;
 						}
+					}
+
+					X509* certificateCopy = X509_dup(certificate);
+
+					if (certificateCopy == nullptr)
+					{
+						return;
+					}
 
-						std::string countryCode(countryBuff, countryLen);
-						std::string organizationName(orgBuff, orgLen);
-						std::string commonName(cnBuff, cnLen);
+					std::shared_ptr<X509> remembered(certificateCopy, X509_free);
 
-						EVP_PKEY* spoofedCertKeypair = GenerateEcKey();
+					ScopedLock lock(m_upstreamCertificateMutex);
 
-						if (spoofedCertKeypair == nullptr)
+					m_upstreamCertificates[host] = remembered;
+
+					// Hosts drop out of those seen most often all the time, so don't leave it all
+					// to prewarming passes to clear out their certificates.
+					if (m_upstreamCertificates.size() > MaxPrewarmHostCount * 2)
+					{
+						PruneUpstreamCertificates();
+					}
+				}
+
+				void BaseInMemoryCertificateStore::PruneUpstreamCertificates()
+				{
+					for (auto known = m_upstreamCertificates.begin(); known != m_upstreamCertificates.end();)
+					{
+						if (!m_hostSketch.IsCandidate(known->first))
 						{
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to generate EC key for spoofed certificate.");
+							known = m_upstreamCertificates.erase(known);
+							continue;
 						}
 
-						// We pass nullptr as the issuer keypair, because we don't want it to be signed yet. We
-						// still have modifications to make, such as adding SAN's.
-						X509* spoofedCert = IssueCertificate(spoofedCertKeypair, nullptr, false, countryCode, organizationName, commonName);
+						++known;
+					}
+				}
+
+				void BaseInMemoryCertificateStore::RunPrewarming()
+				{
+					std::unique_lock<std::mutex> lock(m_prewarmMutex);
 
-						if (spoofedCert == nullptr)
+					while (!m_prewarmStopping)
+					{
+						m_prewarmCondition.wait_for(lock, std::chrono::seconds(static_cast<long>(PrewarmIntervalSeconds)), [this]()
 						{
-							EVP_PKEY_free(spoofedCertKeypair);
+							return m_prewarmStopping || m_prewarmRequested;
+						});
 
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to generate X509 structure.");
+						if (m_prewarmStopping)
+						{
+							break;
 						}
 
-						// We need to get all the SAN, or Subject Alternative Names out of the certificate
-						// we are spoofing, and then add them to our own. This is important for things like
-						// wildcard domains. If we ignored SAN's, we'd get hard to diagnose issues while
-						// in the proxy where some requests that appear to be to the same host are rejected
-						// while others are not. 
-						int i;
-						int sanNamesCount = -1;
-						STACK_OF(GENERAL_NAME)* sanNames = nullptr;
+						m_prewarmRequested = false;
 
-						sanNames = (STACK_OF(GENERAL_NAME)*) X509_get_ext_d2i(originalCertificate, NID_subject_alt_name, nullptr, nullptr);
+						lock.unlock();
 
-						sanNamesCount = sk_GENERAL_NAME_num(sanNames);
+						PrewarmServerContexts();
 
-						// We want to keep each SAN stored in a vector without modification, or any appended
-						// special strings like "DNS:". We want this so we can use this vector for the sole
-						// purpose of iterating over all extracted SAN's and then using them as keys
-						// to point to the same final certificate and or context.
-						//
-						// The SAN string we're going to copy directly into our spoofed certificate is generated
-						// along side this vector, but stored entirely in the sanDnsString variable.
-						std::vector<std::string> sanDomains;
-						std::string sanDnsString;
+						lock.lock();
+					}
+				}
 
-						for (i = 0; i < sanNamesCount; i++)
-						{
-							const GENERAL_NAME* currentName = sk_GENERAL_NAME_value(sanNames, i);
+				void BaseInMemoryCertificateStore::PrewarmServerContexts()
+				{
+					const size_t count = m_prewarmHostCount;
 
-							switch (currentName->type)
-							{
-							case GEN_DNS:
-							{
-								std::string dnsNameString(reinterpret_cast<char*>(ASN1_STRING_data(currentName->d.dNSName)));
+					if (count == 0)
+					{
+						return;
+					}
 
-								auto len = ASN1_STRING_length(currentName->d.dNSName);
+					const auto top = m_hostSketch.GetTop(count);
 
-								if (len == dnsNameString.size())
-								{
-									std::transform(dnsNameString.begin(), dnsNameString.end(), dnsNameString.begin(), ::tolower);
+					std::vector<std::pair<std::string, std::shared_ptr<X509>>> targets;
 
-									if (sanDomains.size() == 0)
-									{
-										sanDnsString.append("DNS:");
-									}
-									else
-									{
-										sanDnsString.append(",DNS:");
-									}
+					{
+						ScopedLock lock(m_upstreamCertificateMutex);
 
-									sanDnsString.append(dnsNameString);
+						PruneUpstreamCertificates();
 
-									sanDomains.push_back(dnsNameString);
-								}
-								else
-								{
-									// Malformed certificate? SAN has embedded null perhaps?
-									break;
-								}
+						for (const auto& host : top)
+						{
+							auto known = m_upstreamCertificates.find(host.first);
+
+							if (known != m_upstreamCertificates.end())
+							{
+								targets.emplace_back(host.first, known->second);
 							}
-							break;
+						}
+					}
 
-							// case GEN_OTHERNAME:
-							// case GEN_EMAIL:
-							// case GEN_X400:
-							// case GEN_DIRNAME:
-							// case GEN_EDIPARTY:
-							// case GEN_URI:
-							// case GEN_IPADD:
-							// case GEN_RID:
+					for (const auto& target : targets)
+					{
+						{
+							std::unique_lock<std::mutex> lock(m_prewarmMutex);
 
-							default:
-								continue;
+							// Doubles as the pause between one context and the next.
+							m_prewarmCondition.wait_for(lock, std::chrono::milliseconds(static_cast<long>(PrewarmPauseMilliseconds)), [this]()
+							{
+								return m_prewarmStopping;
+							});
+
+							if (m_prewarmStopping)
+							{
+								return;
 							}
-						} // End of SAN name loop
+						}
 
-						if (sanNames != nullptr)
+						if (HasServerContext(target.first) || X509_cmp_current_time(X509_get_notAfter(target.second.get())) <= 0)
 						{
-							sk_GENERAL_NAME_pop_free(sanNames, GENERAL_NAME_free);
+							continue;
 						}
 
-						if (sanDnsString.size() > 0)
+						try
 						{
-							if (!Addx509Extension(spoofedCert, NID_subject_alt_name, sanDnsString))
-							{
-								EVP_PKEY_free(spoofedCertKeypair);
-								X509_free(spoofedCert);
-								throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to set SAN's for spoofed certificate.");
-							}
-						}
+							std::vector<std::string> sanDomains;
+
+							auto* ctx = ObtainServerContext(target.first, target.second.get(), sanDomains);
+
+							StoreServerContext(target.first, ctx, sanDomains, true);
 
-						// Now we're done altering the cert, so sign it.
-						if (m_thisCaKeyPair == nullptr || X509_sign(spoofedCert, m_thisCaKeyPair, EVP_sha256()) == 0)
+							++m_prewarmedContexts;
+						}
+						catch (std::exception&)
 						{
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to sign certificate.");
+							// Nobody is waiting on it. The host gets a context minted the usual way
+							// when it's next asked for.
 						}
+					}
+
+					++m_prewarmPasses;
+
+					PersistHostHistory();
+				}
+
+				void BaseInMemoryCertificateStore::PersistHostHistory()
+				{
+					if (m_persistentCache == nullptr || m_prewarmHostCount == 0)
+					{
+						return;
+					}
+
+					const auto top = m_hostSketch.GetTop(m_prewarmHostCount);
 
-						// Now we can create our server context.
-						boost::asio::ssl::context* ctx = new boost::asio::ssl::context(boost::asio::ssl::context::tlsv12_server);
+					// Held until written, since hosts can drop out of the map meanwhile.
+					std::vector<std::shared_ptr<X509>> held;
+					std::vector<PersistentCertificateCache::HostHistoryEntry> history;
 
-						if (ctx == nullptr)
+					{
+						ScopedLock lock(m_upstreamCertificateMutex);
+
+						for (const auto& host : top)
 						{
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to allocate new server context for spoofed certificate.");
+							auto known = m_upstreamCertificates.find(host.first);
+
+							if (known == m_upstreamCertificates.end())
+							{
+								continue;
+							}
+
+							held.push_back(known->second);
+
+							PersistentCertificateCache::HostHistoryEntry entry;
+							entry.host = host.first;
+							entry.seen = host.second;
+							entry.upstreamCertificate = known->second.get();
+
+							history.push_back(std::move(entry));
 						}
+					}
 
-						ctx->set_options(
-							boost::asio::ssl::context::no_compression |
-							boost::asio::ssl::context::default_workarounds |
-							boost::asio::ssl::context::no_sslv2 | 
-							boost::asio::ssl::context::no_sslv3
-							);
+					std::vector<std::string> hosts;
+
+					for (const auto& entry : history)
+					{
+						hosts.push_back(entry.host);
+					}
+
+					std::sort(hosts.begin(), hosts.end());
+
+					// The file is append only, so every write leaves the last one behind as dead
+					// weight until the file is next compacted. Counts shift all the time, but
+					// it's only the hosts that matter.
+					if (history.size() == 0 || hosts == m_persistedHosts)
+					{
+						return;
+					}
 
+					if (m_persistentCache->StoreHostHistory(history))
+					{
+						m_persistedHosts = std::move(hosts);
+					}
+				}
+
+				EVP_PKEY* BaseInMemoryCertificateStore::TakeLeafKey()
+				{
+					if (m_sharedLeafKeyEnabled)
+					{
+						ScopedLock lock(m_keyPoolMutex);
 
-						if (SSL_CTX_set_cipher_list(ctx->native_handle(), ContextCipherList.c_str()) != 1)
+						if (m_sharedLeafKey == nullptr)
 						{
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to set context cipher list.");
-						}						
+							EVP_PKEY* generated = GenerateEcKey();
 
-						if (SSL_CTX_use_certificate(ctx->native_handle(), spoofedCert) != 1)
+							m_sharedLeafKey = EVP_PKEY_get1_EC_KEY(generated);
+
+							EVP_PKEY_free(generated);
+
+							if (m_sharedLeafKey == nullptr)
+							{
+								throw std::runtime_error(u8"In BaseInMemoryCertificateStore::TakeLeafKey() - Failed to generate shared leaf key.");
+							}
+						}
+
+						// Every context gets its own EVP_PKEY, so that freeing contexts works just
+						// the same as it does for contexts with keys of their own. They all just
+						// point to the one EC_KEY.
+						EVP_PKEY* pkey = EVP_PKEY_new();
+
+						if (pkey == nullptr)
 						{
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to set server context certificate.");
+							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::TakeLeafKey() - Failed to allocate EVP_PKEY structure.");
 						}
 
-						if (SSL_CTX_use_PrivateKey(ctx->native_handle(), spoofedCertKeypair) != 1)
+						if (EVP_PKEY_set1_EC_KEY(pkey, m_sharedLeafKey) != 1)
 						{
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to set server context private key.");
+							EVP_PKEY_free(pkey);
+
+							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::TakeLeafKey() - Failed to assign shared leaf key to EVP_PKEY structure.");
 						}
 
-						SSL_CTX_set_options(ctx->native_handle(), SSL_OP_CIPHER_SERVER_PREFERENCE);
+						++m_sharedKeysTaken;
+
+						return pkey;
+					}
+
+					EVP_PKEY* pooled = nullptr;
 
-						EC_KEY* tmpNegotiationEcKey;
+					{
+						ScopedLock lock(m_keyPoolMutex);
 
-						if (nullptr == (tmpNegotiationEcKey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1)))
+						if (m_keyPool.size() > 0)
 						{
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to allocate server context temporary negotiation EC key.");
+							pooled = m_keyPool.front();
+							m_keyPool.pop_front();
 						}
+					}
+
+					RequestKeyPoolRefill();
+
+					if (pooled != nullptr)
+					{
+						++m_pooledKeysTaken;
+
+						return pooled;
+					}
+
+					// The pool ran dry, most likely because of a burst of new hosts. Nothing for
+					// it but to generate one right here.
+					++m_inlineKeysGenerated;
+
+					return GenerateEcKey();
+				}
+
+				void BaseInMemoryCertificateStore::RequestKeyPoolRefill()
+				{
+					if (m_sharedLeafKeyEnabled)
+					{
+						return;
+					}
 
-						if (EC_KEY_generate_key(tmpNegotiationEcKey) != 1)
+					{
+						ScopedLock lock(m_keyPoolMutex);
+
+						if (m_keyPool.size() > (KeyPoolSize / 2) || m_keyPoolRefilling)
 						{
-							EC_KEY_free(tmpNegotiationEcKey);
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Failed to generate server context temporary negotiation EC key.");
+							return;
 						}
 
-						SSL_CTX_set_tmp_ecdh(ctx->native_handle(), tmpNegotiationEcKey);
+						m_keyPoolRefilling = true;
+					}
 
-						bool atLeastOneInsert = false;
+					m_mintService.post(std::bind(&BaseInMemoryCertificateStore::RefillKeyPool, this));
+				}
 
-						if (sanDomains.size() > 0)
+				void BaseInMemoryCertificateStore::RefillKeyPool()
+				{
+					for (;;)
+					{
 						{
-							for (const auto& domain : sanDomains)
+							ScopedLock lock(m_keyPoolMutex);
+
+							if (m_keyPool.size() >= KeyPoolSize || m_sharedLeafKeyEnabled || m_mintService.stopped())
 							{
-								if (m_hostContexts.find(domain) == m_hostContexts.end())
-								{
-									m_hostContexts.insert({ domain, ctx });
-									atLeastOneInsert = true;
-								}
+								m_keyPoolRefilling = false;
+								return;
 							}
 						}
 
-						if (m_hostContexts.find(host) == m_hostContexts.end())
+						EVP_PKEY* key = nullptr;
+
+						try
 						{
-							m_hostContexts.insert({ host, ctx });
-							atLeastOneInsert = true;
+							key = GenerateEcKey();
 						}
-
-						if (!atLeastOneInsert)
+						catch (std::exception&)
 						{
-							// In this case, either the user has made an error and is duplicating data, or perhaps
-							// something more dirty is going on, where we have spoofed a certificate that is lying
-							// about its SN and or SAN's.
-							EC_KEY_free(tmpNegotiationEcKey);
-							EVP_PKEY_free(spoofedCertKeypair);
-							X509_free(spoofedCert);
-							delete ctx;
-							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Context already exists for specified host.");
+							// Try again next time a key is taken. Until then, keys will be generated
+							// as they're needed, which will report whatever the problem is.
+							ScopedLock lock(m_keyPoolMutex);
+							m_keyPoolRefilling = false;
+							return;
 						}
 
-						return ctx;
+						ScopedLock lock(m_keyPoolMutex);
+						m_keyPool.push_back(key);
 					}
-					else
+				}
+
+				void BaseInMemoryCertificateStore::RecordMintLatency(const std::chrono::steady_clock::duration latency)
+				{
+					const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(latency).count();
+
+					size_t bucket = 0;
+
+					while (bucket < MintLatencyBucketCount - 1 && milliseconds >= (static_cast<int64_t>(1) << bucket))
 					{
-						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GetServerContext(std::string, X509*) - Cannot spoof certificate. Either member CA , member CA keypair or certificate to spoof is nullptr.");
+						++bucket;
 					}
+
+					++m_mintLatencyBuckets[bucket];
+					++m_mints;
 				}
 
 				std::vector<char> BaseInMemoryCertificateStore::GetRootCertificatePEM() const
@@ -409,18 +1415,24 @@ namespace te
 
 					if (pkey == nullptr)
 					{
+						EC_KEY_free(eckey);
+
 						throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GenerateEcKey(const int) - Failed to allocate EVP_PKEY structure.");
 					}
 					else
 					{
 						if (EVP_PKEY_set1_EC_KEY(pkey, eckey) != 1)
 						{
+							EC_KEY_free(eckey);
 							EVP_PKEY_free(pkey);
 
 							throw std::runtime_error(u8"In BaseInMemoryCertificateStore::GenerateEcKey(const int) - Failed to assign EC_KEY to EVP_PKEY structure.");
 						}
 					}
 
+					// The EVP_PKEY took its own reference.
+					EC_KEY_free(eckey);
+
 					return pkey;
 				}
 
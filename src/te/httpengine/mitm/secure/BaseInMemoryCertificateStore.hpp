@@ -33,11 +33,24 @@
 
 #include <string>
 #include <unordered_map>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <list>
 #include <openssl/obj_mac.h>
 #include <boost/predef.h>
 #include "../../network/SocketTypes.hpp"
+#include "PersistentCertificateCache.hpp"
+#include "HostFrequencySketch.hpp"
 #include <mutex>
+#include <condition_variable>
 #include <thread>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace te
 {
@@ -76,6 +89,188 @@ namespace te
 					/// </summary>
 					static const std::string ContextCipherList;
 
+					/// <summary>
+					/// Generated contexts are handed out by shared pointer, since the store may
+					/// evict a context while clients are still being served with it.
+					/// </summary>
+					using SharedServerContext = std::shared_ptr<boost::asio::ssl::context>;
+
+					/// <summary>
+					/// Handler invoked with the outcome of ::AsyncGetServerContext(...). On success,
+					/// the context is valid and the message is empty. On failure, the context is
+					/// nullptr and the message says what went wrong.
+					/// </summary>
+					using ServerContextHandler = std::function<void(SharedServerContext, const std::string&)>;
+
+					/// <summary>
+					/// Snapshot of the context cache counters, as given by
+					/// ::GetContextCacheStatistics().
+					/// </summary>
+					struct ContextCacheStatistics
+					{
+						/// <summary>
+						/// Number of contexts presently stored.
+						/// </summary>
+						size_t contexts = 0;
+
+						/// <summary>
+						/// Number of host names the stored contexts are stored under, subject alt
+						/// names included.
+						/// </summary>
+						size_t hosts = 0;
+
+						/// <summary>
+						/// Rough measure of the memory held by the stored contexts.
+						/// </summary>
+						size_t approximateBytes = 0;
+
+						/// <summary>
+						/// Contexts dropped to make room for others.
+						/// </summary>
+						uint64_t evictions = 0;
+					};
+
+					/// <summary>
+					/// Maximum number of contexts stored. When full, a context that hasn't been
+					/// used lately is dropped to make room.
+					/// </summary>
+					static constexpr size_t MaxStoredContexts = 4096;
+
+					/// <summary>
+					/// Maximum number of bytes, as estimated, held by the stored contexts. When
+					/// exceeded, contexts that haven't been used lately are dropped to make room.
+					/// </summary>
+					static constexpr size_t MaxStoredContextBytes = 64 * 1024 * 1024;
+
+					/// <summary>
+					/// Number of pre-generated keypairs kept ready for spoofed certificates. The
+					/// pool is topped back up in the background whenever it falls to half this.
+					/// </summary>
+					static constexpr size_t KeyPoolSize = 32;
+
+					/// <summary>
+					/// Number of buckets in the mint latency histogram. See MintStatistics.
+					/// </summary>
+					static constexpr size_t MintLatencyBucketCount = 12;
+
+					/// <summary>
+					/// Snapshot of the minting counters, as given by ::GetMintStatistics().
+					/// </summary>
+					struct MintStatistics
+					{
+						/// <summary>
+						/// Contexts minted.
+						/// </summary>
+						uint64_t mints = 0;
+
+						/// <summary>
+						/// Keypairs taken ready made from the pool.
+						/// </summary>
+						uint64_t pooledKeys = 0;
+
+						/// <summary>
+						/// Keypairs that had to be generated on the spot, because the pool was
+						/// empty.
+						/// </summary>
+						uint64_t inlineKeys = 0;
+
+						/// <summary>
+						/// Contexts minted over the shared leaf key.
+						/// </summary>
+						uint64_t sharedKeys = 0;
+
+						/// <summary>
+						/// Contexts built over a certificate read back from the persistent cache,
+						/// rather than minted afresh. Counted among the mints all the same, unless
+						/// built by prewarming.
+						/// </summary>
+						uint64_t restored = 0;
+
+						/// <summary>
+						/// Histogram of the time taken from requesting a context that doesn't exist
+						/// yet, to having it, which is how much minting adds to the first handshake
+						/// with a new host. The first bucket counts mints under one millisecond, and
+						/// each bucket after that counts mints under twice the bound of the one
+						/// before, so 1, 2, 4 and so on. The last bucket counts everything over.
+						/// </summary>
+						std::array<uint64_t, MintLatencyBucketCount> latencyBuckets{};
+					};
+
+					/// <summary>
+					/// Snapshot of the prewarming counters, as given by ::GetPrewarmStatistics().
+					/// </summary>
+					struct PrewarmStatistics
+					{
+						/// <summary>
+						/// Prewarming passes completed.
+						/// </summary>
+						uint64_t passes = 0;
+
+						/// <summary>
+						/// Contexts made ready ahead of being asked for.
+						/// </summary>
+						uint64_t prewarmed = 0;
+
+						/// <summary>
+						/// Prewarmed contexts that were then asked for, sparing a client the wait for
+						/// a mint. The hit rate is this over the number of prewarmed contexts.
+						/// </summary>
+						uint64_t hits = 0;
+
+						/// <summary>
+						/// Number of hosts presently tracked as seen often.
+						/// </summary>
+						size_t trackedHosts = 0;
+
+						/// <summary>
+						/// Number of tracked hosts for which the certificate they last presented is
+						/// known, which are the only ones that can be prewarmed.
+						/// </summary>
+						size_t knownCertificates = 0;
+					};
+
+					/// <summary>
+					/// Number of threads minting contexts for ::AsyncGetServerContext(...).
+					/// </summary>
+					static constexpr uint32_t DefaultNumMintThreads = 2;
+
+					/// <summary>
+					/// Default number of the hosts seen most often to keep contexts ready for.
+					/// </summary>
+					static constexpr size_t DefaultPrewarmHostCount = 64;
+
+					/// <summary>
+					/// Most hosts that can be tracked as seen often, and so the most that can be
+					/// prewarmed.
+					/// </summary>
+					static constexpr size_t MaxPrewarmHostCount = 256;
+
+					/// <summary>
+					/// Number of seconds between prewarming passes.
+					/// </summary>
+					static constexpr long PrewarmIntervalSeconds = 600;
+
+					/// <summary>
+					/// Number of milliseconds to pause between prewarming one context and the
+					/// next, so that prewarming never takes more than a sliver of a core away
+					/// from minting for clients that are actually waiting.
+					/// </summary>
+					static constexpr long PrewarmPauseMilliseconds = 50;
+
+					/// <summary>
+					/// Default maximum number of sessions held in the server side session cache of
+					/// each context configured through ::ConfigureServerSessions(...). This is
+					/// OpenSSL's own default.
+					/// </summary>
+					static constexpr size_t DefaultServerSessionCacheSize = 20480;
+
+					/// <summary>
+					/// Number of seconds between session ticket key rotations. Tickets are accepted
+					/// for two rotations, and sessions live for one, so every ticket we issue stays
+					/// good for as long as its session does.
+					/// </summary>
+					static constexpr long SessionTicketKeyRotationSeconds = 3600;
+
 					/// <summary>
 					/// Default constructor, delegates to the parameterized constructure which
 					/// takes country code, organization name and common name, with default values.
@@ -98,17 +293,29 @@ namespace te
 					/// <param name="commonName">
 					/// The common name for the self signed CA to be generated.
 					/// </param>
+					/// <param name="cachePath">
+					/// The path of the persistent cache to keep the CA and every certificate spoofed
+					/// with it in, so that they survive a restart. Empty for no persistent cache.
+					/// See ::OpenPersistentCache(...). If the cache can't be opened, this throws.
+					/// </param>
+					/// <param name="cacheKey">
+					/// The key to encrypt the persistent cache with, which must be
+					/// PersistentCertificateCache::KeyLength bytes. It's up to the caller to keep it
+					/// somewhere safer than next to the file.
+					/// </param>
 					BaseInMemoryCertificateStore(
 						const std::string& countryCode, 
 						const std::string& organizationName, 
-						const std::string& commonName
+						const std::string& commonName,
+						const std::string& cachePath = std::string(),
+						const std::vector<unsigned char>& cacheKey = std::vector<unsigned char>()
 						);
 
 					/// <summary>
-					/// Destructor iterates over all generated boost::asio::ssl::context pointers
-					/// stored in the m_hostContexts member and attempts to correctly free the X509
-					/// structure, the temporary negotiation EC key, and the EVP_PKEY structure for
-					/// each context, finally calling delete on the parent boost::asio::ssl::context structure.
+					/// Destructor stops the minting threads and drops every stored context. Each
+					/// context's X509 and EVP_PKEY structures are freed along with the parent
+					/// boost::asio::ssl::context structure once the last reference to it goes,
+					/// which for contexts still in use by bridges may be after we're gone.
 					/// </summary>
 					virtual ~BaseInMemoryCertificateStore();
 
@@ -125,6 +332,8 @@ namespace te
 					/// extracted subject alt names as keys to point to the same generated
 					/// boost::asio::ssl::context. This is so that the same context can be
 					/// discovered for every single host that the certificate is meant to handle.
+					/// Only so many contexts are stored, and the least recently used are dropped
+					/// to make room for new ones, see MaxStoredContexts and MaxStoredContextBytes.
 					/// 
 					/// Every generated boost::asio::ssl::context is set to be a TLS1.2 server
 					/// context.
@@ -154,11 +363,125 @@ namespace te
 					/// certificates once issued from here.
 					/// </param>
 					/// <returns>
-					/// A pointer to the generated boost::asio::ssl::context object that been
+					/// A shared pointer to the generated boost::asio::ssl::context object that been
 					/// configured to utilize the successfully spoofed certificate, keypair and
-					/// temporary negotiation EC key in a server context.
+					/// temporary negotiation EC key in a server context. Hold on to it for as long
+					/// as the context is in use, as the store may drop its own reference at any
+					/// time.
+					/// </returns>
+					SharedServerContext GetServerContext(const std::string& hostname, X509* certificate);
+
+					/// <summary>
+					/// Asynchronous version of ::GetServerContext(...). A context that already exists
+					/// is handed over straight away, without contending with anything but other
+					/// lookups. Otherwise, the certificate is spoofed and the context created on one
+					/// of this store's own minting threads, so that the expensive bits, generating
+					/// the key and signing the certificate, never hold up the caller's thread.
+					/// Concurrent requests for a host that is already being minted don't start a
+					/// mint of their own, but simply wait on the one in flight.
+					/// 
+					/// The handler is always invoked through the supplied io_service, never from
+					/// within this call, even when the context already exists. Unlike
+					/// ::GetServerContext(...), this never throws. Errors are handed to the
+					/// handler instead.
+					/// </summary>
+					/// <param name="service">
+					/// The io_service through which the handler is to be invoked.
+					/// </param>
+					/// <param name="hostname">
+					/// See ::GetServerContext(...).
+					/// </param>
+					/// <param name="certificate">
+					/// See ::GetServerContext(...). The certificate is copied if need be, so it need
+					/// only be valid for the duration of this call.
+					/// </param>
+					/// <param name="handler">
+					/// The handler to invoke with the outcome.
+					/// </param>
+					void AsyncGetServerContext(boost::asio::io_service& service, const std::string& hostname, X509* certificate, ServerContextHandler handler);
+
+					/// <summary>
+					/// Gets a snapshot of the context cache counters.
+					/// </summary>
+					/// <returns>
+					/// The context cache counters.
+					/// </returns>
+					const ContextCacheStatistics GetContextCacheStatistics();
+
+					/// <summary>
+					/// Sets whether or not every spoofed certificate is issued over one long lived
+					/// leaf key, rather than over a key of its own. This takes key generation out
+					/// of minting altogether, leaving just building and signing the certificate.
+					/// The trade off is that anyone who could get the one key out of our memory
+					/// could impersonate every host we've spoofed, rather than just one, which,
+					/// given the CA key sits in the same memory, isn't much of a trade off. Only
+					/// applies to contexts minted from here on.
+					/// </summary>
+					/// <param name="enabled">
+					/// Whether or not to issue every spoofed certificate over the shared leaf key.
+					/// </param>
+					void SetSharedLeafKeyEnabled(const bool enabled);
+
+					/// <summary>
+					/// Gets whether or not every spoofed certificate is issued over one long lived
+					/// leaf key.
+					/// </summary>
+					/// <returns>
+					/// True if spoofed certificates share a leaf key, false otherwise.
+					/// </returns>
+					const bool GetSharedLeafKeyEnabled() const;
+
+					/// <summary>
+					/// Gets a snapshot of the minting counters, including the distribution of the
+					/// time minting adds to the first handshake with a new host.
+					/// </summary>
+					/// <returns>
+					/// The minting counters.
+					/// </returns>
+					const MintStatistics GetMintStatistics();
+
+					/// <summary>
+					/// Records that a client asked for the supplied host, by name, at the very
+					/// start of its handshake. The hosts asked for most often have contexts made
+					/// ready for them in the background, on startup and periodically after, so
+					/// that they're already there by the time they're asked for. See
+					/// ::SetPrewarmHostCount(...).
+					/// </summary>
+					/// <param name="hostname">
+					/// The host the client asked for.
+					/// </param>
+					void RecordHostSeen(const std::string& hostname);
+
+					/// <summary>
+					/// Sets the number of the hosts seen most often to keep contexts ready for.
+					/// Clamped to MaxPrewarmHostCount. Zero turns prewarming off.
+					///
+					/// A context can only be made ready for a host that has presented its
+					/// certificate to us at least once, since the spoofed certificate is copied
+					/// from it. Without a persistent cache, this means only since
+					/// startup. With it, the hosts seen most often, along with their certificates,
+					/// are kept in the file, and prewarmed on startup.
+					/// </summary>
+					/// <param name="count">
+					/// The number of hosts to keep contexts ready for.
+					/// </param>
+					void SetPrewarmHostCount(const size_t count);
+
+					/// <summary>
+					/// Gets the number of the hosts seen most often to keep contexts ready for.
+					/// </summary>
+					/// <returns>
+					/// The number of hosts to keep contexts ready for.
 					/// </returns>
-					boost::asio::ssl::context* GetServerContext(const std::string& hostname, X509* certificate);
+					const size_t GetPrewarmHostCount() const;
+
+					/// <summary>
+					/// Gets a snapshot of the prewarming counters, including the hit rate.
+					/// </summary>
+					/// <returns>
+					/// The prewarming counters.
+					/// </returns>
+					const PrewarmStatistics GetPrewarmStatistics();
 
 					/// <summary>
 					/// Attempts to install the current temporary root CA certificate for
@@ -199,17 +522,407 @@ namespace te
 					/// </returns>
 					std::vector<char> GetRootCertificatePEM() const;
 
+					/// <summary>
+					/// Configures the supplied server context to let clients resume their sessions,
+					/// both through the context's server side session cache, and through stateless
+					/// session tickets. Ticket keys are generated and rotated by this store, and
+					/// are shared across every context configured here, so that a ticket issued on
+					/// one context can be redeemed on any other.
+					/// 
+					/// Every context returned by ::GetServerContext(...) is configured this way.
+					/// However, OpenSSL looks up the session cache and the ticket keys on the context
+					/// a connection was created from, not the one it was switched over to
+					/// afterwards, which is what client bridges do with the contexts returned by
+					/// ::GetServerContext(...). So the default server context that client bridges
+					/// create their connections from must be configured here as well.
+					/// </summary>
+					/// <param name="context">
+					/// The server context to configure.
+					/// </param>
+					/// <returns>
+					/// True if the context was configured, false otherwise. A context that failed
+					/// configuration still works, it just won't resume sessions.
+					/// </returns>
+					const bool ConfigureServerSessions(SSL_CTX* context);
+
+					/// <summary>
+					/// Sets the maximum number of sessions held in the server side session cache of
+					/// each context configured from here on. Contexts already configured are not
+					/// changed, so for this to apply to the default server context of the
+					/// acceptors, it must be set before the proxy is started.
+					/// </summary>
+					/// <param name="size">
+					/// The maximum number of sessions to hold. Zero means no limit, as it does to
+					/// OpenSSL.
+					/// </param>
+					void SetServerSessionCacheSize(const size_t size);
+
+					/// <summary>
+					/// Gets the maximum number of sessions held in the server side session cache of
+					/// each context configured from here on.
+					/// </summary>
+					/// <returns>
+					/// The maximum number of sessions held.
+					/// </returns>
+					const size_t GetServerSessionCacheSize() const;
+
 				protected:
 
+					/// <summary>
+					/// Key material for encrypting and authenticating session tickets.
+					/// </summary>
+					struct SessionTicketKey
+					{
+						/// <summary>
+						/// Identifies the key within tickets, so that we know which key to decrypt a
+						/// ticket with.
+						/// </summary>
+						unsigned char name[16];
+
+						/// <summary>
+						/// The AES-256 key tickets are encrypted with.
+						/// </summary>
+						unsigned char aesKey[32];
+
+						/// <summary>
+						/// The HMAC-SHA256 key tickets are authenticated with.
+						/// </summary>
+						unsigned char hmacKey[32];
+
+						/// <summary>
+						/// When the key was generated.
+						/// </summary>
+						std::time_t created;
+					};
+
+					/// <summary>
+					/// Looks up the stored context for the supplied host, under a shared lock.
+					/// </summary>
+					/// <param name="host">
+					/// The host, in lower case.
+					/// </param>
+					/// <returns>
+					/// The stored context if there is one, nullptr otherwise.
+					/// </returns>
+					SharedServerContext FindServerContext(const std::string& host);
+
+					/// <summary>
+					/// Spoofs the supplied certificate and creates a server context around it, as
+					/// described at ::GetServerContext(...). Takes no locks, so any number of these
+					/// can run at once. Throws runtime_error on failure.
+					/// </summary>
+					/// <param name="host">
+					/// The host, in lower case.
+					/// </param>
+					/// <param name="originalCertificate">
+					/// The certificate to spoof.
+					/// </param>
+					/// <param name="sanDomains">
+					/// Filled with every DNS subject alt name copied into the spoofed certificate, in
+					/// lower case.
+					/// </param>
+					/// <returns>
+					/// The newly created context, not yet stored.
+					/// </returns>
+					boost::asio::ssl::context* SpoofServerContext(const std::string& host, X509* originalCertificate, std::vector<std::string>& sanDomains);
+
+					/// <summary>
+					/// Builds a server context over the supplied, fully issued certificate and its
+					/// keypair. The context takes over both. Throws runtime_error on failure, in
+					/// which case both are freed.
+					/// </summary>
+					/// <param name="spoofedCert">
+					/// The certificate.
+					/// </param>
+					/// <param name="spoofedCertKeypair">
+					/// The keypair of the certificate.
+					/// </param>
+					/// <returns>
+					/// The newly created context, not yet stored.
+					/// </returns>
+					boost::asio::ssl::context* CreateServerContext(X509* spoofedCert, EVP_PKEY* spoofedCertKeypair);
+
+					/// <summary>
+					/// Gets a new context for the supplied host, built over the certificate in the
+					/// persistent cache if there's one for the supplied certificate, or spoofed
+					/// afresh and then written to the persistent cache otherwise. Throws
+					/// runtime_error on failure.
+					/// </summary>
+					/// <param name="host">
+					/// The host, in lower case.
+					/// </param>
+					/// <param name="originalCertificate">
+					/// The certificate to spoof.
+					/// </param>
+					/// <param name="sanDomains">
+					/// Filled with every DNS subject alt name in the certificate, in lower case.
+					/// </param>
+					/// <returns>
+					/// The newly created context, not yet stored.
+					/// </returns>
+					boost::asio::ssl::context* ObtainServerContext(const std::string& host, X509* originalCertificate, std::vector<std::string>& sanDomains);
+
+					/// <summary>
+					/// Stores a newly created context under the host and every subject alt name it
+					/// was spoofed with, under an exclusive lock. If another context was stored for
+					/// the host in the meantime, the new one is freed and the one already stored is
+					/// kept.
+					/// </summary>
+					/// <returns>
+					/// The context stored for the host.
+					/// </returns>
+					SharedServerContext StoreServerContext(const std::string& host, boost::asio::ssl::context* ctx, const std::vector<std::string>& sanDomains, const bool prewarmed = false);
+
+					/// <summary>
+					/// Checks whether or not a context is stored for the supplied host, without
+					/// counting as a use of it.
+					/// </summary>
+					const bool HasServerContext(const std::string& host);
+
+					/// <summary>
+					/// Keeps a copy of the certificate presented by the supplied host, if the host
+					/// is among those seen most often, so that it can be prewarmed later.
+					/// </summary>
+					void RememberUpstreamCertificate(const std::string& host, X509* certificate);
+
+					/// <summary>
+					/// Drops remembered certificates of hosts no longer among those seen most
+					/// often. Must be called with m_upstreamCertificateMutex held.
+					/// </summary>
+					void PruneUpstreamCertificates();
+
+					/// <summary>
+					/// Keeps the CA and every certificate spoofed with it in an encrypted file at
+					/// the supplied path, so that they survive a restart. If the file already holds
+					/// a CA that hasn't expired, the CA generated on construction is thrown out in
+					/// favour of it, and certificates in the file are handed out again for as long
+					/// as the certificates they were spoofed from are still the ones presented, and
+					/// still valid. Otherwise, the file starts over with the CA generated on
+					/// construction.
+					///
+					/// Since this can change the CA, it is only ever called from the constructor,
+					/// before any of the threads that mint with the CA are started. Throws
+					/// runtime_error on failure.
+					/// </summary>
+					/// <param name="path">
+					/// The path of the file.
+					/// </param>
+					/// <param name="key">
+					/// The key to encrypt the file with.
+					/// </param>
+					void OpenPersistentCache(const std::string& path, const std::vector<unsigned char>& key);
+
+					/// <summary>
+					/// Runs on the prewarming thread, prewarming on request and every
+					/// PrewarmIntervalSeconds, until the store is destroyed.
+					/// </summary>
+					void RunPrewarming();
+
+					/// <summary>
+					/// Makes contexts ready for the hosts seen most often that don't have one,
+					/// one at a time, then writes the hosts seen most often to the persistent
+					/// cache, if enabled.
+					/// </summary>
+					void PrewarmServerContexts();
+
+					/// <summary>
+					/// Writes the hosts seen most often, along with the certificates they last
+					/// presented, to the persistent cache, if enabled.
+					/// </summary>
+					void PersistHostHistory();
+
+					/// <summary>
+					/// Drops stored contexts until there is room for one more, of the supplied
+					/// size. Must be called with m_contextLock held exclusively.
+					/// </summary>
+					void EvictServerContexts(const size_t incomingBytes);
+
+					/// <summary>
+					/// Gives a rough measure of the memory held by the supplied context.
+					/// </summary>
+					static const size_t EstimateServerContextBytes(boost::asio::ssl::context* ctx);
+
+					/// <summary>
+					/// Runs on a minting thread. Spoofs and stores a context for the supplied host,
+					/// then hands it, or the error, to everyone waiting on it.
+					/// </summary>
+					void MintServerContext(const std::string& host, std::shared_ptr<X509> certificate, const std::chrono::steady_clock::time_point requested);
+
+					/// <summary>
+					/// Gets a keypair to issue a spoofed certificate over. That's either a new
+					/// reference to the shared leaf key, if enabled, or a key from the pool, or
+					/// failing that, a freshly generated key. Throws runtime_error on failure.
+					/// </summary>
+					/// <returns>
+					/// The keypair, which the caller owns.
+					/// </returns>
+					EVP_PKEY* TakeLeafKey();
+
+					/// <summary>
+					/// Queues a refill of the key pool on a minting thread, if the pool is running
+					/// low and a refill isn't already queued.
+					/// </summary>
+					void RequestKeyPoolRefill();
+
+					/// <summary>
+					/// Runs on a minting thread. Generates keys until the pool is full.
+					/// </summary>
+					void RefillKeyPool();
+
+					/// <summary>
+					/// Adds a mint to the latency histogram.
+					/// </summary>
+					void RecordMintLatency(const std::chrono::steady_clock::duration latency);
+
+					/// <summary>
+					/// Frees the certificate and key held by the supplied context, then the context
+					/// itself. This is the deleter of every SharedServerContext the store creates.
+					/// </summary>
+					static void FreeServerContext(boost::asio::ssl::context* ctx);
+
+					/// <summary>
+					/// Session ticket key callback installed on every context configured through
+					/// ::ConfigureServerSessions(...). When encrypting, the newest key is used,
+					/// rotating keys first if it is due. When decrypting, the key named in the
+					/// ticket is used, and if it isn't the newest key, the client is asked to
+					/// replace the ticket with a fresh one.
+					/// </summary>
+					static int OnSessionTicketKey(SSL* ssl, unsigned char* keyName, unsigned char* iv, EVP_CIPHER_CTX* cipherContext, HMAC_CTX* hmacContext, int encrypt);
+
+					/// <summary>
+					/// Gets the index under which the owning store is kept in the extra data of
+					/// every context configured through ::ConfigureServerSessions(...).
+					/// </summary>
+					static int GetContextStoreIndex();
+
+					/// <summary>
+					/// Generates a new session ticket key if the newest key is due for rotation,
+					/// dropping any key too old to redeem tickets with anymore. Must be called with
+					/// m_ticketKeyMutex held.
+					/// </summary>
+					/// <returns>
+					/// True if the newest key is good to use, false if a new key was due but could
+					/// not be generated.
+					/// </returns>
+					const bool RotateTicketKeys();
+
 					/// <summary>
 					/// Lock for spoofing.
 					/// </summary>
 					using ScopedLock = std::lock_guard<std::mutex>;
 
 					/// <summary>
-					/// For synchronizing local storage of generated keys, certificates and contexts.
+					/// Shared lock for looking up stored contexts.
+					/// </summary>
+					using Reader = boost::shared_lock<boost::shared_mutex>;
+
+					/// <summary>
+					/// Exclusive lock for storing contexts.
+					/// </summary>
+					using Writer = boost::unique_lock<boost::shared_mutex>;
+
+					/// <summary>
+					/// For synchronizing local storage of generated contexts. Only held to look
+					/// contexts up and to store them, never while generating them.
 					/// </summary>
-					std::mutex m_spoofMutex;
+					boost::shared_mutex m_contextLock;
+
+					/// <summary>
+					/// A handler waiting on a mint, along with the io_service it must be invoked
+					/// through.
+					/// </summary>
+					struct ContextWaiter
+					{
+						boost::asio::io_service* service;
+
+						ServerContextHandler handler;
+					};
+
+					/// <summary>
+					/// For synchronizing access to the mints in flight.
+					/// </summary>
+					std::mutex m_mintMutex;
+
+					/// <summary>
+					/// Handlers waiting on each mint in flight, by host.
+					/// </summary>
+					std::unordered_map<std::string, std::vector<ContextWaiter>> m_mintsInFlight;
+
+					/// <summary>
+					/// Private io_service that the minting threads run.
+					/// </summary>
+					boost::asio::io_service m_mintService;
+
+					/// <summary>
+					/// Keeps the minting threads running while there's nothing to mint.
+					/// </summary>
+					std::unique_ptr<boost::asio::io_service::work> m_mintWork;
+
+					/// <summary>
+					/// The minting threads.
+					/// </summary>
+					std::vector<std::thread> m_mintThreads;
+
+					/// <summary>
+					/// Counts how often each host is asked for. See ::RecordHostSeen(...).
+					/// </summary>
+					HostFrequencySketch m_hostSketch{ MaxPrewarmHostCount };
+
+					/// <summary>
+					/// For synchronizing access to m_upstreamCertificates.
+					/// </summary>
+					std::mutex m_upstreamCertificateMutex;
+
+					/// <summary>
+					/// The certificate last presented by each of the hosts seen most often.
+					/// </summary>
+					std::unordered_map<std::string, std::shared_ptr<X509>> m_upstreamCertificates;
+
+					/// <summary>
+					/// For synchronizing m_prewarmStopping and m_prewarmRequested with the
+					/// prewarming thread.
+					/// </summary>
+					std::mutex m_prewarmMutex;
+
+					/// <summary>
+					/// Wakes the prewarming thread early, to stop or to prewarm right away.
+					/// </summary>
+					std::condition_variable m_prewarmCondition;
+
+					/// <summary>
+					/// Set when the store is being destroyed.
+					/// </summary>
+					bool m_prewarmStopping = false;
+
+					/// <summary>
+					/// Set to have the prewarming thread prewarm right away, rather than waiting
+					/// out the interval.
+					/// </summary>
+					bool m_prewarmRequested = false;
+
+					/// <summary>
+					/// The prewarming thread.
+					/// </summary>
+					std::thread m_prewarmThread;
+
+					/// <summary>
+					/// See ::SetPrewarmHostCount(...).
+					/// </summary>
+					std::atomic<size_t> m_prewarmHostCount{ DefaultPrewarmHostCount };
+
+					/// <summary>
+					/// The hosts last written to the persistent cache by ::PersistHostHistory(),
+					/// sorted, so that it isn't written over and over when nothing has changed.
+					/// Only touched by the prewarming thread, and by the destructor once that's
+					/// gone.
+					/// </summary>
+					std::vector<std::string> m_persistedHosts;
+
+					std::atomic<uint64_t> m_prewarmPasses{ 0 };
+
+					std::atomic<uint64_t> m_prewarmedContexts{ 0 };
+
+					std::atomic<uint64_t> m_prewarmHits{ 0 };
 
 					/// <summary>
 					/// Stores either the provided or default country code information to use for
@@ -240,12 +953,134 @@ namespace te
 					/// </summary>
 					EVP_PKEY* m_thisCaKeyPair = nullptr;
 
+					/// <summary>
+					/// Rough size, in bytes, of everything a stored context holds on to other than
+					/// its certificate. Padded to cover the parsed form of the certificate running
+					/// larger than its encoding.
+					/// </summary>
+					static constexpr size_t EstimatedContextOverheadBytes = 16 * 1024;
+
+					/// <summary>
+					/// Rough size, in bytes, of the bookkeeping for each host name a context is
+					/// stored under, not counting the name itself.
+					/// </summary>
+					static constexpr size_t EstimatedHostKeyOverheadBytes = 64;
+
+					/// <summary>
+					/// A stored context, along with every host name it's stored under.
+					/// </summary>
+					struct StoredContext
+					{
+						/// <summary>
+						/// The context. Ours is just one reference among those of any bridges using it.
+						/// </summary>
+						SharedServerContext context;
+
+						/// <summary>
+						/// Every key in m_hostContexts pointing to this entry.
+						/// </summary>
+						std::vector<std::string> hosts;
+
+						/// <summary>
+						/// Rough measure of the memory held by this entry.
+						/// </summary>
+						size_t bytes = 0;
+
+						/// <summary>
+						/// Set whenever the context is looked up, and cleared by eviction. Lookups
+						/// only hold a shared lock, so this is how they mark an entry as recently
+						/// used without reordering anything.
+						/// </summary>
+						std::atomic<bool> referenced{ false };
+
+						/// <summary>
+						/// Set if the context was made ready by prewarming, and cleared the first
+						/// time it's looked up, which is when it's counted as a prewarming hit.
+						/// </summary>
+						std::atomic<bool> prewarmed{ false };
+					};
+
+					/// <summary>
+					/// Stored contexts, roughly the most recently used first. Only ever changed
+					/// under an exclusive lock.
+					/// </summary>
+					std::list<StoredContext> m_storedContexts;
+
 					/// <summary>
 					/// Stores generated contexts using the host name as the lookup key. Due to the
 					/// existence of SAN's or Subject Alternative Names, it's possible to have
-					/// multiple keys pointing to the same structure. This makes cleanup a little tricky.
+					/// multiple keys pointing to the same structure, which is why the keys point to
+					/// entries in m_storedContexts, which own the contexts, rather than to the
+					/// contexts themselves.
+					/// </summary>
+					std::unordered_map<std::string, std::list<StoredContext>::iterator> m_hostContexts;
+
+					/// <summary>
+					/// Sum of the estimated sizes of every entry in m_storedContexts.
+					/// </summary>
+					size_t m_storedContextBytes = 0;
+
+					std::atomic<uint64_t> m_contextEvictions{ 0 };
+
+					/// <summary>
+					/// For synchronizing access to the key pool and the shared leaf key.
+					/// </summary>
+					std::mutex m_keyPoolMutex;
+
+					/// <summary>
+					/// Pre-generated keypairs, ready to be issued a spoofed certificate. We own one
+					/// reference to each.
+					/// </summary>
+					std::deque<EVP_PKEY*> m_keyPool;
+
+					/// <summary>
+					/// Whether or not a refill of the key pool is queued or underway.
+					/// </summary>
+					bool m_keyPoolRefilling = false;
+
+					/// <summary>
+					/// The shared leaf key, generated the first time it's needed. See
+					/// ::SetSharedLeafKeyEnabled(...).
+					/// </summary>
+					EC_KEY* m_sharedLeafKey = nullptr;
+
+					/// <summary>
+					/// See ::SetSharedLeafKeyEnabled(...).
+					/// </summary>
+					std::atomic<bool> m_sharedLeafKeyEnabled{ false };
+
+					std::atomic<uint64_t> m_mints{ 0 };
+
+					std::atomic<uint64_t> m_pooledKeysTaken{ 0 };
+
+					std::atomic<uint64_t> m_inlineKeysGenerated{ 0 };
+
+					std::atomic<uint64_t> m_sharedKeysTaken{ 0 };
+
+					std::atomic<uint64_t> m_restoredContexts{ 0 };
+
+					/// <summary>
+					/// The persistent cache, if enabled. See ::OpenPersistentCache(...).
+					/// </summary>
+					std::unique_ptr<PersistentCertificateCache> m_persistentCache;
+
+					std::array<std::atomic<uint64_t>, MintLatencyBucketCount> m_mintLatencyBuckets{};
+
+					/// <summary>
+					/// For synchronizing access to the session ticket keys. Kept apart from
+					/// m_spoofMutex, since tickets are handled on every handshake.
+					/// </summary>
+					std::mutex m_ticketKeyMutex;
+
+					/// <summary>
+					/// Session ticket keys, newest first.
+					/// </summary>
+					std::deque<SessionTicketKey> m_ticketKeys;
+
+					/// <summary>
+					/// See ::SetServerSessionCacheSize(...).
 					/// </summary>
-					std::unordered_map<std::string, boost::asio::ssl::context*> m_hostContexts;								
+					std::atomic<size_t> m_serverSessionCacheSize{ DefaultServerSessionCacheSize };
 
 					/// <summary>
 					/// Generates an EC key with the given named curve. As with basically every
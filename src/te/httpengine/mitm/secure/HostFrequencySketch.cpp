@@ -0,0 +1,212 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HostFrequencySketch.hpp"
+#include <algorithm>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace secure
+			{
+
+				HostFrequencySketch::HostFrequencySketch(const size_t maxCandidates)
+					:
+					m_counters(Width * Depth, 0),
+					m_maxCandidates(maxCandidates > 0 ? maxCandidates : 1)
+				{
+
+				}
+
+				HostFrequencySketch::~HostFrequencySketch()
+				{
+
+				}
+
+				void HostFrequencySketch::Record(const std::string& host, const uint32_t count)
+				{
+					if (host.size() == 0 || count == 0)
+					{
+						return;
+					}
+
+					const uint64_t hash = Hash(host);
+					const uint32_t first = static_cast<uint32_t>(hash);
+					const uint32_t second = static_cast<uint32_t>(hash >> 32) | 1;
+
+					size_t indices[Depth];
+
+					for (size_t row = 0; row < Depth; ++row)
+					{
+						indices[row] = row * Width + (first + static_cast<uint32_t>(row) * second) % Width;
+					}
+
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					uint32_t current = UINT32_MAX;
+
+					for (size_t row = 0; row < Depth; ++row)
+					{
+						current = std::min(current, m_counters[indices[row]]);
+					}
+
+					const uint32_t estimate = current > UINT32_MAX - count ? UINT32_MAX : current + count;
+
+					// Conservative update. Counters already above the new estimate have been
+					// pushed there by other hosts, so raising them would only add to the
+					// overcount of those hosts.
+					for (size_t row = 0; row < Depth; ++row)
+					{
+						if (m_counters[indices[row]] < estimate)
+						{
+							m_counters[indices[row]] = estimate;
+						}
+					}
+
+					auto candidate = m_candidates.find(host);
+
+					if (candidate != m_candidates.end())
+					{
+						candidate->second = estimate;
+					}
+					else if (m_candidates.size() < m_maxCandidates)
+					{
+						m_candidates.emplace(host, estimate);
+					}
+					else
+					{
+						auto weakest = m_candidates.begin();
+
+						for (auto it = m_candidates.begin(); it != m_candidates.end(); ++it)
+						{
+							if (it->second < weakest->second)
+							{
+								weakest = it;
+							}
+						}
+
+						if (weakest->second < estimate)
+						{
+							m_candidates.erase(weakest);
+							m_candidates.emplace(host, estimate);
+						}
+					}
+
+					m_sinceAging += count;
+
+					if (m_sinceAging >= AgingPeriod)
+					{
+						Age();
+					}
+				}
+
+				const bool HostFrequencySketch::IsCandidate(const std::string& host)
+				{
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					return m_candidates.find(host) != m_candidates.end();
+				}
+
+				std::vector<std::pair<std::string, uint32_t>> HostFrequencySketch::GetTop(const size_t count)
+				{
+					std::vector<std::pair<std::string, uint32_t>> top;
+
+					{
+						std::lock_guard<std::mutex> lock(m_lock);
+
+						top.assign(m_candidates.begin(), m_candidates.end());
+					}
+
+					std::sort(top.begin(), top.end(), [](const std::pair<std::string, uint32_t>& a, const std::pair<std::string, uint32_t>& b)
+					{
+						return a.second > b.second;
+					});
+
+					if (top.size() > count)
+					{
+						top.resize(count);
+					}
+
+					return top;
+				}
+
+				const size_t HostFrequencySketch::GetCandidateCount()
+				{
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					return m_candidates.size();
+				}
+
+				void HostFrequencySketch::Age()
+				{
+					for (auto& counter : m_counters)
+					{
+						counter >>= 1;
+					}
+
+					for (auto candidate = m_candidates.begin(); candidate != m_candidates.end();)
+					{
+						candidate->second >>= 1;
+
+						if (candidate->second == 0)
+						{
+							candidate = m_candidates.erase(candidate);
+							continue;
+						}
+
+						++candidate;
+					}
+
+					m_sinceAging = 0;
+				}
+
+				const uint64_t HostFrequencySketch::Hash(const std::string& host)
+				{
+					// FNV-1a. Doesn't need to be anything more, since all that's at stake is how
+					// evenly hosts spread over the counters.
+					uint64_t hash = 14695981039346656037ULL;
+
+					for (const char c : host)
+					{
+						hash ^= static_cast<unsigned char>(c);
+						hash *= 1099511628211ULL;
+					}
+
+					return hash;
+				}
+
+			} /* namespace secure */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
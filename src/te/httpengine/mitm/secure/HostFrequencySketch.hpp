@@ -0,0 +1,190 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace secure
+			{
+
+				/// <summary>
+				/// Keeps a rough count of how often each host is seen, in a fixed amount of memory
+				/// no matter how many hosts there are, along with a short list of the hosts seen
+				/// most often.
+				///
+				/// The counts live in a count-min sketch: a few rows of counters, with each host
+				/// hashed to one counter per row. A host's count is the smallest of its counters,
+				/// which can only ever run over the true count, never under, and only by as much
+				/// as the hosts it shares every counter with. Only the smallest of a host's
+				/// counters are raised, which keeps that overcount down.
+				///
+				/// Every so often, all counts are halved, so that hosts that used to be popular
+				/// but no longer are make way for those that are popular now.
+				/// </summary>
+				class HostFrequencySketch
+				{
+
+				public:
+
+					/// <summary>
+					/// Number of counters in each row.
+					/// </summary>
+					static constexpr size_t Width = 4096;
+
+					/// <summary>
+					/// Number of rows.
+					/// </summary>
+					static constexpr size_t Depth = 4;
+
+					/// <summary>
+					/// Number of sightings after which all counts are halved.
+					/// </summary>
+					static constexpr uint64_t AgingPeriod = Width * 16;
+
+					/// <summary>
+					/// Constructs a new, empty sketch.
+					/// </summary>
+					/// <param name="maxCandidates">
+					/// The number of hosts seen most often to keep track of by name.
+					/// </param>
+					HostFrequencySketch(const size_t maxCandidates);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					HostFrequencySketch(const HostFrequencySketch&) = delete;
+					HostFrequencySketch(HostFrequencySketch&&) = delete;
+					HostFrequencySketch& operator=(const HostFrequencySketch&) = delete;
+
+					/// <summary>
+					/// Default destructor.
+					/// </summary>
+					~HostFrequencySketch();
+
+					/// <summary>
+					/// Records sightings of the supplied host.
+					/// </summary>
+					/// <param name="host">
+					/// The host, in lower case.
+					/// </param>
+					/// <param name="count">
+					/// The number of sightings.
+					/// </param>
+					void Record(const std::string& host, const uint32_t count = 1);
+
+					/// <summary>
+					/// Checks whether or not the supplied host is presently among the hosts seen
+					/// most often.
+					/// </summary>
+					/// <param name="host">
+					/// The host, in lower case.
+					/// </param>
+					/// <returns>
+					/// True if the host is among the hosts seen most often, false otherwise.
+					/// </returns>
+					const bool IsCandidate(const std::string& host);
+
+					/// <summary>
+					/// Gets the hosts seen most often, along with their counts, most often first.
+					/// </summary>
+					/// <param name="count">
+					/// The maximum number of hosts to get.
+					/// </param>
+					/// <returns>
+					/// The hosts seen most often.
+					/// </returns>
+					std::vector<std::pair<std::string, uint32_t>> GetTop(const size_t count);
+
+					/// <summary>
+					/// Gets the number of hosts presently tracked by name.
+					/// </summary>
+					/// <returns>
+					/// The number of hosts presently tracked by name.
+					/// </returns>
+					const size_t GetCandidateCount();
+
+				private:
+
+					/// <summary>
+					/// Halves every count, and drops any host tracked by name whose count reaches
+					/// zero. Must be called with m_lock held.
+					/// </summary>
+					void Age();
+
+					/// <summary>
+					/// Hashes the supplied host. The two halves of the hash are combined to pick a
+					/// counter in each row.
+					/// </summary>
+					static const uint64_t Hash(const std::string& host);
+
+					/// <summary>
+					/// Guards everything below.
+					/// </summary>
+					std::mutex m_lock;
+
+					/// <summary>
+					/// Every row of counters, one after the other.
+					/// </summary>
+					std::vector<uint32_t> m_counters;
+
+					/// <summary>
+					/// The hosts seen most often, with their counts as of when last seen.
+					/// </summary>
+					std::unordered_map<std::string, uint32_t> m_candidates;
+
+					/// <summary>
+					/// See the constructor.
+					/// </summary>
+					const size_t m_maxCandidates;
+
+					/// <summary>
+					/// Sightings recorded since counts were last halved.
+					/// </summary>
+					uint64_t m_sinceAging = 0;
+
+				};
+
+			} /* namespace secure */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
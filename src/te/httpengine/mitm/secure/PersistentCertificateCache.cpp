@@ -0,0 +1,1003 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PersistentCertificateCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <boost/predef/os.h>
+
+#if BOOST_OS_WINDOWS
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif // if BOOST_OS_WINDOWS
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace secure
+			{
+
+				namespace
+				{
+					/// <summary>
+					/// Every file starts with this, so that we never go scribbling over some file
+					/// that isn't ours.
+					/// </summary>
+					const char FileMagic[8] = { 'T', 'E', 'C', 'E', 'R', 'T', 'S', '1' };
+
+					void PutU32(std::vector<unsigned char>& out, const uint32_t value)
+					{
+						for (int i = 0; i < 4; ++i)
+						{
+							out.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+						}
+					}
+
+					void PutI64(std::vector<unsigned char>& out, const int64_t value)
+					{
+						const uint64_t bits = static_cast<uint64_t>(value);
+
+						for (int i = 0; i < 8; ++i)
+						{
+							out.push_back(static_cast<unsigned char>((bits >> (8 * i)) & 0xFF));
+						}
+					}
+
+					const uint32_t GetU32(const unsigned char* in)
+					{
+						uint32_t value = 0;
+
+						for (int i = 0; i < 4; ++i)
+						{
+							value |= static_cast<uint32_t>(in[i]) << (8 * i);
+						}
+
+						return value;
+					}
+
+					const int64_t GetI64(const unsigned char* in)
+					{
+						uint64_t bits = 0;
+
+						for (int i = 0; i < 8; ++i)
+						{
+							bits |= static_cast<uint64_t>(in[i]) << (8 * i);
+						}
+
+						return static_cast<int64_t>(bits);
+					}
+
+					/// <summary>
+					/// Reads a length prefixed field out of decrypted contents, advancing past it.
+					/// </summary>
+					const bool GetField(const std::vector<unsigned char>& in, size_t& position, const unsigned char*& field, size_t& length)
+					{
+						if (in.size() - position < 4)
+						{
+							return false;
+						}
+
+						length = GetU32(in.data() + position);
+						position += 4;
+
+						if (in.size() - position < length)
+						{
+							return false;
+						}
+
+						field = in.data() + position;
+						position += length;
+
+						return true;
+					}
+
+					/// <summary>
+					/// Gets the supplied ASN1 time as seconds since the epoch.
+					/// </summary>
+					const bool ToEpochSeconds(const ASN1_TIME* time, int64_t& seconds)
+					{
+						int days = 0;
+						int remainder = 0;
+
+						// Relative to now, since there's no portable way to convert one outright.
+						if (time == nullptr || ASN1_TIME_diff(&days, &remainder, nullptr, time) != 1)
+						{
+							return false;
+						}
+
+						seconds = static_cast<int64_t>(std::time(nullptr)) + static_cast<int64_t>(days) * 86400 + remainder;
+
+						return true;
+					}
+
+					/// <summary>
+					/// Wipes and frees whatever the supplied entry holds.
+					/// </summary>
+					void ReleaseEntry(PersistentCertificateCache::Entry& entry)
+					{
+						if (entry.keypair != nullptr)
+						{
+							EVP_PKEY_free(entry.keypair);
+							entry.keypair = nullptr;
+						}
+
+						if (entry.certificate != nullptr)
+						{
+							X509_free(entry.certificate);
+							entry.certificate = nullptr;
+						}
+
+						entry.sanDomains.clear();
+					}
+
+					#if BOOST_OS_WINDOWS
+
+					/// <summary>
+					/// Converts the supplied UTF-8 path into the UTF-16 the Windows API wants.
+					/// </summary>
+					std::wstring WidenPath(const std::string& path)
+					{
+						const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), static_cast<int>(path.size()), nullptr, 0);
+
+						if (length <= 0)
+						{
+							return std::wstring();
+						}
+
+						std::wstring widened(static_cast<size_t>(length), L'\0');
+
+						MultiByteToWideChar(CP_UTF8, 0, path.c_str(), static_cast<int>(path.size()), &widened[0], length);
+
+						return widened;
+					}
+
+					#endif // if BOOST_OS_WINDOWS
+				}
+
+				PersistentCertificateCache::PersistentCertificateCache(const std::string& path, const std::vector<unsigned char>& key)
+					:
+					m_path(path)
+				{
+					if (key.size() != KeyLength)
+					{
+						throw std::runtime_error(u8"In PersistentCertificateCache::PersistentCertificateCache(const std::string&, const std::vector<unsigned char>&) - Key is of the wrong length.");
+					}
+
+					// Separate keys for sealing and for lookups, so that neither use of the one
+					// key can say anything about the other.
+					unsigned int derivedLength = 0;
+
+					if (
+						HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()), reinterpret_cast<const unsigned char*>(u8"seal"), 4, m_sealKey, &derivedLength) == nullptr ||
+						HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()), reinterpret_cast<const unsigned char*>(u8"lookup"), 6, m_lookupKey, &derivedLength) == nullptr
+						)
+					{
+						OPENSSL_cleanse(m_sealKey, sizeof(m_sealKey));
+						OPENSSL_cleanse(m_lookupKey, sizeof(m_lookupKey));
+						throw std::runtime_error(u8"In PersistentCertificateCache::PersistentCertificateCache(const std::string&, const std::vector<unsigned char>&) - Failed to derive keys.");
+					}
+
+					if (MapAndIndex())
+					{
+						Compact();
+						MapAndIndex();
+					}
+
+					if (m_validSize != m_viewSize)
+					{
+						// The file ends in a torn record, and rewriting it didn't pan out. Anything
+						// appended after the torn record would never be found again, so don't
+						// bother. What's in the file can still be read.
+						return;
+					}
+
+					#if BOOST_OS_WINDOWS
+					m_appender.open(WidenPath(m_path), std::ios::binary | std::ios::app);
+					#else
+					m_appender.open(m_path, std::ios::binary | std::ios::app);
+					#endif // if BOOST_OS_WINDOWS
+
+					if (!m_appender.is_open())
+					{
+						Unmap();
+						OPENSSL_cleanse(m_sealKey, sizeof(m_sealKey));
+						OPENSSL_cleanse(m_lookupKey, sizeof(m_lookupKey));
+						throw std::runtime_error(u8"In PersistentCertificateCache::PersistentCertificateCache(const std::string&, const std::vector<unsigned char>&) - Failed to open file for appending.");
+					}
+
+					if (m_viewSize == 0)
+					{
+						m_appender.write(FileMagic, sizeof(FileMagic));
+						m_appender.flush();
+					}
+				}
+
+				PersistentCertificateCache::~PersistentCertificateCache()
+				{
+					if (m_appender.is_open())
+					{
+						m_appender.close();
+					}
+
+					Unmap();
+
+					OPENSSL_cleanse(m_sealKey, sizeof(m_sealKey));
+					OPENSSL_cleanse(m_lookupKey, sizeof(m_lookupKey));
+				}
+
+				const bool PersistentCertificateCache::LoadCertificateAuthority(Entry& entry)
+				{
+					if (m_certificateAuthority.length == 0)
+					{
+						return false;
+					}
+
+					return Read(m_certificateAuthority, entry);
+				}
+
+				const bool PersistentCertificateCache::StoreCertificateAuthority(EVP_PKEY* keypair, X509* certificate)
+				{
+					int64_t expires = 0;
+
+					if (keypair == nullptr || certificate == nullptr || !ToEpochSeconds(X509_get_notAfter(certificate), expires))
+					{
+						return false;
+					}
+
+					std::vector<unsigned char> contents;
+
+					if (!Encode(keypair, certificate, std::vector<std::string>(), contents))
+					{
+						return false;
+					}
+
+					const unsigned char lookupId[LookupIdLength] = { 0 };
+
+					const bool stored = Append(CertificateAuthorityRecord, lookupId, expires, contents);
+
+					OPENSSL_cleanse(contents.data(), contents.size());
+
+					if (stored)
+					{
+						// Whatever was in the file was signed by some other CA.
+						m_certificateAuthority = RecordRef{ 0, 0, 0 };
+						m_index.clear();
+					}
+
+					return stored;
+				}
+
+				const bool PersistentCertificateCache::Find(const std::string& host, X509* upstreamCertificate, Entry& entry)
+				{
+					if (m_index.size() == 0)
+					{
+						return false;
+					}
+
+					unsigned char lookupId[LookupIdLength];
+
+					if (!MakeLookupId(host, upstreamCertificate, lookupId))
+					{
+						return false;
+					}
+
+					auto record = m_index.find(std::string(reinterpret_cast<const char*>(lookupId), LookupIdLength));
+
+					if (record == m_index.end())
+					{
+						return false;
+					}
+
+					return Read(record->second, entry);
+				}
+
+				const bool PersistentCertificateCache::Store(const std::string& host, X509* upstreamCertificate, EVP_PKEY* keypair, X509* certificate, const std::vector<std::string>& sanDomains)
+				{
+					if (keypair == nullptr || certificate == nullptr)
+					{
+						return false;
+					}
+
+					// The spoofed certificate is only any good for as long as the certificate it
+					// was spoofed from is.
+					int64_t upstreamExpires = 0;
+					int64_t spoofedExpires = 0;
+
+					if (
+						!ToEpochSeconds(X509_get_notAfter(upstreamCertificate), upstreamExpires) ||
+						!ToEpochSeconds(X509_get_notAfter(certificate), spoofedExpires)
+						)
+					{
+						return false;
+					}
+
+					unsigned char lookupId[LookupIdLength];
+
+					if (!MakeLookupId(host, upstreamCertificate, lookupId))
+					{
+						return false;
+					}
+
+					std::vector<unsigned char> contents;
+
+					if (!Encode(keypair, certificate, sanDomains, contents))
+					{
+						return false;
+					}
+
+					const bool stored = Append(HostRecord, lookupId, upstreamExpires < spoofedExpires ? upstreamExpires : spoofedExpires, contents);
+
+					OPENSSL_cleanse(contents.data(), contents.size());
+
+					return stored;
+				}
+
+				const bool PersistentCertificateCache::LoadHostHistory(std::vector<HostHistoryEntry>& history)
+				{
+					std::vector<unsigned char> contents;
+
+					if (m_hostHistory.length == 0 || !Unseal(m_hostHistory, contents))
+					{
+						return false;
+					}
+
+					history.clear();
+
+					if (contents.size() < 4)
+					{
+						return false;
+					}
+
+					const uint32_t count = GetU32(contents.data());
+					size_t position = 4;
+
+					for (uint32_t i = 0; i < count; ++i)
+					{
+						const unsigned char* host = nullptr;
+						size_t hostLength = 0;
+						const unsigned char* certificate = nullptr;
+						size_t certificateLength = 0;
+
+						if (!GetField(contents, position, host, hostLength) || contents.size() - position < 4)
+						{
+							break;
+						}
+
+						const uint32_t seen = GetU32(contents.data() + position);
+						position += 4;
+
+						if (!GetField(contents, position, certificate, certificateLength))
+						{
+							break;
+						}
+
+						X509* upstreamCertificate = d2i_X509(nullptr, &certificate, static_cast<long>(certificateLength));
+
+						if (upstreamCertificate == nullptr)
+						{
+							continue;
+						}
+
+						// No use making a context ready for a certificate that's no longer valid,
+						// since the host must present some other one by now.
+						if (X509_cmp_current_time(X509_get_notAfter(upstreamCertificate)) <= 0)
+						{
+							X509_free(upstreamCertificate);
+							continue;
+						}
+
+						HostHistoryEntry entry;
+						entry.host.assign(reinterpret_cast<const char*>(host), hostLength);
+						entry.seen = seen;
+						entry.upstreamCertificate = upstreamCertificate;
+
+						history.push_back(std::move(entry));
+					}
+
+					return true;
+				}
+
+				const bool PersistentCertificateCache::StoreHostHistory(const std::vector<HostHistoryEntry>& history)
+				{
+					std::vector<unsigned char> contents;
+
+					PutU32(contents, 0);
+
+					uint32_t count = 0;
+
+					for (const auto& entry : history)
+					{
+						const int certificateLength = entry.upstreamCertificate != nullptr ? i2d_X509(entry.upstreamCertificate, nullptr) : 0;
+
+						if (certificateLength <= 0)
+						{
+							continue;
+						}
+
+						PutU32(contents, static_cast<uint32_t>(entry.host.size()));
+						contents.insert(contents.end(), entry.host.begin(), entry.host.end());
+						PutU32(contents, entry.seen);
+						PutU32(contents, static_cast<uint32_t>(certificateLength));
+						contents.resize(contents.size() + static_cast<size_t>(certificateLength));
+
+						unsigned char* out = contents.data() + contents.size() - certificateLength;
+
+						if (i2d_X509(entry.upstreamCertificate, &out) != certificateLength)
+						{
+							return false;
+						}
+
+						++count;
+					}
+
+					for (int i = 0; i < 4; ++i)
+					{
+						contents[i] = static_cast<unsigned char>((count >> (8 * i)) & 0xFF);
+					}
+
+					unsigned char lookupId[LookupIdLength];
+					std::memset(lookupId, 0xFF, sizeof(lookupId));
+
+					const bool stored = Append(HostHistoryRecord, lookupId, static_cast<int64_t>(std::time(nullptr)) + HostHistoryLifetimeSeconds, contents);
+
+					OPENSSL_cleanse(contents.data(), contents.size());
+
+					return stored;
+				}
+
+				const bool PersistentCertificateCache::MapAndIndex()
+				{
+					Unmap();
+
+					m_certificateAuthority = RecordRef{ 0, 0, 0 };
+					m_hostHistory = RecordRef{ 0, 0, 0 };
+					m_index.clear();
+					m_validSize = 0;
+
+					size_t size = 0;
+					void* view = nullptr;
+
+					#if BOOST_OS_WINDOWS
+
+					HANDLE handle = CreateFileW(
+						WidenPath(m_path).c_str(),
+						GENERIC_READ,
+						FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+						nullptr,
+						OPEN_EXISTING,
+						FILE_ATTRIBUTE_NORMAL,
+						nullptr);
+
+					if (handle == INVALID_HANDLE_VALUE)
+					{
+						// Doesn't exist yet.
+						return false;
+					}
+
+					LARGE_INTEGER fileSize;
+
+					if (!GetFileSizeEx(handle, &fileSize))
+					{
+						CloseHandle(handle);
+						throw std::runtime_error(u8"In PersistentCertificateCache::MapAndIndex() - Failed to get file size.");
+					}
+
+					size = static_cast<size_t>(fileSize.QuadPart);
+
+					if (size > 0)
+					{
+						HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+						if (mapping != nullptr)
+						{
+							view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+
+							// The view keeps the mapping object, and with it the file, alive by itself.
+							CloseHandle(mapping);
+						}
+					}
+
+					CloseHandle(handle);
+
+					#else
+
+					const int descriptor = open(m_path.c_str(), O_RDONLY);
+
+					if (descriptor == -1)
+					{
+						// Doesn't exist yet.
+						return false;
+					}
+
+					struct stat status;
+
+					if (fstat(descriptor, &status) != 0)
+					{
+						close(descriptor);
+						throw std::runtime_error(u8"In PersistentCertificateCache::MapAndIndex() - Failed to get file size.");
+					}
+
+					size = static_cast<size_t>(status.st_size);
+
+					if (size > 0)
+					{
+						view = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+
+						if (view == MAP_FAILED)
+						{
+							view = nullptr;
+						}
+					}
+
+					// The mapping keeps the file alive by itself.
+					close(descriptor);
+
+					#endif // if BOOST_OS_WINDOWS
+
+					if (size == 0)
+					{
+						// Brand new. The magic goes in when it's opened for appending.
+						return false;
+					}
+
+					if (view == nullptr)
+					{
+						throw std::runtime_error(u8"In PersistentCertificateCache::MapAndIndex() - Failed to map file.");
+					}
+
+					m_view = static_cast<const unsigned char*>(view);
+					m_viewSize = size;
+
+					if (size < sizeof(FileMagic) || std::memcmp(m_view, FileMagic, sizeof(FileMagic)) != 0)
+					{
+						Unmap();
+						throw std::runtime_error(u8"In PersistentCertificateCache::MapAndIndex() - File is not a certificate cache.");
+					}
+
+					// Only the headers are read here. Later records win over earlier ones with the
+					// same id, and a CA record wipes out everything before it, since whatever was
+					// signed by the CA it replaced is of no use anymore.
+					size_t offset = sizeof(FileMagic);
+
+					while (m_viewSize - offset >= 4)
+					{
+						const size_t length = GetU32(m_view + offset);
+
+						if (length < RecordHeaderLength + TagLength || m_viewSize - offset - 4 < length)
+						{
+							break;
+						}
+
+						const unsigned char* header = m_view + offset + 4;
+
+						const RecordRef record{ offset, 4 + length, GetI64(header + 1 + LookupIdLength) };
+
+						switch (header[0])
+						{
+							case CertificateAuthorityRecord:
+							{
+								m_certificateAuthority = record;
+								m_index.clear();
+							}
+							break;
+
+							case HostRecord:
+							{
+								m_index[std::string(reinterpret_cast<const char*>(header + 1), LookupIdLength)] = record;
+							}
+							break;
+
+							case HostHistoryRecord:
+							{
+								m_hostHistory = record;
+							}
+							break;
+
+							default:
+							break;
+						}
+
+						offset += record.length;
+					}
+
+					m_validSize = offset;
+
+					const int64_t now = static_cast<int64_t>(std::time(nullptr));
+
+					if (m_certificateAuthority.length == 0 || m_certificateAuthority.expires <= now)
+					{
+						// Without the CA that signed them, there's no using any of the others.
+						m_certificateAuthority = RecordRef{ 0, 0, 0 };
+						m_index.clear();
+					}
+
+					if (m_hostHistory.expires <= now)
+					{
+						m_hostHistory = RecordRef{ 0, 0, 0 };
+					}
+
+					size_t liveBytes = sizeof(FileMagic) + m_certificateAuthority.length + m_hostHistory.length;
+
+					for (auto record = m_index.begin(); record != m_index.end();)
+					{
+						if (record->second.expires <= now)
+						{
+							record = m_index.erase(record);
+							continue;
+						}
+
+						liveBytes += record->second.length;
+						++record;
+					}
+
+					const size_t deadBytes = m_viewSize - liveBytes;
+
+					return m_validSize != m_viewSize || (deadBytes > liveBytes && deadBytes >= MinCompactionBytes);
+				}
+
+				const bool PersistentCertificateCache::Compact()
+				{
+					const std::string temporaryPath = m_path + u8".tmp";
+
+					{
+						#if BOOST_OS_WINDOWS
+						std::ofstream rewritten(WidenPath(temporaryPath), std::ios::binary | std::ios::trunc);
+						#else
+						std::ofstream rewritten(temporaryPath, std::ios::binary | std::ios::trunc);
+						#endif // if BOOST_OS_WINDOWS
+
+						if (!rewritten.is_open())
+						{
+							return false;
+						}
+
+						rewritten.write(FileMagic, sizeof(FileMagic));
+
+						if (m_hostHistory.length > 0)
+						{
+							rewritten.write(reinterpret_cast<const char*>(m_view + m_hostHistory.offset), m_hostHistory.length);
+						}
+
+						// The CA goes first, so that it doesn't wipe out what follows next time.
+						if (m_certificateAuthority.length > 0)
+						{
+							rewritten.write(reinterpret_cast<const char*>(m_view + m_certificateAuthority.offset), m_certificateAuthority.length);
+
+							for (const auto& record : m_index)
+							{
+								rewritten.write(reinterpret_cast<const char*>(m_view + record.second.offset), record.second.length);
+							}
+						}
+
+						rewritten.flush();
+
+						if (!rewritten.good())
+						{
+							rewritten.close();
+							std::remove(temporaryPath.c_str());
+							return false;
+						}
+					}
+
+					// Can't replace the file while it's mapped, on Windows anyway.
+					Unmap();
+
+					#if BOOST_OS_WINDOWS
+					const bool replaced = MoveFileExW(WidenPath(temporaryPath).c_str(), WidenPath(m_path).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+					#else
+					const bool replaced = std::rename(temporaryPath.c_str(), m_path.c_str()) == 0;
+					#endif // if BOOST_OS_WINDOWS
+
+					if (!replaced)
+					{
+						std::remove(temporaryPath.c_str());
+					}
+
+					return replaced;
+				}
+
+				void PersistentCertificateCache::Unmap()
+				{
+					if (m_view == nullptr)
+					{
+						return;
+					}
+
+					#if BOOST_OS_WINDOWS
+
+					UnmapViewOfFile(m_view);
+
+					#else
+
+					munmap(const_cast<unsigned char*>(m_view), m_viewSize);
+
+					#endif // if BOOST_OS_WINDOWS
+
+					m_view = nullptr;
+					m_viewSize = 0;
+				}
+
+				const bool PersistentCertificateCache::MakeLookupId(const std::string& host, X509* upstreamCertificate, unsigned char* lookupId) const
+				{
+					if (upstreamCertificate == nullptr)
+					{
+						return false;
+					}
+
+					unsigned char fingerprint[EVP_MAX_MD_SIZE];
+					unsigned int fingerprintLength = 0;
+
+					if (X509_digest(upstreamCertificate, EVP_sha256(), fingerprint, &fingerprintLength) != 1)
+					{
+						return false;
+					}
+
+					std::vector<unsigned char> material(host.begin(), host.end());
+					material.push_back(0);
+					material.insert(material.end(), fingerprint, fingerprint + fingerprintLength);
+
+					unsigned int lookupIdLength = 0;
+
+					return HMAC(EVP_sha256(), m_lookupKey, sizeof(m_lookupKey), material.data(), material.size(), lookupId, &lookupIdLength) != nullptr;
+				}
+
+				const bool PersistentCertificateCache::Encode(EVP_PKEY* keypair, X509* certificate, const std::vector<std::string>& sanDomains, std::vector<unsigned char>& contents) const
+				{
+					const int keyLength = i2d_PrivateKey(keypair, nullptr);
+					const int certificateLength = i2d_X509(certificate, nullptr);
+
+					if (keyLength <= 0 || certificateLength <= 0)
+					{
+						return false;
+					}
+
+					contents.clear();
+
+					PutU32(contents, static_cast<uint32_t>(keyLength));
+					contents.resize(contents.size() + static_cast<size_t>(keyLength));
+
+					unsigned char* out = contents.data() + contents.size() - keyLength;
+
+					if (i2d_PrivateKey(keypair, &out) != keyLength)
+					{
+						OPENSSL_cleanse(contents.data(), contents.size());
+						return false;
+					}
+
+					PutU32(contents, static_cast<uint32_t>(certificateLength));
+					contents.resize(contents.size() + static_cast<size_t>(certificateLength));
+
+					out = contents.data() + contents.size() - certificateLength;
+
+					if (i2d_X509(certificate, &out) != certificateLength)
+					{
+						OPENSSL_cleanse(contents.data(), contents.size());
+						return false;
+					}
+
+					PutU32(contents, static_cast<uint32_t>(sanDomains.size()));
+
+					for (const auto& domain : sanDomains)
+					{
+						PutU32(contents, static_cast<uint32_t>(domain.size()));
+						contents.insert(contents.end(), domain.begin(), domain.end());
+					}
+
+					return true;
+				}
+
+				const bool PersistentCertificateCache::Append(const RecordType type, const unsigned char* lookupId, const int64_t expires, const std::vector<unsigned char>& contents)
+				{
+					std::vector<unsigned char> record;
+					record.reserve(4 + RecordHeaderLength + contents.size() + TagLength);
+
+					PutU32(record, static_cast<uint32_t>(RecordHeaderLength + contents.size() + TagLength));
+					record.push_back(static_cast<unsigned char>(type));
+					record.insert(record.end(), lookupId, lookupId + LookupIdLength);
+					PutI64(record, expires);
+
+					unsigned char nonce[NonceLength];
+
+					if (RAND_bytes(nonce, sizeof(nonce)) != 1)
+					{
+						return false;
+					}
+
+					record.insert(record.end(), nonce, nonce + sizeof(nonce));
+
+					EVP_CIPHER_CTX* cipherContext = EVP_CIPHER_CTX_new();
+
+					if (cipherContext == nullptr)
+					{
+						return false;
+					}
+
+					const size_t sealedOffset = record.size();
+					record.resize(sealedOffset + contents.size() + TagLength);
+
+					int length = 0;
+
+					// Everything ahead of the nonce is authenticated along with the contents, so
+					// that records can't be passed off as being of some other type, for some
+					// other host, or as expiring at some other time.
+					const bool sealed =
+						EVP_EncryptInit_ex(cipherContext, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1 &&
+						EVP_CIPHER_CTX_ctrl(cipherContext, EVP_CTRL_GCM_SET_IVLEN, static_cast<int>(NonceLength), nullptr) == 1 &&
+						EVP_EncryptInit_ex(cipherContext, nullptr, nullptr, m_sealKey, nonce) == 1 &&
+						EVP_EncryptUpdate(cipherContext, nullptr, &length, record.data() + 4, static_cast<int>(RecordHeaderLength - NonceLength)) == 1 &&
+						EVP_EncryptUpdate(cipherContext, record.data() + sealedOffset, &length, contents.data(), static_cast<int>(contents.size())) == 1 &&
+						EVP_EncryptFinal_ex(cipherContext, record.data() + sealedOffset + length, &length) == 1 &&
+						EVP_CIPHER_CTX_ctrl(cipherContext, EVP_CTRL_GCM_GET_TAG, static_cast<int>(TagLength), record.data() + sealedOffset + contents.size()) == 1;
+
+					EVP_CIPHER_CTX_free(cipherContext);
+
+					if (!sealed)
+					{
+						return false;
+					}
+
+					std::lock_guard<std::mutex> lock(m_appendMutex);
+
+					if (!m_appender.is_open())
+					{
+						return false;
+					}
+
+					// In one go, so that a crash leaves at worst a torn record at the very end,
+					// which is dropped next time the file is opened.
+					m_appender.write(reinterpret_cast<const char*>(record.data()), record.size());
+					m_appender.flush();
+
+					return m_appender.good();
+				}
+
+				const bool PersistentCertificateCache::Unseal(const RecordRef& record, std::vector<unsigned char>& contents) const
+				{
+					if (record.expires <= static_cast<int64_t>(std::time(nullptr)))
+					{
+						return false;
+					}
+
+					const unsigned char* header = m_view + record.offset + 4;
+					const unsigned char* nonce = header + RecordHeaderLength - NonceLength;
+					const unsigned char* sealed = header + RecordHeaderLength;
+					const size_t sealedLength = record.length - 4 - RecordHeaderLength - TagLength;
+
+					std::vector<unsigned char> tag(sealed + sealedLength, sealed + sealedLength + TagLength);
+
+					contents.assign(sealedLength + 16, 0);
+
+					EVP_CIPHER_CTX* cipherContext = EVP_CIPHER_CTX_new();
+
+					if (cipherContext == nullptr)
+					{
+						return false;
+					}
+
+					int length = 0;
+					int finalLength = 0;
+
+					const bool opened =
+						EVP_DecryptInit_ex(cipherContext, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1 &&
+						EVP_CIPHER_CTX_ctrl(cipherContext, EVP_CTRL_GCM_SET_IVLEN, static_cast<int>(NonceLength), nullptr) == 1 &&
+						EVP_DecryptInit_ex(cipherContext, nullptr, nullptr, m_sealKey, nonce) == 1 &&
+						EVP_DecryptUpdate(cipherContext, nullptr, &length, header, static_cast<int>(RecordHeaderLength - NonceLength)) == 1 &&
+						EVP_DecryptUpdate(cipherContext, contents.data(), &length, sealed, static_cast<int>(sealedLength)) == 1 &&
+						EVP_CIPHER_CTX_ctrl(cipherContext, EVP_CTRL_GCM_SET_TAG, static_cast<int>(TagLength), tag.data()) == 1 &&
+						EVP_DecryptFinal_ex(cipherContext, contents.data() + length, &finalLength) == 1;
+
+					EVP_CIPHER_CTX_free(cipherContext);
+
+					if (!opened)
+					{
+						// Tampered with, or sealed under some other key.
+						OPENSSL_cleanse(contents.data(), contents.size());
+						return false;
+					}
+
+					contents.resize(static_cast<size_t>(length + finalLength));
+
+					return true;
+				}
+
+				const bool PersistentCertificateCache::Read(const RecordRef& record, Entry& entry) const
+				{
+					std::vector<unsigned char> contents;
+
+					if (!Unseal(record, contents))
+					{
+						return false;
+					}
+
+					size_t position = 0;
+					const unsigned char* field = nullptr;
+					size_t fieldLength = 0;
+
+					bool decoded = false;
+
+					if (GetField(contents, position, field, fieldLength))
+					{
+						entry.keypair = d2i_AutoPrivateKey(nullptr, &field, static_cast<long>(fieldLength));
+
+						if (entry.keypair != nullptr && GetField(contents, position, field, fieldLength))
+						{
+							entry.certificate = d2i_X509(nullptr, &field, static_cast<long>(fieldLength));
+
+							if (entry.certificate != nullptr && contents.size() - position >= 4)
+							{
+								const uint32_t count = GetU32(contents.data() + position);
+								position += 4;
+
+								decoded = true;
+
+								for (uint32_t i = 0; i < count; ++i)
+								{
+									if (!GetField(contents, position, field, fieldLength))
+									{
+										decoded = false;
+										break;
+									}
+
+									entry.sanDomains.emplace_back(reinterpret_cast<const char*>(field), fieldLength);
+								}
+							}
+						}
+					}
+
+					OPENSSL_cleanse(contents.data(), contents.size());
+
+					if (!decoded)
+					{
+						ReleaseEntry(entry);
+						return false;
+					}
+
+					return true;
+				}
+
+			} /* namespace secure */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,428 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace secure
+			{
+
+				/// <summary>
+				/// Keeps the CA keypair and every spoofed certificate minted with it in a local
+				/// file, so that after a restart, the certificate store can carry on with the same
+				/// CA and hand out the very same certificates again, rather than minting them all
+				/// over while every client reconnects at once.
+				///
+				/// The file is append only. Every record is sealed with AES-256-GCM under a key
+				/// supplied by the user, so the keys in it are no more exposed on disk than the key
+				/// protecting them. Records are found by an HMAC of the host name and of the
+				/// fingerprint of the upstream certificate the record was spoofed from, so a
+				/// certificate is only ever handed out again for the very same upstream
+				/// certificate, and the file doesn't give away which hosts were visited. Each
+				/// record also carries, in the clear, the time it expires, which is the earlier of
+				/// when the upstream certificate and the spoofed certificate expire.
+				///
+				/// Alongside those, the file keeps the hosts seen most often, with the
+				/// certificates they last presented, so that the store can make contexts ready
+				/// for them on startup.
+				///
+				/// When opened, the file is mapped into memory and only the record headers are
+				/// read, to build an index. Records are decrypted one at a time, as they're asked
+				/// for. Records appended while open aren't added to the index, since the store
+				/// keeps what it has minted anyway. Superseded and expired records are dropped by
+				/// rewriting the file when opened, once they make up most of it.
+				/// </summary>
+				class PersistentCertificateCache
+				{
+
+				public:
+
+					/// <summary>
+					/// Length, in bytes, of the key the file is sealed with.
+					/// </summary>
+					static constexpr size_t KeyLength = 32;
+
+					/// <summary>
+					/// A certificate read back from the file. The caller owns the keypair and the
+					/// certificate.
+					/// </summary>
+					struct Entry
+					{
+						/// <summary>
+						/// The keypair of the certificate.
+						/// </summary>
+						EVP_PKEY* keypair = nullptr;
+
+						/// <summary>
+						/// The certificate.
+						/// </summary>
+						X509* certificate = nullptr;
+
+						/// <summary>
+						/// Every DNS subject alt name in the certificate, in lower case.
+						/// </summary>
+						std::vector<std::string> sanDomains;
+					};
+
+					/// <summary>
+					/// A host seen often, along with the certificate it last presented, so that a
+					/// context can be made ready for it before it's next asked for. When read back
+					/// from the file, the caller owns the certificate.
+					/// </summary>
+					struct HostHistoryEntry
+					{
+						/// <summary>
+						/// The host, in lower case.
+						/// </summary>
+						std::string host;
+
+						/// <summary>
+						/// Roughly how often the host has been seen.
+						/// </summary>
+						uint32_t seen = 0;
+
+						/// <summary>
+						/// The certificate the host last presented.
+						/// </summary>
+						X509* upstreamCertificate = nullptr;
+					};
+
+					/// <summary>
+					/// Opens the file at the supplied path, creating it if it doesn't exist. Throws
+					/// runtime_error if the file can't be opened, isn't one of ours, or the key
+					/// isn't of the right length.
+					/// </summary>
+					/// <param name="path">
+					/// The path of the file.
+					/// </param>
+					/// <param name="key">
+					/// The key the file is sealed with. Must be KeyLength bytes. A file written
+					/// under one key can't be read under another, and is effectively discarded.
+					/// </param>
+					PersistentCertificateCache(const std::string& path, const std::vector<unsigned char>& key);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					PersistentCertificateCache(const PersistentCertificateCache&) = delete;
+					PersistentCertificateCache(PersistentCertificateCache&&) = delete;
+					PersistentCertificateCache& operator=(const PersistentCertificateCache&) = delete;
+
+					/// <summary>
+					/// Unmaps and closes the file, and wipes the keys.
+					/// </summary>
+					~PersistentCertificateCache();
+
+					/// <summary>
+					/// Reads back the CA, if one was stored and hasn't expired.
+					/// </summary>
+					/// <param name="entry">
+					/// Receives the CA on success.
+					/// </param>
+					/// <returns>
+					/// True if the CA was read back, false otherwise.
+					/// </returns>
+					const bool LoadCertificateAuthority(Entry& entry);
+
+					/// <summary>
+					/// Stores the CA. Every certificate stored before is signed by some other CA,
+					/// and so is discarded. Not safe to call alongside ::Find(...).
+					/// </summary>
+					/// <param name="keypair">
+					/// The keypair of the CA.
+					/// </param>
+					/// <param name="certificate">
+					/// The certificate of the CA.
+					/// </param>
+					/// <returns>
+					/// True if the CA was stored, false otherwise.
+					/// </returns>
+					const bool StoreCertificateAuthority(EVP_PKEY* keypair, X509* certificate);
+
+					/// <summary>
+					/// Reads back the certificate spoofed for the supplied host from the supplied
+					/// upstream certificate, if there is one and it hasn't expired. Safe to call
+					/// from any number of threads at once.
+					/// </summary>
+					/// <param name="host">
+					/// The host, in lower case.
+					/// </param>
+					/// <param name="upstreamCertificate">
+					/// The certificate presented by the host.
+					/// </param>
+					/// <param name="entry">
+					/// Receives the certificate on success.
+					/// </param>
+					/// <returns>
+					/// True if a certificate was read back, false otherwise.
+					/// </returns>
+					const bool Find(const std::string& host, X509* upstreamCertificate, Entry& entry);
+
+					/// <summary>
+					/// Stores the certificate spoofed for the supplied host from the supplied
+					/// upstream certificate.
+					/// </summary>
+					/// <param name="host">
+					/// The host, in lower case.
+					/// </param>
+					/// <param name="upstreamCertificate">
+					/// The certificate presented by the host.
+					/// </param>
+					/// <param name="keypair">
+					/// The keypair of the spoofed certificate.
+					/// </param>
+					/// <param name="certificate">
+					/// The spoofed certificate.
+					/// </param>
+					/// <param name="sanDomains">
+					/// Every DNS subject alt name in the spoofed certificate, in lower case.
+					/// </param>
+					/// <returns>
+					/// True if the certificate was stored, false otherwise.
+					/// </returns>
+					const bool Store(const std::string& host, X509* upstreamCertificate, EVP_PKEY* keypair, X509* certificate, const std::vector<std::string>& sanDomains);
+
+					/// <summary>
+					/// Reads back the host history, as it was when the file was opened, if there is
+					/// one and it hasn't expired. Hosts whose certificates have since expired are
+					/// left out.
+					/// </summary>
+					/// <param name="history">
+					/// Receives the host history on success.
+					/// </param>
+					/// <returns>
+					/// True if the host history was read back, false otherwise.
+					/// </returns>
+					const bool LoadHostHistory(std::vector<HostHistoryEntry>& history);
+
+					/// <summary>
+					/// Stores the host history, replacing whatever was stored before. Unlike the
+					/// certificates, the host history outlives a change of CA.
+					/// </summary>
+					/// <param name="history">
+					/// The host history.
+					/// </param>
+					/// <returns>
+					/// True if the host history was stored, false otherwise.
+					/// </returns>
+					const bool StoreHostHistory(const std::vector<HostHistoryEntry>& history);
+
+				private:
+
+					/// <summary>
+					/// Record types.
+					/// </summary>
+					enum RecordType : uint8_t
+					{
+						CertificateAuthorityRecord = 1,
+						HostRecord = 2,
+						HostHistoryRecord = 3
+					};
+
+					/// <summary>
+					/// How long, in seconds, the host history is kept if not replaced.
+					/// </summary>
+					static constexpr int64_t HostHistoryLifetimeSeconds = 60 * 60 * 24 * 30;
+
+					/// <summary>
+					/// Length of the lookup id of a record.
+					/// </summary>
+					static constexpr size_t LookupIdLength = 32;
+
+					/// <summary>
+					/// Length of the nonce of a record.
+					/// </summary>
+					static constexpr size_t NonceLength = 12;
+
+					/// <summary>
+					/// Length of the authentication tag of a record.
+					/// </summary>
+					static constexpr size_t TagLength = 16;
+
+					/// <summary>
+					/// Length of everything in a record ahead of the sealed contents, other than the
+					/// length field itself: the type, the lookup id, the expiry and the nonce. All
+					/// but the nonce are authenticated along with the contents.
+					/// </summary>
+					static constexpr size_t RecordHeaderLength = 1 + LookupIdLength + 8 + NonceLength;
+
+					/// <summary>
+					/// Superseded and expired records must add up to at least this many bytes, as
+					/// well as outweigh the live records, before the file is rewritten.
+					/// </summary>
+					static constexpr size_t MinCompactionBytes = 1024 * 1024;
+
+					/// <summary>
+					/// Where a record lives in the mapping.
+					/// </summary>
+					struct RecordRef
+					{
+						/// <summary>
+						/// Offset of the record, length field included.
+						/// </summary>
+						size_t offset;
+
+						/// <summary>
+						/// Length of the record, length field included.
+						/// </summary>
+						size_t length;
+
+						/// <summary>
+						/// When the record expires, in seconds since the epoch.
+						/// </summary>
+						int64_t expires;
+					};
+
+					/// <summary>
+					/// Maps the file and indexes its records.
+					/// </summary>
+					/// <returns>
+					/// True if the file ought to be rewritten, because it ends in a torn record, or
+					/// is mostly superseded or expired records.
+					/// </returns>
+					const bool MapAndIndex();
+
+					/// <summary>
+					/// Rewrites the file with only the records in the index.
+					/// </summary>
+					/// <returns>
+					/// True if the file was rewritten, false otherwise.
+					/// </returns>
+					const bool Compact();
+
+					/// <summary>
+					/// Unmaps the file, if mapped.
+					/// </summary>
+					void Unmap();
+
+					/// <summary>
+					/// Computes the lookup id for the supplied host and upstream certificate.
+					/// </summary>
+					const bool MakeLookupId(const std::string& host, X509* upstreamCertificate, unsigned char* lookupId) const;
+
+					/// <summary>
+					/// Encodes the supplied keypair, certificate and SAN's as record contents.
+					/// </summary>
+					const bool Encode(EVP_PKEY* keypair, X509* certificate, const std::vector<std::string>& sanDomains, std::vector<unsigned char>& contents) const;
+
+					/// <summary>
+					/// Seals the supplied contents into a record and appends it to the file.
+					/// </summary>
+					const bool Append(const RecordType type, const unsigned char* lookupId, const int64_t expires, const std::vector<unsigned char>& contents);
+
+					/// <summary>
+					/// Decrypts the contents of the supplied record.
+					/// </summary>
+					const bool Unseal(const RecordRef& record, std::vector<unsigned char>& contents) const;
+
+					/// <summary>
+					/// Decrypts the contents of the supplied record and decodes them.
+					/// </summary>
+					const bool Read(const RecordRef& record, Entry& entry) const;
+
+					/// <summary>
+					/// Path of the file.
+					/// </summary>
+					std::string m_path;
+
+					/// <summary>
+					/// Key the contents of records are sealed with, derived from the user's key.
+					/// </summary>
+					unsigned char m_sealKey[KeyLength];
+
+					/// <summary>
+					/// Key lookup ids are computed with, derived from the user's key.
+					/// </summary>
+					unsigned char m_lookupKey[KeyLength];
+
+					/// <summary>
+					/// The mapping of the file as it was when opened, or nullptr if empty.
+					/// </summary>
+					const unsigned char* m_view = nullptr;
+
+					/// <summary>
+					/// Size of the mapping.
+					/// </summary>
+					size_t m_viewSize = 0;
+
+					/// <summary>
+					/// Size of the mapping up to the end of the last whole record. Falls short of
+					/// the size of the mapping when the file ends in a torn record.
+					/// </summary>
+					size_t m_validSize = 0;
+
+					/// <summary>
+					/// The CA record, if there is a live one.
+					/// </summary>
+					RecordRef m_certificateAuthority{ 0, 0, 0 };
+
+					/// <summary>
+					/// The host history record, if there is a live one.
+					/// </summary>
+					RecordRef m_hostHistory{ 0, 0, 0 };
+
+					/// <summary>
+					/// Live host records in the mapping, by lookup id. Only ever changed while
+					/// opening, so it's safe to read from any thread without a lock.
+					/// </summary>
+					std::unordered_map<std::string, RecordRef> m_index;
+
+					/// <summary>
+					/// For synchronizing appends.
+					/// </summary>
+					std::mutex m_appendMutex;
+
+					/// <summary>
+					/// The file, opened for appending.
+					/// </summary>
+					std::ofstream m_appender;
+
+				};
+
+			} /* namespace secure */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
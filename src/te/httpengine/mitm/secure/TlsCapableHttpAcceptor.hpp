@@ -94,6 +94,29 @@ namespace te
 
 				public:
 
+					/// <summary>
+					/// Snapshot of the downstream session resumption counters, as given by
+					/// ::GetDownstreamSessionStatistics().
+					/// </summary>
+					struct DownstreamSessionStatistics
+					{
+						/// <summary>
+						/// Downstream handshakes completed.
+						/// </summary>
+						uint64_t handshakes = 0;
+
+						/// <summary>
+						/// Downstream handshakes completed by resuming a session, whether from the
+						/// session cache or from a session ticket.
+						/// </summary>
+						uint64_t resumed = 0;
+
+						/// <summary>
+						/// Number of sessions presently held in the session cache.
+						/// </summary>
+						size_t entries = 0;
+					};
+
 					/// <summary>
 					/// Constructs a new TlsCapableHttpAcceptor. In the event that AcceptorType is
 					/// network::TlsSocket, some of the optional parameters become required, such as
@@ -133,6 +156,11 @@ namespace te
 					/// 
 					/// This parameter is only required when AcceptorType is network::TlsSocket.
 					/// </param>
+					/// <param name="hostResolver">
+					/// An optional pointer to the process-wide host resolver, supplied to every
+					/// client bridge for resolving upstream hosts. If not supplied, each bridge
+					/// resolves hosts on its own, without any caching.
+					/// </param>
 					/// <param name="onInfoCb">
 					/// An optional callback for general information about non-critical events.
 					/// </param>
@@ -149,6 +177,7 @@ namespace te
 						uint16_t port = 0,
 						const std::string& caBundleAbsPath = std::string(u8"none"),
 						BaseInMemoryCertificateStore* store = nullptr,
+						network::HostResolver* hostResolver = nullptr,
 						util::cb::MessageFunction onInfoCb = nullptr,
 						util::cb::MessageFunction onWarnCb = nullptr,
 						util::cb::MessageFunction onErrorCb = nullptr
@@ -159,9 +188,12 @@ namespace te
 						m_engine(filteringEngine),
 						m_caBundleAbsolutePath(caBundleAbsPath),
 						m_store(store),
+						m_hostResolver(hostResolver),
 						m_acceptor(*service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address(), port)),
 						m_clientContext(*service, boost::asio::ssl::context::sslv23_client),
-						m_defaultServerContext(*service, boost::asio::ssl::context::tlsv12_server)
+						m_defaultServerContext(*service, boost::asio::ssl::context::tlsv12_server),
+						m_upstreamPool(std::make_shared<UpstreamConnectionPool<AcceptorType>>()),
+						m_sessionCache(std::is_same<AcceptorType, network::TlsSocket>::value ? std::make_shared<UpstreamSessionCache>() : nullptr)
 					{
 
 						bool isTls = std::is_same<AcceptorType, network::TlsSocket>::value;
@@ -211,11 +243,13 @@ namespace te
 					TlsCapableHttpAcceptor& operator=(const TlsCapableHttpAcceptor&) = delete;
 
 					/// <summary>
-					/// Default destructor.
+					/// Closes every idle upstream connection in the pool. Bridges still running
+					/// hold the pool too, so it may outlive us, but they'll find it refusing any
+					/// more connections.
 					/// </summary>
 					~TlsCapableHttpAcceptor()
 					{
-
+						m_upstreamPool->Shutdown();
 					}
 
 					/// <summary>
@@ -241,7 +275,7 @@ namespace te
 						{
 							try
 							{
-								SharedBridge session = std::make_shared<TlsCapableHttpBridge<AcceptorType>>(m_service, m_engine, m_store, &m_defaultServerContext, &m_clientContext, m_onInfo, m_onWarning, m_onError);
+								SharedBridge session = std::make_shared<TlsCapableHttpBridge<AcceptorType>>(m_service, m_engine, m_store, &m_defaultServerContext, &m_clientContext, m_upstreamPool, m_hostResolver, m_sessionCache, m_onInfo, m_onWarning, m_onError);
 
 								if (session == nullptr)
 								{
@@ -263,6 +297,46 @@ namespace te
 						return false;
 					}
 
+					/// <summary>
+					/// Gets a snapshot of the upstream TLS session cache counters.
+					/// </summary>
+					/// <returns>
+					/// The cache counters. All zero when AcceptorType is network::TcpSocket.
+					/// </returns>
+					const UpstreamSessionCache::Statistics GetUpstreamSessionStatistics() const
+					{
+						if (m_sessionCache != nullptr)
+						{
+							return m_sessionCache->GetStatistics();
+						}
+
+						return{};
+					}
+
+					/// <summary>
+					/// Gets a snapshot of the downstream TLS session resumption counters. These
+					/// cover every downstream handshake made through this acceptor, whichever
+					/// spoofed host context it ended up on.
+					/// </summary>
+					/// <returns>
+					/// The resumption counters. All zero when AcceptorType is network::TcpSocket.
+					/// </returns>
+					const DownstreamSessionStatistics GetDownstreamSessionStatistics()
+					{
+						DownstreamSessionStatistics stats;
+
+						if (std::is_same<AcceptorType, network::TlsSocket>::value)
+						{
+							SSL_CTX* context = m_defaultServerContext.native_handle();
+
+							stats.handshakes = static_cast<uint64_t>(SSL_CTX_sess_accept_good(context));
+							stats.resumed = static_cast<uint64_t>(SSL_CTX_sess_hits(context));
+							stats.entries = static_cast<size_t>(SSL_CTX_sess_number(context));
+						}
+
+						return stats;
+					}
+
 					/// <summary>
 					/// Cancels any pending async_accept calls, breaking the accept loop and thus
 					/// stopping the acceptor from accepting any new client connections.
@@ -340,6 +414,20 @@ namespace te
 								This may cause some valid certificates to fail verification, because a cert found in their chain is unreachable and without this \
 								option, verification must span the entire chain.");
 						}
+
+						// Upstream sessions are kept by host in our own cache, shared by every bridge,
+						// so the context's internal cache would just be holding a second copy of each.
+						SSL_CTX_set_session_cache_mode(m_clientContext.native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+
+						// Every downstream connection is created from the default server context, and
+						// OpenSSL keeps using that context's session cache and ticket keys even after
+						// the bridge switches the connection over to the spoofed host context. So
+						// this is where downstream session resumption is actually configured.
+						if (!m_store->ConfigureServerSessions(m_defaultServerContext.native_handle()))
+						{
+							ReportWarning(u8"In TlsCapableHttpAcceptor::InitContexts() - Failed to configure session resumption on default server context. \
+								Clients will have to perform a full handshake on every connection.");
+						}
 					}
 
 					/// <summary>
@@ -408,6 +496,12 @@ namespace te
 					/// </summary>
 					BaseInMemoryCertificateStore* m_store = nullptr;
 
+					/// <summary>
+					/// Pointer to the process-wide host resolver to be supplied to each client
+					/// bridge. Optional.
+					/// </summary>
+					network::HostResolver* m_hostResolver = nullptr;
+
 					/// <summary>
 					/// The underlying TCP acceptor itself.
 					/// </summary>
@@ -425,7 +519,20 @@ namespace te
 					/// for anything, except to construct a ::asio::ssl_stream object within Tls
 					/// client bridges.
 					/// </summary>
-					boost::asio::ssl::context m_defaultServerContext;				
+					boost::asio::ssl::context m_defaultServerContext;
+
+					/// <summary>
+					/// The pool of idle upstream connections shared by every bridge this acceptor
+					/// creates.
+					/// </summary>
+					std::shared_ptr<UpstreamConnectionPool<AcceptorType>> m_upstreamPool;
+
+					/// <summary>
+					/// The cache of upstream TLS sessions shared by every bridge this acceptor
+					/// creates. Only used when AcceptorType is network::TlsSocket, nullptr
+					/// otherwise.
+					/// </summary>
+					std::shared_ptr<UpstreamSessionCache> m_sessionCache;
 
 				};
 
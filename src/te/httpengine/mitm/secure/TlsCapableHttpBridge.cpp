@@ -47,6 +47,9 @@ namespace te
 					BaseInMemoryCertificateStore* certStore,
 					boost::asio::ssl::context* defaultServerContext,
 					boost::asio::ssl::context* clientContext,
+					std::shared_ptr<UpstreamConnectionPool<network::TcpSocket>> upstreamPool,
+					network::HostResolver* hostResolver,
+					std::shared_ptr<UpstreamSessionCache> sessionCache,
 					util::cb::MessageFunction onInfoCb,
 					util::cb::MessageFunction onWarnCb,
 					util::cb::MessageFunction onErrorCb
@@ -56,14 +59,18 @@ namespace te
 						onWarnCb, 
 						onErrorCb
 						),
-					m_upstreamSocket(*service), 
+					m_upstreamSocket(std::make_shared<network::TcpSocket>(*service)),
 					m_downstreamSocket(*service),
 					m_upstreamStrand(*service),
 					m_downstreamStrand(*service),
 					m_resolver(*service),
+					m_service(service),
+					m_hostResolver(hostResolver),
 					m_streamTimer(*service),				
 					m_filteringEngine(filteringEngine),
-					m_certStore(certStore)				
+					m_certStore(certStore),
+					m_upstreamPool(upstreamPool),
+					m_sessionCache(sessionCache)
 				{
 					#ifndef NDEBUG						
 						assert(m_filteringEngine != nullptr && u8"In TlsCapableHttpBridge<network::TcpSocket>::TlsCapableHttpBridge(... args) - Supplied filtering engine pointer is nullptr!");
@@ -94,6 +101,9 @@ namespace te
 					BaseInMemoryCertificateStore* certStore,
 					boost::asio::ssl::context* defaultServerContext,
 					boost::asio::ssl::context* clientContext,
+					std::shared_ptr<UpstreamConnectionPool<network::TlsSocket>> upstreamPool,
+					network::HostResolver* hostResolver,
+					std::shared_ptr<UpstreamSessionCache> sessionCache,
 					util::cb::MessageFunction onInfoCb,
 					util::cb::MessageFunction onWarnCb,
 					util::cb::MessageFunction onErrorCb
@@ -104,14 +114,18 @@ namespace te
 						onWarnCb,
 						onErrorCb
 						),
-					m_upstreamSocket(*service, *clientContext),
+					m_upstreamSocket(std::make_shared<network::TlsSocket>(*service, *clientContext)),
 					m_downstreamSocket(*service, *defaultServerContext),
 					m_upstreamStrand(*service),
 					m_downstreamStrand(*service),
 					m_resolver(*service),
+					m_service(service),
+					m_hostResolver(hostResolver),
 					m_streamTimer(*service),					
 					m_filteringEngine(filteringEngine),
-					m_certStore(certStore)
+					m_certStore(certStore),
+					m_upstreamPool(upstreamPool),
+					m_sessionCache(sessionCache)
 				{
 					#ifndef NDEBUG					
 						assert(m_filteringEngine != nullptr && u8"In TlsCapableHttpBridge<network::TlsSocket>::TlsCapableHttpBridge(... args) - Supplied certificate store is nullptr!");
@@ -227,13 +241,13 @@ namespace te
 				template<>
 				boost::asio::ip::tcp::socket& TlsCapableHttpBridge<network::TcpSocket>::UpstreamSocket()
 				{
-					return m_upstreamSocket;
+					return *m_upstreamSocket;
 				}
 
 				template<>
 				boost::asio::ip::tcp::socket& TlsCapableHttpBridge<network::TlsSocket>::UpstreamSocket()
 				{
-					return m_upstreamSocket.next_layer();
+					return m_upstreamSocket->next_layer();
 				}
 
 				template<>
@@ -287,7 +301,7 @@ namespace te
 						auto writeBuffer = m_request->GetWriteBuffer();
 						
 						boost::asio::async_write(
-							m_upstreamSocket, 
+							*m_upstreamSocket, 
 							writeBuffer, 
 							boost::asio::transfer_all(), 
 							m_upstreamStrand.wrap(
@@ -311,6 +325,39 @@ namespace te
 					Kill();
 				}
 
+				template<>
+				void TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshakeComplete(const boost::system::error_code& error)
+				{
+					if (m_sessionCache != nullptr)
+					{
+						if (!error)
+						{
+							m_sessionCache->Store(m_upstreamSocket->native_handle(), m_upstreamHost, m_upstreamHostPort);
+						}
+						else
+						{
+							m_sessionCache->Remove(m_upstreamHost, m_upstreamHostPort);
+						}
+					}
+
+					if (!error && m_upstreamCert == nullptr && SSL_session_reused(m_upstreamSocket->native_handle()))
+					{
+						// A resumed handshake has no certificate exchange, so the verification
+						// callback was never called. The session still carries the certificate
+						// that was verified when it was first established though, and holds on to
+						// it for as long as the connection lives, same as a borrowed connection.
+						X509* peerCert = SSL_get_peer_certificate(m_upstreamSocket->native_handle());
+
+						if (peerCert != nullptr)
+						{
+							X509_free(peerCert);
+							m_upstreamCert = peerCert;
+						}
+					}
+
+					OnUpstreamHandshake(error);
+				}
+
 				template<>
 				void TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamConnect(const boost::system::error_code& error)
 				{
@@ -323,7 +370,7 @@ namespace te
 					{						
 						SetStreamTimeout(5000);
 
-						m_upstreamSocket.set_verify_mode(boost::asio::ssl::verify_peer | boost::asio::ssl::verify_fail_if_no_peer_cert);
+						m_upstreamSocket->set_verify_mode(boost::asio::ssl::verify_peer | boost::asio::ssl::verify_fail_if_no_peer_cert);
 
 						boost::system::error_code scerr;
 
@@ -331,7 +378,7 @@ namespace te
 						// completion handler will "out-live" the verification callback, so it will hold the shared_ptr
 						// that will ensure this object survives the async handshake.
 
-						m_upstreamSocket.set_verify_callback(
+						m_upstreamSocket->set_verify_callback(
 							std::bind(
 								&TlsCapableHttpBridge::VerifyServerCertificateCallback, 
 								this, 
@@ -343,11 +390,11 @@ namespace te
 
 						if (!scerr)
 						{
-							m_upstreamSocket.async_handshake(
+							m_upstreamSocket->async_handshake(
 								network::TlsSocket::client, 
 								m_upstreamStrand.wrap(
 									std::bind(
-										&TlsCapableHttpBridge::OnUpstreamHandshake, 
+										&TlsCapableHttpBridge::OnUpstreamHandshakeComplete, 
 										shared_from_this(), 
 										std::placeholders::_1
 										)
@@ -385,8 +432,6 @@ namespace te
 					{
 						SetStreamTimeout(5000);
 
-						auto ep = *endpointIterator;
-
 						// Perhaps client requested a port other than 80. We should have already parsed
 						// this before initiating the resolve of the upstream host, so that this information
 						// was not polluting the hostname during resolution.
@@ -398,28 +443,7 @@ namespace te
 						// something unknown to me (I vaguely remember the details) which has a list of port
 						// numbers associated with specific services. So by default, every iterator result
 						// here should be preconfigured to port 80.
-						if (m_upstreamHostPort != 0 && ep.endpoint().port() != m_upstreamHostPort)
-						{
-							ep.endpoint().port(m_upstreamHostPort);
-						}
-
-						// XXX TODO. The correct thing to do here is keep the iterator somehow, then in
-						// the completion handler, in the event of a connection related error, keep
-						// incrementing through the iterator until all possible endpoints for the
-						// requested host have been exhausted. Doing things this way means that we
-						// only take a crack at connecting to the first A record entry resolved, then
-						// quit if that first record does not work.
-
-						m_upstreamSocket.async_connect(
-							ep, 
-							m_upstreamStrand.wrap(
-								std::bind(
-									&TlsCapableHttpBridge::OnUpstreamConnect, 
-									shared_from_this(), 
-									std::placeholders::_1
-									)
-								)
-							);
+						ConnectUpstream(endpointIterator, m_upstreamHostPort);
 
 						return;
 					}
@@ -445,16 +469,14 @@ namespace te
 					{
 						SetStreamTimeout(5000);
 
-						SSL_set_tlsext_host_name(m_upstreamSocket.native_handle(), m_upstreamHost.c_str());
+						SSL_set_tlsext_host_name(m_upstreamSocket->native_handle(), m_upstreamHost.c_str());
 
-						// XXX TODO. The correct thing to do here is keep the iterator somehow, then in
-						// the completion handler, in the event of a connection related error, keep
-						// incrementing through the iterator until all possible endpoints for the
-						// requested host have been exhausted. Doing things this way means that we
-						// only take a crack at connecting to the first A record entry resolved, then
-						// quit if that first record does not work.
+						if (m_sessionCache != nullptr)
+						{
+							m_sessionCache->Apply(m_upstreamSocket->native_handle(), m_upstreamHost, m_upstreamHostPort);
+						}
 
-						// Note also that unlike the TCP version of this handler, we do not check the
+						// Note that unlike the TCP version of this handler, we do not check the
 						// upstream host member for a port number. This is because, AFAIK, there is no
 						// such data in the SNI extension, the place where we get the hostname from.
 						//
@@ -463,19 +485,7 @@ namespace te
 						// for 443 and send them to this proxy, then we'll break the connection entirely.
 						// Care therefore needs to be taken, or a more robust system needs to be put in
 						// place starting at the diversion level.
-
-						boost::asio::ip::tcp::endpoint requestedEndpoint = *endpointIterator;
-
-						m_upstreamSocket.lowest_layer().async_connect(
-							boost::asio::ip::tcp::endpoint(requestedEndpoint.address(), m_upstreamHostPort),
-							m_upstreamStrand.wrap(
-								std::bind(
-									&TlsCapableHttpBridge::OnUpstreamConnect, 
-									shared_from_this(), 
-									std::placeholders::_1
-									)
-								)
-							);
+						ConnectUpstream(endpointIterator, m_upstreamHostPort);
 
 						return;
 					}
@@ -487,7 +497,125 @@ namespace te
 					}
 
 					Kill();
-				}				
+				}
+
+				template<>
+				const bool TlsCapableHttpBridge<network::TcpSocket>::BorrowUpstream()
+				{
+					if (m_upstreamPool == nullptr)
+					{
+						return false;
+					}
+
+					// A zero port means that none was given with the host, which for plain HTTP means 80.
+					auto borrowed = m_upstreamPool->Borrow(m_upstreamHost, m_upstreamHostPort != 0 ? m_upstreamHostPort : 80, std::string());
+
+					if (borrowed == nullptr)
+					{
+						return false;
+					}
+
+					#ifndef NDEBUG
+					ReportInfo(u8"TlsCapableHttpBridge<network::TcpSocket>::BorrowUpstream - Reusing pooled upstream connection.");
+					#endif // !NDEBUG
+
+					m_upstreamSocket = borrowed;
+
+					// Carry on exactly as though the connection had just been made.
+					m_upstreamStrand.post(
+						std::bind(
+							&TlsCapableHttpBridge::OnUpstreamConnect,
+							shared_from_this(),
+							boost::system::error_code()
+							)
+						);
+
+					return true;
+				}
+
+				template<>
+				const bool TlsCapableHttpBridge<network::TlsSocket>::BorrowUpstream()
+				{
+					if (m_upstreamPool == nullptr)
+					{
+						return false;
+					}
+
+					auto borrowed = m_upstreamPool->Borrow(m_upstreamHost, m_upstreamHostPort, m_upstreamHost);
+
+					if (borrowed == nullptr)
+					{
+						return false;
+					}
+
+					// The certificate was verified when the connection was first made, and the
+					// session holds on to it for as long as the connection lives, so there's no
+					// need for us to keep a reference of our own. This is the same non-owning
+					// pointer that the verification callback would have given us.
+					X509* peerCert = SSL_get_peer_certificate(borrowed->native_handle());
+
+					if (peerCert == nullptr)
+					{
+						// Shouldn't be possible, since we always demand a peer certificate. The
+						// connection is no good to us without one though, so let it close, and
+						// connect as usual.
+						return false;
+					}
+
+					X509_free(peerCert);
+
+					#ifndef NDEBUG
+					ReportInfo(u8"TlsCapableHttpBridge<network::TlsSocket>::BorrowUpstream - Reusing pooled upstream connection.");
+					#endif // !NDEBUG
+
+					m_upstreamSocket = borrowed;
+					m_upstreamCert = peerCert;
+
+					// Carry on exactly as though the handshake had just completed.
+					m_upstreamStrand.post(
+						std::bind(
+							&TlsCapableHttpBridge::OnUpstreamHandshake,
+							shared_from_this(),
+							boost::system::error_code()
+							)
+						);
+
+					return true;
+				}
+
+				template<>
+				void TlsCapableHttpBridge<network::TcpSocket>::ReturnUpstream()
+				{
+					if (m_upstreamPool == nullptr || !m_upstreamReusable || m_upstreamHost.size() == 0 || !m_upstreamSocket->is_open())
+					{
+						return;
+					}
+
+					m_upstreamPool->Return(m_upstreamHost, m_upstreamHostPort != 0 ? m_upstreamHostPort : 80, std::string(), m_upstreamSocket);
+				}
+
+				template<>
+				void TlsCapableHttpBridge<network::TlsSocket>::ReturnUpstream()
+				{
+					if (m_upstreamPool == nullptr || !m_upstreamReusable || m_upstreamHost.size() == 0 || !m_upstreamSocket->lowest_layer().is_open())
+					{
+						return;
+					}
+
+					// The verification callback is bound to this bridge, which is about to be
+					// gone. The handshake is long over, so it should never be called again, but
+					// we replace it with one that doesn't depend on us all the same.
+					boost::system::error_code err;
+
+					m_upstreamSocket->set_verify_callback(boost::asio::ssl::rfc2818_verification(m_upstreamHost), err);
+
+					if (err)
+					{
+						return;
+					}
+
+					m_upstreamPool->Return(m_upstreamHost, m_upstreamHostPort, m_upstreamHost, m_upstreamSocket);
+				}
 
 			} /* namespace secure */
 		} /* namespace mitm */
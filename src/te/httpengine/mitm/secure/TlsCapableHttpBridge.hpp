@@ -35,7 +35,11 @@
 #include <boost/predef/os.h>
 #include <boost/predef/compiler.h>
 #include "../../network/SocketTypes.hpp"
+#include "../../network/HostResolver.hpp"
+#include "../../network/StaggeredConnector.hpp"
 #include "BaseInMemoryCertificateStore.hpp"
+#include "UpstreamConnectionPool.hpp"
+#include "UpstreamSessionCache.hpp"
 #include "../../filtering/http/HttpFilteringEngine.hpp"
 #include "../http/HttpRequest.hpp"
 #include "../http/HttpResponse.hpp"
@@ -237,6 +241,24 @@ namespace te
 					/// uses this for verifying server certificates. In this context, the "client"
 					/// is the proxy.
 					/// </param>
+					/// <param name="upstreamPool">
+					/// The pool of idle upstream connections shared by every bridge the acceptor
+					/// creates. Optional. When supplied, the bridge first tries to borrow an idle
+					/// connection to the requested host from the pool, and gives its upstream
+					/// connection back to the pool when it is done with it, if the connection is
+					/// still good for another request.
+					/// </param>
+					/// <param name="hostResolver">
+					/// The process-wide host resolver, which caches lookups and runs them on its own
+					/// threads. Optional. When not supplied, the bridge resolves upstream hosts with
+					/// its own boost::asio::ip::tcp::resolver.
+					/// </param>
+					/// <param name="sessionCache">
+					/// The cache of upstream TLS sessions shared by every bridge the acceptor
+					/// creates. Optional, and only used when BridgeSocketType is
+					/// network::TlsSocket. When supplied, upstream connections offer the last
+					/// session established with the same host, to skip the full handshake.
+					/// </param>
 					/// <param name="onInfoCb">
 					/// A callback to receive generated information about general events. Data that
 					/// may be sent through this callback, if provided, is simply "verbose" output
@@ -268,6 +290,9 @@ namespace te
 						BaseInMemoryCertificateStore* certStore = nullptr,
 						boost::asio::ssl::context* defaultServerContext = nullptr,
 						boost::asio::ssl::context* clientContext = nullptr,
+						std::shared_ptr<UpstreamConnectionPool<BridgeSocketType>> upstreamPool = nullptr,
+						network::HostResolver* hostResolver = nullptr,
+						std::shared_ptr<UpstreamSessionCache> sessionCache = nullptr,
 						util::cb::MessageFunction onInfoCb = nullptr,
 						util::cb::MessageFunction onWarnCb = nullptr,
 						util::cb::MessageFunction onErrorCb = nullptr
@@ -281,11 +306,12 @@ namespace te
 					TlsCapableHttpBridge& operator=(const TlsCapableHttpBridge&) = delete;
 
 					/// <summary>
-					/// Default destructor.
+					/// Gives the upstream connection to the upstream connection pool, if it's still
+					/// good for another request.
 					/// </summary>
 					~TlsCapableHttpBridge()
 					{
-
+						ReturnUpstream();
 					}
 
 				private:
@@ -303,9 +329,11 @@ namespace te
 					std::unique_ptr<http::HttpResponse> m_response = nullptr;
 
 					/// <summary>
-					/// Socket used to connect to the client's desired host.
+					/// Socket used to connect to the client's desired host. Shared, because the
+					/// connection may have been borrowed from the upstream connection pool, and may
+					/// be given back to it when this bridge is done with it.
 					/// </summary>
-					BridgeSocketType m_upstreamSocket;
+					std::shared_ptr<BridgeSocketType> m_upstreamSocket;
 
 					/// <summary>
 					/// Socket used for connecting to the client.
@@ -326,10 +354,30 @@ namespace te
 
 					/// <summary>
 					/// Used for resolving the target upstream server after it has been discovered
-					/// from the client headers or TLS hello.
+					/// from the client headers or TLS hello, when no shared host resolver was
+					/// supplied.
 					/// </summary>
 					boost::asio::ip::tcp::resolver m_resolver;					
 
+					/// <summary>
+					/// The io_service driving this bridge. Needed to have the shared host resolver
+					/// deliver its results back to us.
+					/// </summary>
+					boost::asio::io_service* m_service = nullptr;
+
+					/// <summary>
+					/// The process-wide, caching host resolver. May be nullptr, in which case
+					/// m_resolver is used.
+					/// </summary>
+					network::HostResolver* m_hostResolver = nullptr;
+
+					/// <summary>
+					/// The connector making the staggered connection attempts to the upstream
+					/// host, while they're underway. Only ever accessed atomically, since ::Kill()
+					/// needs to cancel it from whatever thread it happens to be called on.
+					/// </summary>
+					std::shared_ptr<network::StaggeredConnector> m_upstreamConnector;
+
 					/// <summary>
 					/// To prevent asynchronous operations from hanging forever. This should be
 					/// reset with a specific timeout every time a new asynchrous operation is
@@ -353,6 +401,26 @@ namespace te
 					/// </summary>
 					BaseInMemoryCertificateStore* m_certStore;
 
+					/// <summary>
+					/// Pool of idle upstream connections, shared with every other bridge created by
+					/// the same acceptor. May be nullptr, in which case every bridge makes its own
+					/// upstream connection and closes it when done, as it always has.
+					/// </summary>
+					std::shared_ptr<UpstreamConnectionPool<BridgeSocketType>> m_upstreamPool;
+
+					/// <summary>
+					/// The spoofed context the client connection was switched over to, if any. Only
+					/// used when BridgeSocketType is network::TlsSocket.
+					/// </summary>
+					BaseInMemoryCertificateStore::SharedServerContext m_serverContext;
+
+					/// <summary>
+					/// Cache of upstream TLS sessions, shared with every other bridge created by the
+					/// same acceptor. May be nullptr, in which case every upstream handshake is a
+					/// full one.
+					/// </summary>
+					std::shared_ptr<UpstreamSessionCache> m_sessionCache;
+
 					/// <summary>
 					/// Member that is to be set whenever the upstream certificate verification
 					/// callback method is invoked. This member is held, then used to request the in
@@ -457,6 +525,39 @@ namespace te
 					/// </summary>
 					bool m_keepAlive = true;
 
+					/// <summary>
+					/// Indicates whether or not the upstream connection is sitting idle between
+					/// requests, having delivered a complete response with keep-alive. When the
+					/// bridge goes away in this state, rather than closing the upstream connection,
+					/// it is given to the upstream connection pool for another bridge to reuse.
+					/// </summary>
+					std::atomic<bool> m_upstreamReusable{ false };
+
+					/// <summary>
+					/// The content encodings the client accepts for the current response, taken
+					/// from the Accept-Encoding header of the current request before it is replaced
+					/// with our own.
+					/// </summary>
+					http::ContentEncodingSet m_acceptedContentEncodings = http::ToContentEncodingSet(http::ContentEncoding::Identity);
+
+					/// <summary>
+					/// Indicates whether or not a read of the response payload being relayed is
+					/// outstanding. See ::PumpResponseRelay().
+					/// </summary>
+					bool m_relayReadPending = false;
+
+					/// <summary>
+					/// Indicates whether or not a write of the response payload being relayed is
+					/// outstanding. See ::PumpResponseRelay().
+					/// </summary>
+					bool m_relayWritePending = false;
+
+					/// <summary>
+					/// Indicates whether or not the upstream server closed the connection while
+					/// the response payload was being relayed.
+					/// </summary>
+					bool m_relayUpstreamClosed = false;
+
 				public:
 
 					/// <summary>
@@ -522,6 +623,15 @@ namespace te
 							// since the kinds of errors you usually get from these calls are non-fatal
 							// issues. Usually just complaints about state etc.
 
+							// Abandon any connection attempts still underway. Their handlers hold a
+							// shared_ptr to us, so otherwise we'd linger on until they all time out.
+							auto upstreamConnector = std::atomic_load(&m_upstreamConnector);
+
+							if (upstreamConnector != nullptr)
+							{
+								upstreamConnector->Cancel();
+							}
+
 							boost::system::error_code downstreamShutdownErr;
 							boost::system::error_code downstreamCloseErr;	
 							boost::system::error_code upstreamShutdownErr;
@@ -532,7 +642,11 @@ namespace te
 
 							// To try and cut down annoying error messages about shutdown failures when the upstream
 							// socket hasn't even been used yet and ::Kill() has been called.
-							if (m_upstreamHost.size() > 0)
+							//
+							// An upstream connection that is idle between requests is left alone, so
+							// that it can be given to the upstream connection pool once the bridge is
+							// destroyed.
+							if (m_upstreamHost.size() > 0 && !m_upstreamReusable)
 							{						
 								this->UpstreamSocket().shutdown(boost::asio::socket_base::shutdown_both, upstreamShutdownErr);
 								this->UpstreamSocket().close(upstreamCloseErr);
@@ -627,6 +741,118 @@ namespace te
 					/// </param>
 					void OnUpstreamConnect(const boost::system::error_code& error);
 
+					/// <summary>
+					/// Begins connecting to the upstream host, trying the resolved endpoints in
+					/// parallel, staggered, so that one dead or unresponsive address doesn't hold
+					/// up the connection. See network::StaggeredConnector. Whichever attempt wins,
+					/// its socket becomes the upstream socket, and ::OnUpstreamConnect(...) is
+					/// invoked on the upstream strand with the outcome.
+					/// </summary>
+					/// <param name="endpoints">
+					/// The resolved endpoints of the upstream host.
+					/// </param>
+					/// <param name="port">
+					/// The port to connect to. Zero keeps whatever port the endpoints were resolved
+					/// with.
+					/// </param>
+					void ConnectUpstream(boost::asio::ip::tcp::resolver::iterator endpoints, const uint16_t port)
+					{
+						auto connector = std::make_shared<network::StaggeredConnector>(*m_service);
+
+						std::atomic_store(&m_upstreamConnector, connector);
+
+						connector->AsyncConnect(
+							endpoints,
+							port,
+							m_upstreamStrand.wrap(
+								std::bind(
+									&TlsCapableHttpBridge::OnUpstreamConnectorFinished,
+									shared_from_this(),
+									std::placeholders::_1,
+									std::placeholders::_2
+									)
+								)
+							);
+					}
+
+					/// <summary>
+					/// Completion handler for the staggered connection attempts started in
+					/// ::ConnectUpstream(...). Moves the winning connection into the upstream
+					/// socket, then carries on as though the upstream socket had connected by
+					/// itself.
+					/// </summary>
+					/// <param name="error">
+					/// Error code that will indicate if any errors were handled during the async
+					/// operation, providing details if an error did occur and was handled.
+					/// </param>
+					/// <param name="socket">
+					/// The connected socket of the winning attempt. nullptr if every attempt failed.
+					/// </param>
+					void OnUpstreamConnectorFinished(const boost::system::error_code& error, std::shared_ptr<boost::asio::ip::tcp::socket> socket)
+					{
+						std::atomic_store(&m_upstreamConnector, std::shared_ptr<network::StaggeredConnector>());
+
+						if (!error && socket != nullptr)
+						{
+							UpstreamSocket() = std::move(*socket);
+						}
+
+						OnUpstreamConnect(error);
+					}
+
+					/// <summary>
+					/// Begins resolving m_upstreamHost, through the shared host resolver if we have
+					/// one, or through our own resolver otherwise. Either way, ::OnResolve(...) is
+					/// invoked on the upstream strand with the outcome.
+					/// </summary>
+					/// <param name="serviceName">
+					/// The service name, "http" or "https", with which the resolved endpoints are
+					/// configured.
+					/// </param>
+					void ResolveUpstream(const char* serviceName)
+					{
+						auto handler = m_upstreamStrand.wrap(
+							std::bind(
+								&TlsCapableHttpBridge::OnResolve,
+								shared_from_this(),
+								std::placeholders::_1,
+								std::placeholders::_2
+								)
+							);
+
+						if (m_hostResolver != nullptr)
+						{
+							m_hostResolver->AsyncResolve(*m_service, m_upstreamHost, serviceName, handler);
+							return;
+						}
+
+						boost::asio::ip::tcp::resolver::query query(m_upstreamHost, serviceName);
+
+						m_resolver.async_resolve(query, handler);
+					}
+
+					/// <summary>
+					/// Attempts to borrow an idle connection to the upstream host from the upstream
+					/// connection pool, in place of resolving and connecting to the host. This
+					/// method is specialized, because what a borrowed connection lets us skip
+					/// differs. A TCP connection goes straight on to ::OnUpstreamConnect(...). A TLS
+					/// connection has already been through the handshake, so the peer certificate
+					/// is taken from it, and it goes straight on to ::OnUpstreamHandshake(...).
+					/// </summary>
+					/// <returns>
+					/// True if a connection was borrowed and the bridge has carried on with it,
+					/// false if the caller should resolve and connect to the host as usual.
+					/// </returns>
+					const bool BorrowUpstream();
+
+					/// <summary>
+					/// Gives the upstream connection to the upstream connection pool, if it's idle
+					/// between requests and still open. This method is specialized, because a TLS
+					/// connection has a verification callback bound to this bridge that must not
+					/// outlive it.
+					/// </summary>
+					void ReturnUpstream();
+
 					/// <summary>
 					/// Completion handler for when the initial asynchronous read from the upstream
 					/// server is complete. The initial read specifies a condition that indicates
@@ -712,14 +938,14 @@ namespace te
 								// We want to remove any header that has to do with Google's SDHC
 								// compression method. We don't want it, because we don't support it
 								// so we'd have no way to handle content compressed with this method.
-								m_response->RemoveHeader(util::http::headers::GetDictionary);
+								m_response->RemoveHeader(util::http::HeaderId::GetDictionary);
 
 								// Ensure that nobody is advertising for QUIC support.
-								m_response->RemoveHeader(util::http::headers::AlternateProtocol);
+								m_response->RemoveHeader(util::http::HeaderId::AlternateProtocol);
 
 								// Set m_keepAlive to what the server has specified. The client may have requested it, but
 								// ultimately it's up to the server how it's going to serve us.
-								auto connectionHeader = m_response->GetHeader(util::http::headers::Connection);
+								auto connectionHeader = m_response->GetHeader(util::http::HeaderId::Connection);
 
 								bool keepAlive = false;
 
@@ -755,7 +981,7 @@ namespace te
 										SetStreamTimeout(5000);
 
 										boost::asio::async_read(
-											m_upstreamSocket,
+											*m_upstreamSocket,
 											readBuffer,
 											boost::asio::transfer_at_least(1),
 											m_upstreamStrand.wrap(
@@ -779,6 +1005,12 @@ namespace te
 								{
 									// We need to write what we have to the client.
 
+									// An inspected payload may have come in whole along with the headers, in
+									// which case it was decoded and inspected above, and must go back to the
+									// client either exactly as it came, or freshly encoded if it was modified.
+									// Does nothing to a payload that wasn't decoded.
+									m_response->ApplyContentEncodingPolicy(m_acceptedContentEncodings);
+
 									SetStreamTimeout(5000);
 
 									auto writeBuffer = m_response->GetWriteBuffer();
@@ -868,6 +1100,12 @@ namespace te
 										m_response->SetShouldBlock(blockResult);
 										m_response->Make204();
 									}
+									else
+									{
+										// The payload was decoded for inspection. Send it back to the client
+										// either exactly as it came, or freshly encoded if it was modified.
+										m_response->ApplyContentEncodingPolicy(m_acceptedContentEncodings);
+									}
 								}
 								
 								if (m_response->IsPayloadComplete() == false && m_response->GetConsumeAllBeforeSending() == true)
@@ -879,7 +1117,7 @@ namespace te
 										auto readBuffer = m_response->GetPayloadReadBuffer();
 
 										boost::asio::async_read(
-											m_upstreamSocket,
+											*m_upstreamSocket,
 											readBuffer,
 											boost::asio::transfer_at_least(1),
 											m_upstreamStrand.wrap(
@@ -1002,7 +1240,7 @@ namespace te
 								SetStreamTimeout(5000);
 
 								boost::asio::async_read_until(
-									m_upstreamSocket,
+									*m_upstreamSocket,
 									m_response->GetHeaderReadBuffer(), 
 									u8"\r\n\r\n",
 									m_upstreamStrand.wrap(
@@ -1086,39 +1324,59 @@ namespace te
 								// to use their own "I'm too cool for skool" compression methods like SDHC. We
 								// want to be sure that we get normal, non-hipster encoded, non-organic smoothie
 								// encoded reponses that sane people can decompress. So we just always replace
-								// the Accept-Encoding header with this.
-								std::string standardEncoding(u8"gzip, deflate");
-								m_request->AddHeader(util::http::headers::AcceptEncoding, standardEncoding);
+								// the Accept-Encoding header with the encodings we can decode. What the client
+								// actually accepts is kept though, since that decides how the response is
+								// encoded on the way back.
+								const auto acceptEncoding = m_request->GetHeader(util::http::HeaderId::AcceptEncoding);
+
+								m_acceptedContentEncodings = http::ToContentEncodingSet(http::ContentEncoding::Identity);
+
+								if (acceptEncoding.first != acceptEncoding.second)
+								{
+									m_acceptedContentEncodings = http::ParseAcceptEncoding(acceptEncoding.first->second);
+								}
+
+								// gzip and deflate are always asked for, as they always have been. br and zstd
+								// are only asked for when the client takes them too, since responses that are
+								// not inspected pass through exactly as the server sent them.
+								const http::ContentEncodingSet standardEncodings =
+									http::ToContentEncodingSet(http::ContentEncoding::Gzip) |
+									http::ToContentEncodingSet(http::ContentEncoding::Deflate) |
+									(m_acceptedContentEncodings & (http::ToContentEncodingSet(http::ContentEncoding::Brotli) | http::ToContentEncodingSet(http::ContentEncoding::Zstd)));
+
+								m_request->AddHeader(util::http::headers::AcceptEncoding, http::FormatAcceptEncoding(standardEncodings));
 
 								// Modifying content-encoding isn't enough for that sweet organic spraytanned
 								// browser Chrome and its server cartel buddies. If these special headers make
 								// it through, even though we've explicitly defined our accepted encoding,
 								// you're still going to get SDHC encoded data.
-								m_request->RemoveHeader(util::http::headers::XSDHC);
-								m_request->RemoveHeader(util::http::headers::AvailDictionary);
+								m_request->RemoveHeader(util::http::HeaderId::XSDHC);
+								m_request->RemoveHeader(util::http::HeaderId::AvailDictionary);
 								
 								// Ensure that nobody is advertising for QUIC support.
-								m_request->RemoveHeader(util::http::headers::AlternateProtocol);
+								m_request->RemoveHeader(util::http::HeaderId::AlternateProtocol);
 
-								auto hostHeader = m_request->GetHeader(util::http::headers::Host);
+								auto hostHeader = m_request->GetHeader(util::http::HeaderId::Host);
 
 								if (hostHeader.first != hostHeader.second)
 								{
-									auto hostWithoutPort = hostHeader.first->second;
+									auto hostWithoutPort = hostHeader.first->second.to_string();
 
 									boost::trim(hostWithoutPort);
 
 									auto portInd = hostWithoutPort.find(':');
 
+									uint16_t hostPort = 0;
+
 									if (portInd != std::string::npos)
 									{
-										hostWithoutPort = hostWithoutPort.substr(0, portInd);
-										
 										auto portString = hostWithoutPort.substr(portInd + 1);
 
+										hostWithoutPort = hostWithoutPort.substr(0, portInd);
+
 										try
 										{
-											m_upstreamHostPort = static_cast<uint16_t>(std::stoi(portString));
+											hostPort = static_cast<uint16_t>(std::stoi(portString));
 										}
 										catch (...)
 										{
@@ -1151,19 +1409,14 @@ namespace te
 										SetStreamTimeout(5000);
 
 										m_upstreamHost = hostWithoutPort;
-										boost::asio::ip::tcp::resolver::query query(m_upstreamHost, std::is_same<BridgeSocketType, network::TlsSocket>::value ? "https" : "http");
+										m_upstreamHostPort = hostPort;
 
-										m_resolver.async_resolve(
-											query,
-											m_upstreamStrand.wrap(
-												std::bind(
-													&TlsCapableHttpBridge::OnResolve,
-													shared_from_this(),
-													std::placeholders::_1,
-													std::placeholders::_2
-													)
-												)
-											);
+										if (BorrowUpstream())
+										{
+											return;
+										}
+
+										ResolveUpstream(std::is_same<BridgeSocketType, network::TlsSocket>::value ? "https" : "http");
 
 										return;
 									}
@@ -1177,10 +1430,14 @@ namespace te
 
 									SetStreamTimeout(5000);
 
+									// The upstream connection is busy again, so it must not be
+									// given to the pool should the bridge die mid-request.
+									m_upstreamReusable = false;
+
 									auto writeBuffer = m_request->GetWriteBuffer();
 
 									boost::asio::async_write(
-										m_upstreamSocket,
+										*m_upstreamSocket,
 										writeBuffer,
 										boost::asio::transfer_all(),
 										m_upstreamStrand.wrap(
@@ -1287,7 +1544,7 @@ namespace te
 								auto writeBuffer = m_request->GetWriteBuffer();
 
 								boost::asio::async_write(
-									m_upstreamSocket, 
+									*m_upstreamSocket, 
 									writeBuffer, 
 									boost::asio::transfer_all(), 
 									m_upstreamStrand.wrap(
@@ -1340,6 +1597,26 @@ namespace te
 						// after.
 						if (!error)
 						{
+							if (m_response->IsPayloadComplete() == false && m_response->GetConsumeAllBeforeSending() == false)
+							{
+								// The headers are out, and nobody wants to see the rest of the payload, so
+								// relay it through the response's ring rather than bouncing it through the
+								// payload buffer one read and one write at a time. The relay lives on the
+								// upstream strand, so it's started there.
+								m_relayReadPending = false;
+								m_relayWritePending = false;
+								m_relayUpstreamClosed = false;
+
+								m_upstreamStrand.post(
+									std::bind(
+										&TlsCapableHttpBridge::PumpResponseRelay,
+										shared_from_this()
+										)
+									);
+
+								return;
+							}
+
 							if (m_response->IsPayloadComplete() == false)
 							{
 								// The server has more to write.
@@ -1351,7 +1628,7 @@ namespace te
 									auto readBuffer = m_response->GetPayloadReadBuffer();
 
 									boost::asio::async_read(
-										m_upstreamSocket,
+										*m_upstreamSocket,
 										readBuffer,
 										boost::asio::transfer_at_least(1),
 										m_upstreamStrand.wrap(
@@ -1374,69 +1651,290 @@ namespace te
 								}
 							}
 							else
-							{							
-								// We've fulfilled the request. Now, if keep-alive was specified, we'll reset and
-								// start over again. Otherwise, we'll just die.
-								if (m_keepAlive)
-								{
-									#ifndef NDEBUG
-									ReportInfo(u8"In TlsCapableHttpBridge::OnDownstreamWrite(const boost::system::error_code&) - Keep-alive specified, initiating new read.");
-									#endif
-
-									// We cannot use keep-alive when we've actively blocked a
-									// transaction from completing early. If we do, then the follow
-									// up response from the server on the new request will be
-									// polluted by the left over data from the previous, aborted
-									// (blocked) request. Therefore, we have no choice but to
-									// entirely terminate the bridge and force the client to open a
-									// new connection.
-
-									if ((m_request && m_request->GetShouldBlock() != 0) || (m_response && m_response->GetShouldBlock() != 0))
-									{
-										Kill();
-										return;
-									}
+							{
+								// We've fulfilled the request.
+								OnResponseComplete();
+								return;
+							}
+						}
+						else
+						{
+							std::string errMsg(u8"In TlsCapableHttpBridge::OnDownstreamWrite(const boost::system::error_code&) - Got error:\t");
+							errMsg.append(error.message());
+							ReportError(errMsg);
+						}
 
-									SetStreamTimeout(5000);
+						Kill();
+					}
 
-									m_request.reset(new http::HttpRequest());
-									m_response.reset(new http::HttpResponse());
+					/// <summary>
+					/// Called once the complete response has been written to the client. If
+					/// keep-alive was specified, the transactions are reset and the next request
+					/// is read from the client. Otherwise, the bridge is terminated.
+					/// </summary>
+					void OnResponseComplete()
+					{
+						if (m_keepAlive)
+						{
+							#ifndef NDEBUG
+							ReportInfo(u8"In TlsCapableHttpBridge::OnResponseComplete() - Keep-alive specified, initiating new read.");
+							#endif
+
+							// We cannot use keep-alive when we've actively blocked a
+							// transaction from completing early. If we do, then the follow
+							// up response from the server on the new request will be
+							// polluted by the left over data from the previous, aborted
+							// (blocked) request. Therefore, we have no choice but to
+							// entirely terminate the bridge and force the client to open a
+							// new connection.
+
+							if ((m_request && m_request->GetShouldBlock() != 0) || (m_response && m_response->GetShouldBlock() != 0))
+							{
+								Kill();
+								return;
+							}
 
-									// XXX TODO - This is ugly, our bad design is showing. See notes in the
-									// EventReporter class header.
-									m_request->SetOnInfo(m_onInfo);
-									m_request->SetOnWarning(m_onWarning);
-									m_request->SetOnError(m_onError);
-									m_response->SetOnInfo(m_onInfo);
-									m_response->SetOnWarning(m_onWarning);
-									m_response->SetOnError(m_onError);
+							// The response is complete and the server wants to keep the connection
+							// open, so the upstream connection can serve another request, whether
+							// that's the client's next one or, should the client go away, some other
+							// bridge's.
+							m_upstreamReusable = true;
 
-									boost::asio::async_read_until(
-										m_downstreamSocket,
-										m_request->GetHeaderReadBuffer(),
-										u8"\r\n\r\n",
-										m_downstreamStrand.wrap(
-											std::bind(
-												&TlsCapableHttpBridge::OnDownstreamHeaders,
-												shared_from_this(),
-												std::placeholders::_1,
-												std::placeholders::_2
-												)
-											)
-										);
+							SetStreamTimeout(5000);
 
-									return;
-								}
-							}							
+							// Reuse the existing transactions rather than constructing new
+							// ones, so that their parsers, event callbacks and buffers carry
+							// over to the next request on this connection. Both were
+							// created in the constructor, and are never released.
+							m_request->Reset();
+							m_response->Reset();
+
+							boost::asio::async_read_until(
+								m_downstreamSocket,
+								m_request->GetHeaderReadBuffer(),
+								u8"\r\n\r\n",
+								m_downstreamStrand.wrap(
+									std::bind(
+										&TlsCapableHttpBridge::OnDownstreamHeaders,
+										shared_from_this(),
+										std::placeholders::_1,
+										std::placeholders::_2
+										)
+									)
+								);
+
+							return;
 						}
-						else
+
+						Kill();
+					}
+
+					/// <summary>
+					/// Keeps the relay of a response payload moving, starting a write of the oldest
+					/// filled slot of the response's relay ring if none is outstanding, and a read
+					/// into the next free slot if none is outstanding and the payload is not yet
+					/// complete. So long as the ring has room, the server can be read from while
+					/// the client is being written to. See HttpResponse::GetRelayReadBuffer().
+					/// 
+					/// This runs on the upstream strand, so the ring and the relay state of this
+					/// bridge are only ever touched from that one strand. Writes to the client are
+					/// still operations on the downstream socket though, so like every other one,
+					/// they are started and completed on the downstream strand, and only their
+					/// outcome is handed back here. See ::StartDownstreamRelayWrite(...). Once
+					/// nothing is left outstanding, the response is finished with on the
+					/// downstream strand, or the bridge is terminated if the payload was cut short.
+					/// </summary>
+					void PumpResponseRelay()
+					{
+						if (!m_relayWritePending && m_response->HasRelayWrite())
 						{
-							std::string errMsg(u8"In TlsCapableHttpBridge::OnDownstreamWrite(const boost::system::error_code&) - Got error:\t");
+							SetStreamTimeout(5000);
+
+							m_relayWritePending = true;
+
+							// The slot stays put until ::CompleteDownstreamRelayWrite(...) commits it,
+							// so the buffer can safely cross over to the other strand.
+							m_downstreamStrand.post(
+								std::bind(
+									&TlsCapableHttpBridge::StartDownstreamRelayWrite,
+									shared_from_this(),
+									m_response->GetRelayWriteBuffer()
+									)
+								);
+						}
+
+						if (!m_relayReadPending && !m_relayUpstreamClosed && !m_response->IsPayloadComplete() && m_response->CanRelayRead())
+						{
+							SetStreamTimeout(5000);
+
+							m_relayReadPending = true;
+
+							boost::asio::async_read(
+								*m_upstreamSocket,
+								m_response->GetRelayReadBuffer(),
+								boost::asio::transfer_at_least(1),
+								m_upstreamStrand.wrap(
+									std::bind(
+										&TlsCapableHttpBridge::OnUpstreamRelayRead,
+										shared_from_this(),
+										std::placeholders::_1,
+										std::placeholders::_2
+										)
+									)
+								);
+						}
+
+						if (m_relayReadPending || m_relayWritePending)
+						{
+							return;
+						}
+
+						if (m_response->IsPayloadComplete())
+						{
+							// Finishing with the response starts the next read from the client, which
+							// belongs on the downstream strand.
+							m_downstreamStrand.post(
+								std::bind(
+									&TlsCapableHttpBridge::OnResponseComplete,
+									shared_from_this()
+									)
+								);
+
+							return;
+						}
+
+						ReportError(u8"In TlsCapableHttpBridge::PumpResponseRelay() - Upstream server closed the connection before the response payload was complete.");
+						Kill();
+					}
+
+					/// <summary>
+					/// Completion handler for when an asynchronous read of a response payload being
+					/// relayed completes. See ::PumpResponseRelay().
+					/// 
+					/// In the event that this operation was a failure, meaning that the supplied
+					/// error parameter was set and the code was one unexpected, the bridge will be 
+					/// terminated.
+					/// </summary>
+					/// <param name="error">
+					/// Error code that will indicate if any errors were handled during the async
+					/// operation, providing details if an error did occur and was handled.
+					/// </param>
+					/// <param name="bytesTransferred">
+					/// The number of bytes read from the remote upstream server.
+					/// </param>
+					void OnUpstreamRelayRead(const boost::system::error_code& error, const size_t bytesTransferred)
+					{
+						#ifndef NDEBUG
+						ReportInfo(u8"TlsCapableHttpBridge::OnUpstreamRelayRead");
+						#endif // !NDEBUG
+
+						m_relayReadPending = false;
+
+						if (error && error.value() != boost::asio::error::eof)
+						{
+							std::string errMsg(u8"In TlsCapableHttpBridge::OnUpstreamRelayRead(const boost::system::error_code&, const size_t) - Got error:\t");
 							errMsg.append(error.message());
 							ReportError(errMsg);
+							Kill();
+							return;
 						}
 
-						Kill();
+						if (bytesTransferred > 0 && !m_response->CommitRelayRead(bytesTransferred))
+						{
+							ReportError(u8"In TlsCapableHttpBridge::OnUpstreamRelayRead(const boost::system::error_code&, const size_t) - Failed to parse response.");
+							Kill();
+							return;
+						}
+
+						if (error)
+						{
+							// EOF. For a payload with no Content-Length and no chunked framing, this is
+							// the end of the payload. Either way, this connection can't be kept alive.
+							m_response->CommitRelayEof();
+							m_relayUpstreamClosed = true;
+							m_keepAlive = false;
+						}
+
+						PumpResponseRelay();
+					}
+
+					/// <summary>
+					/// Starts an asynchronous write of a slot of the response payload being relayed
+					/// to the client. Runs on the downstream strand, as does the completion of the
+					/// write. See ::PumpResponseRelay().
+					/// </summary>
+					/// <param name="buffer">
+					/// The filled slot of the response's relay ring to write.
+					/// </param>
+					void StartDownstreamRelayWrite(const boost::asio::const_buffers_1 buffer)
+					{
+						boost::asio::async_write(
+							m_downstreamSocket,
+							buffer,
+							boost::asio::transfer_all(),
+							m_downstreamStrand.wrap(
+								std::bind(
+									&TlsCapableHttpBridge::OnDownstreamRelayWrite,
+									shared_from_this(),
+									std::placeholders::_1
+									)
+								)
+							);
+					}
+
+					/// <summary>
+					/// Completion handler for when an asynchronous write of a response payload
+					/// being relayed completes. Runs on the downstream strand, and does nothing but
+					/// hand the outcome back to the upstream strand, where the relay lives. See
+					/// ::CompleteDownstreamRelayWrite(...).
+					/// </summary>
+					/// <param name="error">
+					/// Error code that will indicate if any errors were handled during the async
+					/// operation, providing details if an error did occur and was handled.
+					/// </param>
+					void OnDownstreamRelayWrite(const boost::system::error_code& error)
+					{
+						#ifndef NDEBUG
+						ReportInfo(u8"TlsCapableHttpBridge::OnDownstreamRelayWrite");
+						#endif // !NDEBUG
+
+						m_upstreamStrand.post(
+							std::bind(
+								&TlsCapableHttpBridge::CompleteDownstreamRelayWrite,
+								shared_from_this(),
+								error
+								)
+							);
+					}
+
+					/// <summary>
+					/// Finishes with a write of a response payload being relayed, on the upstream
+					/// strand, freeing the slot written and keeping the relay moving. See
+					/// ::PumpResponseRelay().
+					/// 
+					/// In the event that the write was a failure, meaning that the supplied error
+					/// parameter was set and the code was one unexpected, the bridge will be 
+					/// terminated.
+					/// </summary>
+					/// <param name="error">
+					/// The error code the write completed with.
+					/// </param>
+					void CompleteDownstreamRelayWrite(const boost::system::error_code& error)
+					{
+						m_relayWritePending = false;
+
+						if (error)
+						{
+							std::string errMsg(u8"In TlsCapableHttpBridge::CompleteDownstreamRelayWrite(const boost::system::error_code&) - Got error:\t");
+							errMsg.append(error.message());
+							ReportError(errMsg);
+							Kill();
+							return;
+						}
+
+						m_response->CommitRelayWrite();
+
+						PumpResponseRelay();
 					}
 
 					/// <summary>
@@ -1508,11 +2006,26 @@ namespace te
 						m_streamTimer.async_wait(std::bind(&TlsCapableHttpBridge::OnStreamTimeout, shared_from_this(), std::placeholders::_1));
 					}
 
+					/// <summary>
+					/// Completion handler for the upstream handshake started in
+					/// ::OnUpstreamConnect(...). This method is specialized, and only exists for
+					/// secure clients. Records the session with the session cache, so that the next
+					/// connection to the host can resume it, picks the peer certificate out of the
+					/// session if the handshake was resumed, and then carries on in
+					/// ::OnUpstreamHandshake(...).
+					/// </summary>
+					/// <param name="error">
+					/// Error code that will indicate if any errors were handled during the async
+					/// operation, providing details if an error did occur and was handled.
+					/// </param>
+					void OnUpstreamHandshakeComplete(const boost::system::error_code& error);
+
 					/// <summary>
 					/// Completion handler for when the asynchrous handshake operation with the
 					/// remote upstream host has finished. If the operation was a success, then a
-					/// context by which to serve the connected client will either be retrieved, or
-					/// created, stored and then retrieved.
+					/// context by which to serve the connected client is requested from the
+					/// certificate store, which will either retrieve it, or create, store and then
+					/// retrieve it, handing it to ::OnServerContext(...).
 					/// 
 					/// In the event that this operation was a failure, meaning that the supplied
 					/// error parameter was set and the code was one unexpected, the bridge will be 
@@ -1531,64 +2044,99 @@ namespace te
 
 						if (!error && m_upstreamCert != nullptr)
 						{
-							boost::asio::ssl::context* serverCtx = nullptr;
+							// Spoofing a certificate is expensive, so it's done off our thread. The
+							// store copies the certificate before handing it to a minting thread, so
+							// we don't need to hold on to it past this call.
+							m_certStore->AsyncGetServerContext(
+								*m_service,
+								m_upstreamHost,
+								m_upstreamCert,
+								m_downstreamStrand.wrap(
+									std::bind(
+										&TlsCapableHttpBridge::OnServerContext,
+										shared_from_this(),
+										std::placeholders::_1,
+										std::placeholders::_2
+										)
+									)
+								);
 
-							try
+							return;
+						}
+						else
+						{
+							if (error)
 							{
-								serverCtx = m_certStore->GetServerContext(m_upstreamHost, m_upstreamCert);
+								std::string errMsg(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshake(const boost::system::error_code&) - Got error:\t");
+								errMsg.append(error.message());
+								ReportError(errMsg);
 							}
-							catch (std::exception& e)
+
+							if (m_upstreamCert != nullptr)
 							{
-								serverCtx = nullptr;
-								std::string errMessage(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshake(const boost::system::error_code&) - Got error:\t");
-								errMessage.append(e.what());
-								ReportError(errMessage);
+								ReportError(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshake(const boost::system::error_code&) - Upstream cert is nullptr!");
 							}
+						}
+
+						Kill();
+					}
+
+					/// <summary>
+					/// Completion handler for when the certificate store has retrieved, or created,
+					/// the context by which to serve the connected client. If a context was given,
+					/// the client connection is switched over to it and the handshake with the
+					/// client begins.
+					/// 
+					/// In the event that no context was given, the bridge will be terminated.
+					/// </summary>
+					/// <param name="serverCtx">
+					/// The context by which to serve the connected client, or nullptr on failure.
+					/// </param>
+					/// <param name="errorMessage">
+					/// Details of the failure, if the context is nullptr.
+					/// </param>
+					void OnServerContext(BaseInMemoryCertificateStore::SharedServerContext serverCtx, const std::string& errorMessage)
+					{
 
-							if (serverCtx != nullptr)
+						#ifndef NDEBUG
+						ReportInfo(u8"TlsCapableHttpBridge<network::TlsSocket>::OnServerContext");
+						#endif // !NDEBUG
+
+						if (serverCtx != nullptr)
+						{
+							if (SSL_set_SSL_CTX(m_downstreamSocket.native_handle(), serverCtx->native_handle()) == serverCtx->native_handle())
 							{
-								if (SSL_set_SSL_CTX(m_downstreamSocket.native_handle(), serverCtx->native_handle()) == serverCtx->native_handle())
-								{
-									// Set timeouts
-									SetStreamTimeout(5000);
-									//
-									
-									m_downstreamSocket.async_handshake(
-										network::TlsSocket::server, 
-										m_downstreamStrand.wrap(
-											std::bind(
-												&TlsCapableHttpBridge::OnDownstreamHandshake, 
-												shared_from_this(), 
-												std::placeholders::_1
-												)
+								// The store may drop the context at any time to make room for others,
+								// so we keep our own reference for as long as we're serving with it.
+								m_serverContext = serverCtx;
+
+								// Set timeouts
+								SetStreamTimeout(5000);
+								//
+								
+								m_downstreamSocket.async_handshake(
+									network::TlsSocket::server, 
+									m_downstreamStrand.wrap(
+										std::bind(
+											&TlsCapableHttpBridge::OnDownstreamHandshake, 
+											shared_from_this(), 
+											std::placeholders::_1
 											)
-										);
+										)
+									);
 
-									return;
-								}
-								else
-								{
-									ReportError(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshake(const boost::system::error_code&) - Failed to correctly set context.");
-								}
+								return;
 							}
 							else
 							{
-								ReportError(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshake(const boost::system::error_code&) - Failed to fetch spoofed context.");
+								ReportError(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnServerContext(BaseInMemoryCertificateStore::SharedServerContext, const std::string&) - Failed to correctly set context.");
 							}
 						}
 						else
 						{
-							if (error)
-							{
-								std::string errMsg(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshake(const boost::system::error_code&) - Got error:\t");
-								errMsg.append(error.message());
-								ReportError(errMsg);
-							}
-
-							if (m_upstreamCert != nullptr)
-							{
-								ReportError(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnUpstreamHandshake(const boost::system::error_code&) - Upstream cert is nullptr!");
-							}
+							std::string errMessage(u8"In TlsCapableHttpBridge<network::TlsSocket>::OnServerContext(BaseInMemoryCertificateStore::SharedServerContext, const std::string&) - Failed to fetch spoofed context. Got error:\t");
+							errMessage.append(errorMessage);
+							ReportError(errMessage);
 						}
 
 						Kill();
@@ -1839,6 +2387,9 @@ namespace te
 
 											m_upstreamHost = hostName.to_string();
 
+											// Feeds prewarming. See BaseInMemoryCertificateStore::RecordHostSeen(...).
+											m_certStore->RecordHostSeen(m_upstreamHost);
+
 											// XXX TODO - See notes in the version of ::OnResolve(...), specialized for TLS clients.
 											m_upstreamHostPort = 443;
 
@@ -1848,18 +2399,12 @@ namespace te
 
 											try
 											{
-												boost::asio::ip::tcp::resolver::query query(m_upstreamHost, "https");
-												m_resolver.async_resolve(
-													query, 
-													m_upstreamStrand.wrap(
-														std::bind(
-															&TlsCapableHttpBridge::OnResolve, 
-															shared_from_this(), 
-															std::placeholders::_1, 
-															std::placeholders::_2
-															)
-														)
-													);
+												if (BorrowUpstream())
+												{
+													return;
+												}
+
+												ResolveUpstream("https");
 
 												return;
 											}
@@ -0,0 +1,450 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "../../network/SocketTypes.hpp"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace secure
+			{
+
+				/// <summary>
+				/// Keeps idle upstream connections, left over from bridges whose client went away
+				/// after a complete keep-alive response, so that the next bridge headed for the
+				/// same server can skip the resolve, the connect and, for TLS, the handshake.
+				///
+				/// Connections are keyed by host, port and SNI name. Whether or not the connection
+				/// is TLS is a part of the key as well, but since a pool only ever holds one kind
+				/// of socket, that part is settled by the template parameter. One pool is owned by
+				/// each acceptor and shared by every bridge it creates.
+				///
+				/// Every connection handed out is checked first. Connections that have sat idle
+				/// longer than the idle timeout, that have been closed by the server, or that have
+				/// unsolicited data waiting on them, are closed and discarded instead. There is no
+				/// timer sweeping the pool. Stale connections are discarded whenever the pool is
+				/// used, which is the only time they matter.
+				/// </summary>
+				template<class BridgeSocketType>
+				class UpstreamConnectionPool
+				{
+
+				static_assert((std::is_same<BridgeSocketType, network::TcpSocket> ::value || std::is_same<BridgeSocketType, network::TlsSocket>::value), "UpstreamConnectionPool can only accept boost::asio::ip::tcp::socket or boost::asio::ssl::stream<boost::asio::ip::tcp::socket> as valid template parameters.");
+
+				public:
+
+					using SharedSocket = std::shared_ptr<BridgeSocketType>;
+
+					/// <summary>
+					/// Default maximum number of idle connections kept for any one key.
+					/// </summary>
+					static constexpr size_t DefaultMaxIdlePerHost = 6;
+
+					/// <summary>
+					/// Default maximum number of idle connections kept in total.
+					/// </summary>
+					static constexpr size_t DefaultMaxIdleTotal = 256;
+
+					/// <summary>
+					/// Default number of seconds an idle connection is kept before it is discarded.
+					/// Plenty of servers close idle connections well before this, which the health
+					/// check catches.
+					/// </summary>
+					static constexpr int64_t DefaultIdleTimeoutSeconds = 30;
+
+					/// <summary>
+					/// Constructs a new, empty pool.
+					/// </summary>
+					/// <param name="maxIdlePerHost">
+					/// The maximum number of idle connections kept for any one key.
+					/// </param>
+					/// <param name="maxIdleTotal">
+					/// The maximum number of idle connections kept in total.
+					/// </param>
+					/// <param name="idleTimeoutSeconds">
+					/// The number of seconds an idle connection is kept before it is discarded.
+					/// </param>
+					UpstreamConnectionPool(
+						const size_t maxIdlePerHost = DefaultMaxIdlePerHost,
+						const size_t maxIdleTotal = DefaultMaxIdleTotal,
+						const int64_t idleTimeoutSeconds = DefaultIdleTimeoutSeconds
+						)
+						:
+						m_maxIdlePerHost(maxIdlePerHost),
+						m_maxIdleTotal(maxIdleTotal),
+						m_idleTimeout(std::chrono::seconds(idleTimeoutSeconds))
+					{
+
+					}
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					UpstreamConnectionPool(const UpstreamConnectionPool&) = delete;
+					UpstreamConnectionPool(UpstreamConnectionPool&&) = delete;
+					UpstreamConnectionPool& operator=(const UpstreamConnectionPool&) = delete;
+
+					/// <summary>
+					/// Closes every idle connection.
+					/// </summary>
+					~UpstreamConnectionPool()
+					{
+						Shutdown();
+					}
+
+					/// <summary>
+					/// Takes an idle connection to the supplied server from the pool, if a healthy
+					/// one is available.
+					/// </summary>
+					/// <param name="host">
+					/// The host name of the server.
+					/// </param>
+					/// <param name="port">
+					/// The port on the server.
+					/// </param>
+					/// <param name="sni">
+					/// The SNI name the connection was established with. Empty for plain TCP.
+					/// </param>
+					/// <returns>
+					/// A connected, idle socket, or nullptr if none was available.
+					/// </returns>
+					SharedSocket Borrow(const std::string& host, const uint16_t port, const std::string& sni)
+					{
+						const auto key = MakeKey(host, port, sni);
+						const auto now = std::chrono::steady_clock::now();
+
+						std::vector<SharedSocket> discarded;
+						SharedSocket borrowed = nullptr;
+
+						{
+							std::lock_guard<std::mutex> lock(m_lock);
+
+							auto entry = m_idle.find(key);
+
+							if (entry == m_idle.end())
+							{
+								return nullptr;
+							}
+
+							auto& connections = entry->second;
+
+							// The most recently returned connection is the most likely to still be
+							// alive, so take from the back.
+							while (connections.size() > 0)
+							{
+								auto connection = std::move(connections.back());
+								connections.pop_back();
+								--m_idleCount;
+
+								if (now - connection.since < m_idleTimeout && IsHealthy(*connection.socket))
+								{
+									borrowed = std::move(connection.socket);
+									break;
+								}
+
+								discarded.push_back(std::move(connection.socket));
+							}
+
+							if (connections.size() == 0)
+							{
+								m_idle.erase(entry);
+							}
+						}
+
+						Close(discarded);
+
+						return borrowed;
+					}
+
+					/// <summary>
+					/// Gives an idle connection to the pool. The connection must have no
+					/// operations outstanding, and the last response read from it must have been
+					/// complete and must have allowed keep-alive. If the pool is full for the key
+					/// or in total, or the pool has been shut down, the connection is closed
+					/// instead.
+					/// </summary>
+					/// <param name="host">
+					/// The host name of the server.
+					/// </param>
+					/// <param name="port">
+					/// The port on the server.
+					/// </param>
+					/// <param name="sni">
+					/// The SNI name the connection was established with. Empty for plain TCP.
+					/// </param>
+					/// <param name="socket">
+					/// The connection.
+					/// </param>
+					void Return(const std::string& host, const uint16_t port, const std::string& sni, SharedSocket socket)
+					{
+						if (socket == nullptr)
+						{
+							return;
+						}
+
+						const auto key = MakeKey(host, port, sni);
+						const auto now = std::chrono::steady_clock::now();
+
+						std::vector<SharedSocket> discarded;
+
+						{
+							std::lock_guard<std::mutex> lock(m_lock);
+
+							// Stale connections are only swept out when the pool is used, so do a
+							// little housekeeping while we're here.
+							for (auto entry = m_idle.begin(); entry != m_idle.end();)
+							{
+								auto& connections = entry->second;
+
+								// Connections are appended in the order they're returned, so the
+								// oldest are always at the front.
+								while (connections.size() > 0 && now - connections.front().since >= m_idleTimeout)
+								{
+									discarded.push_back(std::move(connections.front().socket));
+									connections.pop_front();
+									--m_idleCount;
+								}
+
+								if (connections.size() == 0)
+								{
+									entry = m_idle.erase(entry);
+								}
+								else
+								{
+									++entry;
+								}
+							}
+
+							if (!m_shutdown && m_idleCount < m_maxIdleTotal)
+							{
+								auto& connections = m_idle[key];
+
+								if (connections.size() >= m_maxIdlePerHost)
+								{
+									// Make room by dropping the oldest.
+									discarded.push_back(std::move(connections.front().socket));
+									connections.pop_front();
+									--m_idleCount;
+								}
+
+								connections.push_back(IdleConnection{ std::move(socket), now });
+								++m_idleCount;
+							}
+							else
+							{
+								discarded.push_back(std::move(socket));
+							}
+						}
+
+						Close(discarded);
+					}
+
+					/// <summary>
+					/// Closes every idle connection, and refuses any further connections given to
+					/// the pool. Called when the owning acceptor goes away, since bridges it
+					/// created may outlive it.
+					/// </summary>
+					void Shutdown()
+					{
+						std::vector<SharedSocket> discarded;
+
+						{
+							std::lock_guard<std::mutex> lock(m_lock);
+
+							m_shutdown = true;
+
+							for (auto& entry : m_idle)
+							{
+								for (auto& connection : entry.second)
+								{
+									discarded.push_back(std::move(connection.socket));
+								}
+							}
+
+							m_idle.clear();
+							m_idleCount = 0;
+						}
+
+						Close(discarded);
+					}
+
+				private:
+
+					/// <summary>
+					/// An idle connection and the time it was given to the pool.
+					/// </summary>
+					struct IdleConnection
+					{
+						SharedSocket socket;
+
+						std::chrono::steady_clock::time_point since;
+					};
+
+					/// <summary>
+					/// Builds the key that connections are stored under.
+					/// </summary>
+					static std::string MakeKey(const std::string& host, const uint16_t port, const std::string& sni)
+					{
+						std::string key;
+						key.reserve(host.size() + sni.size() + 12);
+
+						key.append(host).append(u8":").append(std::to_string(port));
+						key.append(std::is_same<BridgeSocketType, network::TlsSocket>::value ? u8"/tls/" : u8"/tcp/");
+						key.append(sni);
+
+						return key;
+					}
+
+					/// <summary>
+					/// Checks that an idle connection is still good for another request. A
+					/// non-blocking peek that would block means the server has neither closed the
+					/// connection nor sent anything unasked, which is exactly what an idle
+					/// connection should look like.
+					/// </summary>
+					static const bool IsHealthy(BridgeSocketType& socket)
+					{
+						auto& tcpSocket = TcpLayer(socket);
+
+						if (!tcpSocket.is_open())
+						{
+							return false;
+						}
+
+						boost::system::error_code err;
+
+						tcpSocket.non_blocking(true, err);
+
+						if (err)
+						{
+							return false;
+						}
+
+						char peekByte;
+						tcpSocket.receive(boost::asio::buffer(&peekByte, 1), boost::asio::ip::tcp::socket::message_peek, err);
+
+						boost::system::error_code restoreErr;
+						tcpSocket.non_blocking(false, restoreErr);
+
+						return err == boost::asio::error::would_block && !restoreErr;
+					}
+
+					/// <summary>
+					/// Gets the TCP socket underneath the supplied socket.
+					/// </summary>
+					static network::TcpSocket& TcpLayer(network::TcpSocket& socket)
+					{
+						return socket;
+					}
+
+					/// <summary>
+					/// Gets the TCP socket underneath the supplied socket.
+					/// </summary>
+					static network::TcpSocket& TcpLayer(network::TlsSocket& socket)
+					{
+						return socket.next_layer();
+					}
+
+					/// <summary>
+					/// Closes the supplied connections.
+					/// </summary>
+					static void Close(std::vector<SharedSocket>& sockets)
+					{
+						for (auto& socket : sockets)
+						{
+							if (socket == nullptr)
+							{
+								continue;
+							}
+
+							boost::system::error_code err;
+
+							socket->lowest_layer().shutdown(boost::asio::socket_base::shutdown_both, err);
+							socket->lowest_layer().close(err);
+						}
+
+						sockets.clear();
+					}
+
+					/// <summary>
+					/// Guards all of the members below.
+					/// </summary>
+					std::mutex m_lock;
+
+					/// <summary>
+					/// Idle connections, by key, oldest first.
+					/// </summary>
+					std::unordered_map<std::string, std::deque<IdleConnection>> m_idle;
+
+					/// <summary>
+					/// The total number of idle connections held.
+					/// </summary>
+					size_t m_idleCount = 0;
+
+					/// <summary>
+					/// Whether or not ::Shutdown() has been called.
+					/// </summary>
+					bool m_shutdown = false;
+
+					/// <summary>
+					/// See the constructor.
+					/// </summary>
+					const size_t m_maxIdlePerHost;
+
+					/// <summary>
+					/// See the constructor.
+					/// </summary>
+					const size_t m_maxIdleTotal;
+
+					/// <summary>
+					/// See the constructor.
+					/// </summary>
+					const std::chrono::steady_clock::duration m_idleTimeout;
+
+				};
+
+			} /* namespace secure */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
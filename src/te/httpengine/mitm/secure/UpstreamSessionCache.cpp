@@ -0,0 +1,233 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UpstreamSessionCache.hpp"
+#include <ctime>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace secure
+			{
+
+				UpstreamSessionCache::UpstreamSessionCache(const size_t maxEntries, const long maxAgeSeconds)
+					:
+					m_maxEntries(maxEntries > 0 ? maxEntries : 1),
+					m_maxAgeSeconds(maxAgeSeconds)
+				{
+
+				}
+
+				UpstreamSessionCache::~UpstreamSessionCache()
+				{
+					for (auto& entry : m_sessions)
+					{
+						SSL_SESSION_free(entry.second.session);
+					}
+
+					m_sessions.clear();
+					m_recency.clear();
+				}
+
+				const bool UpstreamSessionCache::Apply(SSL* ssl, const std::string& host, const uint16_t port)
+				{
+					if (ssl == nullptr)
+					{
+						return false;
+					}
+
+					const auto key = MakeKey(host, port);
+
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					auto cached = m_sessions.find(key);
+
+					if (cached == m_sessions.end())
+					{
+						return false;
+					}
+
+					if (!IsFresh(cached->second.session))
+					{
+						SSL_SESSION_free(cached->second.session);
+						m_recency.erase(cached->second.recency);
+						m_sessions.erase(cached);
+						return false;
+					}
+
+					m_recency.splice(m_recency.begin(), m_recency, cached->second.recency);
+
+					// SSL_set_session takes its own reference, so the session is safe from
+					// being freed by the cache once this returns.
+					if (SSL_set_session(ssl, cached->second.session) != 1)
+					{
+						return false;
+					}
+
+					++m_offered;
+
+					return true;
+				}
+
+				void UpstreamSessionCache::Store(SSL* ssl, const std::string& host, const uint16_t port)
+				{
+					if (ssl == nullptr)
+					{
+						return;
+					}
+
+					++m_handshakes;
+
+					if (SSL_session_reused(ssl))
+					{
+						++m_resumed;
+					}
+
+					// When a session is resumed, the server may well have issued a fresh ticket
+					// along the way, in which case the session we've got now is the one to keep.
+					// Either way, storing what we've got is correct.
+					SSL_SESSION* session = SSL_get1_session(ssl);
+
+					if (session == nullptr)
+					{
+						return;
+					}
+
+					const auto key = MakeKey(host, port);
+
+					SSL_SESSION* replaced = nullptr;
+
+					{
+						std::lock_guard<std::mutex> lock(m_lock);
+
+						auto cached = m_sessions.find(key);
+
+						if (cached != m_sessions.end())
+						{
+							replaced = cached->second.session;
+							cached->second.session = session;
+							m_recency.splice(m_recency.begin(), m_recency, cached->second.recency);
+						}
+						else
+						{
+							if (m_sessions.size() >= m_maxEntries && m_recency.size() > 0)
+							{
+								auto oldest = m_sessions.find(m_recency.back());
+
+								if (oldest != m_sessions.end())
+								{
+									replaced = oldest->second.session;
+									m_sessions.erase(oldest);
+								}
+
+								m_recency.pop_back();
+								++m_evictions;
+							}
+
+							m_recency.push_front(key);
+
+							CacheEntry entry;
+							entry.session = session;
+							entry.recency = m_recency.begin();
+
+							m_sessions.emplace(key, entry);
+						}
+					}
+
+					if (replaced != nullptr)
+					{
+						SSL_SESSION_free(replaced);
+					}
+				}
+
+				void UpstreamSessionCache::Remove(const std::string& host, const uint16_t port)
+				{
+					const auto key = MakeKey(host, port);
+
+					SSL_SESSION* removed = nullptr;
+
+					{
+						std::lock_guard<std::mutex> lock(m_lock);
+
+						auto cached = m_sessions.find(key);
+
+						if (cached == m_sessions.end())
+						{
+							return;
+						}
+
+						removed = cached->second.session;
+						m_recency.erase(cached->second.recency);
+						m_sessions.erase(cached);
+					}
+
+					SSL_SESSION_free(removed);
+				}
+
+				const UpstreamSessionCache::Statistics UpstreamSessionCache::GetStatistics()
+				{
+					Statistics stats;
+
+					stats.handshakes = m_handshakes;
+					stats.resumed = m_resumed;
+					stats.offered = m_offered;
+					stats.evictions = m_evictions;
+
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					stats.entries = m_sessions.size();
+
+					return stats;
+				}
+
+				std::string UpstreamSessionCache::MakeKey(const std::string& host, const uint16_t port)
+				{
+					std::string key(host);
+					key.append(u8":").append(std::to_string(port));
+
+					return key;
+				}
+
+				const bool UpstreamSessionCache::IsFresh(SSL_SESSION* session) const
+				{
+					const long age = static_cast<long>(std::time(nullptr)) - SSL_SESSION_get_time(session);
+					const long serverTimeout = SSL_SESSION_get_timeout(session);
+
+					return age >= 0 && age < serverTimeout && age < m_maxAgeSeconds;
+				}
+
+			} /* namespace secure */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
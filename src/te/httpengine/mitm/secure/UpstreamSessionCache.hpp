@@ -0,0 +1,258 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <openssl/ssl.h>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace mitm
+		{
+			namespace secure
+			{
+
+				/// <summary>
+				/// Keeps the most recent TLS session established with each upstream server, so
+				/// that the next connection to the same server can resume it rather than go
+				/// through a full handshake. Sessions are stored whole, so this covers both
+				/// session IDs and session tickets, whichever the server hands out.
+				///
+				/// A resumed handshake skips the certificate exchange entirely, so there is no
+				/// chain to verify the second time around. The session was only ever stored after
+				/// its chain passed verification against the very same host name it's stored
+				/// under, so this is no weaker than verifying again.
+				///
+				/// Sessions are kept per host and port, up to a fixed number of hosts, dropping
+				/// the least recently used host when full. A session is dropped once it's older
+				/// than either the lifetime the server gave it, or our own maximum age, whichever
+				/// comes first.
+				/// </summary>
+				class UpstreamSessionCache
+				{
+
+				public:
+
+					/// <summary>
+					/// Snapshot of the cache counters, as given by ::GetStatistics().
+					/// </summary>
+					struct Statistics
+					{
+						/// <summary>
+						/// Upstream handshakes completed.
+						/// </summary>
+						uint64_t handshakes = 0;
+
+						/// <summary>
+						/// Upstream handshakes completed by resuming a session.
+						/// </summary>
+						uint64_t resumed = 0;
+
+						/// <summary>
+						/// Upstream handshakes on which a cached session was offered, whether or not
+						/// the server took it.
+						/// </summary>
+						uint64_t offered = 0;
+
+						/// <summary>
+						/// Sessions dropped to make room for others.
+						/// </summary>
+						uint64_t evictions = 0;
+
+						/// <summary>
+						/// Number of sessions presently held.
+						/// </summary>
+						size_t entries = 0;
+					};
+
+					/// <summary>
+					/// Default maximum number of hosts to keep a session for.
+					/// </summary>
+					static constexpr size_t DefaultMaxEntries = 2048;
+
+					/// <summary>
+					/// Default maximum age, in seconds, of a session we'll offer, regardless of
+					/// what the server says.
+					/// </summary>
+					static constexpr long DefaultMaxAgeSeconds = 7200;
+
+					/// <summary>
+					/// Constructs a new, empty cache.
+					/// </summary>
+					/// <param name="maxEntries">
+					/// The maximum number of hosts to keep a session for.
+					/// </param>
+					/// <param name="maxAgeSeconds">
+					/// The maximum age, in seconds, of a session we'll offer.
+					/// </param>
+					UpstreamSessionCache(const size_t maxEntries = DefaultMaxEntries, const long maxAgeSeconds = DefaultMaxAgeSeconds);
+
+					/// <summary>
+					/// No copy no move no thx.
+					/// </summary>
+					UpstreamSessionCache(const UpstreamSessionCache&) = delete;
+					UpstreamSessionCache(UpstreamSessionCache&&) = delete;
+					UpstreamSessionCache& operator=(const UpstreamSessionCache&) = delete;
+
+					/// <summary>
+					/// Frees every session held.
+					/// </summary>
+					~UpstreamSessionCache();
+
+					/// <summary>
+					/// Offers the cached session for the supplied host, if there is one, on the
+					/// supplied connection. Must be called before the handshake begins.
+					/// </summary>
+					/// <param name="ssl">
+					/// The upstream connection.
+					/// </param>
+					/// <param name="host">
+					/// The host name of the server.
+					/// </param>
+					/// <param name="port">
+					/// The port on the server.
+					/// </param>
+					/// <returns>
+					/// True if a session was offered, false otherwise.
+					/// </returns>
+					const bool Apply(SSL* ssl, const std::string& host, const uint16_t port);
+
+					/// <summary>
+					/// Records the outcome of a successful handshake on the supplied connection,
+					/// and stores its session for the next connection to the same host.
+					/// </summary>
+					/// <param name="ssl">
+					/// The upstream connection.
+					/// </param>
+					/// <param name="host">
+					/// The host name of the server.
+					/// </param>
+					/// <param name="port">
+					/// The port on the server.
+					/// </param>
+					void Store(SSL* ssl, const std::string& host, const uint16_t port);
+
+					/// <summary>
+					/// Drops the cached session for the supplied host, if there is one. Called when
+					/// a handshake fails, in case the session had anything to do with it.
+					/// </summary>
+					/// <param name="host">
+					/// The host name of the server.
+					/// </param>
+					/// <param name="port">
+					/// The port on the server.
+					/// </param>
+					void Remove(const std::string& host, const uint16_t port);
+
+					/// <summary>
+					/// Gets a snapshot of the cache counters. The resumption rate is the number of
+					/// resumed handshakes over the number of handshakes.
+					/// </summary>
+					/// <returns>
+					/// The cache counters.
+					/// </returns>
+					const Statistics GetStatistics();
+
+				private:
+
+					/// <summary>
+					/// A cached session.
+					/// </summary>
+					struct CacheEntry
+					{
+						/// <summary>
+						/// The session. We hold one reference to it.
+						/// </summary>
+						SSL_SESSION* session;
+
+						/// <summary>
+						/// Position of the key in the recency list.
+						/// </summary>
+						std::list<std::string>::iterator recency;
+					};
+
+					/// <summary>
+					/// Builds the key that sessions are stored under.
+					/// </summary>
+					static std::string MakeKey(const std::string& host, const uint16_t port);
+
+					/// <summary>
+					/// Checks whether or not a session is still young enough to offer.
+					/// </summary>
+					const bool IsFresh(SSL_SESSION* session) const;
+
+					/// <summary>
+					/// Guards the sessions and the recency list.
+					/// </summary>
+					std::mutex m_lock;
+
+					/// <summary>
+					/// Cached sessions, by key.
+					/// </summary>
+					std::unordered_map<std::string, CacheEntry> m_sessions;
+
+					/// <summary>
+					/// Cached keys, most recently used first.
+					/// </summary>
+					std::list<std::string> m_recency;
+
+					/// <summary>
+					/// See the constructor.
+					/// </summary>
+					const size_t m_maxEntries;
+
+					/// <summary>
+					/// See the constructor.
+					/// </summary>
+					const long m_maxAgeSeconds;
+
+					std::atomic<uint64_t> m_handshakes{ 0 };
+
+					std::atomic<uint64_t> m_resumed{ 0 };
+
+					std::atomic<uint64_t> m_offered{ 0 };
+
+					std::atomic<uint64_t> m_evictions{ 0 };
+
+				};
+
+			} /* namespace secure */
+		} /* namespace mitm */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -73,11 +73,15 @@ namespace te
 				WindowsInMemoryCertificateStore::WindowsInMemoryCertificateStore(
 					const std::string& countryCode,
 					const std::string& organizationName,
-					const std::string& commonName
+					const std::string& commonName,
+					const std::string& cachePath,
+					const std::vector<unsigned char>& cacheKey
 					) : BaseInMemoryCertificateStore(						
 						countryCode, 
 						organizationName, 
-						commonName
+						commonName,
+						cachePath,
+						cacheKey
 						)
 				{
 					
@@ -80,10 +80,19 @@ namespace te
 					/// <param name="commonName">
 					/// The common name for the self signed CA to be generated.
 					/// </param>
+					/// <param name="cachePath">
+					/// The path of the persistent certificate cache, or empty for none. See
+					/// BaseInMemoryCertificateStore.
+					/// </param>
+					/// <param name="cacheKey">
+					/// The key to encrypt the persistent certificate cache with.
+					/// </param>
 					WindowsInMemoryCertificateStore(
 						const std::string& countryCode,
 						const std::string& organizationName,
-						const std::string& commonName
+						const std::string& commonName,
+						const std::string& cachePath = std::string(),
+						const std::vector<unsigned char>& cacheKey = std::vector<unsigned char>()
 						);
 
 					virtual ~WindowsInMemoryCertificateStore();
@@ -0,0 +1,277 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HostResolver.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace network
+		{
+
+			HostResolver::HostResolver(
+				const uint32_t numThreads,
+				const size_t maxEntries,
+				const int64_t positiveTtlSeconds,
+				const int64_t negativeTtlSeconds
+				)
+				:
+				m_lookupWork(new boost::asio::io_service::work(m_lookupService)),
+				m_maxEntries(maxEntries > 0 ? maxEntries : 1),
+				m_positiveTtl(std::chrono::seconds(positiveTtlSeconds)),
+				m_negativeTtl(std::chrono::seconds(negativeTtlSeconds)),
+				m_prefetchWindow(std::chrono::seconds(positiveTtlSeconds / 2 < DefaultPrefetchSeconds ? positiveTtlSeconds / 2 : static_cast<int64_t>(DefaultPrefetchSeconds)))
+			{
+				const uint32_t threadCount = numThreads > 0 ? numThreads : 1;
+
+				for (uint32_t i = 0; i < threadCount; ++i)
+				{
+					m_lookupThreads.emplace_back(
+						std::thread
+						{
+							std::bind(
+								static_cast<size_t(boost::asio::io_service::*)()>(&boost::asio::io_service::run),
+								std::ref(m_lookupService)
+								)
+						}
+					);
+				}
+			}
+
+			HostResolver::~HostResolver()
+			{
+				m_lookupWork.reset();
+				m_lookupService.stop();
+
+				for (auto& t : m_lookupThreads)
+				{
+					t.join();
+				}
+			}
+
+			void HostResolver::AsyncResolve(boost::asio::io_service& service, const std::string& host, const std::string& serviceName, ResolveHandler handler)
+			{
+				const auto key = MakeKey(host, serviceName);
+				const auto now = std::chrono::steady_clock::now();
+
+				std::lock_guard<std::mutex> lock(m_lock);
+
+				auto cached = m_cache.find(key);
+
+				if (cached != m_cache.end())
+				{
+					auto& entry = cached->second;
+
+					if (now < entry.expires)
+					{
+						m_recency.splice(m_recency.begin(), m_recency, entry.recency);
+
+						if (entry.error)
+						{
+							++m_negativeHits;
+						}
+						else
+						{
+							++m_hits;
+
+							// Refresh busy names before they expire, so nobody ever has to wait
+							// on them.
+							if (entry.expires - now < m_prefetchWindow && m_inFlight.find(key) == m_inFlight.end())
+							{
+								++m_prefetches;
+								m_inFlight[key];
+								StartLookup(key, host, serviceName);
+							}
+						}
+
+						service.post(std::bind(handler, entry.error, entry.endpoints));
+						return;
+					}
+				}
+
+				auto inFlight = m_inFlight.find(key);
+
+				if (inFlight != m_inFlight.end())
+				{
+					++m_coalesced;
+					inFlight->second.push_back(Waiter{ &service, std::move(handler) });
+					return;
+				}
+
+				++m_misses;
+				m_inFlight[key].push_back(Waiter{ &service, std::move(handler) });
+				StartLookup(key, host, serviceName);
+			}
+
+			const HostResolver::Statistics HostResolver::GetStatistics()
+			{
+				Statistics stats;
+
+				stats.hits = m_hits;
+				stats.negativeHits = m_negativeHits;
+				stats.misses = m_misses;
+				stats.coalesced = m_coalesced;
+				stats.prefetches = m_prefetches;
+				stats.evictions = m_evictions;
+
+				std::lock_guard<std::mutex> lock(m_lock);
+
+				stats.entries = m_cache.size();
+
+				return stats;
+			}
+
+			void HostResolver::Clear()
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+
+				m_cache.clear();
+				m_recency.clear();
+			}
+
+			std::string HostResolver::MakeKey(const std::string& host, const std::string& serviceName)
+			{
+				std::string key;
+				key.reserve(host.size() + serviceName.size() + 1);
+
+				key.append(host).append(u8"/").append(serviceName);
+
+				return key;
+			}
+
+			void HostResolver::StartLookup(const std::string& key, const std::string& host, const std::string& serviceName)
+			{
+				m_lookupService.post(std::bind(&HostResolver::Lookup, this, key, host, serviceName));
+			}
+
+			void HostResolver::Lookup(const std::string& key, const std::string& host, const std::string& serviceName)
+			{
+				boost::system::error_code error;
+				boost::asio::ip::tcp::resolver::iterator endpoints;
+
+				try
+				{
+					// A resolver per lookup, since a synchronous resolve on a shared one would
+					// serialize us right back where we started.
+					boost::asio::ip::tcp::resolver resolver(m_lookupService);
+					boost::asio::ip::tcp::resolver::query query(host, serviceName);
+
+					endpoints = resolver.resolve(query, error);
+				}
+				catch (...)
+				{
+					error = boost::asio::error::host_not_found;
+				}
+
+				if (!error && endpoints == boost::asio::ip::tcp::resolver::iterator())
+				{
+					error = boost::asio::error::host_not_found;
+				}
+
+				std::vector<Waiter> waiters;
+
+				{
+					std::lock_guard<std::mutex> lock(m_lock);
+
+					auto inFlight = m_inFlight.find(key);
+
+					if (inFlight != m_inFlight.end())
+					{
+						waiters = std::move(inFlight->second);
+						m_inFlight.erase(inFlight);
+					}
+
+					// A failed prefetch shouldn't replace a result that is still good.
+					const bool wasPrefetch = waiters.size() == 0;
+
+					if (!error || !wasPrefetch)
+					{
+						Store(key, error, endpoints);
+					}
+				}
+
+				for (auto& waiter : waiters)
+				{
+					waiter.service->post(std::bind(waiter.handler, error, endpoints));
+				}
+			}
+
+			void HostResolver::Store(const std::string& key, const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator endpoints)
+			{
+				const auto ttl = error ? m_negativeTtl : m_positiveTtl;
+
+				auto cached = m_cache.find(key);
+
+				if (ttl <= std::chrono::steady_clock::duration::zero())
+				{
+					if (cached != m_cache.end())
+					{
+						m_recency.erase(cached->second.recency);
+						m_cache.erase(cached);
+					}
+
+					return;
+				}
+
+				const auto expires = std::chrono::steady_clock::now() + ttl;
+
+				if (cached != m_cache.end())
+				{
+					cached->second.error = error;
+					cached->second.endpoints = endpoints;
+					cached->second.expires = expires;
+
+					m_recency.splice(m_recency.begin(), m_recency, cached->second.recency);
+					return;
+				}
+
+				while (m_cache.size() >= m_maxEntries && m_recency.size() > 0)
+				{
+					m_cache.erase(m_recency.back());
+					m_recency.pop_back();
+					++m_evictions;
+				}
+
+				m_recency.push_front(key);
+
+				CacheEntry entry;
+				entry.error = error;
+				entry.endpoints = endpoints;
+				entry.expires = expires;
+				entry.recency = m_recency.begin();
+
+				m_cache.emplace(key, std::move(entry));
+			}
+
+		} /* namespace network */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,358 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace network
+		{
+
+			/// <summary>
+			/// Process-wide asynchronous host name resolver, with a bounded cache in front of it.
+			///
+			/// The resolver that comes with every boost::asio::ip::tcp::resolver runs all lookups
+			/// on a single hidden background thread per io_service, which means that every new
+			/// bridge in the proxy waits in line behind every other bridge's lookup. This class
+			/// instead runs lookups on a small pool of its own threads, and keeps the results for
+			/// a while, so most bridges never have to wait on a lookup at all.
+			///
+			/// Failed lookups are cached too, for a much shorter time, so a client hammering a
+			/// name that doesn't exist doesn't cost a lookup every time. Concurrent requests for
+			/// a name that is already being looked up simply wait on that one lookup rather than
+			/// starting their own. When a cached result that is close to expiring is handed out,
+			/// a fresh lookup is started in the background, so that busy names never actually
+			/// expire.
+			///
+			/// The system resolver doesn't give us the TTLs of the records it returns, so cached
+			/// results are kept for a fixed, configurable time instead. The default is short
+			/// enough to follow any sane DNS change promptly.
+			/// </summary>
+			class HostResolver
+			{
+
+			public:
+
+				/// <summary>
+				/// Handler invoked with the outcome of a lookup. Has the same signature as the
+				/// handler given to boost::asio::ip::tcp::resolver::async_resolve(...).
+				/// </summary>
+				using ResolveHandler = std::function<void(const boost::system::error_code&, boost::asio::ip::tcp::resolver::iterator)>;
+
+				/// <summary>
+				/// Snapshot of the cache counters, as given by ::GetStatistics().
+				/// </summary>
+				struct Statistics
+				{
+					/// <summary>
+					/// Lookups answered from a cached, successful result.
+					/// </summary>
+					uint64_t hits = 0;
+
+					/// <summary>
+					/// Lookups answered from a cached failure.
+					/// </summary>
+					uint64_t negativeHits = 0;
+
+					/// <summary>
+					/// Lookups that had to go to the system resolver.
+					/// </summary>
+					uint64_t misses = 0;
+
+					/// <summary>
+					/// Lookups that joined a lookup for the same name already in flight.
+					/// </summary>
+					uint64_t coalesced = 0;
+
+					/// <summary>
+					/// Background lookups started to refresh a result about to expire.
+					/// </summary>
+					uint64_t prefetches = 0;
+
+					/// <summary>
+					/// Results dropped from the cache to make room for new ones.
+					/// </summary>
+					uint64_t evictions = 0;
+
+					/// <summary>
+					/// Number of results presently held in the cache.
+					/// </summary>
+					size_t entries = 0;
+				};
+
+				/// <summary>
+				/// Default number of threads performing lookups.
+				/// </summary>
+				static constexpr uint32_t DefaultNumThreads = 4;
+
+				/// <summary>
+				/// Default maximum number of results held in the cache.
+				/// </summary>
+				static constexpr size_t DefaultMaxEntries = 4096;
+
+				/// <summary>
+				/// Default number of seconds a successful result is cached.
+				/// </summary>
+				static constexpr int64_t DefaultPositiveTtlSeconds = 60;
+
+				/// <summary>
+				/// Default number of seconds a failed result is cached.
+				/// </summary>
+				static constexpr int64_t DefaultNegativeTtlSeconds = 5;
+
+				/// <summary>
+				/// Default number of seconds before a successful result expires within which
+				/// handing it out starts a background refresh.
+				/// </summary>
+				static constexpr int64_t DefaultPrefetchSeconds = 10;
+
+				/// <summary>
+				/// Constructs a new resolver and starts its lookup threads.
+				/// </summary>
+				/// <param name="numThreads">
+				/// The number of threads performing lookups. Must be at least one.
+				/// </param>
+				/// <param name="maxEntries">
+				/// The maximum number of results held in the cache. When full, the least
+				/// recently used result is dropped.
+				/// </param>
+				/// <param name="positiveTtlSeconds">
+				/// The number of seconds a successful result is cached.
+				/// </param>
+				/// <param name="negativeTtlSeconds">
+				/// The number of seconds a failed result is cached. Zero disables negative
+				/// caching.
+				/// </param>
+				HostResolver(
+					const uint32_t numThreads = DefaultNumThreads,
+					const size_t maxEntries = DefaultMaxEntries,
+					const int64_t positiveTtlSeconds = DefaultPositiveTtlSeconds,
+					const int64_t negativeTtlSeconds = DefaultNegativeTtlSeconds
+					);
+
+				/// <summary>
+				/// No copy no move no thx.
+				/// </summary>
+				HostResolver(const HostResolver&) = delete;
+				HostResolver(HostResolver&&) = delete;
+				HostResolver& operator=(const HostResolver&) = delete;
+
+				/// <summary>
+				/// Stops the lookup threads. Handlers still waiting on a lookup are dropped
+				/// without being invoked.
+				/// </summary>
+				~HostResolver();
+
+				/// <summary>
+				/// Resolves the supplied host and service. The handler is always invoked through
+				/// the supplied io_service, never from within this call, even when the result is
+				/// already cached.
+				/// </summary>
+				/// <param name="service">
+				/// The io_service through which the handler is to be invoked.
+				/// </param>
+				/// <param name="host">
+				/// The host name to resolve.
+				/// </param>
+				/// <param name="serviceName">
+				/// The service name, such as "http" or "https", or port number, with which the
+				/// resolved endpoints are configured.
+				/// </param>
+				/// <param name="handler">
+				/// The handler to invoke with the outcome of the lookup.
+				/// </param>
+				void AsyncResolve(boost::asio::io_service& service, const std::string& host, const std::string& serviceName, ResolveHandler handler);
+
+				/// <summary>
+				/// Gets a snapshot of the cache counters.
+				/// </summary>
+				/// <returns>
+				/// The cache counters.
+				/// </returns>
+				const Statistics GetStatistics();
+
+				/// <summary>
+				/// Drops every cached result. Lookups in flight are unaffected.
+				/// </summary>
+				void Clear();
+
+			private:
+
+				/// <summary>
+				/// A handler waiting on a lookup, along with the io_service it must be invoked
+				/// through.
+				/// </summary>
+				struct Waiter
+				{
+					boost::asio::io_service* service;
+
+					ResolveHandler handler;
+				};
+
+				/// <summary>
+				/// A cached lookup result.
+				/// </summary>
+				struct CacheEntry
+				{
+					/// <summary>
+					/// The error the lookup failed with, if it failed.
+					/// </summary>
+					boost::system::error_code error;
+
+					/// <summary>
+					/// The resolved endpoints, if the lookup succeeded. Copies of the iterator all
+					/// share the same underlying, immutable list of endpoints.
+					/// </summary>
+					boost::asio::ip::tcp::resolver::iterator endpoints;
+
+					/// <summary>
+					/// When the result expires.
+					/// </summary>
+					std::chrono::steady_clock::time_point expires;
+
+					/// <summary>
+					/// Position of the key in the recency list.
+					/// </summary>
+					std::list<std::string>::iterator recency;
+				};
+
+				/// <summary>
+				/// Builds the key that results and lookups are stored under.
+				/// </summary>
+				static std::string MakeKey(const std::string& host, const std::string& serviceName);
+
+				/// <summary>
+				/// Starts a lookup on one of the lookup threads. Must be called with m_lock held,
+				/// and only when no lookup for the key is already in flight.
+				/// </summary>
+				void StartLookup(const std::string& key, const std::string& host, const std::string& serviceName);
+
+				/// <summary>
+				/// Runs on a lookup thread. Performs the lookup, caches the result, and hands it
+				/// to everyone waiting on it.
+				/// </summary>
+				void Lookup(const std::string& key, const std::string& host, const std::string& serviceName);
+
+				/// <summary>
+				/// Stores a result in the cache, making room if need be. Must be called with
+				/// m_lock held.
+				/// </summary>
+				void Store(const std::string& key, const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator endpoints);
+
+				/// <summary>
+				/// Private io_service that the lookup threads run.
+				/// </summary>
+				boost::asio::io_service m_lookupService;
+
+				/// <summary>
+				/// Keeps the lookup threads running while there's nothing to look up.
+				/// </summary>
+				std::unique_ptr<boost::asio::io_service::work> m_lookupWork;
+
+				/// <summary>
+				/// The lookup threads.
+				/// </summary>
+				std::vector<std::thread> m_lookupThreads;
+
+				/// <summary>
+				/// Guards the cache and the lookups in flight.
+				/// </summary>
+				std::mutex m_lock;
+
+				/// <summary>
+				/// Cached results, by key.
+				/// </summary>
+				std::unordered_map<std::string, CacheEntry> m_cache;
+
+				/// <summary>
+				/// Cached keys, most recently used first.
+				/// </summary>
+				std::list<std::string> m_recency;
+
+				/// <summary>
+				/// Handlers waiting on each lookup in flight, by key. A lookup started as a
+				/// prefetch is in here with no waiters.
+				/// </summary>
+				std::unordered_map<std::string, std::vector<Waiter>> m_inFlight;
+
+				/// <summary>
+				/// See the constructor.
+				/// </summary>
+				const size_t m_maxEntries;
+
+				/// <summary>
+				/// See the constructor.
+				/// </summary>
+				const std::chrono::steady_clock::duration m_positiveTtl;
+
+				/// <summary>
+				/// See the constructor.
+				/// </summary>
+				const std::chrono::steady_clock::duration m_negativeTtl;
+
+				/// <summary>
+				/// See DefaultPrefetchSeconds. Never more than half the positive TTL, so that
+				/// not every hit on a short lived result starts a refresh.
+				/// </summary>
+				const std::chrono::steady_clock::duration m_prefetchWindow;
+
+				std::atomic<uint64_t> m_hits{ 0 };
+
+				std::atomic<uint64_t> m_negativeHits{ 0 };
+
+				std::atomic<uint64_t> m_misses{ 0 };
+
+				std::atomic<uint64_t> m_coalesced{ 0 };
+
+				std::atomic<uint64_t> m_prefetches{ 0 };
+
+				std::atomic<uint64_t> m_evictions{ 0 };
+
+			};
+
+		} /* namespace network */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
@@ -0,0 +1,234 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StaggeredConnector.hpp"
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace network
+		{
+
+			StaggeredConnector::StaggeredConnector(boost::asio::io_service& service, const int attemptDelayMilliseconds)
+				:
+				m_service(service),
+				m_strand(service),
+				m_attemptTimer(service),
+				m_attemptDelayMilliseconds(attemptDelayMilliseconds)
+			{
+
+			}
+
+			void StaggeredConnector::AsyncConnect(boost::asio::ip::tcp::resolver::iterator endpoints, const uint16_t port, ConnectHandler handler)
+			{
+				m_handler = std::move(handler);
+
+				// Split the endpoints by family, keeping the order the resolver gave us within
+				// each, then interleave them, starting with whichever family came first.
+				std::vector<boost::asio::ip::tcp::endpoint> preferred;
+				std::vector<boost::asio::ip::tcp::endpoint> other;
+
+				const boost::asio::ip::tcp::resolver::iterator end;
+
+				for (auto it = endpoints; it != end; ++it)
+				{
+					boost::asio::ip::tcp::endpoint ep = *it;
+
+					if (port != 0)
+					{
+						ep.port(port);
+					}
+
+					if (preferred.size() == 0 || ep.address().is_v6() == preferred.front().address().is_v6())
+					{
+						preferred.push_back(ep);
+					}
+					else
+					{
+						other.push_back(ep);
+					}
+				}
+
+				m_endpoints.reserve(preferred.size() + other.size());
+
+				for (size_t i = 0; i < preferred.size() || i < other.size(); ++i)
+				{
+					if (i < preferred.size())
+					{
+						m_endpoints.push_back(preferred[i]);
+					}
+
+					if (i < other.size())
+					{
+						m_endpoints.push_back(other[i]);
+					}
+				}
+
+				m_strand.post(std::bind(&StaggeredConnector::StartNextAttempt, shared_from_this()));
+			}
+
+			void StaggeredConnector::Cancel()
+			{
+				m_strand.post(
+					std::bind(
+						&StaggeredConnector::Finish,
+						shared_from_this(),
+						boost::system::error_code(boost::asio::error::operation_aborted),
+						nullptr
+						)
+					);
+			}
+
+			void StaggeredConnector::StartNextAttempt()
+			{
+				if (m_finished)
+				{
+					return;
+				}
+
+				if (m_attempts.size() >= m_endpoints.size())
+				{
+					// Nothing left to try. If nothing is underway either, we've lost.
+					if (m_pending == 0)
+					{
+						Finish(m_lastError ? m_lastError : boost::system::error_code(boost::asio::error::host_not_found), nullptr);
+					}
+
+					return;
+				}
+
+				const size_t attempt = m_attempts.size();
+
+				auto socket = std::make_shared<boost::asio::ip::tcp::socket>(m_service);
+
+				m_attempts.push_back(socket);
+				++m_pending;
+
+				socket->async_connect(
+					m_endpoints[attempt],
+					m_strand.wrap(
+						std::bind(
+							&StaggeredConnector::OnAttemptConnect,
+							shared_from_this(),
+							std::placeholders::_1,
+							attempt
+							)
+						)
+					);
+
+				// Setting the expiry cancels any wait already pending, so there's only ever the
+				// one delay running, timed from the most recent attempt.
+				if (m_attempts.size() < m_endpoints.size())
+				{
+					m_attemptTimer.expires_from_now(boost::posix_time::milliseconds(m_attemptDelayMilliseconds));
+					m_attemptTimer.async_wait(
+						m_strand.wrap(
+							std::bind(
+								&StaggeredConnector::OnAttemptDelay,
+								shared_from_this(),
+								std::placeholders::_1
+								)
+							)
+						);
+				}
+			}
+
+			void StaggeredConnector::OnAttemptConnect(const boost::system::error_code& error, const size_t attempt)
+			{
+				--m_pending;
+
+				if (m_finished)
+				{
+					return;
+				}
+
+				if (!error)
+				{
+					Finish(error, m_attempts[attempt]);
+					return;
+				}
+
+				m_lastError = error;
+
+				boost::system::error_code closeErr;
+				m_attempts[attempt]->close(closeErr);
+				m_attempts[attempt] = nullptr;
+
+				// No point waiting out the delay when we already know this one is dead.
+				StartNextAttempt();
+			}
+
+			void StaggeredConnector::OnAttemptDelay(const boost::system::error_code& error)
+			{
+				if (error == boost::asio::error::operation_aborted || m_finished)
+				{
+					return;
+				}
+
+				StartNextAttempt();
+			}
+
+			void StaggeredConnector::Finish(const boost::system::error_code& error, std::shared_ptr<boost::asio::ip::tcp::socket> winner)
+			{
+				if (m_finished)
+				{
+					return;
+				}
+
+				m_finished = true;
+
+				boost::system::error_code timerErr;
+				m_attemptTimer.cancel(timerErr);
+
+				for (auto& socket : m_attempts)
+				{
+					if (socket != nullptr && socket != winner)
+					{
+						boost::system::error_code closeErr;
+						socket->close(closeErr);
+					}
+				}
+
+				m_attempts.clear();
+
+				auto handler = std::move(m_handler);
+				m_handler = nullptr;
+
+				if (handler)
+				{
+					m_service.post(std::bind(handler, error, winner));
+				}
+			}
+
+		} /* namespace network */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
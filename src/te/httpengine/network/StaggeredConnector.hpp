@@ -0,0 +1,208 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace network
+		{
+
+			/// <summary>
+			/// Connects to the first reachable endpoint of a resolved host, trying endpoints in
+			/// parallel, staggered, in the manner of RFC 8305 "Happy Eyeballs".
+			///
+			/// Endpoints are reordered so that address families alternate, starting with the
+			/// family of the first endpoint resolved. The first attempt is started immediately.
+			/// Every time an attempt fails, or the attempt delay passes without any attempt
+			/// succeeding, the next attempt is started, while those already started carry on.
+			/// The first attempt to succeed wins, and every other attempt is cancelled. So a
+			/// dead IPv6 address, or an endpoint that silently drops our SYN, costs at most the
+			/// attempt delay rather than an entire connect timeout.
+			///
+			/// Instances must be created through std::make_shared, as they keep themselves
+			/// alive through their own handlers. Each instance is good for a single connect.
+			/// </summary>
+			class StaggeredConnector : public std::enable_shared_from_this<StaggeredConnector>
+			{
+
+			public:
+
+				/// <summary>
+				/// Handler invoked once with the outcome. On success, the error is clear and the
+				/// socket is connected. On failure, the error is that of the last attempt to fail,
+				/// and the socket is nullptr.
+				/// </summary>
+				using ConnectHandler = std::function<void(const boost::system::error_code&, std::shared_ptr<boost::asio::ip::tcp::socket>)>;
+
+				/// <summary>
+				/// Default number of milliseconds to wait on an attempt before starting the
+				/// next one alongside it. This is the value recommended in RFC 8305.
+				/// </summary>
+				static constexpr int DefaultAttemptDelayMilliseconds = 250;
+
+				/// <summary>
+				/// Constructs a new connector.
+				/// </summary>
+				/// <param name="service">
+				/// The io_service that will drive the connection attempts.
+				/// </param>
+				/// <param name="attemptDelayMilliseconds">
+				/// The number of milliseconds to wait on an attempt before starting the next one
+				/// alongside it.
+				/// </param>
+				StaggeredConnector(boost::asio::io_service& service, const int attemptDelayMilliseconds = DefaultAttemptDelayMilliseconds);
+
+				/// <summary>
+				/// No copy no move no thx.
+				/// </summary>
+				StaggeredConnector(const StaggeredConnector&) = delete;
+				StaggeredConnector(StaggeredConnector&&) = delete;
+				StaggeredConnector& operator=(const StaggeredConnector&) = delete;
+
+				/// <summary>
+				/// Default destructor.
+				/// </summary>
+				~StaggeredConnector()
+				{
+
+				}
+
+				/// <summary>
+				/// Begins connecting to the supplied endpoints.
+				/// </summary>
+				/// <param name="endpoints">
+				/// The resolved endpoints to connect to.
+				/// </param>
+				/// <param name="port">
+				/// The port to connect to on every endpoint. Zero keeps whatever port each
+				/// endpoint was resolved with.
+				/// </param>
+				/// <param name="handler">
+				/// The handler to invoke with the outcome. Invoked through the io_service, never
+				/// from within this call.
+				/// </param>
+				void AsyncConnect(boost::asio::ip::tcp::resolver::iterator endpoints, const uint16_t port, ConnectHandler handler);
+
+				/// <summary>
+				/// Abandons the connect. Every attempt is cancelled and the handler is invoked
+				/// with boost::asio::error::operation_aborted, unless it has been already. Safe
+				/// to call from any thread.
+				/// </summary>
+				void Cancel();
+
+			private:
+
+				/// <summary>
+				/// Starts the next attempt, if there is one left, and rearms the attempt delay.
+				/// </summary>
+				void StartNextAttempt();
+
+				/// <summary>
+				/// Completion handler for a single attempt.
+				/// </summary>
+				void OnAttemptConnect(const boost::system::error_code& error, const size_t attempt);
+
+				/// <summary>
+				/// Completion handler for the attempt delay.
+				/// </summary>
+				void OnAttemptDelay(const boost::system::error_code& error);
+
+				/// <summary>
+				/// Cancels every attempt still underway, other than the supplied winner, and
+				/// invokes the handler.
+				/// </summary>
+				void Finish(const boost::system::error_code& error, std::shared_ptr<boost::asio::ip::tcp::socket> winner);
+
+				/// <summary>
+				/// The io_service driving the attempts.
+				/// </summary>
+				boost::asio::io_service& m_service;
+
+				/// <summary>
+				/// Serializes every handler of ours.
+				/// </summary>
+				boost::asio::strand m_strand;
+
+				/// <summary>
+				/// Times the delay between attempts.
+				/// </summary>
+				boost::asio::deadline_timer m_attemptTimer;
+
+				/// <summary>
+				/// See the constructor.
+				/// </summary>
+				const int m_attemptDelayMilliseconds;
+
+				/// <summary>
+				/// The endpoints, in the order they are to be attempted.
+				/// </summary>
+				std::vector<boost::asio::ip::tcp::endpoint> m_endpoints;
+
+				/// <summary>
+				/// The socket of every attempt started, by attempt. Set to nullptr once an
+				/// attempt has failed.
+				/// </summary>
+				std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> m_attempts;
+
+				/// <summary>
+				/// The number of attempts started that have not yet completed.
+				/// </summary>
+				size_t m_pending = 0;
+
+				/// <summary>
+				/// The error of the most recent attempt to fail.
+				/// </summary>
+				boost::system::error_code m_lastError;
+
+				/// <summary>
+				/// Whether or not the handler has been invoked.
+				/// </summary>
+				bool m_finished = false;
+
+				/// <summary>
+				/// See ::AsyncConnect(...).
+				/// </summary>
+				ConnectHandler m_handler;
+
+			};
+
+		} /* namespace network */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
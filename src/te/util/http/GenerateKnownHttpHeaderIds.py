@@ -0,0 +1,375 @@
+#
+# Copyright (c) 2016 Jesse Nicholson.
+#
+# This file is part of Http Filtering Engine.
+#
+# Http Filtering Engine is free software: you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or (at
+# your option) any later version.
+#
+# In addition, as a special exception, the copyright holders give
+# permission to link the code of portions of this program with the OpenSSL
+# library.
+#
+# You must obey the GNU General Public License in all respects for all of
+# the code used other than OpenSSL. If you modify file(s) with this
+# exception, you may extend this exception to your version of the file(s),
+# but you are not obligated to do so. If you do not wish to do so, delete
+# this exception statement from your version. If you delete this exception
+# statement from all source files in the program, then also delete it
+# here.
+#
+# Http Filtering Engine is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+# Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+#
+
+#
+# Generates KnownHttpHeaderIds.hpp from the header constants declared in
+# KnownHttpHeaders.hpp. Run this from any directory whenever a header is added
+# to or removed from KnownHttpHeaders.hpp. The generated tables are verified by a
+# static_assert, so a hand edit that breaks them won't compile.
+#
+# Every known header name gets a small integer id. Names are mapped to ids with
+# a two level perfect hash. The case insensitive FNV-1a hash of the name, which
+# HttpHeaderCollection computes for every parsed header anyway, selects a
+# displacement. The hash mixed with that displacement selects a slot, and every
+# known name is guaranteed to land in a slot of its own. Resolving a parsed name
+# to its id therefore costs a single name comparison.
+#
+
+import os
+import re
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SOURCE = os.path.join(HERE, 'KnownHttpHeaders.hpp')
+OUTPUT = os.path.join(HERE, 'KnownHttpHeaderIds.hpp')
+
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+MIX_MULTIPLIER = 0x9E3779B1
+DISPLACEMENT_BITS = 7
+SLOT_BITS = 9
+
+MASK32 = 0xFFFFFFFF
+
+
+def fold_case(c):
+	return c + 32 if ord('A') <= c <= ord('Z') else c
+
+
+def hash_name(name):
+	h = FNV_OFFSET_BASIS
+	for c in name.encode('ascii'):
+		h = ((h ^ fold_case(c)) * FNV_PRIME) & MASK32
+	return h
+
+
+def slot_of(h, displacement):
+	return (((h ^ displacement) * MIX_MULTIPLIER) & MASK32) >> (32 - SLOT_BITS)
+
+
+def build_tables(headers):
+	buckets = [[] for _ in range(1 << DISPLACEMENT_BITS)]
+
+	for header_id, (_, name) in enumerate(headers, start=1):
+		h = hash_name(name)
+		buckets[h & ((1 << DISPLACEMENT_BITS) - 1)].append((header_id, h))
+
+	displacements = [0] * (1 << DISPLACEMENT_BITS)
+	slots = [0] * (1 << SLOT_BITS)
+
+	# Place the most crowded buckets first, while there's still plenty of room.
+	for bucket_index in sorted(range(len(buckets)), key=lambda b: -len(buckets[b])):
+		bucket = buckets[bucket_index]
+
+		if not bucket:
+			continue
+
+		for displacement in range(1 << 24):
+			chosen = [slot_of(h, displacement) for _, h in bucket]
+
+			if len(set(chosen)) == len(chosen) and all(slots[s] == 0 for s in chosen):
+				break
+		else:
+			raise RuntimeError('Failed to find a displacement for bucket %d.' % bucket_index)
+
+		displacements[bucket_index] = displacement
+
+		for (header_id, _), s in zip(bucket, chosen):
+			slots[s] = header_id
+
+	return displacements, slots
+
+
+def format_array(values, per_line, indent):
+	lines = []
+
+	for i in range(0, len(values), per_line):
+		lines.append(indent + ', '.join(str(v) for v in values[i:i + per_line]))
+
+	return ',\n'.join(lines)
+
+
+def main():
+	with open(SOURCE) as f:
+		source = f.read()
+
+	license_header = source[:source.index('*/') + 2]
+
+	headers = re.findall(r'const std::string (\w+)\{ u8"([^"]*)" \};', source)
+
+	displacements, slots = build_tables(headers)
+
+	tab = '\t'
+	body = tab * 4
+
+	enumerators = ',\n'.join(body + tab + identifier for identifier, _ in headers)
+
+	names = ',\n'.join(
+		body + tab + tab + '{ u8"%s", %d }' % (name, len(name)) for _, name in headers)
+
+	with open(OUTPUT, 'w', newline='\n') as f:
+		f.write(TEMPLATE.format(
+			license=license_header,
+			enumerators=enumerators,
+			count=len(headers) + 1,
+			names=names,
+			displacement_bits=DISPLACEMENT_BITS,
+			slot_bits=SLOT_BITS,
+			fnv_offset_basis=FNV_OFFSET_BASIS,
+			fnv_prime=FNV_PRIME,
+			mix_multiplier=MIX_MULTIPLIER,
+			displacements=format_array(displacements, 8, body + tab + tab),
+			slots=format_array(slots, 16, body + tab + tab)).rstrip('\n'))
+
+
+TEMPLATE = '''{license}
+
+/*
+* This file is generated by GenerateKnownHttpHeaderIds.py from the header
+* constants in KnownHttpHeaders.hpp. Do not edit it by hand.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <boost/utility/string_ref.hpp>
+
+namespace te
+{{
+	namespace httpengine
+	{{
+		namespace util
+		{{
+			namespace http
+			{{
+
+				/// <summary>
+				/// Small integer identifiers for every header declared in
+				/// KnownHttpHeaders.hpp, in the same order. Headers that aren't known are
+				/// identified as Unknown.
+				/// </summary>
+				enum class HeaderId : uint16_t
+				{{
+					Unknown = 0,
+{enumerators}
+				}};
+
+				/// <summary>
+				/// The total number of header ids, including Unknown. Suitable for sizing
+				/// arrays indexed by HeaderId.
+				/// </summary>
+				constexpr size_t HeaderIdCount = {count};
+
+				namespace detail
+				{{
+
+					/// <summary>
+					/// The name of a known header, as it should be written on the wire.
+					/// </summary>
+					struct KnownHeaderName
+					{{
+						const char* name;
+						size_t length;
+					}};
+
+					/// <summary>
+					/// Known header names, indexed by HeaderId.
+					/// </summary>
+					constexpr KnownHeaderName KnownHeaderNames[HeaderIdCount] =
+					{{
+						{{ u8"", 0 }},
+{names}
+					}};
+
+					constexpr uint32_t HeaderNameHashOffsetBasis = {fnv_offset_basis}u;
+
+					constexpr uint32_t HeaderNameHashPrime = {fnv_prime}u;
+
+					constexpr uint32_t HeaderIdMixMultiplier = {mix_multiplier}u;
+
+					constexpr uint32_t HeaderIdDisplacementBits = {displacement_bits};
+
+					constexpr uint32_t HeaderIdSlotBits = {slot_bits};
+
+					/// <summary>
+					/// Per bucket displacements, indexed by the low bits of the name hash.
+					/// </summary>
+					constexpr uint32_t HeaderIdDisplacements[1u << HeaderIdDisplacementBits] =
+					{{
+{displacements}
+					}};
+
+					/// <summary>
+					/// The HeaderId stored in each slot, or zero for empty slots.
+					/// </summary>
+					constexpr uint16_t HeaderIdSlots[1u << HeaderIdSlotBits] =
+					{{
+{slots}
+					}};
+
+				}} /* namespace detail */
+
+				/// <summary>
+				/// Header names are plain ASCII tokens, so there's no reason to drag locales
+				/// into case folding.
+				/// </summary>
+				constexpr char FoldHeaderNameCase(const char c)
+				{{
+					return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+				}}
+
+				/// <summary>
+				/// Computes the case insensitive FNV-1a hash of a header name at compile
+				/// time. This is recursive, so only use it on literals. At runtime, use
+				/// ::ContinueHeaderNameHash(...).
+				/// </summary>
+				constexpr uint32_t HashHeaderName(const char* name, const size_t length, const uint32_t hash = detail::HeaderNameHashOffsetBasis)
+				{{
+					return length == 0 ? hash : HashHeaderName(name + 1, length - 1, (hash ^ static_cast<uint8_t>(FoldHeaderNameCase(*name))) * detail::HeaderNameHashPrime);
+				}}
+
+				/// <summary>
+				/// Continues the case insensitive FNV-1a hash of a header name over more
+				/// data. Begin with detail::HeaderNameHashOffsetBasis. Yields exactly the
+				/// same result as ::HashHeaderName(...).
+				/// </summary>
+				inline uint32_t ContinueHeaderNameHash(uint32_t hash, const char* data, const size_t length)
+				{{
+					for (size_t i = 0; i < length; ++i)
+					{{
+						hash ^= static_cast<uint8_t>(FoldHeaderNameCase(data[i]));
+						hash *= detail::HeaderNameHashPrime;
+					}}
+
+					return hash;
+				}}
+
+				/// <summary>
+				/// Gets the only slot that a header name with the supplied hash may occupy.
+				/// </summary>
+				constexpr size_t GetHeaderIdSlot(const uint32_t nameHash)
+				{{
+					return static_cast<size_t>(((nameHash ^ detail::HeaderIdDisplacements[nameHash & ((1u << detail::HeaderIdDisplacementBits) - 1)]) * detail::HeaderIdMixMultiplier) >> (32 - detail::HeaderIdSlotBits));
+				}}
+
+				/// <summary>
+				/// Resolves a header name to its HeaderId.
+				/// </summary>
+				/// <param name="name">
+				/// The header name, in any case.
+				/// </param>
+				/// <param name="nameHash">
+				/// The case insensitive hash of the name, as computed by
+				/// ::ContinueHeaderNameHash(...).
+				/// </param>
+				/// <returns>
+				/// The HeaderId of the name, or HeaderId::Unknown if the name isn't known.
+				/// </returns>
+				inline HeaderId GetHeaderId(const boost::string_ref name, const uint32_t nameHash)
+				{{
+					const auto id = detail::HeaderIdSlots[GetHeaderIdSlot(nameHash)];
+
+					const auto& known = detail::KnownHeaderNames[id];
+
+					if (id == 0 || known.length != name.size())
+					{{
+						return HeaderId::Unknown;
+					}}
+
+					for (size_t i = 0; i < known.length; ++i)
+					{{
+						if (FoldHeaderNameCase(known.name[i]) != FoldHeaderNameCase(name[i]))
+						{{
+							return HeaderId::Unknown;
+						}}
+					}}
+
+					return static_cast<HeaderId>(id);
+				}}
+
+				/// <summary>
+				/// Resolves a header name to its HeaderId.
+				/// </summary>
+				/// <param name="name">
+				/// The header name, in any case.
+				/// </param>
+				/// <returns>
+				/// The HeaderId of the name, or HeaderId::Unknown if the name isn't known.
+				/// </returns>
+				inline HeaderId GetHeaderId(const boost::string_ref name)
+				{{
+					return GetHeaderId(name, ContinueHeaderNameHash(detail::HeaderNameHashOffsetBasis, name.data(), name.size()));
+				}}
+
+				/// <summary>
+				/// Gets the name of a known header, as it should be written on the wire.
+				/// </summary>
+				/// <param name="id">
+				/// The HeaderId.
+				/// </param>
+				/// <returns>
+				/// The name of the header, or an empty string for HeaderId::Unknown.
+				/// </returns>
+				inline boost::string_ref GetHeaderName(const HeaderId id)
+				{{
+					const auto& known = detail::KnownHeaderNames[static_cast<size_t>(id) < HeaderIdCount ? static_cast<size_t>(id) : 0];
+
+					return boost::string_ref(known.name, known.length);
+				}}
+
+				namespace detail
+				{{
+
+					/// <summary>
+					/// Verifies that every known header name in the supplied id range lands in the
+					/// slot holding its own id. Splits the range in half on every step, so that the
+					/// recursion stays shallow enough for any compiler.
+					/// </summary>
+					constexpr bool IsHeaderIdTablePerfect(const size_t first, const size_t last)
+					{{
+						return (last - first) == 1 ?
+							HeaderIdSlots[GetHeaderIdSlot(HashHeaderName(KnownHeaderNames[first].name, KnownHeaderNames[first].length))] == first :
+							IsHeaderIdTablePerfect(first, first + ((last - first) / 2)) && IsHeaderIdTablePerfect(first + ((last - first) / 2), last);
+					}}
+
+				}} /* namespace detail */
+
+				static_assert(detail::IsHeaderIdTablePerfect(1, HeaderIdCount), u8"The HeaderId tables are inconsistent. Regenerate KnownHttpHeaderIds.hpp with GenerateKnownHttpHeaderIds.py.");
+
+			}} /* namespace http */
+		}} /* namespace util */
+	}} /* namespace httpengine */
+}} /* namespace te */
+'''
+
+
+if __name__ == '__main__':
+	main()
\ No newline at end of file
@@ -0,0 +1,708 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+* This file is generated by GenerateKnownHttpHeaderIds.py from the header
+* constants in KnownHttpHeaders.hpp. Do not edit it by hand.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <boost/utility/string_ref.hpp>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace util
+		{
+			namespace http
+			{
+
+				/// <summary>
+				/// Small integer identifiers for every header declared in
+				/// KnownHttpHeaders.hpp, in the same order. Headers that aren't known are
+				/// identified as Unknown.
+				/// </summary>
+				enum class HeaderId : uint16_t
+				{
+					Unknown = 0,
+					AIM,
+					Accept,
+					AcceptAdditions,
+					AcceptCharset,
+					AcceptDatetime,
+					AcceptEncoding,
+					AcceptFeatures,
+					AcceptLanguage,
+					AcceptPatch,
+					AcceptRanges,
+					AccessControl,
+					AccessControlAllowCredentials,
+					AccessControlAllowHeaders,
+					AccessControlAllowMethods,
+					AccessControlAllowOrigin,
+					AccessControlMaxAge,
+					AccessControlRequestHeaders,
+					AccessControlRequestMethod,
+					Age,
+					Allow,
+					ALPN,
+					Alternates,
+					ApplyToRedirectRef,
+					AuthenticationInfo,
+					Authorization,
+					Base,
+					Body,
+					CExt,
+					CMan,
+					COpt,
+					CPEP,
+					CPEPInfo,
+					CacheControl,
+					CalDAVTimezones,
+					Close,
+					Compliance,
+					Connection,
+					ContentAlternative,
+					ContentBase,
+					ContentDescription,
+					ContentDisposition,
+					ContentDuration,
+					ContentEncoding,
+					Contentfeatures,
+					ContentID,
+					ContentLanguage,
+					ContentLength,
+					ContentLocation,
+					ContentMD5,
+					ContentRange,
+					ContentScriptType,
+					ContentStyleType,
+					ContentTransferEncoding,
+					ContentType,
+					ContentVersion,
+					Cookie,
+					Cookie2,
+					Cost,
+					DASL,
+					Date,
+					DAV,
+					DefaultStyle,
+					DeltaBase,
+					Depth,
+					DerivedFrom,
+					Destination,
+					DifferentialID,
+					Digest,
+					EDIINTFeatures,
+					ETag,
+					Expect,
+					Expires,
+					Ext,
+					Forwarded,
+					From,
+					GetProfile,
+					Hobareg,
+					Host,
+					HTTP2Settings,
+					If,
+					IfMatch,
+					IfModifiedSince,
+					IfNoneMatch,
+					IfRange,
+					IfScheduleTagMatch,
+					IfUnmodifiedSince,
+					IM,
+					KeepAlive,
+					Label,
+					LastModified,
+					Link,
+					Location,
+					LockToken,
+					Man,
+					MaxForwards,
+					MementoDatetime,
+					MessageID,
+					Meter,
+					MethodCheck,
+					MethodCheckExpires,
+					MIMEVersion,
+					Negotiate,
+					NonCompliance,
+					Opt,
+					Optional,
+					OrderingType,
+					Origin,
+					Overwrite,
+					P3P,
+					PEP,
+					PepInfo,
+					PICSLabel,
+					Position,
+					Pragma,
+					Prefer,
+					PreferenceApplied,
+					ProfileObject,
+					Protocol,
+					ProtocolInfo,
+					ProtocolQuery,
+					ProtocolRequest,
+					ProxyAuthenticate,
+					ProxyAuthenticationInfo,
+					ProxyAuthorization,
+					ProxyFeatures,
+					ProxyInstruction,
+					Public,
+					PublicKeyPins,
+					PublicKeyPinsReportOnly,
+					Range,
+					RedirectRef,
+					Referer,
+					RefererRoot,
+					ResolutionHint,
+					ResolverLocation,
+					RetryAfter,
+					Safe,
+					ScheduleReply,
+					ScheduleTag,
+					SecWebSocketAccept,
+					SecWebSocketExtensions,
+					SecWebSocketKey,
+					SecWebSocketProtocol,
+					SecWebSocketVersion,
+					SecurityScheme,
+					Server,
+					SetCookie,
+					SetCookie2,
+					SetProfile,
+					SLUG,
+					SoapAction,
+					StatusURI,
+					StrictTransportSecurity,
+					SubOK,
+					Subst,
+					SurrogateCapability,
+					SurrogateControl,
+					TCN,
+					TE,
+					Timeout,
+					Title,
+					Trailer,
+					TransferEncoding,
+					UAColor,
+					UAMedia,
+					UAPixels,
+					UAResolution,
+					UAWindowpixels,
+					Upgrade,
+					URI,
+					UserAgent,
+					VariantVary,
+					Vary,
+					Version,
+					Via,
+					WantDigest,
+					Warning,
+					WWWAuthenticate,
+					XDeviceAccept,
+					XDeviceAcceptCharset,
+					XDeviceAcceptEncoding,
+					XDeviceAcceptLanguage,
+					XDeviceUserAgent,
+					XFrameOptions,
+					XRequestedWith,
+					DNT,
+					XForwardedFor,
+					XForwardedHost,
+					XForwardedProto,
+					FrontEndHttps,
+					XHttpMethodOverride,
+					XATTDeviceId,
+					XWapProfile,
+					ProxyConnection,
+					XUIDH,
+					XCsrfToken,
+					XXSSProtection,
+					ContentSecurityPolicy,
+					XContentSecurityPolicy,
+					XWebKitCSP,
+					XContentTypeOptions,
+					XPoweredBy,
+					XUACompatible,
+					XContentDuration,
+					GetDictionary,
+					XSDHC,
+					AvailDictionary,
+					AlternateProtocol
+				};
+
+				/// <summary>
+				/// The total number of header ids, including Unknown. Suitable for sizing
+				/// arrays indexed by HeaderId.
+				/// </summary>
+				constexpr size_t HeaderIdCount = 209;
+
+				namespace detail
+				{
+
+					/// <summary>
+					/// The name of a known header, as it should be written on the wire.
+					/// </summary>
+					struct KnownHeaderName
+					{
+						const char* name;
+						size_t length;
+					};
+
+					/// <summary>
+					/// Known header names, indexed by HeaderId.
+					/// </summary>
+					constexpr KnownHeaderName KnownHeaderNames[HeaderIdCount] =
+					{
+						{ u8"", 0 },
+						{ u8"A-IM", 4 },
+						{ u8"Accept", 6 },
+						{ u8"Accept-Additions", 16 },
+						{ u8"Accept-Charset", 14 },
+						{ u8"Accept-Datetime", 15 },
+						{ u8"Accept-Encoding", 15 },
+						{ u8"Accept-Features", 15 },
+						{ u8"Accept-Language", 15 },
+						{ u8"Accept-Patch", 12 },
+						{ u8"Accept-Ranges", 13 },
+						{ u8"Access-Control", 14 },
+						{ u8"Access-Control-Allow-Credentials", 32 },
+						{ u8"Access-Control-Allow-Headers", 28 },
+						{ u8"Access-Control-Allow-Methods", 28 },
+						{ u8"Access-Control-Allow-Origin", 27 },
+						{ u8"Access-Control-Max-Age", 22 },
+						{ u8"Access-Control-Request-Headers", 30 },
+						{ u8"Access-Control-Request-Method", 29 },
+						{ u8"Age", 3 },
+						{ u8"Allow", 5 },
+						{ u8"ALPN", 4 },
+						{ u8"Alternates", 10 },
+						{ u8"Apply-To-Redirect-Ref", 21 },
+						{ u8"Authentication-Info", 19 },
+						{ u8"Authorization", 13 },
+						{ u8"Base", 4 },
+						{ u8"Body", 4 },
+						{ u8"C-Ext", 5 },
+						{ u8"C-Man", 5 },
+						{ u8"C-Opt", 5 },
+						{ u8"C-PEP", 5 },
+						{ u8"C-PEP-Info", 10 },
+						{ u8"Cache-Control", 13 },
+						{ u8"CalDAV-Timezones", 16 },
+						{ u8"Close", 5 },
+						{ u8"Compliance", 10 },
+						{ u8"Connection", 10 },
+						{ u8"Content-Alternative", 19 },
+						{ u8"Content-Base", 12 },
+						{ u8"Content-Description", 19 },
+						{ u8"Content-Disposition", 19 },
+						{ u8"Content-Duration", 16 },
+						{ u8"Content-Encoding", 16 },
+						{ u8"Content-features", 16 },
+						{ u8"Content-ID", 10 },
+						{ u8"Content-Language", 16 },
+						{ u8"Content-Length", 14 },
+						{ u8"Content-Location", 16 },
+						{ u8"Content-MD5", 11 },
+						{ u8"Content-Range", 13 },
+						{ u8"Content-Script-Type", 19 },
+						{ u8"Content-Style-Type", 18 },
+						{ u8"Content-Transfer-Encoding", 25 },
+						{ u8"Content-Type", 12 },
+						{ u8"Content-Version", 15 },
+						{ u8"Cookie", 6 },
+						{ u8"Cookie2", 7 },
+						{ u8"Cost", 4 },
+						{ u8"DASL", 4 },
+						{ u8"Date", 4 },
+						{ u8"DAV", 3 },
+						{ u8"Default-Style", 13 },
+						{ u8"Delta-Base", 10 },
+						{ u8"Depth", 5 },
+						{ u8"Derived-From", 12 },
+						{ u8"Destination", 11 },
+						{ u8"Differential-ID", 15 },
+						{ u8"Digest", 6 },
+						{ u8"EDIINT-Features", 15 },
+						{ u8"ETag", 4 },
+						{ u8"Expect", 6 },
+						{ u8"Expires", 7 },
+						{ u8"Ext", 3 },
+						{ u8"Forwarded", 9 },
+						{ u8"From", 4 },
+						{ u8"GetProfile", 10 },
+						{ u8"Hobareg", 7 },
+						{ u8"Host", 4 },
+						{ u8"HTTP2-Settings", 14 },
+						{ u8"If", 2 },
+						{ u8"If-Match", 8 },
+						{ u8"If-Modified-Since", 17 },
+						{ u8"If-None-Match", 13 },
+						{ u8"If-Range", 8 },
+						{ u8"If-Schedule-Tag-Match", 21 },
+						{ u8"If-Unmodified-Since", 19 },
+						{ u8"IM", 2 },
+						{ u8"Keep-Alive", 10 },
+						{ u8"Label", 5 },
+						{ u8"Last-Modified", 13 },
+						{ u8"Link", 4 },
+						{ u8"Location", 8 },
+						{ u8"Lock-Token", 10 },
+						{ u8"Man", 3 },
+						{ u8"Max-Forwards", 12 },
+						{ u8"Memento-Datetime", 16 },
+						{ u8"Message-ID", 10 },
+						{ u8"Meter", 5 },
+						{ u8"Method-Check", 12 },
+						{ u8"Method-Check-Expires", 20 },
+						{ u8"MIME-Version", 12 },
+						{ u8"Negotiate", 9 },
+						{ u8"Non-Compliance", 14 },
+						{ u8"Opt", 3 },
+						{ u8"Optional", 8 },
+						{ u8"Ordering-Type", 13 },
+						{ u8"Origin", 6 },
+						{ u8"Overwrite", 9 },
+						{ u8"P3P", 3 },
+						{ u8"PEP", 3 },
+						{ u8"Pep-Info", 8 },
+						{ u8"PICS-Label", 10 },
+						{ u8"Position", 8 },
+						{ u8"Pragma", 6 },
+						{ u8"Prefer", 6 },
+						{ u8"Preference-Applied", 18 },
+						{ u8"ProfileObject", 13 },
+						{ u8"Protocol", 8 },
+						{ u8"Protocol-Info", 13 },
+						{ u8"Protocol-Query", 14 },
+						{ u8"Protocol-Request", 16 },
+						{ u8"Proxy-Authenticate", 18 },
+						{ u8"Proxy-Authentication-Info", 25 },
+						{ u8"Proxy-Authorization", 19 },
+						{ u8"Proxy-Features", 14 },
+						{ u8"Proxy-Instruction", 17 },
+						{ u8"Public", 6 },
+						{ u8"Public-Key-Pins", 15 },
+						{ u8"Public-Key-Pins-Report-Only", 27 },
+						{ u8"Range", 5 },
+						{ u8"Redirect-Ref", 12 },
+						{ u8"Referer", 7 },
+						{ u8"Referer-Root", 12 },
+						{ u8"Resolution-Hint", 15 },
+						{ u8"Resolver-Location", 17 },
+						{ u8"Retry-After", 11 },
+						{ u8"Safe", 4 },
+						{ u8"Schedule-Reply", 14 },
+						{ u8"Schedule-Tag", 12 },
+						{ u8"Sec-WebSocket-Accept", 20 },
+						{ u8"Sec-WebSocket-Extensions", 24 },
+						{ u8"Sec-WebSocket-Key", 17 },
+						{ u8"Sec-WebSocket-Protocol", 22 },
+						{ u8"Sec-WebSocket-Version", 21 },
+						{ u8"Security-Scheme", 15 },
+						{ u8"Server", 6 },
+						{ u8"Set-Cookie", 10 },
+						{ u8"Set-Cookie2", 11 },
+						{ u8"SetProfile", 10 },
+						{ u8"SLUG", 4 },
+						{ u8"SoapAction", 10 },
+						{ u8"Status-URI", 10 },
+						{ u8"Strict-Transport-Security", 25 },
+						{ u8"SubOK", 5 },
+						{ u8"Subst", 5 },
+						{ u8"Surrogate-Capability", 20 },
+						{ u8"Surrogate-Control", 17 },
+						{ u8"TCN", 3 },
+						{ u8"TE", 2 },
+						{ u8"Timeout", 7 },
+						{ u8"Title", 5 },
+						{ u8"Trailer", 7 },
+						{ u8"Transfer-Encoding", 17 },
+						{ u8"UA-Color", 8 },
+						{ u8"UA-Media", 8 },
+						{ u8"UA-Pixels", 9 },
+						{ u8"UA-Resolution", 13 },
+						{ u8"UA-Windowpixels", 15 },
+						{ u8"Upgrade", 7 },
+						{ u8"URI", 3 },
+						{ u8"User-Agent", 10 },
+						{ u8"Variant-Vary", 12 },
+						{ u8"Vary", 4 },
+						{ u8"Version", 7 },
+						{ u8"Via", 3 },
+						{ u8"Want-Digest", 11 },
+						{ u8"Warning", 7 },
+						{ u8"WWW-Authenticate", 16 },
+						{ u8"X-Device-Accept", 15 },
+						{ u8"X-Device-Accept-Charset", 23 },
+						{ u8"X-Device-Accept-Encoding", 24 },
+						{ u8"X-Device-Accept-Language", 24 },
+						{ u8"X-Device-User-Agent", 19 },
+						{ u8"X-Frame-Options", 15 },
+						{ u8"X-Requested-With", 16 },
+						{ u8"DNT", 3 },
+						{ u8"X-Forwarded-For", 15 },
+						{ u8"X-Forwarded-Host", 16 },
+						{ u8"X-Forwarded-Proto", 17 },
+						{ u8"Front-End-Https", 15 },
+						{ u8"X-Http-Method-Override", 22 },
+						{ u8"X-ATT-DeviceId", 14 },
+						{ u8"X-Wap-Profile", 13 },
+						{ u8"Proxy-Connection", 16 },
+						{ u8"X-UIDH", 6 },
+						{ u8"X-Csrf-Token", 12 },
+						{ u8"X-XSS-Protection", 16 },
+						{ u8"Content-Security-Policy", 23 },
+						{ u8"X-Content-Security-Policy", 25 },
+						{ u8"X-WebKit-CSP", 12 },
+						{ u8"X-Content-Type-Options", 22 },
+						{ u8"X-Powered-By", 12 },
+						{ u8"X-UA-Compatible", 15 },
+						{ u8"X-Content-Duration", 18 },
+						{ u8"Get-Dictionary", 14 },
+						{ u8"X-SDHC", 6 },
+						{ u8"Avail-Dictionary", 16 },
+						{ u8"Alternate-Protocol", 18 }
+					};
+
+					constexpr uint32_t HeaderNameHashOffsetBasis = 2166136261u;
+
+					constexpr uint32_t HeaderNameHashPrime = 16777619u;
+
+					constexpr uint32_t HeaderIdMixMultiplier = 2654435761u;
+
+					constexpr uint32_t HeaderIdDisplacementBits = 7;
+
+					constexpr uint32_t HeaderIdSlotBits = 9;
+
+					/// <summary>
+					/// Per bucket displacements, indexed by the low bits of the name hash.
+					/// </summary>
+					constexpr uint32_t HeaderIdDisplacements[1u << HeaderIdDisplacementBits] =
+					{
+						1, 0, 0, 1, 0, 0, 4, 0,
+						0, 4, 1, 0, 0, 0, 0, 0,
+						0, 1, 0, 0, 0, 0, 0, 2,
+						0, 1, 1, 2, 0, 1, 0, 0,
+						0, 1, 0, 0, 0, 1, 0, 0,
+						0, 0, 1, 4, 0, 1, 0, 0,
+						0, 0, 0, 0, 0, 0, 0, 0,
+						4, 0, 0, 0, 1, 0, 0, 0,
+						0, 0, 0, 0, 0, 2, 0, 0,
+						0, 3, 2, 0, 1, 0, 4, 0,
+						3, 0, 4, 3, 0, 0, 1, 0,
+						0, 1, 0, 0, 0, 0, 1, 0,
+						1, 0, 0, 0, 0, 1, 1, 0,
+						7, 0, 0, 0, 0, 4, 0, 0,
+						0, 0, 2, 0, 0, 0, 0, 1,
+						0, 0, 0, 0, 0, 0, 0, 3
+					};
+
+					/// <summary>
+					/// The HeaderId stored in each slot, or zero for empty slots.
+					/// </summary>
+					constexpr uint16_t HeaderIdSlots[1u << HeaderIdSlotBits] =
+					{
+						30, 0, 67, 109, 0, 36, 0, 0, 0, 0, 101, 169, 55, 44, 0, 0,
+						0, 0, 0, 207, 0, 0, 0, 206, 0, 0, 0, 117, 0, 0, 157, 0,
+						158, 0, 0, 0, 51, 0, 106, 0, 127, 0, 0, 0, 0, 0, 163, 64,
+						78, 29, 0, 0, 80, 108, 0, 0, 0, 0, 137, 0, 0, 0, 0, 0,
+						104, 115, 0, 6, 124, 0, 103, 0, 0, 32, 0, 0, 0, 0, 0, 28,
+						0, 171, 185, 122, 0, 0, 0, 204, 0, 0, 0, 0, 0, 85, 22, 0,
+						5, 0, 0, 190, 0, 0, 196, 25, 0, 0, 0, 0, 89, 151, 8, 128,
+						0, 0, 180, 0, 0, 0, 0, 0, 0, 187, 193, 0, 0, 62, 198, 0,
+						88, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 58, 0, 0, 68, 0,
+						188, 92, 91, 2, 130, 156, 0, 65, 202, 0, 0, 0, 144, 0, 191, 0,
+						66, 0, 0, 0, 26, 0, 0, 0, 11, 142, 57, 0, 135, 119, 143, 0,
+						0, 0, 0, 0, 170, 0, 0, 0, 0, 161, 199, 178, 86, 0, 162, 121,
+						84, 0, 99, 0, 16, 0, 0, 0, 81, 37, 0, 0, 205, 1, 148, 0,
+						0, 154, 0, 0, 126, 0, 0, 0, 0, 0, 0, 21, 175, 149, 0, 0,
+						38, 0, 0, 0, 150, 0, 0, 0, 194, 0, 0, 0, 0, 14, 0, 112,
+						0, 0, 166, 0, 133, 0, 0, 0, 0, 0, 146, 0, 0, 45, 0, 0,
+						0, 0, 118, 12, 0, 0, 0, 75, 0, 31, 0, 0, 173, 82, 181, 0,
+						0, 0, 0, 46, 0, 114, 0, 0, 17, 200, 19, 0, 0, 0, 0, 0,
+						74, 0, 23, 189, 136, 0, 56, 34, 0, 0, 176, 0, 0, 0, 0, 0,
+						0, 0, 129, 182, 107, 0, 0, 69, 131, 201, 0, 76, 0, 33, 0, 140,
+						10, 0, 0, 120, 152, 147, 0, 0, 123, 116, 9, 0, 0, 0, 0, 49,
+						0, 0, 0, 0, 0, 48, 18, 0, 0, 77, 0, 0, 0, 0, 54, 0,
+						0, 192, 0, 0, 0, 59, 197, 0, 15, 0, 0, 98, 111, 40, 0, 0,
+						0, 0, 138, 0, 0, 159, 0, 0, 70, 0, 90, 73, 0, 50, 167, 153,
+						20, 145, 208, 0, 27, 0, 42, 0, 0, 0, 164, 0, 0, 0, 0, 160,
+						0, 184, 95, 0, 83, 0, 13, 0, 0, 4, 0, 0, 0, 0, 0, 0,
+						0, 105, 0, 186, 0, 53, 52, 110, 60, 0, 0, 72, 79, 0, 0, 0,
+						0, 0, 0, 141, 0, 0, 134, 0, 47, 0, 0, 195, 0, 0, 0, 0,
+						203, 35, 0, 155, 41, 0, 0, 87, 113, 0, 0, 39, 3, 0, 63, 0,
+						174, 0, 0, 71, 43, 179, 125, 0, 0, 0, 0, 0, 0, 0, 0, 168,
+						61, 0, 0, 0, 0, 183, 0, 0, 97, 0, 177, 165, 172, 0, 94, 7,
+						0, 0, 0, 93, 139, 0, 100, 0, 0, 24, 102, 0, 132, 0, 96, 0
+					};
+
+				} /* namespace detail */
+
+				/// <summary>
+				/// Header names are plain ASCII tokens, so there's no reason to drag locales
+				/// into case folding.
+				/// </summary>
+				constexpr char FoldHeaderNameCase(const char c)
+				{
+					return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+				}
+
+				/// <summary>
+				/// Computes the case insensitive FNV-1a hash of a header name at compile
+				/// time. This is recursive, so only use it on literals. At runtime, use
+				/// ::ContinueHeaderNameHash(...).
+				/// </summary>
+				constexpr uint32_t HashHeaderName(const char* name, const size_t length, const uint32_t hash = detail::HeaderNameHashOffsetBasis)
+				{
+					return length == 0 ? hash : HashHeaderName(name + 1, length - 1, (hash ^ static_cast<uint8_t>(FoldHeaderNameCase(*name))) * detail::HeaderNameHashPrime);
+				}
+
+				/// <summary>
+				/// Continues the case insensitive FNV-1a hash of a header name over more
+				/// data. Begin with detail::HeaderNameHashOffsetBasis. Yields exactly the
+				/// same result as ::HashHeaderName(...).
+				/// </summary>
+				inline uint32_t ContinueHeaderNameHash(uint32_t hash, const char* data, const size_t length)
+				{
+					for (size_t i = 0; i < length; ++i)
+					{
+						hash ^= static_cast<uint8_t>(FoldHeaderNameCase(data[i]));
+						hash *= detail::HeaderNameHashPrime;
+					}
+
+					return hash;
+				}
+
+				/// <summary>
+				/// Gets the only slot that a header name with the supplied hash may occupy.
+				/// </summary>
+				constexpr size_t GetHeaderIdSlot(const uint32_t nameHash)
+				{
+					return static_cast<size_t>(((nameHash ^ detail::HeaderIdDisplacements[nameHash & ((1u << detail::HeaderIdDisplacementBits) - 1)]) * detail::HeaderIdMixMultiplier) >> (32 - detail::HeaderIdSlotBits));
+				}
+
+				/// <summary>
+				/// Resolves a header name to its HeaderId.
+				/// </summary>
+				/// <param name="name">
+				/// The header name, in any case.
+				/// </param>
+				/// <param name="nameHash">
+				/// The case insensitive hash of the name, as computed by
+				/// ::ContinueHeaderNameHash(...).
+				/// </param>
+				/// <returns>
+				/// The HeaderId of the name, or HeaderId::Unknown if the name isn't known.
+				/// </returns>
+				inline HeaderId GetHeaderId(const boost::string_ref name, const uint32_t nameHash)
+				{
+					const auto id = detail::HeaderIdSlots[GetHeaderIdSlot(nameHash)];
+
+					const auto& known = detail::KnownHeaderNames[id];
+
+					if (id == 0 || known.length != name.size())
+					{
+						return HeaderId::Unknown;
+					}
+
+					for (size_t i = 0; i < known.length; ++i)
+					{
+						if (FoldHeaderNameCase(known.name[i]) != FoldHeaderNameCase(name[i]))
+						{
+							return HeaderId::Unknown;
+						}
+					}
+
+					return static_cast<HeaderId>(id);
+				}
+
+				/// <summary>
+				/// Resolves a header name to its HeaderId.
+				/// </summary>
+				/// <param name="name">
+				/// The header name, in any case.
+				/// </param>
+				/// <returns>
+				/// The HeaderId of the name, or HeaderId::Unknown if the name isn't known.
+				/// </returns>
+				inline HeaderId GetHeaderId(const boost::string_ref name)
+				{
+					return GetHeaderId(name, ContinueHeaderNameHash(detail::HeaderNameHashOffsetBasis, name.data(), name.size()));
+				}
+
+				/// <summary>
+				/// Gets the name of a known header, as it should be written on the wire.
+				/// </summary>
+				/// <param name="id">
+				/// The HeaderId.
+				/// </param>
+				/// <returns>
+				/// The name of the header, or an empty string for HeaderId::Unknown.
+				/// </returns>
+				inline boost::string_ref GetHeaderName(const HeaderId id)
+				{
+					const auto& known = detail::KnownHeaderNames[static_cast<size_t>(id) < HeaderIdCount ? static_cast<size_t>(id) : 0];
+
+					return boost::string_ref(known.name, known.length);
+				}
+
+				namespace detail
+				{
+
+					/// <summary>
+					/// Verifies that every known header name in the supplied id range lands in the
+					/// slot holding its own id. Splits the range in half on every step, so that the
+					/// recursion stays shallow enough for any compiler.
+					/// </summary>
+					constexpr bool IsHeaderIdTablePerfect(const size_t first, const size_t last)
+					{
+						return (last - first) == 1 ?
+							HeaderIdSlots[GetHeaderIdSlot(HashHeaderName(KnownHeaderNames[first].name, KnownHeaderNames[first].length))] == first :
+							IsHeaderIdTablePerfect(first, first + ((last - first) / 2)) && IsHeaderIdTablePerfect(first + ((last - first) / 2), last);
+					}
+
+				} /* namespace detail */
+
+				static_assert(detail::IsHeaderIdTablePerfect(1, HeaderIdCount), u8"The HeaderId tables are inconsistent. Regenerate KnownHttpHeaderIds.hpp with GenerateKnownHttpHeaderIds.py.");
+
+			} /* namespace http */
+		} /* namespace util */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file
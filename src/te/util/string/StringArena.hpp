@@ -0,0 +1,222 @@
+/*
+* Copyright (c) 2016 Jesse Nicholson.
+*
+* This file is part of Http Filtering Engine.
+*
+* Http Filtering Engine is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published
+* by the Free Software Foundation, either version 3 of the License, or (at
+* your option) any later version.
+*
+* In addition, as a special exception, the copyright holders give
+* permission to link the code of portions of this program with the OpenSSL
+* library.
+*
+* You must obey the GNU General Public License in all respects for all of
+* the code used other than OpenSSL. If you modify file(s) with this
+* exception, you may extend this exception to your version of the file(s),
+* but you are not obligated to do so. If you do not wish to do so, delete
+* this exception statement from your version. If you delete this exception
+* statement from all source files in the program, then also delete it
+* here.
+*
+* Http Filtering Engine is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Http Filtering Engine. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace te
+{
+	namespace httpengine
+	{
+		namespace util
+		{
+			namespace string
+			{
+
+				/// <summary>
+				/// The StringArena is a simple append-only store for immutable strings. Rather
+				/// than allocating every string individually, which for tens of thousands of
+				/// short strings means tens of thousands of heap allocations, each with their own
+				/// bookkeeping overhead, strings are packed back to back into large blocks.
+				/// Stored strings are handed back as string_ref objects, which remain valid until
+				/// the arena is cleared or destroyed. Individual strings cannot be released.
+				/// 
+				/// This class is not thread safe. Callers must synchronize storage themselves.
+				/// Reading through the returned string_ref objects is of course safe from any
+				/// number of threads.
+				/// </summary>
+				class StringArena
+				{
+
+				public:
+
+					/// <summary>
+					/// The default size of each block allocated by the arena.
+					/// </summary>
+					static constexpr size_t DefaultBlockSize = 64 * 1024;
+
+					/// <summary>
+					/// Constructs a new, empty arena.
+					/// </summary>
+					/// <param name="blockSize">
+					/// The size of each block allocated by the arena. Strings larger than this are
+					/// given a block of their own.
+					/// </param>
+					StringArena(const size_t blockSize = DefaultBlockSize) : m_blockSize(blockSize)
+					{
+
+					}
+
+					/// <summary>
+					/// Copies the supplied string into the arena.
+					/// </summary>
+					/// <param name="str">
+					/// The string to store.
+					/// </param>
+					/// <returns>
+					/// A reference to the stored copy of the string, valid for as long as the arena
+					/// is neither cleared nor destroyed.
+					/// </returns>
+					boost::string_ref Store(boost::string_ref str)
+					{
+						if (str.size() == 0)
+						{
+							return boost::string_ref();
+						}
+
+						if (str.size() > m_blockSize)
+						{
+							// Too big to ever fit in a regular block, so it gets its own. We put it
+							// in front of the current block so that the remaining space in the
+							// current block isn't wasted.
+							std::unique_ptr<char[]> oversized(new char[str.size()]);
+							std::memcpy(oversized.get(), str.data(), str.size());
+
+							boost::string_ref stored(oversized.get(), str.size());
+
+							if (m_blocks.empty())
+							{
+								// There is no current block, so the oversized block must never be
+								// mistaken for one.
+								m_blocks.push_back(std::move(oversized));
+								m_blockUsed = m_blockSize;
+								m_lastBlockSize = str.size();
+							}
+							else
+							{
+								m_blocks.insert(m_blocks.end() - 1, std::move(oversized));
+							}
+
+							m_bytesAllocated += str.size();
+
+							return stored;
+						}
+
+						if (m_blocks.empty() || m_blockSize - m_blockUsed < str.size())
+						{
+							m_blocks.emplace_back(new char[m_blockSize]);
+							m_blockUsed = 0;
+							m_bytesAllocated += m_blockSize;
+							m_lastBlockSize = m_blockSize;
+						}
+
+						char* dest = m_blocks.back().get() + m_blockUsed;
+						std::memcpy(dest, str.data(), str.size());
+						m_blockUsed += str.size();
+
+						return boost::string_ref(dest, str.size());
+					}
+
+					/// <summary>
+					/// Releases all memory held by the arena, invalidating every string_ref
+					/// previously returned by ::Store(...).
+					/// </summary>
+					void Clear()
+					{
+						m_blocks.clear();
+						m_blockUsed = 0;
+						m_bytesAllocated = 0;
+						m_lastBlockSize = 0;
+					}
+
+					/// <summary>
+					/// Invalidates every string_ref previously returned by ::Store(...), just like
+					/// ::Clear(), but holds on to the last block so that an arena which is reset
+					/// and refilled over and over again doesn't have to allocate every time.
+					/// </summary>
+					void Reset()
+					{
+						if (m_blocks.empty())
+						{
+							return;
+						}
+
+						// The last block is either a regular block or an oversized block that was
+						// the very first allocation. Either way it's at least m_blockSize long, so
+						// it's safe to reuse as a regular block.
+						auto last = std::move(m_blocks.back());
+
+						m_blocks.clear();
+						m_blocks.push_back(std::move(last));
+
+						m_blockUsed = 0;
+						m_bytesAllocated = m_lastBlockSize;
+					}
+
+					/// <summary>
+					/// Gets the total number of bytes allocated by the arena.
+					/// </summary>
+					/// <returns>
+					/// The total number of bytes allocated by the arena.
+					/// </returns>
+					const size_t GetBytesAllocated() const
+					{
+						return m_bytesAllocated;
+					}
+
+				private:
+
+					/// <summary>
+					/// The size of each regular block.
+					/// </summary>
+					size_t m_blockSize;
+
+					/// <summary>
+					/// All allocated blocks. The last block is always the one currently being
+					/// filled.
+					/// </summary>
+					std::vector<std::unique_ptr<char[]>> m_blocks;
+
+					/// <summary>
+					/// How much of the last block has been used.
+					/// </summary>
+					size_t m_blockUsed = 0;
+
+					/// <summary>
+					/// Total bytes allocated across all blocks.
+					/// </summary>
+					size_t m_bytesAllocated = 0;
+
+					/// <summary>
+					/// The size of the last block in m_blocks.
+					/// </summary>
+					size_t m_lastBlockSize = 0;
+
+				};
+
+			} /* namespace string */
+		} /* namespace util */
+	} /* namespace httpengine */
+} /* namespace te */
\ No newline at end of file